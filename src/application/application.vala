@@ -24,21 +24,30 @@ namespace ScrapperD
       private Advertise.Clock? adv_clock = null;
       private Advertise.Peeker? adv_peeker = null;
       private Advertise.Hub adv_hub;
-      public Kademlia.DBus.NetworkHub hub { get; private construct; }
+      private Metrics.Exporter? exporter = null;
+      private Metrics.TraceFormat trace_format = Metrics.TraceFormat.CHROME;
+      private string? trace_path = null;
+      public Kademlia.DBus.Hub? hub { get; private set; default = null; }
+      public uint write_quorum { get; private set; default = 1; }
 
       construct
         {
           adv_hub = new Advertise.Hub ();
-          hub = new Kademlia.DBus.NetworkHub ();
 
           adv_hub.ensure_protocol (typeof (Kademlia.Ad.Protocol));
 
           add_main_option ("address", 'a', 0, GLib.OptionArg.STRING_ARRAY, "Address of entry node", "ADDRESS");
           add_main_option ("advertise-interval", 0, 0, GLib.OptionArg.INT, "Advertise interval", "MILLISECONDS");
           add_main_option ("advertise-port", 0, 0, GLib.OptionArg.INT, "Advertise port", "PORT");
+          add_main_option ("metrics-port", 0, 0, GLib.OptionArg.INT, "Port where to serve metrics (on loopback only)", "PORT");
           add_main_option ("port", 'p', 0, GLib.OptionArg.INT, "Port where to listen for peer hails", "PORT");
           add_main_option ("public", 0, 0, GLib.OptionArg.STRING_ARRAY, "Public addresses to publish", "ADDRESS");
+          add_main_option ("trace-file", 0, 0, GLib.OptionArg.FILENAME, "Where to dump traced spans on exit", "FILE");
+          add_main_option ("trace-format", 0, 0, GLib.OptionArg.STRING, "Format of dumped spans (chrome or otlp)", "FORMAT");
+          add_main_option ("trace-rate", 0, 0, GLib.OptionArg.DOUBLE, "Fraction of lookups to trace", "RATE");
+          add_main_option ("transport", 0, 0, GLib.OptionArg.STRING, "Protocol spoken between nodes (dbus or wire)", "TRANSPORT");
           add_main_option ("version", 'V', 0, GLib.OptionArg.NONE, "Print version", null);
+          add_main_option ("write-quorum", 0, 0, GLib.OptionArg.INT, "Replicas which must take a value before its insert succeeds", "COUNT");
         }
 
       protected Application (string application_id, GLib.ApplicationFlags flags)
@@ -66,6 +75,7 @@ namespace ScrapperD
 
           while (true)
             {
+              double option_d;
               int option_i;
               string option_s;
               GLib.VariantIter iter;
@@ -76,7 +86,8 @@ namespace ScrapperD
               var advertise_interval = (int) 5000 /* 5 seconds */;
               var advertise_port = (uint16) Advertise.Ipv4Channel.DEFAULT_PORT;
               var entries = new GLib.SList<string> ();
-              var port = (uint16) Kademlia.DBus.NetworkHub.DEFAULT_PORT;
+              var metrics_port = (uint16) 0;
+              var port = (uint16) 0;
 
               if (options.lookup ("address", "as", out iter)) while (iter.next ("s", out option_s))
                 {
@@ -108,6 +119,20 @@ namespace ScrapperD
                   break;
                 }
 
+              if (options.lookup ("metrics-port", "i", out option_i))
+                {
+                  if (option_i > uint16.MIN && option_i < uint16.MAX)
+
+                    metrics_port = (uint16) option_i;
+                  else
+                    {
+                      good = false;
+                      cmdline.printerr ("invalid port %i\n", option_i);
+                      cmdline.set_exit_status (1);
+                      break;
+                    }
+                }
+
               if (options.lookup ("port", "i", out option_i))
                 {
                   if (option_i >= uint16.MIN && option_i < uint16.MAX)
@@ -127,7 +152,60 @@ namespace ScrapperD
                   addresses.prepend ((owned) option_s);
                 }
 
-              try { yield hub.add_local_address ("localhost", port, cancellable); } catch (GLib.Error e)
+              if (options.lookup ("trace-file", "^ay", out option_s))
+                {
+                  trace_path = (owned) option_s;
+                }
+
+              if (options.lookup ("trace-format", "s", out option_s)) switch (option_s)
+                {
+                  case "chrome": trace_format = Metrics.TraceFormat.CHROME; break;
+                  case "otlp": trace_format = Metrics.TraceFormat.OTLP; break;
+                  default:
+
+                    good = false;
+                    cmdline.printerr ("unknown trace format %s\n", option_s);
+                    cmdline.set_exit_status (1);
+                    break;
+                }
+
+              if (unlikely (good == false)) break;
+
+              /* every node of a network has to speak the same one, peers belong to a single hub */
+              if (options.lookup ("transport", "s", out option_s) == false || option_s == "dbus")
+
+                hub = new Kademlia.DBus.NetworkHub ();
+
+              else if (option_s == "wire")
+
+                hub = new Kademlia.DBus.WireHub ();
+              else
+                {
+                  good = false;
+                  cmdline.printerr ("unknown transport %s\n", option_s);
+                  cmdline.set_exit_status (1);
+                  break;
+                }
+
+              var default_port = hub is Kademlia.DBus.WireHub ? Kademlia.DBus.WireHub.DEFAULT_PORT : Kademlia.DBus.NetworkHub.DEFAULT_PORT;
+
+              if (options.contains ("port") == false) port = default_port;
+
+              if (options.lookup ("trace-rate", "d", out option_d))
+                {
+                  if (option_d >= 0 && option_d <= 1)
+
+                    Metrics.Tracer.get_default ().rate = option_d;
+                  else
+                    {
+                      good = false;
+                      cmdline.printerr ("invalid trace rate %g\n", option_d);
+                      cmdline.set_exit_status (1);
+                      break;
+                    }
+                }
+
+              try { yield listen ("localhost", port, cancellable); } catch (GLib.Error e)
                 {
                   good = false;
                   cmdline.printerr ("can not listen on localhost: %s: %u: %s\n", e.domain.to_string (), e.code, e.message);
@@ -135,7 +213,7 @@ namespace ScrapperD
                   break;
                 }
 
-              foreach (unowned var address in addresses) try { yield hub.add_local_address (address, port, cancellable); } catch (GLib.Error e)
+              foreach (unowned var address in addresses) try { yield listen (address, port, cancellable); } catch (GLib.Error e)
                 {
                   good = false;
                   cmdline.printerr ("can not listen on localhost: %s: %u: %s\n", e.domain.to_string (), e.code, e.message);
@@ -145,6 +223,35 @@ namespace ScrapperD
 
               if (unlikely (good == false)) break;
 
+              if (options.lookup ("write-quorum", "i", out option_i))
+                {
+                  if (option_i >= 1 && option_i <= Kademlia.Buckets.MAXSPAN)
+
+                    write_quorum = (uint) option_i;
+                  else
+                    {
+                      good = false;
+                      cmdline.printerr ("invalid write quorum %i\n", option_i);
+                      cmdline.set_exit_status (1);
+                      break;
+                    }
+                }
+
+              if (metrics_port > 0)
+                {
+                  exporter = new Metrics.Exporter ();
+
+                  try { exporter.add_address (new GLib.InetSocketAddress.from_string ("127.0.0.1", metrics_port)); } catch (GLib.Error e)
+                    {
+                      good = false;
+                      cmdline.printerr ("can not serve metrics: %s: %u: %s\n", e.domain.to_string (), e.code, e.message);
+                      cmdline.set_exit_status (1);
+                      break;
+                    }
+
+                  exporter.start ();
+                }
+
               try { ipv4_channel = new Advertise.Ipv4Channel (advertise_port); } catch (GLib.Error e)
                 {
                   good = false;
@@ -153,7 +260,12 @@ namespace ScrapperD
                   break;
                 }
 
-              try { yield register_peers (); } catch (GLib.Error e)
+              try
+                {
+                  yield register_peers ();
+                  hub.foreach_local ((id, role, peer) => peer.write_quorum = write_quorum);
+                }
+              catch (GLib.Error e)
                 {
                   good = false;
                   cmdline.printerr ("can not register peers: %s: %u: %s\n", e.domain.to_string (), e.code, e.message);
@@ -161,9 +273,7 @@ namespace ScrapperD
                   break;
                 }
 
-              var default_port = Kademlia.DBus.NetworkHub.DEFAULT_PORT;
-
-              foreach (unowned var host_and_port in entries) try { yield hub.join_at (host_and_port, default_port, null, cancellable); } catch (GLib.Error e)
+              foreach (unowned var host_and_port in entries) try { yield join_at (host_and_port, default_port, cancellable); } catch (GLib.Error e)
                 {
                   var address = host_and_port;
                   try { address = GLib.NetworkAddress.parse (host_and_port, default_port).to_string (); } catch (GLib.Error e) { }
@@ -196,7 +306,12 @@ namespace ScrapperD
                 }
 
               hold ();
-              hub.start ();
+
+              if (hub is Kademlia.DBus.WireHub)
+
+                ((Kademlia.DBus.WireHub) hub).start ();
+              else
+                ((Kademlia.DBus.NetworkHub) hub).start ();
 
               adv_hub.add_channel (ipv4_channel);
               adv_clock = new Advertise.Clock (adv_hub, advertise_interval);
@@ -209,6 +324,24 @@ namespace ScrapperD
           return good;
         }
 
+      private async bool join_at (string host_and_port, uint16 default_port, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          if (hub is Kademlia.DBus.WireHub)
+
+            return yield ((Kademlia.DBus.WireHub) hub).join_at (host_and_port, default_port, null, cancellable);
+          else
+            return yield ((Kademlia.DBus.NetworkHub) hub).join_at (host_and_port, default_port, null, cancellable);
+        }
+
+      private async void listen (string host_and_port, uint16 default_port, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          if (hub is Kademlia.DBus.WireHub)
+
+            yield ((Kademlia.DBus.WireHub) hub).add_local_address (host_and_port, default_port, cancellable);
+          else
+            yield ((Kademlia.DBus.NetworkHub) hub).add_local_address (host_and_port, default_port, cancellable);
+        }
+
       private void on_got_ad (Advertise.Ad ad)
         {
           foreach (unowned var proto in ad.protocols) if (proto.name == Kademlia.Ad.Protocol.PROTO_NAME)
@@ -241,6 +374,13 @@ namespace ScrapperD
         {
           adv_clock?.stop ();
           adv_peeker?.stop ();
+          exporter?.stop ();
+
+          if (trace_path != null) try { Metrics.Tracer.get_default ().dump (trace_path, trace_format); } catch (GLib.Error e)
+            {
+              warning ("can not dump spans: %s: %u: %s", e.domain.to_string (), e.code, e.message);
+            }
+
           base.shutdown ();
         }
 
@@ -0,0 +1,238 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+[CCode (cprefix = "K", lower_case_cprefix = "k_")]
+
+namespace Kademlia
+{
+  internal enum BatchKind
+    {
+      FIND,
+      STORE,
+    }
+
+  /* one caller's query, shared by the caller and the batch carrying it */
+  internal class Pending
+    {
+      public unowned PendingBatch? batch = null;
+      public GLib.SourceFunc callback;
+      public bool done = false;
+      public GLib.Error? error = null;
+      public Value? found = null;
+      public Key key;
+      public bool stored = false;
+      public Metrics.TraceContext trace;
+      public GLib.Value? value;
+
+      public Pending (Key key, GLib.Value? value, Metrics.TraceContext trace)
+        {
+          this.key = key.copy ();
+          this.trace = trace;
+          this.value = value;
+        }
+    }
+
+  [Compact (opaque = true)]
+
+  internal class PendingBatch
+    {
+      public GLib.Cancellable cancellable = new GLib.Cancellable ();
+      public GLib.GenericArray<Pending> items = new GLib.GenericArray<Pending> ();
+      public uint live = 0;
+      public Key peer_id;
+      public GLib.Source? source = null;
+
+      public PendingBatch (Key peer_id)
+        {
+          this.peer_id = peer_id.copy ();
+        }
+    }
+
+  /*
+   * Gathers requests of one kind bound for the same peer while the caller's
+   * main loop spins (or for ValuePeer.batch_window milliseconds), so they
+   * travel as a single find_values / store_values call. A cancelled request
+   * leaves its batch at once if the batch was not sent yet; otherwise its
+   * caller gets resumed without waiting for the reply, and the call itself
+   * gets cancelled once no request in it is left waiting.
+   */
+
+  internal class Batcher
+    {
+      public const uint MAXBATCH = 128;
+
+      private HashTable<Key, PendingBatch> batches;
+      private BatchKind kind;
+      private unowned ValuePeer peer;
+
+      public Batcher (ValuePeer peer, BatchKind kind)
+        {
+          this.batches = new HashTable<Key, PendingBatch> (Key.hash, Key.equal);
+          this.kind = kind;
+          this.peer = peer;
+        }
+
+      private void cancel (Pending pending)
+        {
+          GLib.Cancellable? call = null;
+          PendingBatch? dropped = null;
+          Key? stolen = null;
+
+          lock (batches)
+            {
+              unowned var batch = pending.batch;
+
+              if (pending.done)
+
+                return;
+
+              pending.done = true;
+              pending.error = new IOError.CANCELLED ("operation was cancelled");
+
+              if (batch.source == null)
+                {
+                  if (--batch.live == 0) call = batch.cancellable;
+                }
+              else
+                {
+                  batch.items.remove (pending);
+
+                  if (batch.items.length == 0)
+                    {
+                      batches.steal_extended (batch.peer_id, out stolen, out dropped);
+                      dropped.source.destroy ();
+                    }
+                }
+            }
+
+          call?.cancel ();
+          pending.callback ();
+        }
+
+      /* resumes whoever still waits on the batch's requests */
+      public void complete (PendingBatch batch, GLib.Error? error)
+        {
+          var resume = new GLib.GenericArray<Pending> ();
+
+          lock (batches) foreach (unowned var pending in batch.items) if (pending.done == false)
+            {
+              pending.done = true;
+              if (error != null) pending.error = error.copy ();
+              resume.add (pending);
+            }
+
+          foreach (unowned var pending in resume) pending.callback ();
+        }
+
+      public async Value find (Key peer_id, Key id, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var pending = new Pending (id, null, trace);
+          yield submit (peer_id, pending, cancellable);
+          return (owned) pending.found;
+        }
+
+      public async bool store (Key peer_id, Key id, GLib.Value? value, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var pending = new Pending (id, value, trace);
+          yield submit (peer_id, pending, cancellable);
+          return pending.stored;
+        }
+
+      private void enqueue (Key peer_id, Pending pending)
+        {
+          unowned PendingBatch? batch;
+          bool full;
+
+          lock (batches)
+            {
+              if ((batch = batches.lookup (peer_id)) == null)
+                {
+                  var key = peer_id.copy ();
+                  var source = new GLib.TimeoutSource (peer.batch_window);
+
+                  batches.insert (peer_id.copy (), new PendingBatch (peer_id));
+                  batch = batches.lookup (peer_id);
+                  batch.source = source;
+
+                  source.set_callback (() => { flush (key); return GLib.Source.REMOVE; });
+                  source.attach (GLib.MainContext.get_thread_default ());
+                }
+
+              pending.batch = batch;
+              batch.items.add (pending);
+              full = batch.items.length >= MAXBATCH;
+            }
+
+          if (full) flush (peer_id);
+        }
+
+      private void flush (Key peer_id)
+        {
+          Key key;
+          PendingBatch? batch;
+          GLib.Source source;
+
+          lock (batches)
+            {
+              if (batches.steal_extended (peer_id, out key, out batch) == false)
+
+                return;
+
+              batch.live = batch.items.length;
+              source = (owned) batch.source;
+            }
+
+          source.destroy ();
+          peer.dispatch_batch.begin (kind, (owned) key, (owned) batch);
+        }
+
+      /* queues pending and waits for its batch, or for cancellable */
+      private async void submit (Key peer_id, Pending pending, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          ulong handler_id = 0;
+
+          cancellable?.set_error_if_cancelled ();
+
+          pending.callback = submit.callback;
+          enqueue (peer_id, pending);
+
+          /* resuming from inside the handler would disconnect it from itself (and deadlock) */
+          if (cancellable != null)
+            {
+              var context = GLib.MainContext.ref_thread_default ();
+
+              handler_id = cancellable.connect (() =>
+                {
+                  var source = new GLib.IdleSource ();
+
+                  source.set_callback (() => { cancel (pending); return GLib.Source.REMOVE; });
+                  source.attach (context);
+                });
+            }
+
+          yield;
+
+          if (cancellable != null)
+
+            cancellable.disconnect (handler_id);
+
+          if (unlikely (pending.error != null))
+
+            throw pending.error.copy ();
+        }
+    }
+}
@@ -17,93 +17,261 @@
 #ifndef __KADEMLIA_BUCKET__
 #define __KADEMLIA_BUCKET__ 1
 #include <glib.h>
+#include <keyval.h>
+#include <string.h>
 
-typedef struct _KKey KKey;
 typedef struct _KBucket KBucket;
+typedef enum _KBucketSlot KBucketSlot;
 typedef struct _KStaleContact KStaleContact;
 
 #if __cplusplus
 extern "C" {
 #endif // __cplusplus
 
+  /*
+   * Every contact known by a bucket lives in exactly one of its three arrays,
+   * and the slots table tells which one without scanning any of them. Arrays
+   * keep the most recently seen contact at the end, so touching a contact is
+   * a short memmove over (at most) MAXSPAN inline keys.
+   */
+
+  enum _KBucketSlot
+    {
+      K_BUCKET_SLOT_NONE = 0,
+      K_BUCKET_SLOT_NODE,
+      K_BUCKET_SLOT_REPLACEMENT,
+      K_BUCKET_SLOT_STALE,
+    };
+
   struct _KBucket
     {
       guint index;
       gint64 lastlookup;
-      GQueue nodes;
-      GQueue replacements;
-      GQueue stale;
+      GArray* nodes;
+      GArray* replacements;
+      GArray* stale;
+      GHashTable* slots;
     };
 
   struct _KStaleContact
     {
       guint drop_count;
-      KKey* key;
+      KKeyVal key;
       gint64 lastping;
     };
 
-  KKey* k_key_copy (KKey * self);
-  void k_key_free (KKey * self);
+  static __inline void k_bucket_free (KBucket* bucket);
+  static __inline KBucket* k_bucket_new (guint index);
+
+  static __inline guint _k_bucket_slot_hash (gconstpointer key)
+    {
+      return k_key_val_hash ((const KKeyVal*) key);
+    }
+
+  static __inline gboolean _k_bucket_slot_equal (gconstpointer a, gconstpointer b)
+    {
+      return k_key_val_cmp ((const KKeyVal*) a, (const KKeyVal*) b);
+    }
+
+  static __inline GArray* _k_bucket_array (KBucket* bucket, KBucketSlot slot)
+    {
+      switch (slot)
+        {
+          case K_BUCKET_SLOT_NODE: return bucket->nodes;
+          case K_BUCKET_SLOT_REPLACEMENT: return bucket->replacements;
+          case K_BUCKET_SLOT_STALE: return bucket->stale;
+          default: g_return_val_if_reached (NULL);
+        }
+    }
+
+  static __inline gint _k_bucket_array_find (GArray* array, KBucketSlot slot, const KKeyVal* key)
+    {
+      guint i;
+
+      for (i = array->len; i > 0; --i)
+        {
+          const KKeyVal* other = slot != K_BUCKET_SLOT_STALE
+
+            ? & g_array_index (array, KKeyVal, i - 1)
+            : & g_array_index (array, KStaleContact, i - 1).key;
 
-  #define k_bucket_get_nodes(val) (&(val)->nodes)
-  #define k_bucket_get_replacements(val) (&(val)->replacements)
-  #define k_bucket_get_stale(val) (&(val)->stale)
+          if (k_key_val_cmp (other, key)) return (gint) (i - 1);
+        }
+      return -1;
+    }
+
+  static __inline void k_bucket_free (KBucket* bucket)
+    {
+      g_array_unref (bucket->nodes);
+      g_array_unref (bucket->replacements);
+      g_array_unref (bucket->stale);
+      g_hash_table_unref (bucket->slots);
+      g_free (bucket);
+    }
 
-  static __inline void k_bucket_destroy (KBucket* bucket);
-  static __inline void k_bucket_init (KBucket* bucket, guint index);
-  static __inline void k_stale_contact_copy (KStaleContact* src, KStaleContact* dst);
-  static __inline void k_stale_contact_destroy (KStaleContact* contact);
-  static __inline void k_stale_contact_init (KStaleContact* contact, KKey* key);
+  static __inline guint k_bucket_get_n_nodes (KBucket* bucket)
+    {
+      return bucket->nodes->len;
+    }
 
-  static __inline void k_bucket_destroy (KBucket* bucket)
+  static __inline guint k_bucket_get_n_replacements (KBucket* bucket)
     {
-      g_queue_clear_full (& bucket->nodes, (GDestroyNotify) k_key_free);
-      g_queue_clear_full (& bucket->replacements, (GDestroyNotify) k_key_free);
-      g_queue_clear_full (& bucket->stale, (GDestroyNotify) k_stale_contact_destroy);
+      return bucket->replacements->len;
     }
 
-  static __inline void k_bucket_init (KBucket* bucket, guint index)
+  static __inline guint k_bucket_get_n_stale (KBucket* bucket)
     {
-      g_return_if_fail (index < G_MAXINT);
+      return bucket->stale->len;
+    }
+
+  static __inline KBucketSlot k_bucket_lookup (KBucket* bucket, const KKeyVal* key)
+    {
+      return (KBucketSlot) GPOINTER_TO_UINT (g_hash_table_lookup (bucket->slots, key));
+    }
+
+  static __inline KBucket* k_bucket_new (guint index)
+    {
+      g_return_val_if_fail (index < G_MAXINT, NULL);
+      KBucket* bucket = g_new (KBucket, 1);
 
       bucket->index = index;
-      g_queue_init (& bucket->nodes);
-      g_queue_init (& bucket->replacements);
-      g_queue_init (& bucket->stale);
+      bucket->lastlookup = 0;
+      bucket->nodes = g_array_new (FALSE, FALSE, sizeof (KKeyVal));
+      bucket->replacements = g_array_new (FALSE, FALSE, sizeof (KKeyVal));
+      bucket->stale = g_array_new (FALSE, FALSE, sizeof (KStaleContact));
+      bucket->slots = g_hash_table_new_full (_k_bucket_slot_hash, _k_bucket_slot_equal, g_free, NULL);
+      return bucket;
+    }
+
+  /* nth most recently seen (0 is the newest one) */
+  static __inline KKeyVal* k_bucket_nth_node (KBucket* bucket, guint nth)
+    {
+      g_return_val_if_fail (nth < bucket->nodes->len, NULL);
+      return & g_array_index (bucket->nodes, KKeyVal, bucket->nodes->len - 1 - nth);
+    }
+
+  static __inline KStaleContact* k_bucket_nth_stale (KBucket* bucket, guint nth)
+    {
+      g_return_val_if_fail (nth < bucket->stale->len, NULL);
+      return & g_array_index (bucket->stale, KStaleContact, bucket->stale->len - 1 - nth);
     }
 
-  static __inline gboolean k_queue_bring_front (GQueue* queue, gpointer data, GCompareFunc func)
+  static __inline gboolean k_bucket_pop_replacement (KBucket* bucket, KKeyVal* key)
     {
-      GList* link;
+      guint last;
 
-      if ((link = g_queue_find_custom (queue, data, func)) == NULL)
+      if ((last = bucket->replacements->len) == 0)
 
         return FALSE;
       else
         {
-          g_queue_unlink (queue, link);
-          g_queue_push_head_link (queue, link);
+          (void) k_key_val_copy (& g_array_index (bucket->replacements, KKeyVal, last - 1), key);
+          g_array_set_size (bucket->replacements, last - 1);
+          g_hash_table_remove (bucket->slots, key);
         }
       return TRUE;
     }
 
-  static __inline void k_stale_contact_copy (KStaleContact* src, KStaleContact* dst)
+  static __inline void _k_bucket_push (KBucket* bucket, KBucketSlot slot, const KKeyVal* key, gboolean newest)
+    {
+      GArray* array = _k_bucket_array (bucket, slot);
+
+      if (slot != K_BUCKET_SLOT_STALE)
+        {
+          if (newest)
+            g_array_append_vals (array, key, 1);
+          else
+            g_array_prepend_vals (array, key, 1);
+        }
+      else
+        {
+          KStaleContact contact = { .drop_count = 0, .lastping = 0, };
+
+          (void) k_key_val_copy (key, & contact.key);
+
+          if (newest)
+            g_array_append_vals (array, & contact, 1);
+          else
+            g_array_prepend_vals (array, & contact, 1);
+        }
+
+      g_hash_table_insert (bucket->slots, g_memdup2 (key, sizeof (KKeyVal)), GUINT_TO_POINTER (slot));
+    }
+
+  /* pushes as the least recently seen node (the one evicted last) */
+  static __inline void k_bucket_push_node_oldest (KBucket* bucket, const KKeyVal* key)
+    {
+      _k_bucket_push (bucket, K_BUCKET_SLOT_NODE, key, FALSE);
+    }
+
+  static __inline void k_bucket_push_node (KBucket* bucket, const KKeyVal* key)
+    {
+      _k_bucket_push (bucket, K_BUCKET_SLOT_NODE, key, TRUE);
+    }
+
+  static __inline void k_bucket_push_replacement (KBucket* bucket, const KKeyVal* key)
     {
-      k_stale_contact_init (dst, src->key);
+      _k_bucket_push (bucket, K_BUCKET_SLOT_REPLACEMENT, key, TRUE);
     }
 
-  static __inline void k_stale_contact_destroy (KStaleContact* contact)
+  static __inline void k_bucket_push_stale (KBucket* bucket, const KKeyVal* key)
     {
-      g_clear_pointer (& contact->key, (GDestroyNotify) k_key_free);
+      _k_bucket_push (bucket, K_BUCKET_SLOT_STALE, key, TRUE);
     }
 
-  static __inline void k_stale_contact_init (KStaleContact* contact, KKey* key)
+  static __inline KStaleContact* k_bucket_find_stale (KBucket* bucket, const KKeyVal* key)
     {
-      g_return_if_fail (key != NULL);
+      gint at;
 
-      contact->drop_count = 0;
-      contact->key = k_key_copy (key);
-      contact->lastping = 0;
+      if (k_bucket_lookup (bucket, key) != K_BUCKET_SLOT_STALE)
+        return NULL;
+      if ((at = _k_bucket_array_find (bucket->stale, K_BUCKET_SLOT_STALE, key)) < 0)
+        g_return_val_if_reached (NULL);
+
+      return & g_array_index (bucket->stale, KStaleContact, at);
+    }
+
+  static __inline gboolean k_bucket_remove (KBucket* bucket, const KKeyVal* key)
+    {
+      KBucketSlot slot;
+      GArray* array;
+      gint at;
+
+      if ((slot = k_bucket_lookup (bucket, key)) == K_BUCKET_SLOT_NONE)
+        return FALSE;
+      if ((at = _k_bucket_array_find (array = _k_bucket_array (bucket, slot), slot, key)) < 0)
+        g_return_val_if_reached (FALSE);
+
+      g_array_remove_index (array, at);
+      g_hash_table_remove (bucket->slots, key);
+      return TRUE;
+    }
+
+  /* marks a contact as the most recently seen one within its array */
+  static __inline gboolean k_bucket_touch (KBucket* bucket, const KKeyVal* key)
+    {
+      KBucketSlot slot;
+      GArray* array;
+      guint size;
+      gint at;
+
+      if ((slot = k_bucket_lookup (bucket, key)) == K_BUCKET_SLOT_NONE)
+        return FALSE;
+      if ((at = _k_bucket_array_find (array = _k_bucket_array (bucket, slot), slot, key)) < 0)
+        g_return_val_if_reached (FALSE);
+
+      if ((guint) at + 1 < array->len)
+        {
+          guint8 item [sizeof (KStaleContact)];
+          guint8* data = (guint8*) array->data;
+
+          size = g_array_get_element_size (array);
+
+          memcpy (item, data + at * size, size);
+          memmove (data + at * size, data + (at + 1) * size, (array->len - at - 1) * size);
+          memcpy (data + (array->len - 1) * size, item, size);
+        }
+      return TRUE;
     }
 
 #if __cplusplus
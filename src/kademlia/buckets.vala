@@ -22,7 +22,10 @@ namespace Kademlia
   public class Buckets
     {
       public Key self { get; private owned set; }
-      private GLib.List<Bucket?> buckets;
+      [CCode (array_length_cexpr = "K_KEY_BITLEN")]
+      private Bucket? buckets [Key.BITLEN];
+      private Deadlines dormant = new Deadlines ();
+      private Deadlines stale = new Deadlines ();
 
       [CCode (cheader_filename = "glib.h", cname = "G_USEC_PER_SEC")]
 
@@ -39,194 +42,241 @@ namespace Kademlia
 
       public Buckets (owned Key self)
         {
-          this.buckets = new GLib.List<Bucket?> ();
           this.self = (owned) self;
         }
 
       public void awake_range (Key key)
         {
-          unowned var bucket = (Bucket?) search (key, false)?.data;
+          unowned var bucket = search (key, false);
           unowned var now = (int64) GLib.get_monotonic_time ();
-          if (bucket != null) bucket.lastlookup = now;
+
+          if (bucket != null)
+            {
+              bucket.lastlookup = now;
+              dormant.schedule (range_key (bucket.index), now + MAXSLEEPTIME);
+            }
         }
 
-      static int compare_index (Bucket? a, Bucket? b) { return (int) b.index - (int) a.index; }
-      static int compare_index2 (Kademlia.Bucket? a, Kademlia.Bucket? b) { return int.from_pointer ((void*) b) - (int) a.index; }
-      static int compare_key (Key a, Key b) { return Key.equal (a, b) ? 0 : 1; }
-      static int compare_stale_contact (StaleContact? a, StaleContact? b) { return compare_key (a.key, (Key) (void*) b); }
+      /* contacts known, summed over every bucket */
+      public void count (out uint nodes, out uint replacements, out uint stale)
+        {
+          nodes = 0;
+          replacements = 0;
+          stale = 0;
+
+          foreach (unowned var bucket in buckets) if (bucket != null)
+            {
+              nodes += bucket.n_nodes;
+              replacements += bucket.n_replacements;
+              stale += bucket.n_stale;
+            }
+        }
 
       public void drop (Key key) requires (Key.equal (key, self) == false)
         {
-          unowned Kademlia.Bucket? bucket;
-          unowned GLib.List<Key> link = null;
-          unowned GLib.List<StaleContact?> link2 = null;
+          unowned Bucket? bucket;
+          unowned StaleContact? contact;
 
-          if ((bucket = search (key, false)?.data) != null)
+          if ((bucket = search (key, false)) != null) switch (bucket.lookup (key.value))
             {
-              if ((link = bucket.nodes.find_custom (key, compare_key)) != null)
+              case BucketSlot.NODE:
                 {
-                  var t = link.data.copy ();
-                  bucket.nodes.delete_link (link);
-                  bucket.stale.push_head (StaleContact (t));
-                  staled_contact (bucket.stale.head.data.key);
+                  KeyVal replacement;
 
-                  if (bucket.replacements.length > 0)
-                    {
-                      bucket.nodes.push_tail (bucket.replacements.pop_head ());
-                      added_contact (bucket.nodes.head.data);
-                    }
-                }
-              else if ((link2 = bucket.stale.find_custom ((StaleContact?) (void*) key, compare_stale_contact)) != null)
-                {
-                  if (link2.data.drop_count < MAXBACKOFF)
+                  bucket.remove (key.value);
+                  bucket.push_stale (key.value);
+                  stale.schedule (key, GLib.get_monotonic_time ());
+                  staled_contact (key);
 
-                    ++link2.data.drop_count;
-                  else
+                  if (bucket.pop_replacement (out replacement))
                     {
-                      dropped_contact ((Key) link2.data.key);
-                      bucket.stale.delete_link (link2);
+                      bucket.push_node_oldest (replacement);
+                      added_contact (new Key.from_val (replacement));
                     }
+                  break;
                 }
-              else if ((link = bucket.replacements.find_custom (key, compare_key)) != null)
-                {
-                  bucket.replacements.delete_link (link);
-                }
+
+              case BucketSlot.STALE:
+
+                if ((contact = bucket.find_stale (key.value)).drop_count < MAXBACKOFF)
+                  {
+                    ++contact.drop_count;
+                    stale.schedule (key, contact.lastping + (FIRSTSTALETIME << contact.drop_count));
+                  }
+                else
+                  {
+                    bucket.remove (key.value);
+                    stale.cancel (key);
+                    dropped_contact (key);
+                  }
+                break;
+
+              case BucketSlot.REPLACEMENT:
+
+                bucket.remove (key.value);
+                break;
+
+              default: break;
             }
         }
 
       public GLib.List<Key> enumerate_dormant_ranges ()
         {
+          Key? range;
           var list = new GLib.List<Key> ();
           var now = (int64) GLib.get_monotonic_time ();
 
-          foreach (unowned var bucket in buckets) if (now - bucket.lastlookup > MAXSLEEPTIME)
+          while ((range = dormant.pop (now)) != null)
             {
-              if (bucket.nodes.length > 0)
+              unowned var bucket = buckets [Key.distance (self, range)];
+
+              if (bucket.n_nodes > 0)
                 {
-                  var l = (int32) bucket.nodes.length;
+                  var l = (int32) bucket.n_nodes;
                   var n = (uint) GLib.Random.int_range (0, l);
 
-                  list.append (bucket.nodes.head.nth (n).data.copy ());
+                  list.append (new Key.from_val (bucket.nth_node (n)));
                 }
+
+              dormant.schedule (range, now + MAXSLEEPTIME);
             }
           return (owned) list;
         }
 
       public GLib.List<Key> enumerate_stale_contacts ()
         {
+          Key? key;
           var list = new GLib.List<Key> ();
           var now = (int64) GLib.get_monotonic_time ();
 
-          foreach (unowned var bucket in buckets) foreach (unowned var stale in bucket.stale.head)
+          while ((key = stale.pop (now)) != null)
             {
-              if (now - stale.lastping > (FIRSTSTALETIME * (1 << stale.drop_count)))
-                {
-                  list.append (stale.key.copy ());
-                  stale.lastping = now;
-                }
+              unowned var contact = buckets [Key.distance (self, key)].find_stale (key.value);
+
+              /* contact got refreshed or dropped since it was scheduled */
+              if (unlikely (contact == null))
+
+                continue;
+
+              contact.lastping = now;
+              stale.schedule (key, now + (FIRSTSTALETIME << contact.drop_count));
+              list.append ((owned) key);
             }
           return (owned) list;
         }
 
       public bool insert (Key key) requires (Key.equal (key, self) == false)
         {
-          unowned var bucket = (Bucket?) search (key, true).data;
-          unowned var item = (StaleContact?) (void*) key;
+          unowned var bucket = (Bucket) search (key, true);
 
-          if (queue_bring_front<StaleContact?> (bucket.stale, item, compare_stale_contact))
-            {
-              bucket.stale.pop_head ();
-              return insert (key);
-            }
-          else if (queue_bring_front<Key> (bucket.replacements, key, compare_key) == false)
+          switch (bucket.lookup (key.value))
             {
-              if (queue_bring_front<Key> (bucket.nodes, key, compare_key))
+              case BucketSlot.STALE:
+
+                bucket.remove (key.value);
+                stale.cancel (key);
+                return insert (key);
+
+              case BucketSlot.NODE:
+              case BucketSlot.REPLACEMENT:
 
+                bucket.touch (key.value);
                 return false;
-              if (bucket.nodes.length >= MAXSPAN)
-                {
-                  bucket.replacements.push_head (key.copy ());
-                  return false;
-                }
-              else
-                {
-                  bucket.nodes.push_head (key.copy ());
-                  added_contact (bucket.nodes.head.data);
-                  return true;
-                }
+
+              default:
+
+                if (bucket.n_nodes >= MAXSPAN)
+                  {
+                    bucket.push_replacement (key.value);
+                    return false;
+                  }
+                else
+                  {
+                    bucket.push_node (key.value);
+                    added_contact (key);
+                    return true;
+                  }
             }
-          return false;
         }
 
       public GLib.SList<Key> nearest (Key key)
         {
-          var got = 0;
+          KeyVal span [MAXSPAN];
+          var got = nearest_span (key, span);
           var result = new GLib.SList<Key> ();
 
-          unowned GLib.List<Key>? head = null;
-          unowned GLib.List<Bucket?>? pivt = null;
+          for (; got > 0; --got) result.prepend (new Key.from_val (span [got - 1]));
+          return result;
+        }
+
+      /*
+       * Fills span with the contacts nearest to key (self included), nearest
+       * first, and returns how many there were; up to span.length of them
+       */
+      public uint nearest_span (Key key, KeyVal[] span)
+        {
+          var got = (uint) 0;
+          var max = (uint) span.length;
+
+          unowned Bucket? pivt = null;
           unowned int i, j, d;
+          unowned uint n;
 
-          if ((d = Key.distance (self, key)) < 0)
+          if ((d = Key.distance (self, key)) < 0 && got < max)
             {
-              result.prepend (self.copy ());
-              ++got;
+              span [got++] = self.value;
             }
 
-          for (j = 1 + (i = d < 0 ? 0 : d); got < MAXSPAN && (i >= 0 || j < Key.BITLEN); --i, ++j)
+          for (j = 1 + (i = d < 0 ? 0 : d); got < max && (i >= 0 || j < Key.BITLEN); --i, ++j)
             {
               if (i >= 0)
-              if ((pivt = search_index (i, false)) != null)
-              for (head = pivt.data.nodes.head; head != null && got < MAXSPAN; head = head.next)
+              if ((pivt = buckets [i]) != null)
+              for (n = 0; n < pivt.n_nodes && got < max; ++n)
                 {
-                  result.prepend (head.data.copy ());
-                  ++got;
+                  span [got++] = pivt.nth_node (n);
                 }
 
-              if (got >= MAXSPAN) break;
+              if (got >= max) break;
 
               if (j < Key.BITLEN)
-              if ((pivt = search_index (j, false)) != null)
-              for (head = pivt.data.nodes.head; head != null && got < MAXSPAN; head = head.next)
+              if ((pivt = buckets [j]) != null)
+              for (n = 0; n < pivt.n_nodes && got < max; ++n)
                 {
-                  result.prepend (head.data.copy ());
-                  ++got;
+                  span [got++] = pivt.nth_node (n);
                 }
             }
 
-          if (got < MAXSPAN && d >= 0)
+          if (got < max && d >= 0)
             {
-              result.prepend (self.copy ());
-              ++got;
+              span [got++] = self.value;
             }
 
-          result.reverse ();
-
-          return result;
+          return got;
         }
 
-      private unowned GLib.List<Bucket?>? search (Key key, bool create = false)
+      /* a key whose distance to self falls in the index-th bucket */
+      private Key range_key (uint index)
         {
-          return search_index (Key.distance (self, key), create);
+          var key = self.copy ();
+          key.value.bytes [(Key.BITLEN - 1 - index) >> 3] ^= (uint8) (1 << (index & 7));
+          return key;
         }
 
-      private unowned GLib.List<Bucket?>? search_index (int index, bool create = false) requires (index >= 0)
+      private unowned Bucket? search (Key key, bool create = false)
         {
-          unowned GLib.List<Bucket?> link;
-          unowned var data = index.to_pointer ();
+          var index = Key.distance (self, key);
+          return index < 0 ? null : search_index (index, create);
+        }
 
-          do
+      private unowned Bucket? search_index (int index, bool create = false) requires (index >= 0 && index < Key.BITLEN)
+        {
+          if (buckets [index] == null && create)
             {
-              if ((link = buckets.find_custom ((Kademlia.Bucket?) data, compare_index2)) != null)
-
-                return link;
-              else if (create == false) return null; else
-                {
-                  buckets.insert_sorted (Bucket (index), compare_index);
-                  continue;
-                }
+              buckets [index] = new Bucket ((uint) index);
+              dormant.schedule (range_key ((uint) index), GLib.get_monotonic_time ());
             }
-          while (true);
+
+          return buckets [index];
         }
     }
 }
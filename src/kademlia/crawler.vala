@@ -27,7 +27,7 @@ namespace Kademlia
         {
           CompareDataFunc<Key> sorter = (a, b) =>
             {
-              return Key.distance (a, key) - Key.distance (b, key);
+              return Key.compare_distance (a, b, key);
             };
 
           return (owned) sorter;
@@ -0,0 +1,178 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+[CCode (cprefix = "K", lower_case_cprefix = "k_")]
+
+namespace Kademlia
+{
+  /*
+   * Keys ordered by the (monotonic or wall clock, caller's choice) time they
+   * are next due at, kept as an indexed binary min-heap: scheduling, moving
+   * and cancelling a key are O(log n) and draining what expired costs
+   * O(expired log n), no matter how many keys are tracked. Not thread safe.
+   */
+
+  public class Deadlines
+    {
+      [Compact (opaque = true)]
+
+      class Node
+        {
+          public int64 due;
+          public Key key;
+          public uint position;
+
+          public Node (owned Key key, int64 due, uint position)
+            {
+              this.due = due;
+              this.key = (owned) key;
+              this.position = position;
+            }
+        }
+
+      private uint count = 0;
+      private Node?[] heap = new Node? [16];
+      private GLib.HashTable<unowned Key, unowned Node> index;
+
+      public uint length { get { return count; } }
+
+      public Deadlines ()
+        {
+          index = new GLib.HashTable<unowned Key, unowned Node> (Key.hash, Key.equal);
+        }
+
+      public bool cancel (Key key)
+        {
+          unowned Node? node;
+
+          if ((node = index.lookup (key)) == null)
+
+            return false;
+          else
+            {
+              remove_at (node.position);
+              return true;
+            }
+        }
+
+      public bool contains (Key key)
+        {
+          return index.contains (key);
+        }
+
+      public bool peek (out int64 due)
+        {
+          due = count == 0 ? int64.MAX : heap [0].due;
+          return count > 0;
+        }
+
+      /* pops the earliest key due at or before now, if any */
+      public Key? pop (int64 now)
+        {
+          if (count == 0 || heap [0].due > now)
+
+            return null;
+          else
+            {
+              var node = remove_at (0);
+              return (owned) node.key;
+            }
+        }
+
+      public void schedule (Key key, int64 due)
+        {
+          unowned Node? node;
+
+          if ((node = index.lookup (key)) != null)
+            {
+              var before = node.due;
+
+              node.due = due;
+
+              if (due < before)
+                sift_up (node.position);
+              else
+                sift_down (node.position);
+            }
+          else
+            {
+              if (count == heap.length) heap.resize (heap.length << 1);
+
+              heap [count] = new Node (key.copy (), due, count);
+              index.insert (heap [count].key, heap [count]);
+              sift_up (count++);
+            }
+        }
+
+      private Node remove_at (uint at)
+        {
+          var node = (owned) heap [at];
+
+          index.remove (node.key);
+
+          if (at < --count)
+            {
+              heap [at] = (owned) heap [count];
+              heap [at].position = at;
+
+              sift_down (at);
+              sift_up (at);
+            }
+          return (owned) node;
+        }
+
+      private void sift_down (uint at)
+        {
+          while (true)
+            {
+              var left = 2 * at + 1;
+              var right = left + 1;
+              var least = at;
+
+              if (left < count && heap [left].due < heap [least].due) least = left;
+              if (right < count && heap [right].due < heap [least].due) least = right;
+              if (least == at) break;
+
+              swap (at, least);
+              at = least;
+            }
+        }
+
+      private void sift_up (uint at)
+        {
+          while (at > 0)
+            {
+              var parent = (at - 1) >> 1;
+
+              if (heap [parent].due <= heap [at].due) break;
+
+              swap (at, parent);
+              at = parent;
+            }
+        }
+
+      private void swap (uint a, uint b)
+        {
+          var node = (owned) heap [a];
+
+          heap [a] = (owned) heap [b];
+          heap [b] = (owned) node;
+          heap [a].position = a;
+          heap [b].position = b;
+        }
+    }
+}
@@ -21,133 +21,81 @@ namespace Kademlia
 {
   public class InsertValueCrawler : GLib.Object, BaseCrawler
     {
-      private uint any;
-      [CCode (array_length_cexpr = "K_PEER_ALPHA")]
-      private uint dones [Peer.ALPHA];
-      private AsyncQueue<GLib.Error> errors;
-      [CCode (array_length_cexpr = "K_PEER_ALPHA")]
-      private GenericArray<Key>? lists [Peer.ALPHA];
+      private uint acked = 0;
+      private GLib.Error? error = null;
+      private uint inflight = 0;
       private ValuePeer peer;
+      private Key[] peers;
+      private uint quorum = 0;
       private Key target_id;
-      private ThreadPool<Delegated> worker;
+      private Metrics.TraceContext trace;
+      private GLib.Value? value = null;
+      private GLib.SourceFunc? wakeup = null;
 
-      [Compact (opaque = false)] class Delegated
-        {
-          public GLib.Cancellable cancellable;
-          public uint k;
-          public GenericArray<Key> peers;
-          public unowned InsertValueCrawler self;
-          public unowned GLib.Value* value;
-
-          public Delegated (GenericArray<Key> peers, uint k, InsertValueCrawler self, GLib.Value* value, GLib.Cancellable? cancellable = null)
-            {
-              this.cancellable = cancellable;
-              this.k = k;
-              this.peers = peers;
-              this.self = self;
-              this.value = value;
-            }
-        }
+      /* whether crawl got the quorum it asked for (as clamped to the peers found), storing somewhere at least */
+      public bool quorate { get { return acked > 0 && acked >= quorum; } }
+      public uint replicas { get { return acked; } }
 
-      public async InsertValueCrawler (ValuePeer peer, owned Key target_id, GLib.Cancellable? cancellable = null) throws GLib.Error
+      public async InsertValueCrawler (ValuePeer peer, owned Key target_id, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
-          this.any = 0;
-          this.errors = new AsyncQueue<GLib.Error> ();
           this.peer = peer;
           this.target_id = (owned) target_id;
+          this.trace = trace;
 
-          var max_threads = (int) dones.length;
-          var exclusive = (bool) false;
-          this.worker = new ThreadPool<Delegated>.with_owned_data (worker_b, max_threads, exclusive);
-
-          Key[] peers = yield peer.lookup_node (this.target_id, cancellable);
-          uint reserve = (peers.length + dones.length - 1) / dones.length;
-
-          for (int i = 0; i < dones.length; ++i)
-            {
-              dones [i] = 0;
-              lists [i] = new GenericArray<Key> (reserve);
-            }
-
-          for (unowned uint i = 0, j = 0; j < peers.length; ++j, i = (i + 1) % dones.length)
-            {
-              lists [i].add (peers [j].copy ());
-            }
-        }
-
-      public extern async bool crawl (GLib.Value? value, GLib.Cancellable? cancellable) throws GLib.Error;
-
-      [CCode (cname = "k_insert_value_crawler_crawl")]
-
-      public void crawl_ (GLib.Value* value, GLib.Cancellable? cancellable, GLib.AsyncReadyCallback callback)
-        {
-          var task = new GLib.Task (this, cancellable, callback);
-
-          task.set_source_tag ((void*) crawl_);
-          task.set_static_name ("crawl_async");
-          task.set_task_data (value, null);
-          task.run_in_thread ((t, s, d, c) => ((InsertValueCrawler) s).crawl_worker (t, d, c));
+          var crawler = new LookupNodeCrawler (peer, this.target_id.copy (), trace);
+          this.peers = yield crawler.crawl (cancellable);
         }
 
-      public bool crawl_finish (GLib.AsyncResult res) throws GLib.Error
-        {
-          ((GLib.Task) res).propagate_boolean ();
-          return any > 0;
-        }
+      /*
+       * Stores on every one of the k closest peers at once, and returns as soon
+       * as quorum of them acknowledged it. Stragglers keep going after that (the
+       * crawler stays alive until they are done), and unreachable ones get
+       * dropped from routing by insert_on_node.
+       */
 
-      void crawl_worker (GLib.Task task, GLib.Value* value, GLib.Cancellable? cancellable)
+      public async uint crawl (GLib.Value? value, uint quorum, GLib.Cancellable? cancellable) throws GLib.Error
         {
-          for (unowned uint i = 0; i < dones.length; ++i) if (lists [i].length == 0)
+          this.quorum = quorum = uint.min (quorum, peers.length);
+          this.value = value;
 
-            GLib.AtomicUint.set (ref dones [i], 1);
-          else
+          foreach (unowned var key in peers)
             {
-              var delegated = new Delegated (lists [i], i, this, value, cancellable);
-              try { worker.add (((owned) delegated)); } catch (GLib.Error e) { };
+              ++inflight;
+              peer.insert_on_node.begin (key, target_id, this.value, trace, cancellable, (o, res) => on_reply (res));
             }
 
-          for (unowned uint i, pending = 1; pending > 0;)
+          while (inflight > 0 && acked < quorum)
             {
-              GLib.Thread.yield ();
+              wakeup = crawl.callback;
+              yield;
+            }
 
-              for (i = 0, pending = 0; i < dones.length; ++i)
+          if (unlikely (acked == 0 && error != null))
 
-                pending |= AtomicUint.get (ref dones [i]) ^ 1;
-            }
+            throw (owned) error;
 
-          task.return_boolean (true);
+          return acked;
         }
 
-      void worker_a (uint k, GLib.AsyncResult res)
+      void on_reply (GLib.AsyncResult res)
         {
-          var result = false;
+          --inflight;
 
-          try { result = peer.insert_on_nodes.end (res); } catch (GLib.Error e)
+          try { if (peer.insert_on_node.end (res)) ++acked; } catch (GLib.Error e)
             {
-              errors.push ((owned) e);
-            }
+              if (error == null)
 
-          if (result)
-
-            GLib.AtomicUint.inc (ref any);
-            GLib.AtomicUint.set (ref dones [k], 1);
-        }
-
-      static void worker_b (owned Delegated delegated)
-        {
-          unowned var cancellable = delegated.cancellable;
-          unowned var id = delegated.self.target_id;
-          unowned var self = delegated.self;
-          unowned var value = (GLib.Value?) delegated.value;
-          unowned uint done = 0;
+                error = (owned) e;
+              else
+                warning ("%s: %u: %s", e.domain.to_string (), e.code, e.message);
+            }
 
-          self.peer.insert_on_nodes.begin ((owned) delegated.peers, id, value, cancellable, (o, res) =>
+          if (wakeup != null)
             {
-              delegated.self.worker_a (delegated.k, res);
-              AtomicUint.set (ref done, 1);
-            });
-
-          while (AtomicUint.get (ref done) == 0) GLib.Thread.yield ();
+              var callback = (owned) wakeup;
+              wakeup = null;
+              callback ();
+            }
         }
     }
 }
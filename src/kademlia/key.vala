@@ -94,6 +94,11 @@ namespace Kademlia
             }
         }
 
+      public Key.from_val (KeyVal? val)
+        {
+          GLib.Memory.copy ((uint8[]) (void*) & value.bytes [0], (uint8[]) (void*) & val.bytes [0], bytelen);
+        }
+
       public Key.parse (string key, int length = -1) throws GLib.Error
         {
           if ((length = (length >= 0 ? length : key.length)) != (bytelen << 1))
@@ -148,11 +153,32 @@ namespace Kademlia
           return KeyVal.log (a.value, b.value);
         }
 
+      /* orders a and b by their whole xor distance to target, nearest first */
+      public static int compare_distance (Key a, Key b, Key target)
+        {
+          var n = KeyVal.log (a.value, b.value);
+
+          if (n < 0)
+
+            return 0;
+          else
+            {
+              /* the nearer one is the one agreeing with target on the highest bit a and b differ at */
+              var at = ((int) BITLEN - 1 - n) >> 3;
+              return (((a.value.bytes [at] ^ target.value.bytes [at]) >> (n & 7)) & 1) == 0 ? -1 : 1;
+            }
+        }
+
       public static bool equal (Key a, Key b)
         {
           return (void*) a == (void*) b || KeyVal.cmp (a.value, b.value);
         }
 
+      public bool equal_val (KeyVal? val)
+        {
+          return KeyVal.cmp (value, val);
+        }
+
       public static GLib.Type get_type ()
         {
           return Key._get_type ();
@@ -0,0 +1,130 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __KADEMLIA_KEYSET__
+#define __KADEMLIA_KEYSET__ 1
+#include <glib.h>
+#include <keyval.h>
+#include <string.h>
+
+typedef struct _KKeySet KKeySet;
+
+#if __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+  /*
+   * Set of keys stored inline (open addressing, linear probing), so adding
+   * a key copies its 32 bytes into the table instead of allocating it. Keys
+   * are never removed; crawlers build one per lookup and drop it whole.
+   */
+
+  struct _KKeySet
+    {
+      guint size;
+      guint mask;
+      guint8* used;
+      KKeyVal* keys;
+    };
+
+  #define K_KEY_SET_MINSIZE 64
+
+  static __inline void k_key_set_free (KKeySet* set)
+    {
+      g_free (set->used);
+      g_free (set->keys);
+      g_free (set);
+    }
+
+  static __inline guint k_key_set_get_size (KKeySet* set)
+    {
+      return set->size;
+    }
+
+  static __inline KKeySet* k_key_set_new (void)
+    {
+      KKeySet* set = g_new (KKeySet, 1);
+
+      set->size = 0;
+      set->mask = K_KEY_SET_MINSIZE - 1;
+      set->used = g_new0 (guint8, K_KEY_SET_MINSIZE);
+      set->keys = g_new (KKeyVal, K_KEY_SET_MINSIZE);
+      return set;
+    }
+
+  static __inline guint _k_key_set_probe (KKeySet* set, const KKeyVal* key)
+    {
+      guint i;
+
+      for (i = k_key_val_hash (key) & set->mask; set->used [i]; i = (i + 1) & set->mask)
+        {
+          if (k_key_val_cmp (& set->keys [i], key)) break;
+        }
+      return i;
+    }
+
+  static __inline gboolean k_key_set_contains (KKeySet* set, const KKeyVal* key)
+    {
+      return set->used [_k_key_set_probe (set, key)];
+    }
+
+  static __inline void _k_key_set_grow (KKeySet* set)
+    {
+      guint i, length = set->mask + 1;
+      guint8* used = set->used;
+      KKeyVal* keys = set->keys;
+
+      set->mask = (length << 1) - 1;
+      set->used = g_new0 (guint8, length << 1);
+      set->keys = g_new (KKeyVal, length << 1);
+
+      for (i = 0; i < length; ++i) if (used [i])
+        {
+          guint at = _k_key_set_probe (set, & keys [i]);
+
+          set->used [at] = TRUE;
+          (void) k_key_val_copy (& keys [i], & set->keys [at]);
+        }
+
+      g_free (used);
+      g_free (keys);
+    }
+
+  /* returns FALSE when key was already there */
+  static __inline gboolean k_key_set_add (KKeySet* set, const KKeyVal* key)
+    {
+      guint at;
+
+      if (set->used [at = _k_key_set_probe (set, key)])
+
+        return FALSE;
+      else if (((set->size + 1) << 2) > ((set->mask + 1) * 3))
+        {
+          _k_key_set_grow (set);
+          at = _k_key_set_probe (set, key);
+        }
+
+      ++set->size;
+      set->used [at] = TRUE;
+      (void) k_key_val_copy (key, & set->keys [at]);
+      return TRUE;
+    }
+
+#if __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __KADEMLIA_KEYSET__
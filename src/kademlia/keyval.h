@@ -58,13 +58,20 @@ extern "C" {
       (memcpy (__dst, __src, sizeof (*__dst)), FALSE); \
     }))
 
-  #define k_key_val_hash(val) (G_GNUC_EXTENSION ({ \
- ; \
-      const KKeyVal* __a = (val); \
-      guint __i, __hash = 5381; \
-      for (__i = 0; __i < (K_KEY_VAL_BITLEN >> 3); ++__i) __hash = (__hash << 5) + __hash + __a->bytes [__i]; \
-      __hash; \
-    }))
+  /*
+   * Keys are digests (or random) already, so a multiplicative mix over the
+   * four words spreads them well enough without walking every byte.
+   */
+
+  static __inline guint k_key_val_hash (const KKeyVal* val)
+    {
+      guint64 hash = 0;
+      guint i;
+
+      for (i = 0; i < G_N_ELEMENTS (val->quads); ++i)
+        hash = (hash ^ val->quads [i]) * G_GUINT64_CONSTANT (0x9e3779b97f4a7c15);
+      return (guint) (hash ^ (hash >> 32));
+    }
 
   static __inline void k_key_val_xor (KKeyVal* d, const KKeyVal* a, const KKeyVal* b)
     {
@@ -112,19 +119,30 @@ extern "C" {
   G_STATIC_ASSERT (_2exp (sizeof (gchar) << 3) == G_N_ELEMENTS (k_key_val_logtable));
   #undef _2exp
 
+  /*
+   * Index of the highest differing bit, counting from the least significant
+   * one (bytes [0] being the most significant byte). Compares a word at a
+   * time, and only looks inside the first word that differs.
+   */
+
   static __inline gint k_key_val_log (const KKeyVal* a, const KKeyVal* b)
     {
-      KKeyVal xor;
-      guint8 c;
+      guint64 x;
       guint i;
 
-      k_key_val_xor (&xor, a, b);
-
-      for (i = 1; i < 1 + (K_KEY_VAL_BITLEN >> 3); ++i)
+      for (i = 0; i < G_N_ELEMENTS (a->quads); ++i)
         {
-          if ((c = xor.bytes [i - 1]) != 0)
-
-            return (K_KEY_VAL_BITLEN - (i << 3)) + k_key_val_logtable [c];
+          if ((x = GUINT64_FROM_BE (a->quads [i] ^ b->quads [i])) != 0)
+            {
+  #if defined (__GNUC__) || defined (__clang__)
+              return (K_KEY_VAL_BITLEN - 1) - (i << 6) - __builtin_clzll (x);
+  #else // !__GNUC__
+              guint shift = 56;
+
+              while ((x >> shift) == 0) shift -= 8;
+              return (K_KEY_VAL_BITLEN - ((i + 1) << 6)) + shift + k_key_val_logtable [x >> shift];
+  #endif // __GNUC__
+            }
         }
       return -1; /* equals */
     }
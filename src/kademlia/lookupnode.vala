@@ -21,171 +21,135 @@ namespace Kademlia
 {
   public sealed class LookupNodeCrawler : GLib.Object, BaseCrawler
     {
+      /* rounds of queries sent out and queries made so far */
+      public uint rounds { get; private set; default = 0; }
+      public uint rpcs { get; private set; default = 0; }
+
+      /* nearest node the lookup heard of but left out of its result, if any */
+      public Key? runner_up { get; private owned set; }
+
       private GenericArray<Key> closest;
-      [CCode (array_length_cexpr = "K_PEER_ALPHA")]
-      private uint dones [Peer.ALPHA];
-      private AsyncQueue<GLib.Error> errors;
+      private GLib.Error? error = null;
+      private uint inflight = 0;
       private Peer peer;
-      private AsyncQueue<Key> peers;
+      private Queue<Key> peers;
       private CompareDataFunc<Key> sorter;
       private Key target_id;
-      private GenericSet<Key> visited;
-      private ThreadPool<Delegated> worker;
+      private Metrics.TraceContext trace;
+      private KeySet visited;
+      private GLib.SourceFunc? wakeup = null;
 
-      [Compact (opaque = false)] class Delegated
-        {
-          public GLib.Cancellable cancellable;
-          public uint k;
-          public Key peer;
-          public unowned LookupNodeCrawler self;
-
-          public Delegated (owned Key peer, uint k, LookupNodeCrawler self, GLib.Cancellable? cancellable = null)
-            {
-              this.cancellable = cancellable;
-              this.k = k;
-              this.peer = (owned) peer;
-              this.self = self;
-            }
-        }
-
-      public LookupNodeCrawler (Peer peer, owned Key target_id) throws GLib.Error
+      public LookupNodeCrawler (Peer peer, owned Key target_id, Metrics.TraceContext trace) throws GLib.Error
         {
           this.closest = new GenericArray<Key> (2 * Buckets.MAXSPAN);
-          this.errors = new AsyncQueue<GLib.Error> ();
           this.peer = peer;
-          this.peers = new AsyncQueue<Key> ();
+          this.peers = new Queue<Key> ();
           this.sorter = create_sorter (target_id.copy ());
           this.target_id = (owned) target_id;
-          this.visited = new GenericSet<Key> (Key.hash, Key.equal);
-
-          var max_threads = (int) dones.length;
-          var exclusive = (bool) false;
-          this.worker = new ThreadPool<Delegated>.with_owned_data (worker_b, max_threads, exclusive);
+          this.trace = trace;
+          this.visited = new KeySet ();
 
-          var seed = (SList<Key>) peer.nearest (this.target_id);
-          peers.lock ();
+          KeyVal seed [Buckets.MAXSPAN];
+          var got = peer.nearest_span (this.target_id, seed);
 
-          for (unowned var link = (SList<Key>) seed; link != null; link = link.next)
+          for (uint i = 0; i < got; ++i) if (visited.add (seed [i]))
             {
-              peers.push_unlocked ((owned) link.data);
+              peers.insert_sorted (new Key.from_val (seed [i]), sorter);
             }
-
-          peers.unlock ();
-        }
-
-      public extern async Key[] crawl (GLib.Cancellable? cancellable) throws GLib.Error;
-
-      [CCode (cname = "k_lookup_node_crawler_crawl")]
-
-      public void crawl_ (GLib.Cancellable? cancellable, GLib.AsyncReadyCallback callback)
-        {
-          var task = new GLib.Task (this, cancellable, callback);
-
-          task.set_source_tag ((void*) crawl_);
-          task.set_static_name ("crawl_async");
-          task.run_in_thread ((t, s, d, c) => ((LookupNodeCrawler) s).crawl_worker (t, c));
         }
 
-      public Key[] crawl_finish (GLib.AsyncResult res) throws GLib.Error
-        {
-          ((GLib.Task) res).propagate_boolean ();
-          return closest.steal ();
-        }
+      /*
+       * Keeps up to ALPHA queries in flight and fires the next one as soon as
+       * any reply lands. Everything happens in the caller's main context, so
+       * the crawler state needs no locking. When traced, each round spans
+       * from its queries going out to the first reply coming back.
+       */
 
-      void crawl_worker (GLib.Task task, GLib.Cancellable? cancellable)
+      public async Key[] crawl (GLib.Cancellable? cancellable) throws GLib.Error
         {
-          uint left;
+          var span = Metrics.Span (trace);
 
-          while ((left = (int) peers.length ()) > 0)
+          while (true)
             {
-              for (unowned uint i = 0; i < dones.length; ++i)
-                {
-                  dones [i] = 1;
-                }
+              var round = Metrics.Span (span.child ());
+              var sent = rpcs;
 
-              for (unowned uint i = 0; i < uint.min (left, dones.length); ++i)
+              while (error == null && inflight < Peer.ALPHA && peers.length > 0)
                 {
-                  AtomicUint.set (ref dones [i], 0);
-                  var delegated = new Delegated (peers.pop (), i, this, cancellable);
-                  try { worker.add (((owned) delegated)); } catch (GLib.Error e) { };
+                  ++inflight;
+                  ++rpcs;
+                  peer.lookup_node_a.begin (peers.pop_head (), target_id, round.child (), cancellable, (o, res) => on_reply (res));
                 }
 
-              for (unowned uint i, pending = 1; pending > 0;)
-                {
-                  GLib.Thread.yield ();
-
-                  for (i = 0, pending = 0; i < dones.length; ++i)
+              if (rpcs > sent) ++rounds;
+              if (inflight == 0) break;
 
-                    pending |= AtomicUint.get (ref dones [i]) ^ 1;
-                }
+              wakeup = crawl.callback;
+              yield;
 
-              errors.lock ();
+              if (rpcs > sent) round.end ("round");
+            }
 
-              if (errors.length_unlocked () == 0)
+          Meters.get_default ().node_rounds.observe (rounds);
+          Meters.get_default ().node_rpcs.observe (rpcs);
+          span.end ("lookup node", span.sampled () ? target_id.to_string () : null);
 
-                errors.unlock ();
-              else
-                {
-                  var f = errors.pop_unlocked ();
+          if (unlikely (error != null))
 
-                  for (unowned var i = 0; i < errors.length_unlocked (); ++i)
-                    {
-                      var e = errors.pop_unlocked ();
-                      warning ("%s: %u: %s", e.domain.to_string (), e.code, e.message);
-                    }
+            throw (owned) error;
 
-                  task.return_error ((owned) f);
-                  errors.unlock ();
-                  return;
-                }
-            }
+          return closest.steal ();
+        }
 
-          task.return_boolean (true);
+      static bool holds (GenericArray<Key> keys, KeyVal? val)
+        {
+          foreach (unowned var key in keys) if (key.equal_val (val)) return true;
+          return false;
         }
 
-      void worker_a (uint k, GLib.AsyncResult res)
+      void on_reply (GLib.AsyncResult res)
         {
-          Key[]? newl = null;
+          KeyVal[]? newl = null;
+          --inflight;
 
           try { newl = peer.lookup_node_a.end (res); } catch (GLib.Error e)
             {
-              errors.push ((owned) e);
+              if (error == null)
+
+                error = (owned) e;
+              else
+                warning ("%s: %u: %s", e.domain.to_string (), e.code, e.message);
             }
 
-          if (likely (newl != null)) lock (visited)
+          if (likely (newl != null))
             {
-              foreach (unowned var key in newl) if (closest.find_custom (key, Key.equal) == false)
+              foreach (var val in newl) if (holds (closest, val) == false)
                 {
-                  closest.add (key.copy ());
+                  closest.add (new Key.from_val (val));
                 }
 
               closest.sort_values_with_data (sorter);
-              closest.length = int.min (closest.length, (int) Buckets.MAXSPAN);
 
-              foreach (unowned var key in newl) if (closest.find_custom (key, Key.equal) && ! visited.contains (key))
+              if (closest.length > Buckets.MAXSPAN)
                 {
-                  visited.add (key.copy ());
-                  peers.push_sorted (key.copy (), sorter);
-                }
-            }
+                  unowned var dropped = closest [(int) Buckets.MAXSPAN];
 
-          AtomicUint.set (ref dones [k], 1);
-        }
+                  if (runner_up == null || sorter (dropped, runner_up) < 0) runner_up = dropped.copy ();
+                  closest.length = (int) Buckets.MAXSPAN;
+                }
 
-      static void worker_b (owned Delegated delegated)
-        {
-          unowned var cancellable = delegated.cancellable;
-          unowned var id = delegated.self.target_id;
-          unowned var self = delegated.self;
-          unowned uint done = 0;
+              foreach (var val in newl) if (holds (closest, val) && visited.add (val))
+                {
+                  peers.insert_sorted (new Key.from_val (val), sorter);
+                }
+            }
 
-          self.peer.lookup_node_a.begin ((owned) delegated.peer, id, cancellable, (o, res) =>
+          if (wakeup != null)
             {
-              delegated.self.worker_a (delegated.k, res);
-              AtomicUint.set (ref done, 1);
-            });
-
-          while (AtomicUint.get (ref done) == 0) GLib.Thread.yield ();
+              var callback = (owned) wakeup;
+              wakeup = null;
+              callback ();
+            }
         }
     }
 }
@@ -21,166 +21,202 @@ namespace Kademlia
 {
   public sealed class LookupValueCrawler : GLib.Object, BaseCrawler
     {
+      /* rounds of queries sent out and queries made so far */
+      public uint rounds { get; private set; default = 0; }
+      public uint rpcs { get; private set; default = 0; }
+
+      private GLib.Cancellable cancellable;
       private GenericArray<Key> closest;
-      [CCode (array_length_cexpr = "K_PEER_ALPHA")]
-      private uint dones [Peer.ALPHA];
-      private AsyncQueue<GLib.Error> errors;
+      private bool done = false;
+      private GLib.Error? error = null;
+      private Value? found = null;
+      private uint inflight = 0;
       private ValuePeer peer;
       private Queue<Key> peers;
+      private KeySet responded;
       private CompareDataFunc<Key> sorter;
       private Key target_id;
-      private AsyncQueue<Kademlia.Value> values;
-      private GenericSet<Key> visited;
-      private ThreadPool<Delegated?> worker;
-
-      [Compact (opaque = false)] class Delegated
-        {
-          public GLib.Cancellable cancellable;
-          public uint k;
-          public Key peer;
-          public unowned LookupValueCrawler self;
-
-          public Delegated (owned Key peer, uint k, LookupValueCrawler self, GLib.Cancellable? cancellable = null)
-            {
-              this.cancellable = cancellable;
-              this.k = k;
-              this.peer = (owned) peer;
-              this.self = self;
-            }
-        }
+      private Metrics.TraceContext trace;
+      private KeySet visited;
+      private GLib.SourceFunc? wakeup = null;
 
-      public LookupValueCrawler (ValuePeer peer, owned Key target_id) throws GLib.Error
+      public LookupValueCrawler (ValuePeer peer, owned Key target_id, Metrics.TraceContext trace) throws GLib.Error
         {
+          this.cancellable = new GLib.Cancellable ();
           this.closest = new GenericArray<Key> (2 * Buckets.MAXSPAN);
-          this.errors = new AsyncQueue<GLib.Error> ();
           this.peer = peer;
           this.peers = new Queue<Key> ();
+          this.responded = new KeySet ();
           this.sorter = create_sorter (target_id.copy ());
           this.target_id = (owned) target_id;
-          this.values = new AsyncQueue<Kademlia.Value> ();
-          this.visited = new GenericSet<Key> (Key.hash, Key.equal);
+          this.trace = trace;
+          this.visited = new KeySet ();
 
-          var max_threads = (int) dones.length;
-          var exclusive = (bool) false;
-          this.worker = new ThreadPool<Delegated>.with_owned_data (worker_b, max_threads, exclusive);
+          KeyVal seed [Buckets.MAXSPAN];
+          var got = peer.nearest_span (this.target_id, seed);
 
-          var seed = (SList<Key>) peer.nearest (this.target_id);
-
-          for (unowned var link = (SList<Key>) seed; link != null; link = link.next)
+          for (uint i = 0; i < got; ++i) if (visited.add (seed [i]))
             {
-              peers.push_head ((owned) link.data);
+              var key = new Key.from_val (seed [i]);
+              closest.add (key.copy ());
+              peers.insert_sorted ((owned) key, sorter);
             }
-        }
 
-      public extern async GLib.Value? crawl (GLib.Cancellable? cancellable) throws GLib.Error;
+          closest.sort_values_with_data (sorter);
+          closest.length = int.min (closest.length, (int) Buckets.MAXSPAN);
+        }
 
-      [CCode (cname = "k_lookup_value_crawler_crawl")]
+      /*
+       * Same dispatching scheme as LookupNodeCrawler, but the crawl ends as
+       * soon as a value shows up (in-flight queries get cancelled) or once
+       * every one of the k closest peers seen so far answered without it.
+       */
 
-      public void crawl_ (GLib.Cancellable? cancellable, GLib.AsyncReadyCallback callback)
+      public async GLib.Value? crawl (GLib.Cancellable? cancellable) throws GLib.Error
         {
-          var task = new GLib.Task (this, cancellable, callback);
+          ulong handler_id = 0;
+          var span = Metrics.Span (trace);
 
-          task.set_source_tag ((void*) crawl_);
-          task.set_static_name ("crawl_async");
-          task.run_in_thread ((t, s, d, c) => ((LookupValueCrawler) s).crawl_worker (t, c));
-        }
-
-      public GLib.Value? crawl_finish (GLib.AsyncResult res) throws GLib.Error
-        {
-          ((GLib.Task) res).propagate_boolean ();
-          return values.try_pop ()?.steal_value ();
-        }
+          if (cancellable != null)
 
-      void crawl_worker (GLib.Task task, GLib.Cancellable? cancellable)
-        {
-          uint left = 0;
+            handler_id = cancellable.connect (() => this.cancellable.cancel ());
 
-          while (values.length () == 0 && (left = (int) peers.length) > 0)
+          while (found == null && error == null && converged () == false)
             {
-              for (unowned uint i = 0; i < dones.length; ++i)
-                {
-                  dones [i] = 1;
-                }
+              var round = Metrics.Span (span.child ());
+              var sent = rpcs;
 
-              for (unowned uint i = 0; i < uint.min (left, dones.length); ++i) lock (visited)
+              while (inflight < Peer.ALPHA && peers.length > 0)
                 {
-                  AtomicUint.set (ref dones [i], 0);
-                  var delegated = new Delegated (peers.pop_head (), i, this, cancellable);
-                  try { worker.add (((owned) delegated)); } catch (GLib.Error e) { };
+                  var next = peers.pop_head ();
+                  ++inflight;
+                  ++rpcs;
+
+                  peer.lookup_in_node.begin (next.copy (), target_id, round.child (), this.cancellable, (o, res) => on_reply (next, res));
                 }
 
-              for (unowned uint i, pending = 1; pending > 0;)
-                {
-                  GLib.Thread.yield ();
+              if (rpcs > sent) ++rounds;
+              if (inflight == 0) break;
 
-                  for (i = 0, pending = 0; i < dones.length; ++i)
+              wakeup = crawl.callback;
+              yield;
 
-                    pending |= AtomicUint.get (ref dones [i]) ^ 1;
-                }
+              if (rpcs > sent) round.end ("round");
+            }
 
-              errors.lock ();
+          done = true;
 
-              if (errors.length_unlocked () == 0)
+          Meters.get_default ().value_rounds.observe (rounds);
+          Meters.get_default ().value_rpcs.observe (rpcs);
+          span.end ("lookup value", span.sampled () ? target_id.to_string () : null);
 
-                errors.unlock ();
-              else
-                {
-                  var f = errors.pop_unlocked ();
+          if (cancellable != null)
 
-                  for (unowned var i = 0; i < errors.length_unlocked (); ++i)
-                    {
-                      var e = errors.pop_unlocked ();
-                      warning ("%s: %u: %s", e.domain.to_string (), e.code, e.message);
-                    }
+            cancellable.disconnect (handler_id);
 
-                  task.return_error ((owned) f);
-                  errors.unlock ();
-                  return;
-                }
+          if (inflight > 0)
+
+            this.cancellable.cancel ();
+
+          if (unlikely (error != null))
+
+            throw (owned) error;
+
+          if (found == null)
+
+            return null;
+          else
+            {
+              store_on_closest (span.child ());
+              return found.steal_value ();
             }
+        }
+
+      bool converged ()
+        {
+          foreach (unowned var key in closest) if (responded.contains (key.value) == false)
 
-          task.return_boolean (true);
+            return false;
+
+          return true;
         }
 
-      void worker_a (uint k, GLib.AsyncResult res)
+      void on_reply (Key from, GLib.AsyncResult res)
         {
           Value? value = null;
+          --inflight;
 
           try { value = peer.lookup_in_node.end (res); } catch (GLib.Error e)
             {
-              errors.push ((owned) e);
+              if (done)
+
+                return;
+              else if (error == null)
+
+                error = (owned) e;
+              else
+                warning ("%s: %u: %s", e.domain.to_string (), e.code, e.message);
             }
 
-          if (likely (value != null))
+          if (done)
+
+            return;
+          else if (value == null)
+            {
+              /* unreachable peers would otherwise stall the convergence check */
+              for (unowned var i = 0; i < closest.length; ++i) if (Key.equal (closest [i], from))
+                {
+                  closest.remove_index (i);
+                  break;
+                }
+            }
+          else if (value.is_inmediate)
+            {
+              found = (owned) value;
+            }
+          else
             {
-              if (value.is_inmediate)
+              responded.add (from.value);
+
+              foreach (unowned var key in value.keys) if (closest.find_custom (key, Key.equal) == false)
                 {
-                  values.push ((owned) value);
+                  closest.add (key.copy ());
                 }
-              else lock (visited) foreach (unowned var other in value.keys) if (visited.contains (other) == false)
+
+              closest.sort_values_with_data (sorter);
+              closest.length = int.min (closest.length, (int) Buckets.MAXSPAN);
+
+              foreach (unowned var key in value.keys) if (closest.find_custom (key, Key.equal) && visited.add (key.value))
                 {
-                  visited.add (other.copy ());
-                  peers.insert_sorted (other.copy (), sorter);
+                  peers.insert_sorted (key.copy (), sorter);
                 }
             }
 
-          AtomicUint.set (ref dones [k], 1);
+          if (wakeup != null)
+            {
+              var callback = (owned) wakeup;
+              wakeup = null;
+              callback ();
+            }
         }
 
-      static void worker_b (owned Delegated delegated)
+      void store_on_closest (Metrics.TraceContext trace)
         {
-          unowned var cancellable = delegated.cancellable;
-          unowned var id = delegated.self.target_id;
-          unowned var self = delegated.self;
-          unowned uint done = 0;
-
-          self.peer.lookup_in_node.begin ((owned) delegated.peer, id, cancellable, (o, res) =>
+          foreach (unowned var key in closest) if (responded.contains (key.value))
             {
-              delegated.self.worker_a (delegated.k, res);
-              AtomicUint.set (ref done, 1);
-            });
+              var id = target_id.copy ();
+              var to = key.copy ();
+              var value = found.steal_value ();
 
-          while (AtomicUint.get (ref done) == 0) GLib.Thread.yield ();
+              peer.insert_on_node.begin (to, id, value, trace, null, (o, res) =>
+                {
+                  try { ((ValuePeer) o).insert_on_node.end (res); } catch (GLib.Error e)
+                    {
+                      debug ("can not cache value %s at %s: %s: %u: %s", id.to_string (), to.to_string (), e.domain.to_string (), e.code, e.message);
+                    }
+                });
+              break;
+            }
         }
     }
 }
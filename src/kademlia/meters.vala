@@ -0,0 +1,102 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+[CCode (cprefix = "K", lower_case_cprefix = "k_")]
+
+namespace Kademlia
+{
+  /* outgoing calls, as Role names them */
+  internal enum RpcMethod
+    {
+      PING,
+      FIND_NODE,
+      FIND_VALUE,
+      FIND_VALUES,
+      STORE,
+      STORE_MANY;
+
+      public const uint COUNT = 6;
+
+      public unowned string to_name ()
+        {
+          switch (this)
+            {
+              case PING: return "Ping";
+              case FIND_NODE: return "FindNode";
+              case FIND_VALUE: return "FindValue";
+              case FIND_VALUES: return "FindValues";
+              case STORE: return "Store";
+              case STORE_MANY: return "StoreMany";
+              default: assert_not_reached ();
+            }
+        }
+    }
+
+  /* metrics the routing layer records on, registered the first time they are needed */
+
+  [Compact (opaque = true)]
+
+  internal class Meters
+    {
+      public unowned Metrics.Histogram node_rounds;
+      public unowned Metrics.Histogram node_rpcs;
+      public (unowned Metrics.Histogram)[] rpc_durations;
+      public unowned Metrics.Counter unreachable;
+      public unowned Metrics.Histogram value_rounds;
+      public unowned Metrics.Histogram value_rpcs;
+
+      private static GLib.Once<Meters> _default;
+
+      public Meters ()
+        {
+          var registry = Metrics.Registry.get_default ();
+          var rounds = "crawler rounds (dispatches of queries) per lookup";
+          var rpcs = "queries sent per lookup";
+
+          node_rounds = registry.histogram ("kademlia_lookup_rounds", rounds, 1, "lookup=\"node\"");
+          node_rpcs = registry.histogram ("kademlia_lookup_rpcs", rpcs, 1, "lookup=\"node\"");
+          rpc_durations = new (unowned Metrics.Histogram) [RpcMethod.COUNT];
+          unreachable = registry.counter ("kademlia_rpc_unreachable_total", "queries whose peer could not be reached");
+          value_rounds = registry.histogram ("kademlia_lookup_rounds", rounds, 1, "lookup=\"value\"");
+          value_rpcs = registry.histogram ("kademlia_lookup_rpcs", rpcs, 1, "lookup=\"value\"");
+
+          for (uint i = 0; i < RpcMethod.COUNT; ++i)
+            {
+              var labels = @"method=\"$(((RpcMethod) i).to_name ())\"";
+              rpc_durations [i] = registry.histogram ("kademlia_rpc_duration_seconds", "outgoing query latency", 1e-6, labels);
+            }
+        }
+
+      public static unowned Meters get_default ()
+        {
+          return _default.once (() => new Meters ());
+        }
+
+      /*
+       * latency of a call to peer, started at started (monotonic), ending its
+       * span too; peers only show up in (sampled) spans, since a label per
+       * peer would cost a registry lookup per call and grow without bound
+       */
+      public static void rpc (RpcMethod method, Key peer, int64 started, Metrics.Span span)
+        {
+          var elapsed = GLib.get_monotonic_time () - started;
+
+          get_default ().rpc_durations [method].observe ((uint64) elapsed);
+          span.end (method.to_name (), span.sampled () ? peer.to_string () : null);
+        }
+    }
+}
@@ -75,6 +75,11 @@ namespace Kademlia
           lock (buckets) buckets.awake_range (peer);
         }
 
+      public void count_contacts (out uint nodes, out uint replacements, out uint stale)
+        {
+          lock (buckets) buckets.count (out nodes, out replacements, out stale);
+        }
+
       public void drop_contact (Key peer)
         {
           lock (buckets) buckets.drop (peer);
@@ -106,21 +111,20 @@ namespace Kademlia
           return true;
         }
 
-      protected async virtual Key[] find_peer (Key peer, Key id, GLib.Cancellable? cancellable = null) throws GLib.Error
+      protected async virtual KeyVal[] find_peer (Key peer, Key id, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
           throw new IOError.FAILED ("unimplemented");
         }
 
-      public async Key[] find_peer_complete (Key? from, Key id, GLib.Cancellable? cancellable = null) throws GLib.Error
+      public async KeyVal[] find_peer_complete (Key? from, Key id, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
           if (from != null) add_contact (from);
 
-          var ni = (SList<Key>) nearest (id);
-          var ar = (Key[]) new Key [ni.length ()];
-          int i = 0;
+          var span = new KeyVal [Buckets.MAXSPAN];
+          var got = nearest_span (id, span);
 
-          for (unowned var l = (SList<Key>) ni; l != null; l = l.next) ar [i++] = (owned) l.data;
-          return (owned) ar;
+          span.resize ((int) got);
+          return (owned) span;
         }
 
       public async bool join (Key to, GLib.Cancellable? cancellable = null) throws GLib.Error
@@ -131,20 +135,27 @@ namespace Kademlia
 
       public async Key[] lookup_node (Key id, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
-          var crawler = new LookupNodeCrawler (this, id.copy ());
+          var crawler = new LookupNodeCrawler (this, id.copy (), Metrics.Tracer.get_default ().sample ());
           return yield crawler.crawl (cancellable);
         }
 
-      internal async Key[]? lookup_node_a (owned Key peer, Key id, GLib.Cancellable? cancellable = null) throws GLib.Error
+      internal async KeyVal[]? lookup_node_a (owned Key peer, Key id, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
-          Key[] result;
+          KeyVal[] result;
           bool same;
 
           try
             {
               if ((same = Key.equal (peer, this.id)) == false)
+                {
+                  var span = Metrics.Span (trace);
+                  var started = GLib.get_monotonic_time ();
 
-                result = yield find_peer (peer, id, cancellable);
+                  try { result = yield find_peer (peer, id, span.child (), cancellable); } finally
+                    {
+                      Meters.rpc (RpcMethod.FIND_NODE, peer, started, span);
+                    }
+                }
               else
                 result = yield find_peer_complete (null, id, cancellable);
 
@@ -158,6 +169,7 @@ namespace Kademlia
                 throw (owned) e;
               else
                 {
+                  Meters.get_default ().unreachable.inc ();
                   if (!same) drop_contact (peer);
                   return null;
                 }
@@ -172,6 +184,15 @@ namespace Kademlia
           return (owned) list;
         }
 
+      /* same contacts nearest would list, copied inline into span */
+      public virtual uint nearest_span (Key to, KeyVal[] span)
+        {
+          uint got;
+
+          lock (buckets) got = buckets.nearest_span (to, span);
+          return got;
+        }
+
       public async bool ping (Key peer, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
           bool same;
@@ -179,8 +200,15 @@ namespace Kademlia
           try
             {
               if ((same = Key.equal (peer, this.id)) == false)
+                {
+                  var span = Metrics.Span (Metrics.TraceContext ());
+                  var started = GLib.get_monotonic_time ();
 
-                return yield ping_peer (peer, cancellable);
+                  try { return yield ping_peer (peer, span.child (), cancellable); } finally
+                    {
+                      Meters.rpc (RpcMethod.PING, peer, started, span);
+                    }
+                }
               else
                 return yield ping_peer_complete (null, cancellable);
             }
@@ -191,13 +219,14 @@ namespace Kademlia
                 throw (owned) e;
               else
                 {
+                  Meters.get_default ().unreachable.inc ();
                   if (!same) drop_contact (peer);
                   return false;
                 }
             }
         }
 
-      protected async virtual bool ping_peer (Key peer, GLib.Cancellable? cancellable = null) throws GLib.Error
+      protected async virtual bool ping_peer (Key peer, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
           throw new IOError.FAILED ("unimplemented");
         }
@@ -0,0 +1,189 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+[CCode (cprefix = "K", lower_case_cprefix = "k_")]
+
+namespace Kademlia
+{
+  /*
+   * Paces republication of a peer's stale values. Stale keys are given a
+   * jittered deadline, taken off as the token bucket allows (what does not
+   * fit gets deferred to when tokens will be back). A lookup's nodes also
+   * take the keys after it that provably have those same k closest nodes,
+   * the others getting lookups of their own (see reach).
+   * Keys some other node stored on us within the last interval are skipped,
+   * as that node is assumed to have stored them on the other replicas too.
+   */
+
+  public class Republisher : GLib.Object
+    {
+      public uint burst { get; set; default = 128; }
+      public int64 interval { get; set; default = 3 * Buckets.USEC_PER_SEC; }
+      public int64 jitter { get; set; default = Buckets.USEC_PER_SEC; }
+      public double rate { get; set; default = 64; }
+
+      public uint backlog { get { return pending.length; } }
+      public uint deferred { get { return AtomicUint.get (ref _deferred); } }
+      public uint lookups { get { return AtomicUint.get (ref _lookups); } }
+      public uint republished { get { return AtomicUint.get (ref _republished); } }
+      public uint skipped { get { return AtomicUint.get (ref _skipped); } }
+
+      private uint _deferred = 0;
+      private uint _lookups = 0;
+      private uint _republished = 0;
+      private uint _skipped = 0;
+
+      private int64 last_refill = 0;
+      private Deadlines pending = new Deadlines ();
+      private Deadlines received = new Deadlines ();
+      private double tokens = 0;
+      private unowned ValuePeer peer;
+
+      internal Republisher (ValuePeer peer)
+        {
+          this.peer = peer;
+        }
+
+      /* some other node just stored key on us */
+      internal void received_from_peer (Key key)
+        {
+          var now = GLib.get_monotonic_time ();
+          lock (received) received.schedule (key, now + interval);
+        }
+
+      public async void step (GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          Key? key;
+          var now = GLib.get_monotonic_time ();
+          var batch = new GenericArray<Key> ();
+          var later = new GenericArray<Key> ();
+
+          tokens = double.min (burst, tokens + rate * (now - last_refill) / Buckets.USEC_PER_SEC);
+          last_refill = now;
+
+          lock (received) while ((key = received.pop (now)) != null) { }
+
+          var spread = (int32) (jitter / 1000);
+
+          foreach (unowned var stale in yield peer.value_store.enumerate_staled_values (cancellable))
+            {
+              bool fresh;
+
+              lock (received) fresh = received.contains (stale);
+
+              if (fresh)
+
+                AtomicUint.inc (ref _skipped);
+              else if (pending.contains (stale) == false)
+
+                pending.schedule (stale, now + (spread > 0 ? GLib.Random.int_range (0, spread) * 1000 : 0));
+            }
+
+          while ((key = pending.pop (now)) != null)
+            {
+              if (tokens < 1)
+
+                later.add ((owned) key);
+              else
+                {
+                  tokens -= 1;
+                  batch.add ((owned) key);
+                }
+            }
+
+          for (uint i = 0; i < later.length; ++i)
+            {
+              AtomicUint.inc (ref _deferred);
+              pending.schedule (later [i], now + (int64) ((i + 1) * Buckets.USEC_PER_SEC / rate));
+            }
+
+          if (batch.length > 0) yield publish (batch, cancellable);
+        }
+
+      /*
+       * Keys nearer to the looked up one than this (in Key.distance terms) have
+       * the same k closest nodes: every node the lookup left out lies in a
+       * higher block of xor distance than all the ones it kept, and moving the
+       * target within such a block does not reorder the blocks themselves
+       */
+      static int reach (Key[] closest, Key? runner_up)
+        {
+          if (runner_up == null || closest.length == 0)
+
+            return int.MAX;
+          else
+            return Key.distance (closest [closest.length - 1], runner_up);
+        }
+
+      private async void publish (GenericArray<Key> batch, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          batch.sort ((a, b) => GLib.Memory.cmp (a.bytes, b.bytes, a.bytes.length));
+
+          for (uint first = 0, last = 0; first < batch.length; first = last)
+            {
+              var span = Metrics.Span (Metrics.Tracer.get_default ().sample ());
+              var crawler = new LookupNodeCrawler (peer, batch [first].copy (), span.child ());
+              var closest = yield crawler.crawl (cancellable);
+              var inflight = 0;
+              var within = reach (closest, crawler.runner_up);
+              var waiting = false;
+
+              AtomicUint.inc (ref _lookups);
+
+              /* batch is sorted, so the keys close enough to the first one follow it */
+              for (last = first + 1; last < batch.length && Key.distance (batch [first], batch [last]) < within; ++last) { }
+
+              for (uint i = first; i < last; ++i)
+                {
+                  GLib.Value? value;
+                  var stored = false;
+
+                  if ((value = yield peer.value_store.lookup_value (batch [i], cancellable)) == null)
+
+                    continue;
+
+                  foreach (unowned var node in closest)
+                    {
+                      ++inflight;
+
+                      peer.insert_on_node.begin (node, batch [i], value, span.child (), cancellable, (o, res) =>
+                        {
+                          try { if (((ValuePeer) o).insert_on_node.end (res) && ! stored) { stored = true; AtomicUint.inc (ref _republished); } } catch (GLib.Error e)
+                            {
+                              debug ("republish failed: %s: %u: %s", e.domain.to_string (), e.code, e.message);
+                            }
+
+                          if (--inflight == 0 && waiting)
+                            {
+                              waiting = false;
+                              publish.callback ();
+                            }
+                        });
+                    }
+                }
+
+              if (inflight > 0)
+                {
+                  waiting = true;
+                  yield;
+                }
+
+              span.end ("republish", span.sampled () ? (last - first).to_string () + " keys" : null);
+            }
+        }
+    }
+}
@@ -21,56 +21,278 @@ namespace Kademlia
 {
   public abstract class ValuePeer : Peer
     {
+      public uint batch_window { get; set; default = 0; }
+      public Republisher republisher { get; private set; }
       public ValueStore value_store { get; construct; }
+      public uint write_quorum { get; set; default = 1; }
+
+      private Batcher finds;
+      private Batcher stores;
+
+      construct
+        {
+          finds = new Batcher (this, BatchKind.FIND);
+          republisher = new Republisher (this);
+          stores = new Batcher (this, BatchKind.STORE);
+        }
 
       protected ValuePeer (ValueStore value_store, Key? id = null)
         {
           Object (id : id, value_store : value_store);
         }
 
-      protected virtual async Value find_value (Key peer, Key id, GLib.Cancellable? cancellable = null) throws GLib.Error
+      protected virtual async Value find_value (Key peer, Key id, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
           throw new IOError.FAILED ("unimplemented");
         }
 
-      public async Value find_value_complete (Key? from, Key id, GLib.Cancellable? cancellable = null) throws GLib.Error
+      public async Value find_value_complete (Key? from, Key id, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
           GLib.Value? value;
+          var span = Metrics.Span (trace);
           if (from != null) add_contact (from);
 
-          if ((value = yield value_store.lookup_value (id, cancellable)) != null)
+          try { value = yield value_store.lookup_value (id, cancellable); } finally
+            {
+              span.end ("store lookup", span.sampled () ? id.to_string () : null);
+            }
+
+          if (value != null)
 
             return new Value.inmediate ((owned) value);
           else
+            return delegate_value (id);
+        }
+
+      protected virtual async Value[] find_values (Key peer, Key[] ids, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          GLib.Error? error = null;
+          var left = ids.length;
+          var values = new Value [ids.length];
+
+          for (int i = 0; i < ids.length; ++i)
+            {
+              var at = i;
+
+              find_value.begin (peer, ids [i], trace, cancellable, (o, res) =>
+                {
+                  try { values [at] = find_value.end (res); } catch (GLib.Error e)
+                    {
+                      if (error == null) error = (owned) e;
+                    }
+
+                  if (--left == 0) find_values.callback ();
+                });
+            }
+
+          if (ids.length > 0) yield;
+          if (unlikely (error != null)) throw (owned) error;
+          return (owned) values;
+        }
+
+      public async Value[] find_values_complete (Key? from, Key[] ids, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          GLib.Value?[] found;
+          var span = Metrics.Span (trace);
+          if (from != null) add_contact (from);
+
+          try { found = yield value_store.lookup_values (ids, cancellable); } finally
             {
-              var ni = (SList<Key>) nearest (id);
-              var ar = (Key[]) new Key [ni.length ()];
-              int i = 0;
+              span.end ("store lookup", span.sampled () ? ids.length.to_string () + " keys" : null);
+            }
 
-              foreach (unowned var n in ni) ar [i++] = n.copy ();
-              return new Value.delegated ((owned) ar);
+          var values = new Value [ids.length];
+
+          for (int i = 0; i < ids.length; ++i)
+            {
+              if (found [i] != null)
+
+                values [i] = new Value.inmediate ((owned) found [i]);
+              else
+                values [i] = delegate_value (ids [i]);
             }
+          return (owned) values;
+        }
+
+      private Value delegate_value (Key id)
+        {
+          KeyVal span [Buckets.MAXSPAN];
+          var got = nearest_span (id, span);
+          var ar = (Key[]) new Key [got];
+
+          for (uint i = 0; i < got; ++i) ar [i] = new Key.from_val (span [i]);
+          return new Value.delegated ((owned) ar);
         }
 
-      protected virtual async bool store_value (Key peer, Key id, GLib.Value? value = null, GLib.Cancellable? cancellable = null) throws GLib.Error
+      protected virtual async bool store_value (Key peer, Key id, GLib.Value? value, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
           throw new IOError.FAILED ("unimplemented");
         }
 
-      public async bool store_value_complete (Key? from, Key id, GLib.Value? value = null, GLib.Cancellable? cancellable = null) throws GLib.Error
+      public async bool store_value_complete (Key? from, Key id, GLib.Value? value, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var span = Metrics.Span (trace);
+          if (from != null) add_contact (from);
+          if (from != null) republisher.received_from_peer (id);
+
+          try { yield value_store.insert_value (id, value, cancellable); } finally
+            {
+              span.end ("store insert", span.sampled () ? id.to_string () : null);
+            }
+
+          return true;
+        }
+
+      protected virtual async bool store_values (Key peer, Key[] ids, GLib.Value?[] values, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          GLib.Error? error = null;
+          var left = ids.length;
+          var stored = true;
+
+          for (int i = 0; i < ids.length; ++i)
+            {
+              store_value.begin (peer, ids [i], values [i], trace, cancellable, (o, res) =>
+                {
+                  try { stored &= store_value.end (res); } catch (GLib.Error e)
+                    {
+                      if (error == null) error = (owned) e;
+                    }
+
+                  if (--left == 0) store_values.callback ();
+                });
+            }
+
+          if (ids.length > 0) yield;
+          if (unlikely (error != null)) throw (owned) error;
+          return stored;
+        }
+
+      public async bool store_values_complete (Key? from, Key[] ids, GLib.Value?[] values, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
+          var span = Metrics.Span (trace);
           if (from != null) add_contact (from);
-          yield value_store.insert_value (id, value, cancellable);
+          if (from != null) foreach (unowned var id in ids) republisher.received_from_peer (id);
+
+          try { yield value_store.insert_values (ids, values, cancellable); } finally
+            {
+              span.end ("store insert", span.sampled () ? ids.length.to_string () + " keys" : null);
+            }
+
           return true;
         }
 
+      internal async void dispatch_batch (BatchKind kind, owned Key peer, owned PendingBatch batch)
+        {
+          GLib.Error? error = null;
+          unowned var items = batch.items;
+          var span = Metrics.Span (batch_trace (items));
+          var started = GLib.get_monotonic_time ();
+
+          try
+            {
+              if (items.length == 1) switch (kind)
+                {
+                  case BatchKind.FIND: items [0].found = yield find_value (peer, items [0].key, span.child (), batch.cancellable); break;
+                  case BatchKind.STORE: items [0].stored = yield store_value (peer, items [0].key, items [0].value, span.child (), batch.cancellable); break;
+                }
+              else
+                {
+                  var ids = new Key [items.length];
+
+                  for (int i = 0; i < ids.length; ++i) ids [i] = items [i].key.copy ();
+
+                  switch (kind)
+                    {
+                      case BatchKind.FIND:
+                        {
+                          var values = yield find_values (peer, ids, span.child (), batch.cancellable);
+
+                          if (unlikely (values.length != ids.length))
+
+                            throw new IOError.INVALID_DATA ("batched reply does not match request");
+
+                          for (int i = 0; i < ids.length; ++i) items [i].found = (owned) values [i];
+                          break;
+                        }
+
+                      case BatchKind.STORE:
+                        {
+                          var values = new GLib.Value? [ids.length];
+
+                          for (int i = 0; i < ids.length; ++i) values [i] = items [i].value;
+
+                          var stored = yield store_values (peer, ids, values, span.child (), batch.cancellable);
+
+                          for (int i = 0; i < ids.length; ++i) items [i].stored = stored;
+                          break;
+                        }
+                    }
+                }
+            }
+          catch (GLib.Error e)
+            {
+              error = (owned) e;
+            }
+
+          if (error != null && error.matches (PeerError.quark (), PeerError.UNREACHABLE))
+
+            Meters.get_default ().unreachable.inc ();
+
+          if (kind == BatchKind.FIND)
+
+            Meters.rpc (items.length == 1 ? RpcMethod.FIND_VALUE : RpcMethod.FIND_VALUES, peer, started, span);
+          else
+            Meters.rpc (items.length == 1 ? RpcMethod.STORE : RpcMethod.STORE_MANY, peer, started, span);
+
+          (kind == BatchKind.FIND ? finds : stores).complete (batch, error);
+        }
+
+      /* batches mix queries of unrelated lookups, the call goes under the first sampled one */
+      static Metrics.TraceContext batch_trace (GLib.GenericArray<Pending> items)
+        {
+          foreach (unowned var item in items) if (unlikely (item.trace.sampled ()))
+
+            return item.trace;
+
+          return Metrics.TraceContext ();
+        }
+
       public async bool insert (Key id, GLib.Value? value = null, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
-          var crawler = yield new InsertValueCrawler (this, id.copy (), cancellable);
-          return yield crawler.crawl (value, cancellable);
+          bool quorate;
+
+          yield replicate (id, value, write_quorum, out quorate, cancellable);
+          return quorate;
+        }
+
+      public async uint insert_replicated (Key id, GLib.Value? value = null, uint quorum = Buckets.MAXSPAN, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          bool quorate;
+          return yield replicate (id, value, quorum, out quorate, cancellable);
+        }
+
+      /* fewer than write_quorum closest peers means the quorum is all of them, as crawl has it */
+      private async uint replicate (Key id, GLib.Value? value, uint quorum, out bool quorate, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          var span = Metrics.Span (Metrics.Tracer.get_default ().sample ());
+
+          quorate = false;
+
+          try
+            {
+              var crawler = yield new InsertValueCrawler (this, id.copy (), span.child (), cancellable);
+              var acked = yield crawler.crawl (value, quorum, cancellable);
+
+              quorate = crawler.quorate;
+              return acked;
+            }
+          finally
+            {
+              span.end ("insert", span.sampled () ? id.to_string () : null);
+            }
         }
 
-      async bool insert_on_node (Key peer, Key id, GLib.Value? value = null, GLib.Cancellable? cancellable = null) throws GLib.Error
+      internal async bool insert_on_node (Key peer, Key id, GLib.Value? value, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
           bool same;
 
@@ -78,9 +300,16 @@ namespace Kademlia
             {
               if ((same = Key.equal (peer, this.id)) == false)
 
-                return yield store_value (peer, id, value, cancellable);
+                return yield stores.store (peer, id, value, trace, cancellable);
               else
-                return yield value_store.insert_value (id, value, cancellable);
+                {
+                  var span = Metrics.Span (trace);
+
+                  try { return yield value_store.insert_value (id, value, cancellable); } finally
+                    {
+                      span.end ("store insert", span.sampled () ? id.to_string () : null);
+                    }
+                }
             }
           catch (PeerError e)
             {
@@ -95,20 +324,13 @@ namespace Kademlia
             }
         }
 
-      internal async bool insert_on_nodes (GenericArray<Key> peers, Key id, GLib.Value? value = null, GLib.Cancellable? cancellable = null) throws GLib.Error
-        {
-          bool good = false;
-          foreach (unowned var peer in peers) if (yield insert_on_node (peer, id, value, cancellable)) good = true;
-          return good;
-        }
-
       public async GLib.Value? lookup (Key id, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
-          var crawler = new LookupValueCrawler (this, id.copy ());
+          var crawler = new LookupValueCrawler (this, id.copy (), Metrics.Tracer.get_default ().sample ());
           return yield crawler.crawl (cancellable);
         }
 
-      internal async Value? lookup_in_node (owned Key peer, Key id, GLib.Cancellable? cancellable = null) throws GLib.Error
+      internal async Value? lookup_in_node (owned Key peer, Key id, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
           Value? result;
           bool same;
@@ -117,17 +339,9 @@ namespace Kademlia
             {
               if ((same = Key.equal (peer, this.id)) == false)
 
-                result = yield find_value (peer, id, cancellable);
+                result = yield finds.find (peer, id, trace, cancellable);
               else
-                {
-                  GLib.Value? value;
-
-                  if ((value = yield value_store.lookup_value (id, cancellable)) == null)
-
-                    result = null;
-                  else
-                    result = new Value.inmediate ((owned) value);
-                }
+                result = yield find_value_complete (null, id, trace, cancellable);
 
               if (!same) awake_range (peer);
               return (owned) result;
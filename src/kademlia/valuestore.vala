@@ -29,5 +29,27 @@ namespace Kademlia
 
       public abstract async bool insert_value (Key key, GLib.Value? value = null, GLib.Cancellable? cancellable = null) throws GLib.Error;
       public abstract async GLib.Value? lookup_value (Key key, GLib.Cancellable? cancellable = null) throws GLib.Error;
+
+      public virtual async bool insert_values (Key[] keys, GLib.Value?[] values, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var stored = true;
+
+          for (int i = 0; i < keys.length; ++i)
+            {
+              stored &= yield insert_value (keys [i], values [i], cancellable);
+            }
+          return stored;
+        }
+
+      public virtual async GLib.Value?[] lookup_values (Key[] keys, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var values = new GLib.Value? [keys.length];
+
+          for (int i = 0; i < keys.length; ++i)
+            {
+              values [i] = yield lookup_value (keys [i], cancellable);
+            }
+          return (owned) values;
+        }
     }
 }
@@ -66,21 +66,36 @@ namespace Kademlia.DBus
             {
               yield peer.check_dormat_ranges (cancellable);
               yield peer.check_stale_contacts (cancellable);
+              meter_contacts (peer);
             }
         }
 
+      static void meter_contacts (PeerImpl peer)
+        {
+          uint nodes, replacements, stale;
+          var registry = Metrics.Registry.get_default ();
+          var help = "routing table contacts, by bucket slot";
+
+          peer.count_contacts (out nodes, out replacements, out stale);
+
+          registry.gauge ("kademlia_contacts", help, @"peer=\"$(peer.id)\",slot=\"node\"").set (nodes);
+          registry.gauge ("kademlia_contacts", help, @"peer=\"$(peer.id)\",slot=\"replacement\"").set (replacements);
+          registry.gauge ("kademlia_contacts", help, @"peer=\"$(peer.id)\",slot=\"stale\"").set (stale);
+        }
+
       private async void value_step (Hub hub, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
           var locals = new GLib.List<PeerImpl> ();
           hub.foreach_local ((a, b, peer) => locals.append (peer));
 
-          foreach (unowned var peer in locals) foreach (unowned var key in yield peer.value_store.enumerate_staled_values (cancellable))
+          foreach (unowned var peer in locals)
             {
-              GLib.Value? value;
+              yield peer.republisher.step (cancellable);
 
-              if ((value = yield peer.value_store.lookup_value (key, cancellable)) != null)
+              var registry = Metrics.Registry.get_default ();
+              var labels = @"peer=\"$(peer.id)\"";
 
-                yield peer.insert (key, (owned) value, cancellable);
+              registry.gauge ("kademlia_republish_backlog", "stale values waiting for their republication", labels).set (peer.republisher.backlog);
             }
         }
 
@@ -90,6 +105,8 @@ namespace Kademlia.DBus
 
           if ((hub = _hub.get () as Hub) != null)
             {
+              hub.expire ();
+
               if (peer_mutex.trylock ())
 
                 peer_step.begin (hub, cancellable, (o, res) =>
@@ -0,0 +1,555 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+[CCode (cprefix = "KDBus", lower_case_cprefix = "k_dbus_")]
+
+namespace Kademlia.DBus
+{
+  /*
+   * Maintenance calls (Ping and FindNode) over UDP, one packet each way.
+   * Every encrypted link whose handshake derived datagram keys (see
+   * Krypt.IOStream) opens a channel named by the session id both ends got.
+   * Channels are not tied to the stream: they stay usable after it closes
+   * for as long as the session cache keeps the tickets that handshake left
+   * behind, so contacts whose link idled out still get pinged over UDP;
+   * packets carry the same frames WireLink uses, sealed as one datagram.
+   * Unanswered requests get sealed and sent again (a resent copy of the
+   * same packet would be dropped as a replay) a few times before timing
+   * out, and replies not fitting a packet come back as MESSAGE_TOO_LARGE
+   * errors so callers go through the stream instead.
+   */
+
+  internal class Datagrams : GLib.Object
+    {
+      public const uint8 KIND = 1;
+      public const uint MAXPACKET = 1200;
+      public const uint RETRIES = 3;
+      public const uint RETRYTIME = 250;
+
+      private WeakRef _hub;
+      public Hub hub { owned get { return (Hub) _hub.get (); } construct { _hub.set (value); } }
+
+      private GLib.HashTable<uint, unowned Call> calls;
+      private GLib.HashTable<uint64?, Channel> channels;
+      private uint32 last_id = 0;
+      private GLib.HashTable<Key, unowned Channel> peers;
+      private GLib.GenericArray<GLib.Socket> sockets;
+      private GLib.GenericArray<GLib.Source> sources;
+
+      [Compact (opaque = true)] class Call
+        {
+          public GLib.SourceFunc callback;
+          public GLib.Error? error;
+          public WireReader? reply;
+          public uint64 session;
+
+          public Call (owned GLib.SourceFunc callback, uint64 session)
+            {
+              this.callback = (owned) callback;
+              this.error = null;
+              this.reply = null;
+              this.session = session;
+            }
+        }
+
+      /* keys of one encrypted link, and where the other end takes datagrams */
+      [Compact (opaque = true)] class Channel
+        {
+          public int64 expires;
+          public Krypt.Aead.DatagramOpener opener;
+          public GLib.InetSocketAddress? remote;
+          public Krypt.Aead.DatagramSealer sealer;
+          public uint64 session;
+
+          public Channel (Krypt.IOStream stream, GLib.InetSocketAddress? remote, int64 expires)
+            {
+              this.expires = expires;
+              this.opener = stream.datagram_opener;
+              this.remote = remote;
+              this.sealer = stream.datagram_sealer;
+              this.session = stream.datagram_session;
+            }
+        }
+
+      ~Datagrams ()
+        {
+          foreach (unowned var source in sources) source.destroy ();
+        }
+
+      construct
+        {
+          calls = new GLib.HashTable<uint, unowned Call> (GLib.direct_hash, GLib.direct_equal);
+          channels = new GLib.HashTable<uint64?, Channel> (GLib.int64_hash, GLib.int64_equal);
+          peers = new GLib.HashTable<Key, unowned Channel> (Key.hash, Key.equal);
+          sockets = new GLib.GenericArray<GLib.Socket> ();
+          sources = new GLib.GenericArray<GLib.Source> ();
+        }
+
+      public Datagrams (Hub hub)
+        {
+          Object (hub : hub);
+        }
+
+      /* the first address the node advertised which parses as an ip one */
+      private GLib.InetSocketAddress? advertised (Key id)
+        {
+          foreach (unowned var address in hub.list_remote_addresses (id))
+            {
+              var remote = new GLib.InetSocketAddress.from_string (address.address, address.port);
+
+              if (remote != null) return remote;
+            }
+
+          return null;
+        }
+
+      public GLib.Socket bind (GLib.InetSocketAddress address) throws GLib.Error
+        {
+          var socket = new GLib.Socket (address.family, GLib.SocketType.DATAGRAM, GLib.SocketProtocol.UDP);
+          var source = socket.create_source (GLib.IOCondition.IN);
+
+          socket.blocking = false;
+          socket.bind (address, true);
+
+          source.set_callback ((s, c) => on_readable (s, c));
+          source.attach (GLib.MainContext.get_thread_default ());
+
+          lock (sockets)
+            {
+              sockets.add (socket);
+              sources.add (source);
+            }
+
+          return socket;
+        }
+
+      /* drops channels whose handshake tickets are gone by now */
+      public void expire ()
+        {
+          var now = GLib.get_monotonic_time ();
+
+          lock (channels)
+            {
+              peers.foreach_remove ((id, channel) => channel.expires <= now);
+              channels.foreach_remove ((session, channel) => channel.expires <= now);
+            }
+        }
+
+      /* stops using datagrams towards a node which did not answer them */
+      private void forget (Key id, uint64 session)
+        {
+          lock (channels) if (peers.lookup (id) == channels.lookup (session))
+
+            peers.remove (id);
+        }
+
+      public async WireReader invoke (Key to, owned WireWriter request, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var id = request.id;
+          var frame = request.end ();
+          var remote = (GLib.InetSocketAddress?) null;
+          var session = (uint64) 0;
+
+          if (unlikely (frame.get_size () > MAXPACKET))
+
+            throw new IOError.MESSAGE_TOO_LARGE ("request does not fit a datagram");
+
+          lock (channels)
+            {
+              unowned Channel? channel;
+
+              if ((channel = peers.lookup (to)) != null)
+                {
+                  if (channel.remote == null) channel.remote = advertised (to);
+
+                  remote = channel.remote;
+                  session = channel.session;
+                }
+            }
+
+          if (unlikely (remote == null))
+
+            throw new IOError.NOT_CONNECTED ("no datagram channel to %s", to.to_string ());
+
+          var call = new Call (invoke.callback, session);
+          var context = GLib.MainContext.ref_thread_default ();
+          var timeout = new GLib.TimeoutSource (RETRYTIME);
+          var tries = 1;
+          ulong handler_id = 0;
+
+          if (cancellable != null)
+
+            cancellable.set_error_if_cancelled ();
+
+          lock (calls) calls.insert (id, call);
+
+          try { transmit (session, remote, frame); } catch (GLib.Error e)
+            {
+              lock (calls) calls.remove (id);
+              throw (owned) e;
+            }
+
+          /* as in WireLink.invoke, never resume from inside the handler */
+          if (cancellable != null)
+
+            handler_id = cancellable.connect (() =>
+              {
+                var source = new GLib.IdleSource ();
+
+                source.set_callback (() =>
+                  {
+                    resolve (id, session, new IOError.CANCELLED ("operation was cancelled"));
+                    return GLib.Source.REMOVE;
+                  });
+
+                source.attach (context);
+              });
+
+          timeout.set_callback (() =>
+            {
+              if (tries++ >= RETRIES)
+                {
+                  resolve (id, session, new IOError.TIMED_OUT ("datagram request timed out"));
+                  return GLib.Source.REMOVE;
+                }
+
+              try { transmit (session, remote, frame); } catch (GLib.Error e)
+                {
+                  resolve (id, session, (owned) e);
+                  return GLib.Source.REMOVE;
+                }
+              return GLib.Source.CONTINUE;
+            });
+
+          timeout.attach (context);
+          yield;
+
+          timeout.destroy ();
+
+          if (cancellable != null)
+
+            cancellable.disconnect (handler_id);
+
+          if (unlikely (call.error != null))
+            {
+              if (call.error.matches (IOError.quark (), IOError.TIMED_OUT))
+
+                forget (to, session);
+
+              throw (owned) call.error;
+            }
+
+          return (owned) call.reply;
+        }
+
+      public void link (Krypt.IOStream stream, GLib.GenericArray<Key> ids)
+        {
+          GLib.InetSocketAddress? remote = null;
+
+          if (stream.datagram_sealer == null)
+
+            return;
+
+          /* only the dialing end knows for sure which address the other one listens at */
+          if (stream.initiator && stream.base_stream is GLib.SocketConnection) try
+            {
+              remote = (GLib.InetSocketAddress) ((GLib.SocketConnection) stream.base_stream).get_remote_address ();
+            }
+          catch (GLib.Error e)
+            {
+              debug ("can not get remote address: %s: %u: %s", e.domain.to_string (), e.code, e.message);
+            }
+
+          var expires = GLib.get_monotonic_time () + hub.session_cache.lifetime;
+          var channel = new Channel (stream, remote, expires);
+          var replaced = new GLib.GenericSet<uint64?> (GLib.int64_hash, GLib.int64_equal);
+
+          lock (channels)
+            {
+              foreach (unowned var id in ids)
+                {
+                  unowned Channel? older;
+
+                  if ((older = peers.lookup (id)) != null) replaced.add (older.session);
+                  peers.replace (id.copy (), channel);
+                }
+
+              /* a new link to the same nodes supersedes whatever channel an older one left */
+              replaced.foreach ((session) =>
+                {
+                  unowned Channel? older = channels.lookup (session);
+
+                  if (older != null && peers.find ((id, other) => other == older) == null)
+
+                    channels.remove (session);
+                });
+
+              channels.replace (stream.datagram_session, (owned) channel);
+            }
+        }
+
+      private bool on_readable (GLib.Socket socket, GLib.IOCondition condition)
+        {
+          var buffer = new uint8 [MAXPACKET + Krypt.Aead.DATAGRAM_HEADSZ + Krypt.Aead.TAGSZ];
+          GLib.SocketAddress? from = null;
+          ssize_t got = 0;
+
+          while (true)
+            {
+              try { got = socket.receive_from (out from, buffer); } catch (GLib.Error e)
+                {
+                  if (e.matches (IOError.quark (), IOError.WOULD_BLOCK) == false)
+
+                    debug ("receiving datagram: %s: %u: %s", e.domain.to_string (), e.code, e.message);
+                  break;
+                }
+
+              try { process (socket, from, buffer [0 : got]); } catch (GLib.Error e)
+                {
+                  debug ("dropping datagram: %s: %u: %s", e.domain.to_string (), e.code, e.message);
+                }
+            }
+
+          return GLib.Source.CONTINUE;
+        }
+
+      private GLib.Socket pick_socket (GLib.SocketFamily family) throws GLib.Error
+        {
+          GLib.Socket? found = null;
+
+          lock (sockets) foreach (unowned var socket in sockets) if (socket.family == family)
+            {
+              found = socket;
+              break;
+            }
+
+          return found ?? bind (new GLib.InetSocketAddress (new GLib.InetAddress.any (family), 0));
+        }
+
+      private void process (GLib.Socket socket, GLib.SocketAddress from, uint8[] packet) throws GLib.Error
+        {
+          uint8[] plain;
+          var session = Krypt.Aead.DatagramOpener.parse_session (packet);
+
+          if (unlikely (Krypt.Aead.DatagramOpener.parse_kind (packet) != KIND))
+
+            throw new IOError.NOT_SUPPORTED ("unknown datagram kind");
+
+          lock (channels)
+            {
+              unowned Channel? channel;
+
+              if ((channel = channels.lookup (session)) == null)
+
+                throw new IOError.NOT_FOUND ("unknown datagram session");
+
+              plain = channel.opener.open (packet);
+            }
+
+          var reader = new WireReader (new GLib.Bytes.take ((owned) plain));
+
+          reader.get_uint32 ();
+
+          var id = reader.get_uint32 ();
+          var op = reader.get_uint8 ();
+
+          if ((op & WireOp.ERROR) != 0)
+
+            resolve (id, session, reader.get_error ());
+
+          else if ((op & WireOp.REPLY) != 0)
+
+            resolve (id, session, null, (owned) reader);
+          else
+            serve.begin (socket, from, session, id, op, (owned) reader);
+        }
+
+      public WireWriter request (WireOp op, Key to)
+        {
+          uint32 id;
+
+          lock (calls) id = ++last_id;
+
+          var request = new WireWriter (id, op);
+
+          request.put_key (to.bytes);
+          return (owned) request;
+        }
+
+      private void resolve (uint32 id, uint64 session, owned GLib.Error? error, owned WireReader? reply = null)
+        {
+          unowned Call? call;
+
+          lock (calls)
+            {
+              if ((call = calls.lookup (id)) != null && call.session == session)
+
+                calls.remove (id);
+              else
+                call = null;
+            }
+
+          if (call != null)
+            {
+              call.error = (owned) error;
+              call.reply = (owned) reply;
+              call.callback ();
+            }
+        }
+
+      private async void respond (uint8 op, WireReader request, WireWriter reply) throws GLib.Error
+        {
+          var hub = this.hub;
+          var to = new Key.verbatim (request.get_key ());
+
+          if (unlikely (hub.has_local (to) == false))
+
+            throw new PeerError.NOT_FOUND ("no such node %s", to.to_string ());
+
+          var role = yield hub.lookup_role (to);
+          var from = request.get_peer ();
+          var trace = request.get_trace ();
+
+          switch (op)
+            {
+              case WireOp.PING:
+
+                reply.put_bool (yield role.ping (from, trace));
+                break;
+
+              case WireOp.FIND_NODE:
+                {
+                  var key = KeyRef (request.get_key ());
+                  reply.put_peers (yield role.find_node (from, key, trace));
+                  break;
+                }
+
+              default:
+
+                throw new IOError.NOT_SUPPORTED ("opcode %u not served over datagrams", op);
+            }
+        }
+
+      private uint8[] seal (uint64 session, GLib.Bytes frame) throws GLib.Error
+        {
+          unowned Channel? channel;
+
+          lock (channels)
+            {
+              if ((channel = channels.lookup (session)) == null)
+
+                throw new IOError.CONNECTION_CLOSED ("datagram channel closed");
+
+              return channel.sealer.seal (KIND, session, frame.get_data ());
+            }
+        }
+
+      private async void serve (GLib.Socket socket, GLib.SocketAddress to, uint64 session, uint32 id, uint8 op, owned WireReader request)
+        {
+          var reply = new WireWriter (id, op | WireOp.REPLY);
+
+          try { yield respond (op, request, reply); } catch (GLib.Error e)
+            {
+              reply = new WireWriter (id, WireOp.ERROR);
+              reply.put_error (e);
+            }
+
+          var frame = reply.end ();
+
+          if (frame.get_size () > MAXPACKET)
+            {
+              reply = new WireWriter (id, WireOp.ERROR);
+              reply.put_error (new IOError.MESSAGE_TOO_LARGE ("reply does not fit a datagram"));
+              frame = reply.end ();
+            }
+
+          try { socket.send_to (to, seal (session, frame)); } catch (GLib.Error e)
+            {
+              debug ("replying datagram: %s: %u: %s", e.domain.to_string (), e.code, e.message);
+            }
+        }
+
+      private void transmit (uint64 session, GLib.InetSocketAddress remote, GLib.Bytes frame) throws GLib.Error
+        {
+          pick_socket (remote.family).send_to (remote, seal (session, frame));
+        }
+
+      public Role? pick_role (Key id)
+        {
+          lock (channels) if (peers.contains (id) == false) return null;
+          return new DatagramRole (this, id);
+        }
+    }
+
+  /*
+   * Role answering Ping and FindNode through Datagrams, anything else is
+   * left for the stream roles
+   */
+
+  internal class DatagramRole : GLib.Object, Role
+    {
+      public Datagrams datagrams { get; construct; }
+      public Key target { get; construct; }
+
+      public KeyRef id { owned get { return KeyRef (target.bytes); } }
+      public string role { owned get { return datagrams.hub.pick_contact_role (target)?.role ?? ""; } }
+
+      public DatagramRole (Datagrams datagrams, Key target)
+        {
+          Object (datagrams : datagrams, target : target);
+        }
+
+      public async PeerRef[] find_node (PeerRef from, KeyRef key, Metrics.TraceContext trace, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          var request = datagrams.request (WireOp.FIND_NODE, target);
+
+          request.put_peer (from);
+          request.put_trace (trace);
+          request.put_key (key.value);
+          return (yield datagrams.invoke (target, (owned) request, cancellable)).get_peers ();
+        }
+
+      public async ValueRef find_value (PeerRef from, KeyRef key, Metrics.TraceContext trace, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          throw new IOError.NOT_SUPPORTED ("FindValue is not served over datagrams");
+        }
+
+      public async ValueRef[] find_values (PeerRef from, KeyRef[] keys, Metrics.TraceContext trace, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          throw new IOError.NOT_SUPPORTED ("FindValues is not served over datagrams");
+        }
+
+      public async bool ping (PeerRef from, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var request = datagrams.request (WireOp.PING, target);
+
+          request.put_peer (from);
+          request.put_trace (trace);
+          return (yield datagrams.invoke (target, (owned) request, cancellable)).get_bool ();
+        }
+
+      public async bool store (PeerRef from, KeyRef key, GLib.Variant value, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          throw new IOError.NOT_SUPPORTED ("Store is not served over datagrams");
+        }
+
+      public async bool store_many (PeerRef from, KeyRef[] keys, GLib.Variant[] values, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          throw new IOError.NOT_SUPPORTED ("StoreMany is not served over datagrams");
+        }
+    }
+}
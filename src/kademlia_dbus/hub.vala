@@ -25,6 +25,7 @@ namespace Kademlia.DBus
       public GLib.HashTable<Key, GenericSet<Address?>> contacts { get; construct; }
       public GLib.HashTable<Key, Local?> locals { get; construct; }
       public GLib.HashTable<Key, Role> roles { get; construct; }
+      public Krypt.Dh.SessionCache session_cache { get; construct; }
       private Clock clock;
 
       public struct Local
@@ -51,6 +52,7 @@ namespace Kademlia.DBus
           clock = new Clock (this);
           locals = new HashTable<Key, Local?> (Key.hash, Key.equal);
           roles = new HashTable<Key, Role> (Key.hash, Key.equal);
+          if (session_cache == null) session_cache = new Krypt.Dh.SessionCache ();
         }
 
       [CCode (scope = "notified")]
@@ -254,8 +256,10 @@ namespace Kademlia.DBus
               lock (roles) role = roles.lookup (id);
 
               if (unlikely (role != null))
-
-                return role;
+                {
+                  touch_role (id);
+                  return role;
+                }
               else
                 {
                   lock (locals) local = locals.lookup (id);
@@ -264,9 +268,9 @@ namespace Kademlia.DBus
                     {
                       add_contact_role (id, new RoleSkeleton (this, local.role, local.peer));
                     }
-                  else while (false == yield reconnect (id, cancellable))
+                  else if (false == yield reconnect (id, cancellable))
                     {
-                      GLib.Thread.yield ();
+                      break;
                     }
                 }
             }
@@ -276,6 +280,16 @@ namespace Kademlia.DBus
 
       public abstract async bool reconnect (Key id, GLib.Cancellable? cancellable = null) throws GLib.Error;
 
+      /* called on every clock tick, lets hubs drop whatever went idle */
+      internal virtual void expire ()
+        {
+        }
+
+      /* called whenever a known role is handed out to a caller, or its node reached us */
+      internal virtual void touch_role (Key id)
+        {
+        }
+
       public void remove_local_peer (Key id)
         {
           Local? local = null;
@@ -298,5 +312,11 @@ namespace Kademlia.DBus
         {
           lock (roles) return roles.lookup (id);
         }
+
+      /* role taking Ping and FindNode over datagrams, if the hub has one towards id */
+      public virtual Role? pick_datagram_role (Key id)
+        {
+          return null;
+        }
     }
 }
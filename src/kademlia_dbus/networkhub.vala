@@ -31,18 +31,93 @@ namespace Kademlia.DBus
     {
       public const uint16 DEFAULT_PORT = 33334;
 
+      [CCode (cheader_filename = "glib.h", cname = "G_USEC_PER_SEC")]
+
+      public extern const int64 USEC_PER_SEC;
+
+      public const int64 FIRSTBACKOFF = USEC_PER_SEC >> 1;
+      public const int64 IDLETIME = 300 * USEC_PER_SEC;
+      public const uint MAXBACKOFF = 7;
+
+      /* how long a connection may go unused before it gets closed */
+      public int64 idle_time { get; construct; default = IDLETIME; }
+
+      private GLib.HashTable<Address?, Backoff> backoffs;
+      private Datagrams datagrams;
+      private GLib.HashTable<Key, Dial> dials;
       private GLib.ThreadPool<GLib.SocketConnection> incomming_pool;
+      private GLib.HashTable<Key, unowned Link> linked;
+      private GLib.HashTable<unowned GLib.DBusConnection, Link> links;
+      private int64 next_expire = 0;
       private GLib.SocketService socket_service;
 
+      /* failed dials to an address, and when it may be dialed again */
+      [Compact (opaque = true)] class Backoff
+        {
+          public uint failures;
+          public int64 until;
+
+          public Backoff ()
+            {
+              this.failures = 0;
+              this.until = 0;
+            }
+        }
+
+      /*
+       * A reconnect in flight; whoever else asks for the same node while it
+       * lasts waits for its outcome instead of dialing again
+       */
+      [Compact (opaque = true)] class Dial
+        {
+          public GLib.Queue<unowned Waiter> waiters;
+
+          public Dial ()
+            {
+              this.waiters = new GLib.Queue<unowned Waiter> ();
+            }
+        }
+
+      [Compact (opaque = true)] class Waiter
+        {
+          public GLib.SourceFunc callback;
+          public GLib.Error? error;
+          public bool result;
+
+          public Waiter (owned GLib.SourceFunc callback)
+            {
+              this.callback = (owned) callback;
+              this.error = null;
+              this.result = false;
+            }
+        }
+
+      /* an established connection, shared by every node reachable through it */
+      [Compact (opaque = true)] class Link
+        {
+          public GLib.DBusConnection dbus;
+          public GLib.GenericArray<Key> ids;
+          public int64 lastuse;
+
+          public Link (GLib.DBusConnection dbus, owned GLib.GenericArray<Key> ids)
+            {
+              this.dbus = dbus;
+              this.ids = (owned) ids;
+              this.lastuse = GLib.get_monotonic_time ();
+            }
+        }
+
       struct RegIds
         {
           public uint node_regid;
           public uint[] role_regids;
+          public uint stats_regid;
 
-          public RegIds (uint node_regid, owned uint[] role_regids)
+          public RegIds (uint node_regid, owned uint[] role_regids, uint stats_regid)
             {
               this.node_regid = node_regid;
               this.role_regids = (owned) role_regids;
+              this.stats_regid = stats_regid;
             }
         }
 
@@ -50,6 +125,12 @@ namespace Kademlia.DBus
         {
           int max_threads;
 
+          backoffs = new GLib.HashTable<Address?, Backoff> (Address.hash, Address.equal);
+          datagrams = new Datagrams (this);
+          dials = new GLib.HashTable<Key, Dial> (Key.hash, Key.equal);
+          linked = new GLib.HashTable<Key, unowned Link> (Key.hash, Key.equal);
+          links = new GLib.HashTable<unowned GLib.DBusConnection, Link> (GLib.direct_hash, GLib.direct_equal);
+
           try
             {
               max_threads = (int) GLib.get_num_processors ();
@@ -65,6 +146,11 @@ namespace Kademlia.DBus
             }
         }
 
+      public NetworkHub (int64 idle_time = IDLETIME)
+        {
+          Object (idle_time : idle_time);
+        }
+
       public new async void add_local_address (string host_and_port, uint16 default_port, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
           var network_address = GLib.NetworkAddress.parse (host_and_port, default_port);
@@ -82,19 +168,16 @@ namespace Kademlia.DBus
               var inet_address = ((GLib.InetSocketAddress) effective_address).address;
               var inet_port = ((GLib.InetSocketAddress) effective_address).port;
               base.add_local_address (inet_address.to_string (), (uint16) inet_port);
+
+              try { datagrams.bind ((GLib.InetSocketAddress) effective_address); } catch (GLib.Error e)
+                {
+                  warning ("can not bind datagram socket: %s: %u: %s", e.domain.to_string (), e.code, e.message);
+                }
             }
         }
 
-      private async Node? connect_to (string host_and_port, uint16 default_port, GLib.Cancellable? cancellable = null) throws GLib.Error
+      private async Node? adopt (GLib.DBusConnection dbus, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
-          var flags1 = GLib.DBusConnectionFlags.AUTHENTICATION_CLIENT;
-          var flags2 = GLib.DBusConnectionFlags.DELAY_MESSAGE_PROCESSING;
-          var flags = flags1 | flags2;
-          var socket_connection = yield (new SocketClient ()).connect_to_host_async (host_and_port, default_port, cancellable);
-          var krypt_stream = new Krypt.IOStream ("AES", "CBC", socket_connection);
-          yield krypt_stream.handshake_client (GLib.Priority.LOW, cancellable);
-          var dbus = yield new GLib.DBusConnection (krypt_stream, null, flags, null, cancellable);
-
           yield prepare_connection (dbus, cancellable);
 
           dbus.exit_on_close = false;
@@ -103,6 +186,18 @@ namespace Kademlia.DBus
           return yield register_connection (dbus, cancellable);
         }
 
+      private bool backing_off (Address? address, int64 now)
+        {
+          unowned Backoff? backoff;
+          lock (backoffs) return (backoff = backoffs.lookup (address)) != null && backoff.until > now;
+        }
+
+      private async Node? connect_to (string host_and_port, uint16 default_port, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var dbus = yield dial (host_and_port, default_port, cancellable);
+          return yield adopt (dbus, cancellable);
+        }
+
       public async ValuePeer create_proxy_at (string host_and_port, uint16 default_port, string role, GLib.Cancellable? cancellable) throws GLib.Error
         {
           var node = (Node?) yield connect_to (host_and_port, default_port, cancellable);
@@ -119,6 +214,209 @@ namespace Kademlia.DBus
           return (owned) proxy;
         }
 
+      private async GLib.DBusConnection dial (string host_and_port, uint16 default_port, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var flags1 = GLib.DBusConnectionFlags.AUTHENTICATION_CLIENT;
+          var flags2 = GLib.DBusConnectionFlags.DELAY_MESSAGE_PROCESSING;
+          var flags = flags1 | flags2;
+          var socket_connection = yield (new SocketClient ()).connect_to_host_async (host_and_port, default_port, cancellable);
+          var krypt_stream = new Krypt.IOStream ("AES", "GCM", socket_connection);
+
+          krypt_stream.session_cache = session_cache;
+          krypt_stream.session_name = @"$host_and_port/$default_port";
+
+          yield krypt_stream.handshake_client (GLib.Priority.LOW, cancellable);
+          return yield new GLib.DBusConnection (krypt_stream, null, flags, null, cancellable);
+        }
+
+      /*
+       * Dials every known address of the node at once (but those backing off)
+       * and keeps the first connection to come up, the rest get cancelled or
+       * closed. A node still linked through a live connection (its role was
+       * dropped after a failed call) is not dialed at all.
+       */
+
+      private async bool dial_node (Key id, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          GLib.DBusConnection? dbus = null;
+          unowned Link? link;
+
+          lock (links) if ((link = linked.lookup (id)) != null && link.dbus.is_closed () == false) dbus = link.dbus;
+
+          if (dbus != null)
+            {
+              add_contact_role (id, yield dbus.get_proxy<Role> (null, @"$(Node.BASE_PATH)/$id", 0, cancellable));
+              return true;
+            }
+
+          var addresses = list_remote_addresses (id);
+          var now = GLib.get_monotonic_time ();
+          var pending = 0;
+          var prevrole = pick_contact_role (id)?.role;
+          var race = new GLib.Cancellable ();
+          var waiting = false;
+          GLib.Error? error = null;
+
+          if (unlikely (addresses.length == 0))
+            {
+              var id_s = id.to_string ();
+              debug ("not route to node %s", id_s);
+              throw new PeerError.UNREACHABLE ("can not reach node '%s'", id_s);
+            }
+
+          ulong handler_id = 0;
+
+          if (cancellable != null)
+
+            handler_id = cancellable.connect (() => race.cancel ());
+
+          foreach (unowned var address in addresses) if (backing_off (address, now) == false)
+            {
+              var at = (Address) address;
+              ++pending;
+
+              dial.begin (at.address, at.port, race, (o, res) =>
+                {
+                  GLib.DBusConnection? got = null;
+
+                  try { got = ((NetworkHub) o).dial.end (res); } catch (GLib.Error e)
+                    {
+                      if (e.matches (GLib.IOError.quark (), GLib.IOError.CANCELLED) == false)
+
+                        failed (id, at);
+
+                      if (error == null) error = (owned) e;
+                    }
+
+                  if (got != null) succeeded (at);
+
+                  if (got != null && dbus == null)
+                    {
+                      dbus = got;
+                      race.cancel ();
+                    }
+                  else if (got != null)
+                    {
+                      got.close.begin (null);
+                    }
+
+                  --pending;
+
+                  if (waiting && (pending == 0 || dbus != null))
+                    {
+                      waiting = false;
+                      dial_node.callback ();
+                    }
+                });
+            }
+
+          if (pending > 0 && dbus == null)
+            {
+              waiting = true;
+              yield;
+            }
+
+          if (cancellable != null)
+
+            cancellable.disconnect (handler_id);
+
+          if (unlikely (dbus == null && error != null))
+
+            throw (owned) error;
+
+          else if (unlikely (dbus == null))
+
+            throw new PeerError.UNREACHABLE ("backing off node '%s'", id.to_string ());
+
+          var done = null != yield adopt (dbus, cancellable);
+          var role = done == false ? null : pick_contact_role (id);
+
+          if (unlikely (role == null && prevrole == null))
+
+            throw new PeerError.UNREACHABLE ("peer has no roles %s", id.to_string ());
+
+          else if (unlikely (role == null))
+            {
+              debug ("peer registered as %s, vanished", id.to_string ());
+              throw new NetworkError.RESETTED_PEER ("peer vanished %s:%s", prevrole, id.to_string ());
+            }
+
+          var newid = new Key.verbatim (role.id.value);
+
+          if (unlikely (Key.equal (id, newid) == false || (prevrole != null && prevrole != role.role)))
+            {
+
+              if (Key.equal (id, newid) == false)
+
+                debug ("peer registered as %s, id changed to %s", id.to_string (), newid.to_string ());
+
+              else if (prevrole != null && prevrole != role.role)
+
+                debug ("peer registered role was %s, changed to %s:%s", prevrole, role.role, newid.to_string ());
+
+              throw new NetworkError.RESETTED_PEER ("peer role was resetted (maybe address collision?)");
+            }
+
+          return true;
+        }
+
+      internal override void expire ()
+        {
+          var idle = new GLib.SList<GLib.DBusConnection> ();
+          var now = GLib.get_monotonic_time ();
+
+          if (now < next_expire)
+
+            return;
+
+          lock (links)
+            {
+              unowned Link? link;
+              var iter = GLib.HashTableIter<unowned GLib.DBusConnection, Link> (links);
+
+              while (iter.next (null, out link)) if (link.lastuse + idle_time <= now)
+
+                idle.prepend (link.dbus);
+            }
+
+          foreach (unowned var dbus in idle)
+            {
+              debug ("closing idle connection");
+              dbus.close.begin (null);
+            }
+
+          datagrams.expire ();
+          next_expire = now + (idle_time >> 4);
+        }
+
+      /* bumps address backoff (FIRSTBACKOFF doubling), and forgets it once it failed too often */
+      private void failed (Key id, Address? address)
+        {
+          unowned Backoff? backoff;
+          var drop = false;
+
+          lock (backoffs)
+            {
+              if ((backoff = backoffs.lookup (address)) == null)
+                {
+                  backoffs.insert (address, new Backoff ());
+                  backoff = backoffs.lookup (address);
+                }
+
+              if ((drop = ++backoff.failures > MAXBACKOFF) == true)
+
+                backoffs.remove (address);
+              else
+                backoff.until = GLib.get_monotonic_time () + (FIRSTBACKOFF << (backoff.failures - 1));
+            }
+
+          if (drop)
+            {
+              debug ("dropping address %s:%u of %s", address.address, address.port, id.to_string ());
+              drop_contact_address (id, address);
+            }
+        }
+
       public async bool join_at (string host_and_port, uint16 default_port, string? role, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
           var any = 0;
@@ -143,6 +441,31 @@ namespace Kademlia.DBus
 
             dbus.unregister_object (regid);
             dbus.unregister_object (regids.node_regid);
+            dbus.unregister_object (regids.stats_regid);
+        }
+
+      private void on_link_closed (GLib.DBusConnection dbus)
+        {
+          Link? link;
+
+          lock (links)
+            {
+              if (links.steal_extended (dbus, null, out link))
+
+                foreach (unowned var id in link.ids) if (linked.lookup (id) == link)
+                  {
+                    linked.remove (id);
+                  }
+            }
+
+          if (link != null) foreach (unowned var id in link.ids)
+            {
+              var role = pick_contact_role (id);
+
+              if (role != null && ((GLib.DBusProxy) role).get_connection () == dbus)
+
+                drop_role (id);
+            }
         }
 
       private bool on_incoming (GLib.SocketConnection socket_connection)
@@ -161,16 +484,13 @@ namespace Kademlia.DBus
           var flags3 = GLib.DBusConnectionFlags.DELAY_MESSAGE_PROCESSING;
           var flags = flags1 | flags2 | flags3;
           var guid = GLib.DBus.generate_guid ();
-          var krypt_stream = new Krypt.IOStream ("AES", "CBC", socket_connection);
-          yield krypt_stream.handshake_server (GLib.Priority.LOW, cancellable);
-          var dbus = yield new GLib.DBusConnection (krypt_stream, guid, flags, null, cancellable);
-
-          yield prepare_connection (dbus, cancellable);
+          var krypt_stream = new Krypt.IOStream ("AES", "GCM", socket_connection);
 
-          dbus.exit_on_close = false;
-          dbus.start_message_processing ();
+          krypt_stream.session_cache = session_cache;
 
-          return yield register_connection (dbus, cancellable);
+          yield krypt_stream.handshake_server (GLib.Priority.LOW, cancellable);
+          var dbus = yield new GLib.DBusConnection (krypt_stream, guid, flags, null, cancellable);
+          return yield adopt (dbus, cancellable);
         }
 
       private void on_incoming_pooled (owned GLib.SocketConnection socket_connection)
@@ -186,11 +506,17 @@ namespace Kademlia.DBus
             });
         }
 
+      public override Role? pick_datagram_role (Key id)
+        {
+          return datagrams.pick_role (id);
+        }
+
       private async bool prepare_connection (GLib.DBusConnection dbus, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
           var node = new NodeSkeleton (this);
           var node_regid = dbus.register_object<Node> (Node.BASE_PATH, node);
           var role_regids = new Array<uint> ();
+          var stats_regid = dbus.register_object<Stats> (Stats.PATH, new StatsSkeleton ());
 
           foreach_local ((id, role, value_peer) =>
             {
@@ -199,86 +525,119 @@ namespace Kademlia.DBus
               role_regids.append_val (regid);
             });
 
-          var regids = RegIds (node_regid, role_regids.steal ());
+          var regids = RegIds (node_regid, role_regids.steal (), stats_regid);
 
           dbus.on_closed.connect ((c, a, b) => on_closed (c, regids));
           return true;
         }
 
+      private void succeeded (Address? address)
+        {
+          lock (backoffs) backoffs.remove (address);
+        }
+
       public void start () { socket_service.start (); }
 
       public void stop () { socket_service.stop (); }
 
       protected override async bool reconnect (Key id, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
-          var address = pick_contact_address (id);
-          var prevrole = pick_contact_role (id)?.role;
+          unowned Dial? dial;
+          Dial? done;
+          GLib.Error? error = null;
+          var result = false;
 
-          if (unlikely (address == null))
-            {
-              var id_s = id.to_string ();
-              debug ("not route to node %s", id_s);
-              throw new PeerError.UNREACHABLE ("can not reach node '%s'", id_s);
-            }
-          else try
+          lock (dials) if ((dial = dials.lookup (id)) == null) dials.insert (id.copy (), new Dial ());
+
+          if (dial != null)
             {
-              var done = null != yield connect_to (address.address, address.port, cancellable);
-              var role = done == false ? null : pick_contact_role (id);
-              var newid = new Key.verbatim (role.id.value);
+              var context = GLib.MainContext.ref_thread_default ();
+              var waiter = new Waiter (reconnect.callback);
+              ulong handler_id = 0;
+
+              if (cancellable != null)
+                {
+                  cancellable.set_error_if_cancelled ();
 
-              if (unlikely (done == false && prevrole == null))
+                  handler_id = cancellable.connect (() =>
+                    {
+                      /* resuming from inside the handler would disconnect it from itself (and deadlock) */
+                      var source = new GLib.IdleSource ();
 
-                throw new PeerError.UNREACHABLE ("peer has no roles %s", id.to_string ());
+                      source.set_callback (() =>
+                        {
+                          unowned Dial? still;
+                          var parked = false;
 
-              else if (unlikely (done == false && prevrole != null))
-                {
-                  debug ("peer registered as %s, vanished", id.to_string ());
-                  throw new NetworkError.RESETTED_PEER ("peer vanished %s:%s", prevrole, id.to_string ());
+                          lock (dials) if ((still = dials.lookup (id)) != null) parked = still.waiters.remove (waiter);
+
+                          if (parked)
+                            {
+                              waiter.error = new IOError.CANCELLED ("Operation was cancelled");
+                              waiter.callback ();
+                            }
+
+                          return GLib.Source.REMOVE;
+                        });
+
+                      source.attach (context);
+                    });
                 }
 
-              if (unlikely (Key.equal (id, newid) == false || (prevrole != null && prevrole != role.role)))
+              /* the dial may have finished while the handler got connected */
+              lock (dials) if ((dial = dials.lookup (id)) != null) dial.waiters.push_tail (waiter);
+
+              if (unlikely (dial == null))
                 {
+                  if (cancellable != null) cancellable.disconnect (handler_id);
+                  return yield reconnect (id, cancellable);
+                }
 
-                  if (Key.equal (id, newid) == false)
+              yield;
 
-                    debug ("peer registered as %s, id changed to %s", id.to_string (), newid.to_string ());
+              if (cancellable != null) cancellable.disconnect (handler_id);
 
-                  else if (prevrole != null && prevrole != role.role)
+              if (unlikely (waiter.error != null))
+                {
+                  /* whoever dialed gave up, which says nothing about this caller */
+                  if (waiter.error.matches (IOError.quark (), IOError.CANCELLED) && ! (cancellable?.is_cancelled () ?? false))
 
-                    debug ("peer registered role was %s, changed to %s:%s", prevrole, role.role, newid.to_string ());
+                    return yield reconnect (id, cancellable);
 
-                  throw new NetworkError.RESETTED_PEER ("peer role was resetted (maybe address collision?)");
+                  throw (owned) waiter.error;
                 }
 
-              return done;
+              return waiter.result;
             }
-          catch (IOError e)
+
+          try { result = yield dial_node (id, cancellable); } catch (GLib.Error e)
             {
-              switch (e.code)
-                {
-                  case GLib.IOError.CONNECTION_REFUSED:
-                  case GLib.IOError.HOST_UNREACHABLE:
-                  case GLib.IOError.NETWORK_UNREACHABLE:
+              error = (owned) e;
+            }
 
-                    drop_contact_address (id, address);  
-                    break;
+          lock (dials) dials.steal_extended (id, null, out done);
 
-                  default: throw (owned) e;
-                }
-            }
-          catch (GLib.Error e)
+          unowned Waiter? next;
+
+          while ((next = done.waiters.pop_head ()) != null)
             {
-              throw (owned) e;
+              next.error = error == null ? null : error.copy ();
+              next.result = result;
+              next.callback ();
             }
 
-          return false;
+          if (unlikely (error != null))
+
+            throw (owned) error;
+
+          return result;
         }
 
       private async Node? register_connection (GLib.DBusConnection dbus, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
           unowned var object_path = Node.BASE_PATH;
 
-          var any = false;
+          var ids = new GLib.GenericArray<Key> ();
           var node = yield dbus.get_proxy<Node> (null, object_path, 0, cancellable);
           var addresses = yield node.list_addresses (cancellable);
           var keyrefs = yield node.list_ids (cancellable);
@@ -290,10 +649,53 @@ namespace Kademlia.DBus
 
               add_contact_addresses (id, addresses);
               add_contact_role (id, role);
-              any = true;
+              ids.add ((owned) id);
+            }
+
+          if (ids.length == 0)
+
+            return null;
+          else
+            {
+              if (dbus.stream is Krypt.IOStream)
+
+                datagrams.link ((Krypt.IOStream) dbus.stream, ids);
+
+              track (dbus, (owned) ids);
+              return (owned) node;
             }
+        }
+
+      /* bumped on whatever comes in through the connection, served calls included */
+      private void touch_link (GLib.DBusConnection dbus)
+        {
+          unowned Link? link;
+          lock (links) if ((link = links.lookup (dbus)) != null) link.lastuse = GLib.get_monotonic_time ();
+        }
+
+      internal override void touch_role (Key id)
+        {
+          unowned Link? link;
+          lock (links) if ((link = linked.lookup (id)) != null) link.lastuse = GLib.get_monotonic_time ();
+        }
+
+      private void track (GLib.DBusConnection dbus, owned GLib.GenericArray<Key> ids)
+        {
+          var link = new Link (dbus, (owned) ids);
+
+          lock (links)
+            {
+              foreach (unowned var id in link.ids) linked.replace (id.copy (), link);
+              links.insert (dbus, (owned) link);
+            }
+
+          dbus.add_filter ((c, m, incoming) =>
+            {
+              if (incoming) touch_link (c);
+              return m;
+            });
 
-          return any == false ? null : (owned) node;
+          dbus.on_closed.connect ((c, a, b) => on_link_closed (c));
         }
     }
 }
@@ -28,15 +28,27 @@ namespace Kademlia.DBus
       [DBus (name = "ListIds", timeout = 3000)] public abstract async KeyRef[] list_ids (GLib.Cancellable? cancellable = null) throws GLib.Error;
     }
 
+  [DBus (name = "org.hck.Kademlia.DBus.Stats")]
+
+  public interface Stats : GLib.Object
+    {
+      public const string PATH = "/org/hck/Kademlia/Stats";
+      [DBus (name = "Exposition", timeout = 3000)] public abstract async string exposition (GLib.Cancellable? cancellable = null) throws GLib.Error;
+      [DBus (name = "Snapshot", timeout = 3000)] public abstract async GLib.HashTable<string, GLib.Variant> snapshot (GLib.Cancellable? cancellable = null) throws GLib.Error;
+      [DBus (name = "Spans", timeout = 3000)] public abstract async string spans (string format, GLib.Cancellable? cancellable = null) throws GLib.Error;
+    }
+
   [DBus (name = "org.hck.Kademlia.DBus.Role")]
 
   public interface Role : GLib.Object
     {
       [DBus (name = "Id", timeout = 3000)] public abstract KeyRef id { owned get; }
-      [DBus (name = "FindNode", timeout = 3000)] public abstract async PeerRef[] find_node (PeerRef from, KeyRef key, GLib.Cancellable? cancellable = null) throws GLib.Error;
-      [DBus (name = "FindValue", timeout = 3000)] public abstract async ValueRef find_value (PeerRef from, KeyRef key, GLib.Cancellable? cancellable = null) throws GLib.Error;
+      [DBus (name = "FindNode", timeout = 3000)] public abstract async PeerRef[] find_node (PeerRef from, KeyRef key, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error;
+      [DBus (name = "FindValue", timeout = 3000)] public abstract async ValueRef find_value (PeerRef from, KeyRef key, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error;
+      [DBus (name = "FindValues", timeout = 3000)] public abstract async ValueRef[] find_values (PeerRef from, KeyRef[] keys, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error;
       [DBus (name = "Role", timeout = 3000)] public abstract string role { owned get; }
-      [DBus (name = "Store", timeout = 3000)] public abstract async bool store (PeerRef from, KeyRef key, GLib.Variant value, GLib.Cancellable? cancellable = null) throws GLib.Error;
-      [DBus (name = "Ping", timeout = 3000)] public abstract async bool ping (PeerRef from, GLib.Cancellable? cancellable = null) throws GLib.Error;
+      [DBus (name = "Store", timeout = 3000)] public abstract async bool store (PeerRef from, KeyRef key, GLib.Variant value, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error;
+      [DBus (name = "StoreMany", timeout = 3000)] public abstract async bool store_many (PeerRef from, KeyRef[] keys, GLib.Variant[] values, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error;
+      [DBus (name = "Ping", timeout = 3000)] public abstract async bool ping (PeerRef from, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error;
     }
 }
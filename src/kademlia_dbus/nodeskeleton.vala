@@ -40,6 +40,38 @@ namespace Kademlia.DBus
         }
     }
 
+  /* every metric the process registered, as Prometheus text or one double per sample */
+  public class StatsSkeleton : GLib.Object, Kademlia.DBus.Stats
+    {
+      public Metrics.Registry registry { get; construct; }
+
+      public StatsSkeleton (Metrics.Registry? registry = null)
+        {
+          Object (registry : registry ?? Metrics.Registry.get_default ());
+        }
+
+      public async string exposition (GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          return registry.to_prometheus ();
+        }
+
+      public async GLib.HashTable<string, GLib.Variant> snapshot (GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          return registry.snapshot ();
+        }
+
+      /* spans recorded so far, format being either 'chrome' or 'otlp' */
+      public async string spans (string format, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          switch (format)
+            {
+              case "chrome": return Metrics.Tracer.get_default ().to_chrome_trace ();
+              case "otlp": return Metrics.Tracer.get_default ().to_otlp_json ();
+              default: throw new IOError.INVALID_ARGUMENT ("unknown trace format '%s'", format);
+            }
+        }
+    }
+
   public class RoleSkeleton : GLib.Object, Kademlia.DBus.Role
     {
       private WeakRef _hub;
@@ -55,23 +87,74 @@ namespace Kademlia.DBus
           Object (hub : hub, name : role, value_peer : value_peer);
         }
 
-      public async PeerRef[] find_node (PeerRef from_, KeyRef key, GLib.Cancellable? cancellable) throws GLib.Error
+      /*
+       * Served calls carrying a sampled trace record a span under the caller's
+       * one; value calls hang the store access under it
+       */
+
+      public async PeerRef[] find_node (PeerRef from_, KeyRef key, Metrics.TraceContext trace, GLib.Cancellable? cancellable) throws GLib.Error
         {
+          var span = Metrics.Span (trace);
           var from = from_.know (hub);
           var id = new Key.verbatim (key.value);
-          var re = yield value_peer.find_peer_complete (from, id, cancellable);
-          var ar = new PeerRef [re.length];
 
-          for (int i = 0; i < ar.length; ++i) ar [i] = PeerRef (re [i].bytes, hub.list_remote_addresses (re [i]));
-          return (owned) ar;
+          try
+            {
+              var re = yield value_peer.find_peer_complete (from, id, cancellable);
+              var ar = new PeerRef [re.length];
+
+              var key = new Key.zero ();
+
+              for (int i = 0; i < ar.length; ++i)
+                {
+                  GLib.Memory.copy (key.bytes, re [i].bytes, key.bytes.length);
+                  ar [i] = PeerRef (key.bytes, hub.list_remote_addresses (key));
+                }
+
+              return (owned) ar;
+            }
+          finally
+            {
+              span.end ("serve FindNode");
+            }
         }
 
-      public async ValueRef find_value (PeerRef from_, KeyRef key, GLib.Cancellable? cancellable) throws GLib.Error
+      public async ValueRef find_value (PeerRef from_, KeyRef key, Metrics.TraceContext trace, GLib.Cancellable? cancellable) throws GLib.Error
         {
+          var span = Metrics.Span (trace);
           var from = (Key?) from_.know (hub);
           var id = (Key) new Key.verbatim (key.value);
-          var value = (Value) yield value_peer.find_value_complete (from, id, cancellable);
 
+          try { return pack_value (hub, yield value_peer.find_value_complete (from, id, span.child (), cancellable)); } finally
+            {
+              span.end ("serve FindValue");
+            }
+        }
+
+      public async ValueRef[] find_values (PeerRef from_, KeyRef[] keys, Metrics.TraceContext trace, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          var span = Metrics.Span (trace);
+          var from = (Key?) from_.know (hub);
+          var ids = new Key [keys.length];
+
+          for (int i = 0; i < ids.length; ++i) ids [i] = new Key.verbatim (keys [i].value);
+
+          try
+            {
+              var values = (Value[]) yield value_peer.find_values_complete (from, ids, span.child (), cancellable);
+              var ar = new ValueRef [values.length];
+
+              for (int i = 0; i < ar.length; ++i) ar [i] = pack_value (hub, values [i]);
+              return (owned) ar;
+            }
+          finally
+            {
+              span.end ("serve FindValues");
+            }
+        }
+
+      static ValueRef pack_value (Hub hub, Value value)
+        {
           if (value.is_inmediate)
 
             return ValueRef.inmediate (value.value);
@@ -85,15 +168,39 @@ namespace Kademlia.DBus
             }
         }
 
-      public async bool store (PeerRef from_, KeyRef key, GLib.Variant value, GLib.Cancellable? cancellable = null) throws GLib.Error
+      public async bool store (PeerRef from_, KeyRef key, GLib.Variant value, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
+          var span = Metrics.Span (trace);
           var from = (Key?) from_.know (hub);
           var id = (Key) new Key.verbatim (key.value);
-          var go = (bool) yield value_peer.store_value_complete (from, id, GValr.net2nat (value), cancellable);
-          return go;
+
+          try { return yield value_peer.store_value_complete (from, id, GValr.net2nat (value), span.child (), cancellable); } finally
+            {
+              span.end ("serve Store");
+            }
+        }
+
+      public async bool store_many (PeerRef from_, KeyRef[] keys, GLib.Variant[] values, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          if (unlikely (keys.length != values.length))
+
+            throw new IOError.INVALID_ARGUMENT ("keys and values length mismatch");
+
+          var span = Metrics.Span (trace);
+          var from = (Key?) from_.know (hub);
+          var ids = new Key [keys.length];
+          var natives = new GLib.Value? [values.length];
+
+          for (int i = 0; i < ids.length; ++i) ids [i] = new Key.verbatim (keys [i].value);
+          for (int i = 0; i < ids.length; ++i) natives [i] = GValr.net2nat (values [i]);
+
+          try { return yield value_peer.store_values_complete (from, ids, natives, span.child (), cancellable); } finally
+            {
+              span.end ("serve StoreMany");
+            }
         }
 
-      public async bool ping (PeerRef from_, GLib.Cancellable? cancellable = null) throws GLib.Error
+      public async bool ping (PeerRef from_, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
           var from = (Key?) from_.know (hub);
           return yield value_peer.ping_peer_complete (from, cancellable);
@@ -73,6 +73,16 @@ namespace Kademlia.DBus
             }
         }
 
+      /* datagram calls failing for whatever reason (but cancellation) are retried over the stream */
+      private void fall_back (Key peer, owned GLib.Error e) throws GLib.Error
+        {
+          if (e.matches (GLib.IOError.quark (), GLib.IOError.CANCELLED))
+
+            throw (owned) e;
+
+          debug ("datagram call to %s failed: %s: %u: %s", peer.to_string (), e.domain.to_string (), e.code, e.message);
+        }
+
       private void know (Hub hub, Key peer, PeerRef? @ref)
         {
           if (Key.equal (id, peer) == false)
@@ -82,22 +92,51 @@ namespace Kademlia.DBus
             }
         }
 
+      /*
+       * Role towards peer, a traced call getting a span for it when there was
+       * none and the hub had to reconnect (or retry one it dropped)
+       */
+      private async Role resolve (Hub hub, Key peer, Metrics.TraceContext trace, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          if (likely (trace.sampled () == false) || hub.pick_contact_role (peer) != null)
+
+            return yield hub.lookup_role (peer, cancellable);
+          else
+            {
+              var span = Metrics.Span (trace);
+
+              try { return yield hub.lookup_role (peer, cancellable); } finally
+                {
+                  span.end ("reconnect", peer.to_string ());
+                }
+            }
+        }
+
       protected virtual PeerRef get_self ()
         {
           return PeerRef (id.bytes, hub.list_local_addresses ());
         }
 
-      protected override async Key[] find_peer (Key peer, Key id, GLib.Cancellable? cancellable = null) throws GLib.Error requires (_hub.get () != null)
+      protected override async KeyVal[] find_peer (Key peer, Key id, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error requires (_hub.get () != null)
         {
+          Role? quick;
+
+          if ((quick = hub.pick_datagram_role (peer)) != null) try
+            {
+              var refs = yield quick.find_node (get_self (), KeyRef (id.bytes), trace, cancellable);
+              return unpack_peers (hub, refs);
+            }
+          catch (GLib.Error e)
+            {
+              fall_back (peer, (owned) e);
+            }
+
           while (true) try
             {
               var hub = this.hub;
-              var role = yield hub.lookup_role (peer, cancellable);
-              var refs = yield role.find_node (get_self (), KeyRef (id.bytes), cancellable);
-              var ar = new Key [refs.length];
-              for (int i = 0; i < ar.length; ++i) ar [i] = new Key.verbatim (refs [i].id.value);
-              for (int i = 0; i < ar.length; ++i) if (refs [i].knowable) know (hub, ar [i], refs [i]);
-              return (owned) ar;
+              var role = yield resolve (hub, peer, trace, cancellable);
+              var refs = yield role.find_node (get_self (), KeyRef (id.bytes), trace, cancellable);
+              return unpack_peers (hub, refs);
             }
           catch (GLib.Error e)
             {
@@ -105,24 +144,36 @@ namespace Kademlia.DBus
             }
         }
 
-      protected override async Value find_value (Key peer, Key id, GLib.Cancellable? cancellable = null) throws GLib.Error requires (_hub.get () != null)
+      protected override async Value find_value (Key peer, Key id, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error requires (_hub.get () != null)
         {
           while (true) try
             {
               var hub = this.hub;
-              var role = yield hub.lookup_role (peer, cancellable);
-              var value = yield role.find_value (get_self (), KeyRef (id.bytes), cancellable);
+              var role = yield resolve (hub, peer, trace, cancellable);
+              var value = yield role.find_value (get_self (), KeyRef (id.bytes), trace, cancellable);
+              return unpack_value (hub, value);
+            }
+          catch (GLib.Error e)
+            {
+              @catch (peer, (owned) e);
+            }
+        }
 
-              if (value.found)
+      protected override async Value[] find_values (Key peer, Key[] ids, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error requires (_hub.get () != null)
+        {
+          var keys = new KeyRef [ids.length];
 
-                return new Kademlia.Value.inmediate (value.get_value ());
-              else
-                {
-                  var ar = new Key [value.others.length];
-                  for (int i = 0; i < ar.length; ++i) ar [i] = new Key.verbatim (value.others [i].id.value);
-                  for (int i = 0; i < ar.length; ++i) if (value.others [i].knowable) know (hub, ar [i], value.others [i]);
-                  return new Kademlia.Value.delegated ((owned) ar);
-                }
+          for (int i = 0; i < keys.length; ++i) keys [i] = KeyRef (ids [i].bytes);
+
+          while (true) try
+            {
+              var hub = this.hub;
+              var role = yield resolve (hub, peer, trace, cancellable);
+              var values = yield role.find_values (get_self (), keys, trace, cancellable);
+              var ar = new Value [values.length];
+
+              for (int i = 0; i < ar.length; ++i) ar [i] = unpack_value (hub, values [i]);
+              return (owned) ar;
             }
           catch (GLib.Error e)
             {
@@ -130,12 +181,46 @@ namespace Kademlia.DBus
             }
         }
 
-      protected override async bool store_value (Key peer, Key key, GLib.Value? value = null, GLib.Cancellable? cancellable = null) throws GLib.Error requires (_hub.get () != null)
+      /* ids copied inline, going through one scratch key to reach routing (which keeps its own copy) */
+      private KeyVal[] unpack_peers (Hub hub, PeerRef[] refs)
+        {
+          var ar = new KeyVal [refs.length];
+          var got = 0;
+          var scratch = new Key.zero ();
+
+          foreach (unowned var @ref in refs) if (@ref.id.value.length == scratch.bytes.length)
+            {
+              GLib.Memory.copy (scratch.bytes, @ref.id.value, scratch.bytes.length);
+              GLib.Memory.copy (ar [got].bytes, @ref.id.value, scratch.bytes.length);
+
+              if (@ref.knowable) know (hub, scratch, @ref);
+              ++got;
+            }
+
+          ar.resize (got);
+          return (owned) ar;
+        }
+
+      private Value unpack_value (Hub hub, ValueRef value)
+        {
+          if (value.found)
+
+            return new Kademlia.Value.inmediate (value.get_value ());
+          else
+            {
+              var ar = new Key [value.others.length];
+              for (int i = 0; i < ar.length; ++i) ar [i] = new Key.verbatim (value.others [i].id.value);
+              for (int i = 0; i < ar.length; ++i) if (value.others [i].knowable) know (hub, ar [i], value.others [i]);
+              return new Kademlia.Value.delegated ((owned) ar);
+            }
+        }
+
+      protected override async bool store_value (Key peer, Key key, GLib.Value? value, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error requires (_hub.get () != null)
         {
           while (true) try
             {
-              var role = yield hub.lookup_role (peer, cancellable);
-              var result = yield role.store (get_self (), KeyRef (key.bytes), GValr.nat2net (value), cancellable);
+              var role = yield resolve (hub, peer, trace, cancellable);
+              var result = yield role.store (get_self (), KeyRef (key.bytes), GValr.nat2net (value), trace, cancellable);
               return result;
             }
           catch (GLib.Error e)
@@ -144,12 +229,43 @@ namespace Kademlia.DBus
             }
         }
 
-      protected override async bool ping_peer (Key peer, GLib.Cancellable? cancellable = null) throws GLib.Error requires (_hub.get () != null)
+      protected override async bool store_values (Key peer, Key[] ids, GLib.Value?[] values, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error requires (_hub.get () != null)
         {
+          var keys = new KeyRef [ids.length];
+          var nets = new GLib.Variant [values.length];
+
+          for (int i = 0; i < keys.length; ++i) keys [i] = KeyRef (ids [i].bytes);
+          for (int i = 0; i < nets.length; ++i) nets [i] = GValr.nat2net (values [i]);
+
+          while (true) try
+            {
+              var role = yield resolve (hub, peer, trace, cancellable);
+              var result = yield role.store_many (get_self (), keys, nets, trace, cancellable);
+              return result;
+            }
+          catch (GLib.Error e)
+            {
+              @catch (peer, (owned) e);
+            }
+        }
+
+      protected override async bool ping_peer (Key peer, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error requires (_hub.get () != null)
+        {
+          Role? quick;
+
+          if ((quick = hub.pick_datagram_role (peer)) != null) try
+            {
+              return yield quick.ping (get_self (), trace, cancellable);
+            }
+          catch (GLib.Error e)
+            {
+              fall_back (peer, (owned) e);
+            }
+
           while (true) try
             {
-              var role = yield hub.lookup_role (peer, cancellable);
-              var result = yield role.ping (get_self (), cancellable);
+              var role = yield resolve (hub, peer, trace, cancellable);
+              var result = yield role.ping (get_self (), trace, cancellable);
               return result;
             }
           catch (GLib.Error e)
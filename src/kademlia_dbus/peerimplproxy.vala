@@ -52,5 +52,17 @@ namespace Kademlia.DBus
           list.foreach (a => { if (Key.equal (a, this.id)) list.remove (a); });
           return (owned) list;
         }
+
+      public override uint nearest_span (Key id, KeyVal[] span)
+        {
+          var got = base.nearest_span (id, span);
+          var kept = (uint) 0;
+
+          for (uint i = 0; i < got; ++i) if (this.id.equal_val (span [i]) == false)
+            {
+              span [kept++] = span [i];
+            }
+          return kept;
+        }
     }
 }
@@ -103,6 +103,12 @@ namespace Kademlia.DBus
           this.value = GValr.nat2net (value);
         }
 
+      internal ValueRef.serialized (owned GLib.Variant value)
+        {
+          this.found = true;
+          this.value = (owned) value;
+        }
+
       public GLib.Value? get_value ()
         {
           return GValr.net2nat (value);
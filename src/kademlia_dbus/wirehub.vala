@@ -0,0 +1,399 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+[CCode (cprefix = "KDBus", lower_case_cprefix = "k_dbus_")]
+
+namespace Kademlia.DBus
+{
+  /*
+   * Hub speaking the binary protocol in wireproto.vala instead of D-Bus;
+   * it runs next to (and independently of) a NetworkHub. Remote roles are
+   * WireRole objects, so peers use them exactly like D-Bus role proxies,
+   * and local roles get served through the same RoleSkeleton both hubs use.
+   */
+
+  public class WireHub : Hub
+    {
+      public const uint16 DEFAULT_PORT = 33335;
+
+      private GLib.HashTable<Key, unowned WireLink> linked;
+      private GLib.GenericSet<WireLink> links;
+      private GLib.SocketService socket_service;
+
+      construct
+        {
+          linked = new GLib.HashTable<Key, unowned WireLink> (Key.hash, Key.equal);
+          links = new GLib.GenericSet<WireLink> (GLib.direct_hash, GLib.direct_equal);
+          socket_service = new GLib.SocketService ();
+
+          socket_service.stop ();
+          socket_service.incoming.connect (on_incoming);
+        }
+
+      public new async void add_local_address (string host_and_port, uint16 default_port, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var network_address = GLib.NetworkAddress.parse (host_and_port, default_port);
+          var address_enumerator = network_address.enumerate ();
+          var effective_address = (GLib.SocketAddress?) null;
+          var address = (GLib.SocketAddress?) null;
+
+          while ((address = yield address_enumerator.next_async (cancellable)) != null)
+            {
+              var protocol = GLib.SocketProtocol.TCP;
+              var type = GLib.SocketType.STREAM;
+
+              socket_service.add_address (address, type, protocol, address, out effective_address);
+
+              var inet_address = ((GLib.InetSocketAddress) effective_address).address;
+              var inet_port = ((GLib.InetSocketAddress) effective_address).port;
+              base.add_local_address (inet_address.to_string (), (uint16) inet_port);
+            }
+        }
+
+      private WireLink adopt (GLib.IOStream stream)
+        {
+          var link = new WireLink (this, stream);
+
+          lock (links) links.add (link);
+
+          link.lost.connect (on_lost);
+          link.start ();
+          return link;
+        }
+
+      private async WireLink connect_to (string host_and_port, uint16 default_port, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var socket_connection = yield (new SocketClient ()).connect_to_host_async (host_and_port, default_port, cancellable);
+          var krypt_stream = new Krypt.IOStream ("AES", "GCM", socket_connection);
+
+          socket_connection.socket.set_option (6 /* IPPROTO_TCP */, 1 /* TCP_NODELAY */, 1);
+
+          krypt_stream.session_cache = session_cache;
+          krypt_stream.session_name = @"$host_and_port/$default_port";
+
+          yield krypt_stream.handshake_client (GLib.Priority.LOW, cancellable);
+
+          var link = adopt (krypt_stream);
+          var request = link.request (WireOp.HELLO);
+
+          put_hello (request);
+          read_hello (link, yield link.invoke ((owned) request, cancellable));
+          return link;
+        }
+
+      public async bool join_at (string host_and_port, uint16 default_port, string? role, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var any = 0;
+          var link = yield connect_to (host_and_port, default_port, cancellable);
+
+          foreach (unowned var id in link.roles.get_keys ())
+            {
+              var rol = (Role) yield lookup_role (id, cancellable);
+
+              if (role == null || role == rol.role)
+
+                any += (yield join (id, rol.role, cancellable)) ? 1 : 0;
+            }
+
+          return any > 0;
+        }
+
+      private bool on_incoming (GLib.SocketConnection socket_connection)
+        {
+          var krypt_stream = new Krypt.IOStream ("AES", "GCM", socket_connection);
+
+          krypt_stream.session_cache = session_cache;
+
+          try { socket_connection.socket.set_option (6 /* IPPROTO_TCP */, 1 /* TCP_NODELAY */, 1); } catch (GLib.Error e)
+            {
+              debug ("can not set TCP_NODELAY: %s: %u: %s", e.domain.to_string (), e.code, e.message);
+            }
+
+          krypt_stream.handshake_server.begin (GLib.Priority.LOW, null, (o, res) =>
+            {
+              try { ((Krypt.IOStream) o).handshake_server.end (res); adopt ((Krypt.IOStream) o); } catch (GLib.Error e)
+                {
+                  warning ("%s: %u: %s", e.domain.to_string (), e.code, e.message);
+                }
+            });
+          return true;
+        }
+
+      private void on_lost (WireLink link)
+        {
+          lock (links)
+            {
+              links.remove (link);
+
+              foreach (unowned var id in link.roles.get_keys ()) if (linked.lookup (id) == link)
+
+                linked.remove (id);
+            }
+
+          foreach (unowned var id in link.roles.get_keys ())
+            {
+              var role = pick_contact_role (id);
+
+              if (role is WireRole && ((WireRole) role).link == link)
+
+                drop_role (id);
+            }
+        }
+
+      private void put_hello (WireWriter writer)
+        {
+          writer.put_addresses (list_local_addresses ());
+
+          lock (locals)
+            {
+              writer.put_uint16 ((uint16) locals.length);
+
+              foreach (unowned var local in locals.get_values ())
+                {
+                  writer.put_key (local.peer.id.bytes);
+                  writer.put_string (local.role);
+                }
+            }
+        }
+
+      private void read_hello (WireLink link, WireReader reader) throws GLib.Error
+        {
+          var addresses = reader.get_addresses ();
+          var count = reader.get_uint16 ();
+
+          for (uint i = 0; i < count; ++i)
+            {
+              var id = new Key.verbatim (reader.get_key ());
+              var role = reader.get_string ();
+
+              add_contact_addresses (id, addresses);
+              add_contact_role (id, new WireRole (link, id, role));
+
+              lock (links) linked.replace (id.copy (), link);
+              link.roles.replace ((owned) id, (owned) role);
+            }
+        }
+
+      protected override async bool reconnect (Key id, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          unowned WireLink? link;
+          string? name = null;
+
+          lock (links) if ((link = linked.lookup (id)) != null && link.closed == false)
+            {
+              name = link.roles.lookup (id);
+            }
+
+          if (name != null)
+            {
+              add_contact_role (id, new WireRole (link, id, name));
+              return true;
+            }
+
+          foreach (unowned var address in list_remote_addresses (id))
+            {
+              try { yield connect_to (address.address, address.port, cancellable); } catch (IOError e)
+                {
+                  switch (e.code)
+                    {
+                      case GLib.IOError.CONNECTION_REFUSED:
+                      case GLib.IOError.HOST_UNREACHABLE:
+                      case GLib.IOError.NETWORK_UNREACHABLE:
+                      case GLib.IOError.TIMED_OUT:
+
+                        drop_contact_address (id, address);
+                        continue;
+
+                      default: throw (owned) e;
+                    }
+                }
+
+              if (pick_contact_role (id) != null)
+
+                return true;
+            }
+
+          throw new PeerError.UNREACHABLE ("can not reach node '%s'", id.to_string ());
+        }
+
+      internal async void serve (WireLink link, uint8 op, WireReader request, WireWriter reply) throws GLib.Error
+        {
+          if (op == WireOp.HELLO)
+            {
+              read_hello (link, request);
+              put_hello (reply);
+              return;
+            }
+
+          var to = new Key.verbatim (request.get_key ());
+
+          if (unlikely (has_local (to) == false))
+
+            throw new PeerError.NOT_FOUND ("no such node %s", to.to_string ());
+
+          var role = yield lookup_role (to);
+          var from = request.get_peer ();
+          var trace = request.get_trace ();
+
+          switch (op)
+            {
+              case WireOp.PING:
+
+                reply.put_bool (yield role.ping (from, trace));
+                break;
+
+              case WireOp.FIND_NODE:
+                {
+                  var key = KeyRef (request.get_key ());
+                  reply.put_peers (yield role.find_node (from, key, trace));
+                  break;
+                }
+
+              case WireOp.FIND_VALUE:
+                {
+                  var key = KeyRef (request.get_key ());
+                  reply.put_value (yield role.find_value (from, key, trace));
+                  break;
+                }
+
+              case WireOp.FIND_VALUES:
+                {
+                  var keys = new KeyRef [request.get_uint16 ()];
+
+                  for (int i = 0; i < keys.length; ++i) keys [i] = KeyRef (request.get_key ());
+
+                  var values = yield role.find_values (from, keys, trace);
+
+                  reply.put_uint16 ((uint16) values.length);
+                  foreach (unowned var value in values) reply.put_value (value);
+                  break;
+                }
+
+              case WireOp.STORE:
+                {
+                  var key = KeyRef (request.get_key ());
+                  var value = request.get_variant ();
+                  reply.put_bool (yield role.store (from, key, value, trace));
+                  break;
+                }
+
+              case WireOp.STORE_MANY:
+                {
+                  var keys = new KeyRef [request.get_uint16 ()];
+                  var values = new GLib.Variant [keys.length];
+
+                  for (int i = 0; i < keys.length; ++i) keys [i] = KeyRef (request.get_key ());
+                  for (int i = 0; i < keys.length; ++i) values [i] = request.get_variant ();
+
+                  reply.put_bool (yield role.store_many (from, keys, values, trace));
+                  break;
+                }
+
+              default:
+
+                throw new IOError.NOT_SUPPORTED ("unknown opcode %u", op);
+            }
+        }
+
+      public void start () { socket_service.start (); }
+
+      public void stop () { socket_service.stop (); }
+    }
+
+  internal class WireRole : GLib.Object, Role
+    {
+      public WireLink link { get; construct; }
+      public string name { get; construct; }
+      public Key target { get; construct; }
+
+      public KeyRef id { owned get { return KeyRef (target.bytes); } }
+      public string role { owned get { return _name; } }
+
+      public WireRole (WireLink link, Key target, string name)
+        {
+          Object (link : link, name : name, target : target);
+        }
+
+      public async PeerRef[] find_node (PeerRef from, KeyRef key, Metrics.TraceContext trace, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          var request = link.request (WireOp.FIND_NODE, target);
+
+          request.put_peer (from);
+          request.put_trace (trace);
+          request.put_key (key.value);
+          return (yield link.invoke ((owned) request, cancellable)).get_peers ();
+        }
+
+      public async ValueRef find_value (PeerRef from, KeyRef key, Metrics.TraceContext trace, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          var request = link.request (WireOp.FIND_VALUE, target);
+
+          request.put_peer (from);
+          request.put_trace (trace);
+          request.put_key (key.value);
+          return (yield link.invoke ((owned) request, cancellable)).get_value ();
+        }
+
+      public async ValueRef[] find_values (PeerRef from, KeyRef[] keys, Metrics.TraceContext trace, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          var request = link.request (WireOp.FIND_VALUES, target);
+
+          request.put_peer (from);
+          request.put_trace (trace);
+          request.put_uint16 ((uint16) keys.length);
+          foreach (unowned var key in keys) request.put_key (key.value);
+
+          var reply = yield link.invoke ((owned) request, cancellable);
+          var values = new ValueRef [reply.get_uint16 ()];
+
+          for (int i = 0; i < values.length; ++i) values [i] = reply.get_value ();
+          return (owned) values;
+        }
+
+      public async bool ping (PeerRef from, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var request = link.request (WireOp.PING, target);
+
+          request.put_peer (from);
+          request.put_trace (trace);
+          return (yield link.invoke ((owned) request, cancellable)).get_bool ();
+        }
+
+      public async bool store (PeerRef from, KeyRef key, GLib.Variant value, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var request = link.request (WireOp.STORE, target);
+
+          request.put_peer (from);
+          request.put_trace (trace);
+          request.put_key (key.value);
+          request.put_variant (value);
+          return (yield link.invoke ((owned) request, cancellable)).get_bool ();
+        }
+
+      public async bool store_many (PeerRef from, KeyRef[] keys, GLib.Variant[] values, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var request = link.request (WireOp.STORE_MANY, target);
+
+          request.put_peer (from);
+          request.put_trace (trace);
+          request.put_uint16 ((uint16) keys.length);
+          foreach (unowned var key in keys) request.put_key (key.value);
+          foreach (unowned var value in values) request.put_variant (value);
+          return (yield link.invoke ((owned) request, cancellable)).get_bool ();
+        }
+    }
+}
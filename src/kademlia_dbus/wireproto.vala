@@ -0,0 +1,588 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+[CCode (cprefix = "KDBus", lower_case_cprefix = "k_dbus_")]
+
+namespace Kademlia.DBus
+{
+  /*
+   * Frames are a big endian uint32 length (counting what follows it), the
+   * uint32 request id, an opcode byte and the opcode's body. Replies carry
+   * the id of their request, so any number of requests may be in flight on
+   * one stream and get answered in any order. Keys travel as their raw
+   * bytes, values as serialized 'v' variants the receiver maps straight out
+   * of the frame it read. Requests follow their sender's peer with a trace
+   * context, a single zero byte when the call was not sampled.
+   */
+
+  internal enum WireOp
+    {
+      HELLO = 1,
+      PING,
+      FIND_NODE,
+      FIND_VALUE,
+      FIND_VALUES,
+      STORE,
+      STORE_MANY,
+      REPLY = 0x40,
+      ERROR = 0x80,
+    }
+
+  [Compact (opaque = true)] internal class WireWriter
+    {
+      public uint32 id;
+      private GLib.ByteArray buffer;
+
+      public WireWriter (uint32 id, uint8 op)
+        {
+          this.buffer = new GLib.ByteArray.sized (128);
+          this.id = id;
+
+          put_uint32 (0);
+          put_uint32 (id);
+          put_uint8 (op);
+        }
+
+      public GLib.Bytes end ()
+        {
+          var length = ((uint32) (buffer.len - sizeof (uint32))).to_big_endian ();
+
+          GLib.Memory.copy (buffer.data, & length, sizeof (uint32));
+          return GLib.ByteArray.free_to_bytes ((owned) buffer);
+        }
+
+      public void put_addresses (Address[] addresses)
+        {
+          put_uint16 ((uint16) addresses.length);
+
+          foreach (unowned var address in addresses)
+            {
+              put_string (address.address);
+              put_uint16 (address.port);
+            }
+        }
+
+      public void put_bool (bool value)
+        {
+          put_uint8 (value ? 1 : 0);
+        }
+
+      public void put_error (GLib.Error error)
+        {
+          put_string (error.domain.to_string ());
+          put_uint32 ((uint32) error.code);
+          put_string (error.message);
+        }
+
+      public void put_key (uint8[] key) requires (key.length == Key.BITLEN >> 3)
+        {
+          buffer.append (key);
+        }
+
+      public void put_peer (PeerRef peer)
+        {
+          put_bool (peer.knowable);
+          put_key (peer.id.value);
+
+          if (peer.knowable) put_addresses (peer.addresses);
+        }
+
+      public void put_peers (PeerRef[] peers)
+        {
+          put_uint16 ((uint16) peers.length);
+          foreach (unowned var peer in peers) put_peer (peer);
+        }
+
+      public void put_trace (Metrics.TraceContext trace)
+        {
+          put_bool (trace.sampled ());
+
+          if (trace.sampled ())
+            {
+              put_uint64 (trace.trace);
+              put_uint64 (trace.parent);
+            }
+        }
+
+      public void put_string (string value) requires (value.length <= uint16.MAX)
+        {
+          put_uint16 ((uint16) value.length);
+          buffer.append (value.data);
+        }
+
+      public void put_uint8 (uint8 value)
+        {
+          buffer.append ({ value });
+        }
+
+      public void put_uint16 (uint16 value)
+        {
+          var be = value.to_big_endian ();
+          unowned var ar = (uint8[]) & be;
+                    ar.length = (int) sizeof (uint16);
+          buffer.append (ar);
+        }
+
+      public void put_uint32 (uint32 value)
+        {
+          var be = value.to_big_endian ();
+          unowned var ar = (uint8[]) & be;
+                    ar.length = (int) sizeof (uint32);
+          buffer.append (ar);
+        }
+
+      public void put_uint64 (uint64 value)
+        {
+          var be = value.to_big_endian ();
+          unowned var ar = (uint8[]) & be;
+                    ar.length = (int) sizeof (uint64);
+          buffer.append (ar);
+        }
+
+      public void put_value (ValueRef value)
+        {
+          put_bool (value.found);
+
+          if (value.found)
+
+            put_variant (value.value);
+          else
+            put_peers (value.others);
+        }
+
+      public void put_variant (GLib.Variant value)
+        {
+          var boxed = new GLib.Variant.variant (value);
+          var bytes = boxed.get_data_as_bytes ();
+
+          put_uint32 ((uint32) bytes.get_size ());
+          buffer.append (bytes.get_data ());
+        }
+    }
+
+  [Compact (opaque = true)] internal class WireReader
+    {
+      private GLib.Bytes bytes;
+      private size_t offset;
+
+      public WireReader (GLib.Bytes bytes)
+        {
+          this.bytes = bytes;
+          this.offset = 0;
+        }
+
+      private unowned uint8[] take (size_t size) throws GLib.Error
+        {
+          unowned var data = bytes.get_data ();
+
+          if (unlikely (offset + size > data.length))
+
+            throw new IOError.INVALID_DATA ("truncated frame");
+
+          unowned var ar = (uint8[]) (void*) ((uint8*) data + offset);
+                    ar.length = (int) size;
+          offset += size;
+          return ar;
+        }
+
+      public Address[] get_addresses () throws GLib.Error
+        {
+          var addresses = new Address [get_uint16 ()];
+
+          for (int i = 0; i < addresses.length; ++i)
+            {
+              var address = get_string ();
+              addresses [i] = Address ((owned) address, get_uint16 ());
+            }
+
+          return (owned) addresses;
+        }
+
+      public bool get_bool () throws GLib.Error
+        {
+          return get_uint8 () != 0;
+        }
+
+      public GLib.Error get_error () throws GLib.Error
+        {
+          var domain = get_string ();
+          var code = (int) get_uint32 ();
+          var message = get_string ();
+          return new GLib.Error.literal (GLib.Quark.from_string (domain), code, message);
+        }
+
+      public uint8[] get_key () throws GLib.Error
+        {
+          return take (Key.BITLEN >> 3).copy ();
+        }
+
+      public PeerRef get_peer () throws GLib.Error
+        {
+          var knowable = get_bool ();
+          var id = get_key ();
+
+          if (knowable == false)
+
+            return PeerRef.anonymous ((owned) id);
+          else
+            return PeerRef ((owned) id, get_addresses ());
+        }
+
+      public PeerRef[] get_peers () throws GLib.Error
+        {
+          var peers = new PeerRef [get_uint16 ()];
+
+          for (int i = 0; i < peers.length; ++i) peers [i] = get_peer ();
+          return (owned) peers;
+        }
+
+      public Metrics.TraceContext get_trace () throws GLib.Error
+        {
+          if (get_bool () == false)
+
+            return Metrics.TraceContext ();
+          else
+            {
+              var id = get_uint64 ();
+              return Metrics.TraceContext () { trace = id, parent = get_uint64 () };
+            }
+        }
+
+      public string get_string () throws GLib.Error
+        {
+          unowned var data = take (get_uint16 ());
+          var value = ((string) data).ndup (data.length);
+
+          if (unlikely (value.length != data.length || value.validate () == false))
+
+            throw new IOError.INVALID_DATA ("malformed string");
+
+          return (owned) value;
+        }
+
+      public uint8 get_uint8 () throws GLib.Error
+        {
+          return take (sizeof (uint8)) [0];
+        }
+
+      public uint16 get_uint16 () throws GLib.Error
+        {
+          uint16 value = 0;
+          GLib.Memory.copy (& value, take (sizeof (uint16)), sizeof (uint16));
+          return uint16.from_big_endian (value);
+        }
+
+      public uint32 get_uint32 () throws GLib.Error
+        {
+          uint32 value = 0;
+          GLib.Memory.copy (& value, take (sizeof (uint32)), sizeof (uint32));
+          return uint32.from_big_endian (value);
+        }
+
+      public uint64 get_uint64 () throws GLib.Error
+        {
+          uint64 value = 0;
+          GLib.Memory.copy (& value, take (sizeof (uint64)), sizeof (uint64));
+          return uint64.from_big_endian (value);
+        }
+
+      public ValueRef get_value () throws GLib.Error
+        {
+          if (get_bool () == false)
+
+            return ValueRef.delegated (get_peers ());
+          else
+            return ValueRef.serialized (get_variant ());
+        }
+
+      /* the variant keeps a reference to the frame instead of copying its slice */
+      public GLib.Variant get_variant () throws GLib.Error
+        {
+          var size = (size_t) get_uint32 ();
+          var start = offset;
+
+          take (size);
+
+          var slice = new GLib.Bytes.from_bytes (bytes, start, size);
+          var boxed = new GLib.Variant.from_bytes (GLib.VariantType.VARIANT, slice, false);
+          return boxed.get_variant ();
+        }
+    }
+
+  /*
+   * One stream to a remote hub. Calls are written as soon as they are made
+   * (frames queued meanwhile get coalesced into a single write) and matched
+   * with their replies by request id; requests coming from the other end
+   * are served concurrently and answered as they complete.
+   */
+
+  internal class WireLink : GLib.Object
+    {
+      public const uint MAXFRAME = 16 << 20;
+      public const uint TIMEOUT = 3000;
+
+      private WeakRef _hub;
+      public WireHub hub { owned get { return (WireHub) _hub.get (); } construct { _hub.set (value); } }
+      public GLib.HashTable<Key, string> roles { get; private owned set; }
+      public bool closed { get; private set; default = false; }
+      public GLib.IOStream stream { get; construct; }
+
+      private GLib.HashTable<uint, unowned Call> calls;
+      private uint32 last_id = 0;
+      private GLib.Queue<GLib.Bytes> outgoing;
+      private bool writing = false;
+
+      public signal void lost ();
+
+      [Compact (opaque = true)] class Call
+        {
+          public GLib.SourceFunc callback;
+          public GLib.Error? error;
+          public WireReader? reply;
+
+          public Call (owned GLib.SourceFunc callback)
+            {
+              this.callback = (owned) callback;
+              this.error = null;
+              this.reply = null;
+            }
+        }
+
+      construct
+        {
+          calls = new GLib.HashTable<uint, unowned Call> (GLib.direct_hash, GLib.direct_equal);
+          roles = new GLib.HashTable<Key, string> (Key.hash, Key.equal);
+          outgoing = new GLib.Queue<GLib.Bytes> ();
+        }
+
+      public WireLink (WireHub hub, GLib.IOStream stream)
+        {
+          Object (hub : hub, stream : stream);
+        }
+
+      public void close ()
+        {
+          fail (new IOError.CONNECTION_CLOSED ("connection closed"));
+        }
+
+      private void fail (owned GLib.Error error)
+        {
+          unowned Call? call;
+
+          if (closed)
+
+            return;
+
+          closed = true;
+
+          foreach (unowned var id in calls.get_keys ()) if ((call = calls.lookup (id)) != null)
+            {
+              calls.remove (id);
+              call.error = new IOError.CONNECTION_CLOSED ("connection lost: %s", error.message);
+              call.callback ();
+            }
+
+          stream.close_async.begin (GLib.Priority.LOW, null, (o, res) =>
+            {
+              try { ((GLib.IOStream) o).close_async.end (res); } catch (GLib.Error e)
+                {
+                  debug ("closing link: %s: %u: %s", e.domain.to_string (), e.code, e.message);
+                }
+            });
+
+          lost ();
+        }
+
+      private async void flush ()
+        {
+          GLib.Bytes? frame;
+
+          while ((frame = outgoing.pop_head ()) != null)
+            {
+              if (outgoing.length > 0)
+                {
+                  var buffer = new GLib.ByteArray.take (frame.get_data ().copy ());
+
+                  while ((frame = outgoing.pop_head ()) != null) buffer.append (frame.get_data ());
+                  frame = GLib.ByteArray.free_to_bytes ((owned) buffer);
+                }
+
+              try { yield stream.output_stream.write_all_async (frame.get_data (), GLib.Priority.DEFAULT, null, null); } catch (GLib.Error e)
+                {
+                  fail ((owned) e);
+                  break;
+                }
+            }
+
+          writing = false;
+        }
+
+      public async WireReader invoke (owned WireWriter request, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var context = GLib.MainContext.ref_thread_default ();
+          var id = request.id;
+          var call = new Call (invoke.callback);
+          var timeout = new GLib.TimeoutSource (TIMEOUT);
+          ulong handler_id = 0;
+
+          if (unlikely (closed))
+
+            throw new IOError.CONNECTION_CLOSED ("connection closed");
+
+          if (cancellable != null)
+            {
+              cancellable.set_error_if_cancelled ();
+
+              /* resuming from inside the handler would disconnect it from itself (and deadlock) */
+              handler_id = cancellable.connect (() =>
+                {
+                  var source = new GLib.IdleSource ();
+
+                  source.set_callback (() =>
+                    {
+                      resolve (id, new IOError.CANCELLED ("operation was cancelled"));
+                      return GLib.Source.REMOVE;
+                    });
+
+                  source.attach (context);
+                });
+            }
+
+          timeout.set_callback (() =>
+            {
+              resolve (id, new IOError.TIMED_OUT ("request timed out"));
+              return GLib.Source.REMOVE;
+            });
+
+          timeout.attach (context);
+          calls.insert (id, call);
+          send (request.end ());
+          yield;
+
+          timeout.destroy ();
+
+          if (cancellable != null)
+
+            cancellable.disconnect (handler_id);
+
+          if (unlikely (call.error != null))
+
+            throw (owned) call.error;
+
+          return (owned) call.reply;
+        }
+
+      private async void receive ()
+        {
+          var head = new uint8 [sizeof (uint32)];
+          size_t got;
+
+          while (closed == false) try
+            {
+              uint32 length = 0;
+
+              if (false == yield stream.input_stream.read_all_async (head, GLib.Priority.DEFAULT, null, out got) || got < head.length)
+
+                throw new IOError.CONNECTION_CLOSED ("connection closed by peer");
+
+              GLib.Memory.copy (& length, head, sizeof (uint32));
+
+              if (unlikely ((length = uint32.from_big_endian (length)) > MAXFRAME))
+
+                throw new IOError.INVALID_DATA ("frame too large");
+
+              var body = new uint8 [length];
+
+              if (false == yield stream.input_stream.read_all_async (body, GLib.Priority.DEFAULT, null, out got) || got < length)
+
+                throw new IOError.CONNECTION_CLOSED ("connection closed by peer");
+
+              var reader = new WireReader (new GLib.Bytes.take ((owned) body));
+              var id = reader.get_uint32 ();
+              var op = reader.get_uint8 ();
+
+              if ((op & WireOp.ERROR) != 0)
+
+                resolve (id, reader.get_error ());
+
+              else if ((op & WireOp.REPLY) != 0)
+
+                resolve (id, null, (owned) reader);
+              else
+                serve.begin (id, op, (owned) reader);
+            }
+          catch (GLib.Error e)
+            {
+              fail ((owned) e);
+            }
+        }
+
+      public WireWriter request (WireOp op, Key? to = null)
+        {
+          var request = new WireWriter (++last_id, op);
+
+          if (to != null) request.put_key (to.bytes);
+          return (owned) request;
+        }
+
+      private void resolve (uint32 id, owned GLib.Error? error, owned WireReader? reply = null)
+        {
+          unowned Call? call;
+
+          if ((call = calls.lookup (id)) != null)
+            {
+              calls.remove (id);
+              call.error = (owned) error;
+              call.reply = (owned) reply;
+              call.callback ();
+            }
+        }
+
+      private void send (owned GLib.Bytes frame)
+        {
+          if (closed)
+
+            return;
+
+          outgoing.push_tail ((owned) frame);
+
+          if (writing == false)
+            {
+              writing = true;
+              flush.begin ();
+            }
+        }
+
+      private async void serve (uint32 id, uint8 op, owned WireReader request)
+        {
+          var reply = new WireWriter (id, op | WireOp.REPLY);
+
+          try { yield hub.serve (this, op, request, reply); } catch (GLib.Error e)
+            {
+              reply = new WireWriter (id, WireOp.ERROR);
+              reply.put_error (e);
+            }
+
+          send (reply.end ());
+        }
+
+      public void start ()
+        {
+          receive.begin ();
+        }
+    }
+}
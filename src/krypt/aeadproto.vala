@@ -0,0 +1,299 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+[CCode (cprefix = "KryptAead", lower_case_cprefix = "krypt_aead_")]
+
+namespace Krypt.Aead
+{
+  public const uint HEADSZ = 4;
+  public const uint MAXRECORD = 65536;
+  public const uint SALTSZ = 4;
+  public const uint TAGSZ = 16;
+
+  /*
+   * Records go on the wire as a big endian payload length, the sealed payload
+   * and its GCM tag. The length is authenticated as associated data and the
+   * nonce is a per-direction salt followed by the record sequence number, so
+   * a record can neither be resized, replayed nor reordered unnoticed.
+   */
+
+  public abstract class RecordCipher : GLib.Object, GLib.Initable
+    {
+      internal Cipher cipher;
+      private uint8 nonce [12];
+      private uint64 sequence;
+      public string algo_name { get; construct; }
+      public uint keylen { get; private set; }
+
+      class construct
+        {
+          Krypt._gcry_init ();
+        }
+
+      public bool init (GLib.Cancellable? cancellable) throws Krypt.Error
+        {
+          var algo = CipherAlgo.NONE;
+
+          if ((algo = CipherAlgo.parse (algo_name)) == CipherAlgo.NONE)
+            {
+              throw new Error.FAILED ("unknown cipher algorithm %s", algo_name);
+            }
+
+          if (algo.get_blocksz () != 16)
+            {
+              throw new Error.FAILED ("cipher algorithm %s can not be used in GCM mode", algo_name);
+            }
+
+          keylen = algo.get_keylen ();
+
+          try { cipher = Cipher.open (algo, CipherMode.GCM, (CipherFlags) 0); } catch (GLib.Error e)
+            {
+              Error.rethrow ((owned) e);
+              assert_not_reached ();
+            }
+
+          return true;
+        }
+
+      /* returns the sequence number the nonce was built from */
+      protected uint64 next_nonce () throws GLib.Error
+        {
+          if (GLib.unlikely (sequence == uint64.MAX))
+            {
+              throw new IOError.FAILED ("record sequence exhausted");
+            }
+
+          set_nonce (sequence);
+          return sequence++;
+        }
+
+      protected void set_nonce (uint64 number) throws GLib.Error
+        {
+          var counter = number.to_big_endian ();
+          GLib.Memory.copy (& nonce [SALTSZ], & counter, sizeof (uint64));
+          cipher.setiv (nonce);
+        }
+
+      public void set_key (uint8[] key, uint8[] salt) throws Krypt.Error requires (salt.length == SALTSZ)
+        {
+          try { cipher.setkey (key); } catch (GLib.Error e)
+            {
+              Error.rethrow ((owned) e);
+              assert_not_reached ();
+            }
+
+          GLib.Memory.copy (& nonce [0], & salt [0], SALTSZ);
+          sequence = 0;
+        }
+    }
+
+  public class Opener : RecordCipher
+    {
+
+      public Opener (string algo_name) throws GLib.Error
+        {
+          Object (algo_name : algo_name);
+          init ();
+        }
+
+      public static uint parse_head (uint8[] head) throws GLib.IOError requires (head.length == HEADSZ)
+        {
+          uint32 length;
+
+          GLib.Memory.copy (& length, & head [0], HEADSZ);
+
+          if ((length = uint32.from_big_endian (length)) == 0 || length > MAXRECORD)
+
+            throw new IOError.INVALID_DATA ("invalid record length %u", (uint) length);
+          return (uint) length;
+        }
+
+      /* sealed holds the ciphertext followed by its tag, plain gets the payload */
+      public void open (uint8[] head, uint8[] @sealed, uint8[] plain) throws GLib.Error
+
+          requires (@sealed.length == plain.length + TAGSZ)
+        {
+          unowned var body = (uint8[]) & @sealed [0]; body.length = plain.length;
+          unowned var tag = (uint8[]) & @sealed [plain.length]; tag.length = (int) TAGSZ;
+
+          next_nonce ();
+          cipher.authenticate (head);
+          cipher.decrypt (plain, body);
+
+          try { cipher.checktag (tag); } catch (GLib.Error e)
+            {
+              throw new IOError.INVALID_DATA ("record authentication failed");
+            }
+        }
+    }
+
+  public class Sealer : RecordCipher
+    {
+
+      public Sealer (string algo_name) throws GLib.Error
+        {
+          Object (algo_name : algo_name);
+          init ();
+        }
+
+      /* frame must hold HEADSZ + payload.length + TAGSZ bytes, returns how many were used */
+      public size_t seal (uint8[] payload, uint8[] frame) throws GLib.Error
+
+          requires (payload.length > 0 && payload.length <= MAXRECORD)
+          requires (frame.length >= HEADSZ + payload.length + TAGSZ)
+        {
+          var length = ((uint32) payload.length).to_big_endian ();
+          unowned var head = (uint8[]) & frame [0]; head.length = (int) HEADSZ;
+          unowned var body = (uint8[]) & frame [HEADSZ]; body.length = payload.length;
+          unowned var tag = (uint8[]) & frame [HEADSZ + payload.length]; tag.length = (int) TAGSZ;
+
+          GLib.Memory.copy (& frame [0], & length, HEADSZ);
+
+          next_nonce ();
+          cipher.authenticate (head);
+          cipher.encrypt (body, payload);
+          cipher.gettag (tag);
+          return HEADSZ + payload.length + TAGSZ;
+        }
+    }
+
+  /*
+   * Datagrams may get lost or reordered, so they carry their sequence number
+   * in the clear (next to a kind byte and a session id the receiver finds
+   * its keys by); all of that header is authenticated, and openers keep a
+   * sliding window of the sequence numbers they accepted to drop replays.
+   */
+
+  public const uint COUNTERSZ = 8;
+  public const uint DATAGRAM_HEADSZ = 1 + SESSIONSZ + COUNTERSZ;
+  public const uint SESSIONSZ = 8;
+  public const uint WINDOWSZ = 64;
+
+  public class DatagramOpener : RecordCipher
+    {
+      private uint64 highest = 0;
+      private uint64 window = 0;
+
+      public DatagramOpener (string algo_name) throws GLib.Error
+        {
+          Object (algo_name : algo_name);
+          init ();
+        }
+
+      public static uint8 parse_kind (uint8[] packet) throws GLib.IOError
+        {
+          if (packet.length < DATAGRAM_HEADSZ + TAGSZ)
+
+            throw new IOError.INVALID_DATA ("datagram too short");
+          return packet [0];
+        }
+
+      public static uint64 parse_session (uint8[] packet) throws GLib.IOError
+        {
+          uint64 session;
+
+          if (packet.length < DATAGRAM_HEADSZ + TAGSZ)
+
+            throw new IOError.INVALID_DATA ("datagram too short");
+
+          GLib.Memory.copy (& session, & packet [1], SESSIONSZ);
+          return uint64.from_big_endian (session);
+        }
+
+      /* returns the payload of an authentic datagram not seen before */
+      public uint8[] open (uint8[] packet) throws GLib.Error
+        {
+          uint64 sequence;
+
+          if (packet.length < DATAGRAM_HEADSZ + TAGSZ)
+
+            throw new IOError.INVALID_DATA ("datagram too short");
+
+          var plain = new uint8 [packet.length - DATAGRAM_HEADSZ - TAGSZ];
+
+          unowned var head = (uint8[]) & packet [0]; head.length = (int) DATAGRAM_HEADSZ;
+          unowned var body = (uint8[]) & packet [DATAGRAM_HEADSZ]; body.length = plain.length;
+          unowned var tag = (uint8[]) & packet [DATAGRAM_HEADSZ + plain.length]; tag.length = (int) TAGSZ;
+
+          GLib.Memory.copy (& sequence, & packet [1 + SESSIONSZ], COUNTERSZ);
+
+          if (replayed (sequence = uint64.from_big_endian (sequence)))
+
+            throw new IOError.INVALID_DATA ("replayed datagram");
+
+          set_nonce (sequence);
+          cipher.authenticate (head);
+          cipher.decrypt (plain, body);
+
+          try { cipher.checktag (tag); } catch (GLib.Error e)
+            {
+              throw new IOError.INVALID_DATA ("datagram authentication failed");
+            }
+
+          if (sequence > highest)
+            {
+              window = sequence - highest >= WINDOWSZ ? 0 : window << (int) (sequence - highest);
+              highest = sequence;
+            }
+
+          window |= (uint64) 1 << (int) (highest - sequence);
+          return (owned) plain;
+        }
+
+      private bool replayed (uint64 sequence)
+        {
+          if (sequence > highest)
+
+            return false;
+          else if (highest - sequence >= WINDOWSZ)
+
+            return true;
+          else
+            return (window & ((uint64) 1 << (int) (highest - sequence))) != 0;
+        }
+    }
+
+  public class DatagramSealer : RecordCipher
+    {
+      public DatagramSealer (string algo_name) throws GLib.Error
+        {
+          Object (algo_name : algo_name);
+          init ();
+        }
+
+      public uint8[] seal (uint8 kind, uint64 session, uint8[] payload) throws GLib.Error
+        {
+          var packet = new uint8 [DATAGRAM_HEADSZ + payload.length + TAGSZ];
+          var session_ = session.to_big_endian ();
+
+          unowned var head = (uint8[]) & packet [0]; head.length = (int) DATAGRAM_HEADSZ;
+          unowned var body = (uint8[]) & packet [DATAGRAM_HEADSZ]; body.length = payload.length;
+          unowned var tag = (uint8[]) & packet [DATAGRAM_HEADSZ + payload.length]; tag.length = (int) TAGSZ;
+
+          var sequence = next_nonce ().to_big_endian ();
+
+          packet [0] = kind;
+          GLib.Memory.copy (& packet [1], & session_, SESSIONSZ);
+          GLib.Memory.copy (& packet [1 + SESSIONSZ], & sequence, COUNTERSZ);
+
+          cipher.authenticate (head);
+          cipher.encrypt (body, payload);
+          cipher.gettag (tag);
+          return (owned) packet;
+        }
+    }
+}
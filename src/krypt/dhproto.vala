@@ -41,7 +41,7 @@ namespace Krypt.Dh
           return Scalar.cmp (a.x, b.x) == 0;
         }
 
-      public void derivate (uint8[] buffer, uint bitlen) throws Krypt.Error
+      public void derivate (uint8[] buffer, uint bitlen, uint8[]? salt = null) throws Krypt.Error
 
           requires (buffer.length >= ((bitlen + 7) >> 3))
         {
@@ -52,7 +52,7 @@ namespace Krypt.Dh
 
               var ps = new uint8 [(x.nbits + 7) >> 3];
               x.to_buffer (ExternalFormat.USG, ps, null);
-              Kdf.derive (ps, KdfAlgos.SCRYPT, 8, "some salt".data, 8, buf);
+              Kdf.derive (ps, KdfAlgos.SCRYPT, 8, salt != null ? salt : "some salt".data, 8, buf);
             }
           catch (GLib.Error e)
             {
@@ -61,16 +61,16 @@ namespace Krypt.Dh
             }
         }
 
-      public uint8[] derivate_key (uint bitlen) throws Krypt.Error
+      public uint8[] derivate_key (uint bitlen, uint8[]? salt = null) throws Krypt.Error
         {
           uint8[] buffer;
-          derivate (buffer = new uint8 [(bitlen + 7) >> 3], bitlen);
+          derivate (buffer = new uint8 [(bitlen + 7) >> 3], bitlen, salt);
           return (owned) buffer;
         }
 
-      public GLib.Bytes derivate_key_as_bytes (uint bitlen) throws Krypt.Error
+      public GLib.Bytes derivate_key_as_bytes (uint bitlen, uint8[]? salt = null) throws Krypt.Error
         {
-          return new Bytes.take (derivate_key (bitlen));
+          return new Bytes.take (derivate_key (bitlen, salt));
         }
     }
 
@@ -162,11 +162,28 @@ namespace Krypt.Dh
 
   public abstract class IOStream : GLib.IOStream
     {
+      public const uint NONCESZ = 16;
+      const string REFUSE = "!";
+      const string RESUME = "*";
+      const string SESSION_SALT = "session";
+      const string TICKET_SALT = "ticket";
+
       public GLib.IOStream base_stream { get; construct; }
       public bool close_base_stream { get; construct; default = true; }
       public string curve_name { get; construct; }
+      public bool initiator { get; protected set; default = false; }
+      public bool resumed { get; private set; default = false; }
+      public SessionCache? session_cache { get; set; default = null; }
+      public string? session_name { get; set; default = null; }
       protected SharedSecret? shared_secret = null;
 
+      private uint64 exchanged = 0;
+      private int64 expires = 0;
+      private int64 started = 0;
+      private uint8[]? resumed_nonces = null;
+      private GLib.Bytes? resumed_secret = null;
+      private Metrics.Span span;
+
       construct
         {
           if (curve_name == null) curve_name = "Curve25519";
@@ -183,9 +200,87 @@ namespace Krypt.Dh
           return true;
         }
 
+      private uint curve_bits () throws Krypt.Error
+        {
+          Scalar? p;
+
+          try { GLib.assert ((p = Curve.named (curve_name).named_scalar ("p")) != null); } catch (GLib.Error e)
+            {
+              Error.rethrow ((owned) e);
+              assert_not_reached ();
+            }
+
+          return p.nbits;
+        }
+
+      /*
+       * Key material for the stream, out of the shared secret of a full
+       * handshake or, on resumed ones, out of the ticket secret and both
+       * nonces (a single HMAC round, there is nothing to stretch there)
+       */
+
+      protected uint8[] derivate_key (uint bitlen, string label = SESSION_SALT) throws Krypt.Error
+        {
+          if (shared_secret != null && label == SESSION_SALT)
+
+            return shared_secret.derivate_key (bitlen);
+
+          else if (shared_secret != null)
+
+            return shared_secret.derivate_key (bitlen, label.data);
+
+          var buffer = new uint8 [(bitlen + 7) >> 3];
+          var salt = new GLib.ByteArray.sized (label.length + resumed_nonces.length);
+
+          salt.append (label.data);
+          salt.append (resumed_nonces);
+
+          try { Kdf.derive (resumed_secret.get_data (), KdfAlgos.PBKDF2, 8 /* GCRY_MD_SHA256 */, salt.data, 1, buffer); } catch (GLib.Error e)
+            {
+              Error.rethrow ((owned) e);
+              assert_not_reached ();
+            }
+
+          return (owned) buffer;
+        }
+
+      private bool finish (GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          var done = handshake_done (cancellable);
+
+          Meters.handshake (initiator, resumed, started, exchanged, span);
+
+          if (session_cache != null && (initiator == false || session_name != null))
+            {
+              var material = derivate_key ((Ticket.IDSZ + Ticket.SECRETSZ) << 3, TICKET_SALT);
+              var ticket = new Ticket (material [0 : (int) Ticket.IDSZ], material [(int) Ticket.IDSZ : material.length], expires);
+
+              if (initiator)
+
+                session_cache.put_issued (session_name, (owned) ticket);
+              else
+                session_cache.put_accepted ((owned) ticket);
+            }
+
+          return done;
+        }
+
       public async bool handshake_client (int io_priority, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
           Scalar? p;
+          Ticket? ticket = null;
+
+          initiator = true;
+          span = Metrics.Span (Metrics.Tracer.get_default ().sample ());
+          started = GLib.get_monotonic_time ();
+
+          if (session_cache != null && session_name != null && (ticket = session_cache.take_issued (session_name)) != null)
+            {
+              if (yield resume_client (ticket, io_priority, cancellable))
+
+                return finish (cancellable);
+            }
+
           var private_secret = new PrivateSecret.generate (curve_name);
           var public_secret = new PublicSecret.generate (private_secret);
           GLib.assert ((p = private_secret.curve.named_scalar ("p")) != null);
@@ -193,8 +288,9 @@ namespace Krypt.Dh
           yield share_public_secret (public_secret, io_priority, cancellable);
           var foreign_secret = yield listen_public_secret (p.nbits, io_priority, cancellable);
 
+          expires = GLib.get_monotonic_time () + (session_cache?.lifetime ?? 0);
           shared_secret = new SharedSecret (private_secret, foreign_secret);
-          return handshake_done (cancellable);
+          return finish (cancellable);
         }
 
       public virtual bool handshake_done (GLib.Cancellable? cancellable = null) throws GLib.Error
@@ -204,16 +300,30 @@ namespace Krypt.Dh
 
       public async bool handshake_server (int io_priority, GLib.Cancellable? cancellable = null) throws GLib.Error
         {
-          Scalar? p;
+          span = Metrics.Span (Metrics.Tracer.get_default ().sample ());
+          started = GLib.get_monotonic_time ();
+
+          var pbits = curve_bits ();
+          var line = yield next_line (pbits, io_priority, cancellable);
+
+          if (line.has_prefix (RESUME))
+            {
+              if (yield resume_server (line, io_priority, cancellable))
+
+                return finish (cancellable);
+
+              line = yield next_line (pbits, io_priority, cancellable);
+            }
+
           var private_secret = new PrivateSecret.generate (curve_name);
           var public_secret = new PublicSecret.generate (private_secret);
-          GLib.assert ((p = private_secret.curve.named_scalar ("p")) != null);
+          var foreign_secret = new PublicSecret.from_buffer (Base64.decode (line));
 
-          var foreign_secret = yield listen_public_secret (p.nbits, io_priority, cancellable);
           yield share_public_secret (public_secret, io_priority, cancellable);
 
+          expires = GLib.get_monotonic_time () + (session_cache?.lifetime ?? 0);
           shared_secret = new SharedSecret (private_secret, foreign_secret);
-          return handshake_done (cancellable);
+          return finish (cancellable);
         }
 
       private async PublicSecret listen_public_secret (uint pbits, int io_priority, GLib.Cancellable? cancellable) throws GLib.Error
@@ -224,6 +334,68 @@ namespace Krypt.Dh
           return (owned) secret;
         }
 
+      /* presents a ticket, false if the server refused it (a full handshake follows then) */
+      private async bool resume_client (Ticket ticket, int io_priority, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          var hello = new uint8 [Ticket.IDSZ + NONCESZ];
+          var nonces = new uint8 [NONCESZ << 1];
+
+          randomize (nonces [0 : (int) NONCESZ], RandomnessLevel.STRONG);
+          GLib.Memory.copy (hello, ticket.id.get_data (), Ticket.IDSZ);
+          GLib.Memory.copy (& hello [Ticket.IDSZ], nonces, NONCESZ);
+
+          yield write_line (RESUME + Base64.encode (hello), io_priority, cancellable);
+
+          var line = yield next_line ((uint) hello.length << 3, io_priority, cancellable);
+
+          if (line == REFUSE)
+
+            return false;
+
+          uint8[] theirs;
+
+          if (line.has_prefix (RESUME) == false || (theirs = Base64.decode (line.offset (RESUME.length))).length != NONCESZ)
+
+            throw new IOError.INVALID_DATA ("malformed resumption reply");
+
+          GLib.Memory.copy (& nonces [NONCESZ], theirs, NONCESZ);
+
+          expires = ticket.expires;
+          resumed = true;
+          resumed_nonces = (owned) nonces;
+          resumed_secret = ticket.secret;
+          return true;
+        }
+
+      /* accepts a presented ticket if it is known and still valid, refuses it otherwise */
+      private async bool resume_server (string line, int io_priority, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          Ticket? ticket = null;
+          var hello = Base64.decode (line.offset (RESUME.length));
+          var nonces = new uint8 [NONCESZ << 1];
+
+          if (session_cache != null && hello.length == Ticket.IDSZ + NONCESZ)
+
+            ticket = session_cache.take_accepted (new GLib.Bytes (hello [0 : (int) Ticket.IDSZ]));
+
+          if (ticket == null)
+            {
+              yield write_line (REFUSE, io_priority, cancellable);
+              return false;
+            }
+
+          randomize (nonces [(int) NONCESZ : nonces.length], RandomnessLevel.STRONG);
+          GLib.Memory.copy (nonces, & hello [Ticket.IDSZ], NONCESZ);
+
+          yield write_line (RESUME + Base64.encode (nonces [(int) NONCESZ : nonces.length]), io_priority, cancellable);
+
+          expires = ticket.expires;
+          resumed = true;
+          resumed_nonces = (owned) nonces;
+          resumed_secret = ticket.secret;
+          return true;
+        }
+
       private async string next_line (uint pbits, int io_priority, GLib.Cancellable? cancellable) throws GLib.Error
         {
           var expected_decodedsz = ((pbits + 7) / 8) * 3 + Packed.OVERHEAD;
@@ -249,6 +421,7 @@ namespace Krypt.Dh
                 throw new IOError.INVALID_DATA ("foreign public key too long");
             }
 
+          exchanged += (uint64) builder.len + 1;
           return builder.free_and_steal ();
         }
 
@@ -257,11 +430,17 @@ namespace Krypt.Dh
           var data = public_secret.get_data ();
           var line = Base64.encode (data);
 
+          yield write_line (line, io_priority, cancellable);
+          return true;
+        }
+
+      private async void write_line (string line, int io_priority, GLib.Cancellable? cancellable) throws GLib.Error
+        {
           unowned var output_stream = (GLib.OutputStream) this.base_stream.output_stream;
 
           yield output_stream.write_all_async (line.data, io_priority, cancellable, null);
           yield output_stream.write_all_async ("\n".data, io_priority, cancellable, null);
-          return true;
+          exchanged += line.length + 1;
         }
     }
 }
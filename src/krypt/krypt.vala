@@ -59,6 +59,7 @@ namespace Krypt
                 var to = uint.min (buffer.length, available - copied);
                 GLib.Memory.copy (& buffer [0], & interned [copied], to);
                 copied += to;
+                Meters.get_default ().bytes_in.add (to);
                 return to;
               }
             else
@@ -158,17 +159,153 @@ namespace Krypt
               base_stream.write_all (@out, null, cancellable);
             }
 
+          Meters.get_default ().bytes_out.add (buffer.length);
           return buffer.length;
         }
     }
 
+  class MyRecordInputStream : GLib.FilterInputStream
+    {
+      public Aead.Opener opener { get; construct; }
+
+      private uint available;
+      private uint copied;
+      private uint8 head [4];
+      private uint8[] plain;
+      private uint8[] @sealed;
+
+      construct
+        {
+          available = copied = 0;
+          plain = new uint8 [Aead.MAXRECORD];
+          @sealed = new uint8 [Aead.MAXRECORD + Aead.TAGSZ];
+
+          bind_property ("close_base_stream", base_stream, "close_base_stream", GLib.BindingFlags.SYNC_CREATE);
+        }
+
+      public MyRecordInputStream (GLib.InputStream base_stream, Aead.Opener opener)
+        {
+          var buffersz = Aead.HEADSZ + Aead.MAXRECORD + Aead.TAGSZ;
+          Object (base_stream : new GLib.BufferedInputStream.sized (base_stream, buffersz), opener : opener);
+        }
+
+      public override bool close (GLib.Cancellable? cancellable) throws GLib.IOError
+        {
+          return base_stream.close (cancellable);
+        }
+
+      public override ssize_t read (uint8[] buffer, GLib.Cancellable? cancellable = null) throws GLib.IOError
+        {
+          while (true)
+
+            if (copied < available)
+              {
+                var to = uint.min (buffer.length, available - copied);
+                GLib.Memory.copy (& buffer [0], & plain [copied], to);
+                copied += to;
+                Meters.get_default ().bytes_in.add (to);
+                return to;
+              }
+            else
+              {
+                size_t got = 0;
+                copied = available = 0;
+
+                base_stream.read_all (head, out got, cancellable);
+
+                if (got == 0)
+
+                  return 0;
+                else if (got < head.length)
+
+                  throw new IOError.PARTIAL_INPUT ("truncated record head");
+
+                var length = Aead.Opener.parse_head (head);
+                var direct = buffer.length >= length;
+                unowned var frame = (uint8[]) & @sealed [0]; frame.length = (int) (length + Aead.TAGSZ);
+                unowned var @out = (uint8[]) (direct ? & buffer [0] : & plain [0]); @out.length = (int) length;
+
+                base_stream.read_all (frame, out got, cancellable);
+
+                if (got < frame.length)
+
+                  throw new IOError.PARTIAL_INPUT ("truncated record");
+
+                try { opener.open (head, frame, @out); } catch (GLib.Error e)
+                  {
+                    if (e.domain == GLib.IOError.quark ())
+
+                      throw (GLib.IOError) (owned) e;
+                    else
+                      throw new GLib.IOError.FAILED ("can not decrypt record: %s", e.message);
+                  }
+
+                if (direct == false)
+
+                  available = length;
+                else
+                  {
+                    Meters.get_default ().bytes_in.add (length);
+                    return length;
+                  }
+              }
+        }
+    }
+
+  class MyRecordOutputStream : GLib.FilterOutputStream
+    {
+      public Aead.Sealer sealer { get; construct; }
+      private uint8[] frame;
+
+      construct
+        {
+          frame = new uint8 [Aead.HEADSZ + Aead.MAXRECORD + Aead.TAGSZ];
+        }
+
+      public MyRecordOutputStream (GLib.OutputStream base_stream, Aead.Sealer sealer)
+        {
+          Object (base_stream : base_stream, sealer : sealer);
+        }
+
+      public override bool close (GLib.Cancellable? cancellable) throws GLib.IOError
+        {
+          if (close_base_stream) return base_stream.close (cancellable);
+          return true;
+        }
+
+      public override ssize_t write (uint8[] buffer, GLib.Cancellable? cancellable = null) throws GLib.IOError
+        {
+          if (buffer.length == 0) return 0;
+
+          unowned var @in = (uint8[]) & buffer [0]; @in.length = int.min (buffer.length, (int) Aead.MAXRECORD);
+          unowned var @out = (uint8[]) & frame [0];
+
+          try { @out.length = (int) sealer.seal (@in, frame); } catch (GLib.Error e)
+            {
+              if (e.domain == GLib.IOError.quark ())
+
+                throw (GLib.IOError) (owned) e;
+              else
+                throw new GLib.IOError.FAILED ("can not encrypt record: %s", e.message);
+            }
+
+          base_stream.write_all (@out, null, cancellable);
+          Meters.get_default ().bytes_out.add (@in.length);
+          return @in.length;
+        }
+    }
+
   public class IOStream : Krypt.Dh.IOStream, GLib.Initable
     {
-      private MyConverterInputStream _input_stream;
-      private MyConverterOutputStream _output_stream;
+      private GLib.FilterInputStream _input_stream;
+      private GLib.FilterOutputStream _output_stream;
       private uint keylen;
+      private bool records;
 
       public string algo_name { get; construct; }
+      public Aead.DatagramOpener? datagram_opener { get; private set; default = null; }
+      public Aead.DatagramSealer? datagram_sealer { get; private set; default = null; }
+      public uint64 datagram_session { get; private set; default = 0; }
       public string mode_name { get; construct; }
 
       public override GLib.InputStream input_stream { get { return _input_stream; } }
@@ -182,15 +319,63 @@ namespace Krypt
 
       public override bool handshake_done (GLib.Cancellable? cancellable = null) throws GLib.Error
         {
-          var bitlen = keylen << 3;
-          var key = (uint8[]) shared_secret.derivate_key (bitlen);
-          ((Bc.DecryptConverter) _input_stream.converter).set_key (key);
-          ((Bc.EncryptConverter) _output_stream.converter).set_key (key);
+          if (records == false)
+            {
+              var bitlen = keylen << 3;
+              var key = derivate_key (bitlen);
+              ((Bc.DecryptConverter) ((MyConverterInputStream) _input_stream).converter).set_key (key);
+              ((Bc.EncryptConverter) ((MyConverterOutputStream) _output_stream).converter).set_key (key);
+            }
+          else
+            {
+              /*
+               * Both ends share one secret, so each direction gets its own key and
+               * salt (initiator to responder first) to keep nonces from colliding;
+               * datagram keys, salts and session id follow the stream ones
+               */
+              var bitlen = (((keylen + Aead.SALTSZ) << 2) + Aead.SESSIONSZ) << 3;
+              var material = derivate_key (bitlen);
+              var keysz = (int) keylen;
+              var saltsz = (int) Aead.SALTSZ;
+              var salts = keysz << 1;
+
+              var ours = initiator ? 0 : 1;
+              var theirs = ours ^ 1;
+
+              unowned var opener = ((MyRecordInputStream) _input_stream).opener;
+              unowned var sealer = ((MyRecordOutputStream) _output_stream).sealer;
+
+              opener.set_key (material [theirs * keysz : (theirs + 1) * keysz], material [salts + theirs * saltsz : salts + (theirs + 1) * saltsz]);
+              sealer.set_key (material [ours * keysz : (ours + 1) * keysz], material [salts + ours * saltsz : salts + (ours + 1) * saltsz]);
+
+              unowned var datagrams = material [(keysz + saltsz) << 1 : material.length];
+              uint64 session;
+
+              datagram_opener = new Aead.DatagramOpener (algo_name);
+              datagram_sealer = new Aead.DatagramSealer (algo_name);
+
+              datagram_opener.set_key (datagrams [theirs * keysz : (theirs + 1) * keysz], datagrams [salts + theirs * saltsz : salts + (theirs + 1) * saltsz]);
+              datagram_sealer.set_key (datagrams [ours * keysz : (ours + 1) * keysz], datagrams [salts + ours * saltsz : salts + (ours + 1) * saltsz]);
+
+              GLib.Memory.copy (& session, & datagrams [(keysz + saltsz) << 1], Aead.SESSIONSZ);
+              datagram_session = uint64.from_big_endian (session);
+            }
           return true;
         }
 
       public bool init (GLib.Cancellable? cancellable) throws GLib.Error
         {
+          if ((records = (CipherMode.parse (mode_name) == CipherMode.GCM)))
+            {
+              var opener = new Aead.Opener (algo_name);
+              var sealer = new Aead.Sealer (algo_name);
+              keylen = opener.keylen;
+
+              _input_stream = new MyRecordInputStream (base_stream.input_stream, opener);
+              _output_stream = new MyRecordOutputStream (base_stream.output_stream, sealer);
+              return true;
+            }
+
           var input_converter = new Bc.DecryptConverter (algo_name, mode_name);
           var output_converter = new Bc.EncryptConverter (algo_name, mode_name);
           keylen = input_converter.keylen;
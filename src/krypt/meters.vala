@@ -0,0 +1,65 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+[CCode (cprefix = "Krypt", lower_case_cprefix = "krypt_")]
+
+namespace Krypt
+{
+  /* metrics krypt streams record on, registered the first time they are needed */
+
+  [Compact (opaque = true)]
+
+  internal class Meters
+    {
+      public unowned Metrics.Counter bytes_in;
+      public unowned Metrics.Counter bytes_out;
+
+      private static GLib.Once<Meters> _default;
+
+      public Meters ()
+        {
+          var registry = Metrics.Registry.get_default ();
+          var help = "plain bytes through krypt streams";
+
+          bytes_in = registry.counter ("krypt_stream_bytes_total", help, "direction=\"in\"");
+          bytes_out = registry.counter ("krypt_stream_bytes_total", help, "direction=\"out\"");
+        }
+
+      public static unowned Meters get_default ()
+        {
+          return _default.once (() => new Meters ());
+        }
+
+      /*
+       * A finished handshake: how long it took and how many bytes it exchanged.
+       * Handshakes run below any lookup, so they are sampled as traces of
+       * their own
+       */
+      public static void handshake (bool initiator, bool resumed, int64 started, uint64 exchanged, Metrics.Span span)
+        {
+          var side = initiator ? "client" : "server";
+          var kind = resumed ? "resumed" : "full";
+          var labels = @"kind=\"$kind\",side=\"$side\"";
+          var registry = Metrics.Registry.get_default ();
+
+          registry.counter ("krypt_handshakes_total", "handshakes completed", labels).inc ();
+          registry.counter ("krypt_handshake_bytes_total", "bytes exchanged by completed handshakes", labels).add (exchanged);
+          registry.histogram ("krypt_handshake_duration_seconds", "handshake latency", 1e-6, labels).observe ((uint64) (GLib.get_monotonic_time () - started));
+          span.end ("handshake", span.sampled () ? @"$kind $side" : null);
+        }
+    }
+}
@@ -0,0 +1,138 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+[CCode (cprefix = "KryptDh", lower_case_cprefix = "krypt_dh_")]
+
+namespace Krypt.Dh
+{
+  /*
+   * Every handshake leaves a ticket behind on both ends: an id and a secret
+   * derived from the handshake keys the other end can derive as well. A
+   * client presenting the id later (together with a fresh nonce) gets keys
+   * out of the secret and both nonces without any curve math; tickets are
+   * single use, every resumption issues the next one (which expires when
+   * its first ancestor did, so full handshakes still happen once in a while)
+   */
+
+  [Compact (opaque = true)] public class Ticket
+    {
+      public const uint IDSZ = 16;
+      public const uint SECRETSZ = 32;
+
+      public GLib.Bytes id;
+      public int64 expires;
+      public GLib.Bytes secret;
+
+      public Ticket (uint8[] id, uint8[] secret, int64 expires) requires (id.length == IDSZ && secret.length == SECRETSZ)
+        {
+          this.expires = expires;
+          this.id = new GLib.Bytes (id);
+          this.secret = new GLib.Bytes (secret);
+        }
+    }
+
+  /*
+   * Tickets a process holds, both the ones it got as a client (by the name
+   * of the server it dialed) and the ones it accepts as a server (by id)
+   */
+
+  public class SessionCache : GLib.Object
+    {
+      [CCode (cheader_filename = "glib.h", cname = "G_USEC_PER_SEC")]
+
+      public extern const int64 USEC_PER_SEC;
+
+      public uint capacity { get; construct; default = 4096; }
+      public int64 lifetime { get; construct; default = 3600 * USEC_PER_SEC; }
+
+      private GLib.HashTable<GLib.Bytes, Ticket> accepted;
+      private GLib.HashTable<string, Ticket> issued;
+
+      construct
+        {
+          accepted = new GLib.HashTable<GLib.Bytes, Ticket> (GLib.Bytes.hash, GLib.Bytes.equal);
+          issued = new GLib.HashTable<string, Ticket> (GLib.str_hash, GLib.str_equal);
+        }
+
+      public SessionCache (uint capacity = 4096, int64 lifetime = 3600 * USEC_PER_SEC)
+        {
+          Object (capacity : capacity, lifetime : lifetime);
+        }
+
+      public uint length { get { lock (accepted) lock (issued) return accepted.length + issued.length; } }
+
+      /* drops expired tickets, and then any of them if there is still no room left */
+      static void make_room<K> (GLib.HashTable<K, Ticket> table, uint capacity)
+        {
+          var now = GLib.get_monotonic_time ();
+
+          if (table.length < capacity)
+
+            return;
+
+          table.foreach_remove ((k, ticket) => ticket.expires <= now);
+
+          if (table.length >= capacity)
+            {
+              K key;
+              var iter = GLib.HashTableIter<K, Ticket> (table);
+
+              if (iter.next (out key, null)) iter.remove ();
+            }
+        }
+
+      public void put_accepted (owned Ticket ticket)
+        {
+          lock (accepted)
+            {
+              make_room<GLib.Bytes> (accepted, capacity);
+              accepted.replace (ticket.id, (owned) ticket);
+            }
+        }
+
+      public void put_issued (string name, owned Ticket ticket)
+        {
+          lock (issued)
+            {
+              make_room<string> (issued, capacity);
+              issued.replace (name, (owned) ticket);
+            }
+        }
+
+      static Ticket? take<K> (GLib.HashTable<K, Ticket> table, K key)
+        {
+          K stolen;
+          Ticket? ticket;
+
+          if (table.steal_extended (key, out stolen, out ticket) == false || ticket.expires <= GLib.get_monotonic_time ())
+
+            return null;
+
+          return (owned) ticket;
+        }
+
+      public Ticket? take_accepted (GLib.Bytes id)
+        {
+          lock (accepted) return take<GLib.Bytes> (accepted, id);
+        }
+
+      public Ticket? take_issued (string name)
+        {
+          lock (issued) return take<string> (issued, name);
+        }
+    }
+}
@@ -0,0 +1,90 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+[CCode (cprefix = "Metrics", lower_case_cprefix = "metrics_")]
+
+namespace Metrics
+{
+  /*
+   * Minimal HTTP/1.0 endpoint for Prometheus scrapers: whatever gets
+   * requested (the request head is read up to its blank line and otherwise
+   * ignored) the answer is the registry in text exposition format
+   */
+
+  public class Exporter : GLib.Object
+    {
+      public const uint MAXHEADLINES = 64;
+
+      public Registry registry { get; construct; }
+      private GLib.SocketService service;
+
+      construct
+        {
+          service = new GLib.SocketService ();
+          service.incoming.connect (on_incoming);
+        }
+
+      public Exporter (Registry? registry = null)
+        {
+          Object (registry : registry ?? Registry.get_default ());
+        }
+
+      public void add_address (GLib.SocketAddress address) throws GLib.Error
+        {
+          service.add_address (address, GLib.SocketType.STREAM, GLib.SocketProtocol.TCP, null, null);
+        }
+
+      private bool on_incoming (GLib.SocketConnection connection, GLib.Object? source_object)
+        {
+          serve.begin (connection, (o, res) =>
+            {
+              try { ((Exporter) o).serve.end (res); } catch (GLib.Error e)
+                {
+                  debug ("metrics request failed: %s: %u: %s", e.domain.to_string (), e.code, e.message);
+                }
+            });
+
+          return true;
+        }
+
+      private async void serve (GLib.SocketConnection connection) throws GLib.Error
+        {
+          string? line;
+          var input = new GLib.DataInputStream (connection.input_stream);
+          var lines = 0;
+
+          input.close_base_stream = false;
+          input.newline_type = GLib.DataStreamNewlineType.ANY;
+
+          while ((line = yield input.read_line_async (GLib.Priority.LOW, null)) != null && line.strip ().length > 0)
+            {
+              if (++lines > MAXHEADLINES) throw new GLib.IOError.INVALID_DATA ("request head too long");
+            }
+
+          var body = registry.to_prometheus ();
+          var head = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %i\r\nConnection: close\r\n\r\n".printf (body.length);
+
+          yield connection.output_stream.write_all_async (head.data, GLib.Priority.LOW, null, null);
+          yield connection.output_stream.write_all_async (body.data, GLib.Priority.LOW, null, null);
+          yield connection.close_async (GLib.Priority.LOW, null);
+        }
+
+      public void start () { service.start (); }
+
+      public void stop () { service.stop (); }
+    }
+}
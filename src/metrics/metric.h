@@ -0,0 +1,215 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __METRICS_METRIC__
+#define __METRICS_METRIC__ 1
+#include <glib.h>
+#include <string.h>
+#if defined (_MSC_VER)
+#include <intrin.h>
+#endif // _MSC_VER
+
+typedef struct _MetricsCounter MetricsCounter;
+typedef struct _MetricsGauge MetricsGauge;
+typedef struct _MetricsHistogram MetricsHistogram;
+
+#if __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+  /*
+   * Counters and histograms are split in METRICS_SHARDS shards, each one on
+   * cache lines of its own (metrics get allocated on a line boundary, and
+   * rows span whole lines). A thread always records on the shard its GThread
+   * hashes to, with a relaxed atomic add, so recording takes no lock and two
+   * threads rarely touch the same line; reading sums every shard up. Values
+   * are integers (microseconds, bytes, ...), histograms scale them on read.
+   *
+   * Histogram bucket i counts values needing exactly i bits, that is values
+   * from 2^(i-1) to 2^i - 1 (bucket 0 counts zeroes), and the last bucket
+   * everything beyond.
+   */
+
+  #define METRICS_BUCKETS 40
+  #define METRICS_LINESZ 64
+  #define METRICS_LINE (METRICS_LINESZ / sizeof (guint64))
+  #define METRICS_ROW (((METRICS_BUCKETS + 2 + METRICS_LINE - 1) / METRICS_LINE) * METRICS_LINE)
+  #define METRICS_SHARDS 16
+
+  struct _MetricsCounter
+    {
+      guint64 cells [METRICS_SHARDS * METRICS_LINE];
+    };
+
+  struct _MetricsGauge
+    {
+      gint64 value;
+      gint64 padding [METRICS_LINE - 1];
+    };
+
+  struct _MetricsHistogram
+    {
+      guint64 cells [METRICS_SHARDS * METRICS_ROW];
+      gdouble scale;
+    };
+
+  static __inline gpointer _metrics_alloc (gsize size)
+    {
+      return g_aligned_alloc0 (1, size, METRICS_LINESZ);
+    }
+
+  static __inline void _metrics_add (guint64* cell, guint64 value)
+    {
+#if defined (__GNUC__) || defined (__clang__)
+      (void) __atomic_fetch_add (cell, value, __ATOMIC_RELAXED);
+#elif defined (_MSC_VER)
+      (void) _InterlockedExchangeAdd64 ((volatile __int64*) cell, (__int64) value);
+#else
+# error "no 64 bits atomics for this compiler"
+#endif
+    }
+
+  static __inline guint64 _metrics_load (guint64* cell)
+    {
+#if defined (__GNUC__) || defined (__clang__)
+      return __atomic_load_n (cell, __ATOMIC_RELAXED);
+#else
+      return *(volatile guint64*) cell;
+#endif
+    }
+
+  static __inline guint _metrics_shard (void)
+    {
+      gsize self = GPOINTER_TO_SIZE (g_thread_self ());
+      return (guint) (((self >> 4) ^ (self >> 12)) % METRICS_SHARDS);
+    }
+
+  static __inline guint _metrics_bits (guint64 value)
+    {
+#if defined (__GNUC__) || defined (__clang__)
+      return value == 0 ? 0 : (guint) (64 - __builtin_clzll (value));
+#else
+      guint bits;
+
+      for (bits = 0; value > 0; value >>= 1) ++bits;
+      return bits;
+#endif
+    }
+
+  static __inline void metrics_counter_add (MetricsCounter* counter, guint64 value)
+    {
+      _metrics_add (& counter->cells [_metrics_shard () * METRICS_LINE], value);
+    }
+
+  static __inline void metrics_counter_free (MetricsCounter* counter)
+    {
+      g_aligned_free (counter);
+    }
+
+  static __inline void metrics_counter_inc (MetricsCounter* counter)
+    {
+      metrics_counter_add (counter, 1);
+    }
+
+  static __inline MetricsCounter* metrics_counter_new (void)
+    {
+      return (MetricsCounter*) _metrics_alloc (sizeof (MetricsCounter));
+    }
+
+  static __inline guint64 metrics_counter_read (MetricsCounter* counter)
+    {
+      guint64 sum = 0;
+      guint i;
+
+      for (i = 0; i < METRICS_SHARDS; ++i) sum += _metrics_load (& counter->cells [i * METRICS_LINE]);
+      return sum;
+    }
+
+  static __inline void metrics_gauge_add (MetricsGauge* gauge, gint64 delta)
+    {
+      _metrics_add ((guint64*) & gauge->value, (guint64) delta);
+    }
+
+  static __inline void metrics_gauge_free (MetricsGauge* gauge)
+    {
+      g_aligned_free (gauge);
+    }
+
+  static __inline MetricsGauge* metrics_gauge_new (void)
+    {
+      return (MetricsGauge*) _metrics_alloc (sizeof (MetricsGauge));
+    }
+
+  static __inline gint64 metrics_gauge_read (MetricsGauge* gauge)
+    {
+      return (gint64) _metrics_load ((guint64*) & gauge->value);
+    }
+
+  static __inline void metrics_gauge_set (MetricsGauge* gauge, gint64 value)
+    {
+#if defined (__GNUC__) || defined (__clang__)
+      __atomic_store_n (& gauge->value, value, __ATOMIC_RELAXED);
+#else
+      *(volatile gint64*) & gauge->value = value;
+#endif
+    }
+
+  static __inline void metrics_histogram_free (MetricsHistogram* histogram)
+    {
+      g_aligned_free (histogram);
+    }
+
+  static __inline MetricsHistogram* metrics_histogram_new (gdouble scale)
+    {
+      MetricsHistogram* histogram = (MetricsHistogram*) _metrics_alloc (sizeof (MetricsHistogram));
+
+      histogram->scale = scale;
+      return histogram;
+    }
+
+  static __inline void metrics_histogram_observe (MetricsHistogram* histogram, guint64 value)
+    {
+      guint64* row = & histogram->cells [_metrics_shard () * METRICS_ROW];
+
+      _metrics_add (& row [MIN (_metrics_bits (value), METRICS_BUCKETS - 1)], 1);
+      _metrics_add (& row [METRICS_BUCKETS + 0], value);
+      _metrics_add (& row [METRICS_BUCKETS + 1], 1);
+    }
+
+  /* buckets must hold METRICS_BUCKETS counts, which come out per bucket (not cumulative) */
+  static __inline void metrics_histogram_read (MetricsHistogram* histogram, guint64* buckets, guint64* sum, guint64* count)
+    {
+      guint i, j;
+
+      memset (buckets, 0, METRICS_BUCKETS * sizeof (guint64));
+      *sum = *count = 0;
+
+      for (i = 0; i < METRICS_SHARDS; ++i)
+        {
+          guint64* row = & histogram->cells [i * METRICS_ROW];
+
+          for (j = 0; j < METRICS_BUCKETS; ++j) buckets [j] += _metrics_load (& row [j]);
+
+          *sum += _metrics_load (& row [METRICS_BUCKETS + 0]);
+          *count += _metrics_load (& row [METRICS_BUCKETS + 1]);
+        }
+    }
+
+#if __cplusplus
+}
+#endif // __cplusplus
+
+#endif // __METRICS_METRIC__
@@ -0,0 +1,318 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+[CCode (cprefix = "Metrics", lower_case_cprefix = "metrics_")]
+
+namespace Metrics
+{
+  public enum Kind
+    {
+      COUNTER,
+      GAUGE,
+      HISTOGRAM;
+
+      public unowned string type_name ()
+        {
+          switch (this)
+            {
+              case COUNTER: return "counter";
+              case GAUGE: return "gauge";
+              case HISTOGRAM: return "histogram";
+              default: assert_not_reached ();
+            }
+        }
+    }
+
+  [Compact (opaque = true)]
+
+  class Series
+    {
+      public Counter? counter = null;
+      public Gauge? gauge = null;
+      public Histogram? histogram = null;
+      public string labels;
+
+      public Series (Kind kind, string labels, double scale)
+        {
+          this.labels = labels;
+
+          switch (kind)
+            {
+              case Kind.COUNTER: counter = new Counter (); break;
+              case Kind.GAUGE: gauge = new Gauge (); break;
+              case Kind.HISTOGRAM: histogram = new Histogram (scale); break;
+            }
+        }
+    }
+
+  [Compact (opaque = true)]
+
+  class Family
+    {
+      public string help;
+      public Kind kind;
+      public string name;
+      public GLib.GenericArray<Series> series;
+
+      public Family (string name, string help, Kind kind)
+        {
+          this.help = help;
+          this.kind = kind;
+          this.name = name;
+          this.series = new GLib.GenericArray<Series> ();
+        }
+    }
+
+  /*
+   * Process wide metric table. Subsystems get (and create, the first time)
+   * their metrics by name and label set (already formatted, as in
+   * 'method="Ping",peer="..."'), then record on them lock free; lookups
+   * take a reader lock, so hot paths with fixed names keep what they got.
+   * Metrics live as long as the process does; a family going past
+   * MAXSERIES label sets lumps newer ones under OVERFLOW, without keeping
+   * their keys (unbounded label values would grow the table forever), and
+   * full families hand out the overflow series on the reader path too.
+   */
+
+  public class Registry : GLib.Object
+    {
+      public const uint MAXSERIES = 1024;
+      public const string OVERFLOW = "overflow=\"true\"";
+
+      private GLib.HashTable<string, Family> families;
+      private GLib.RWLock rwlock;
+      private GLib.HashTable<string, unowned Series> series;
+
+      private static GLib.Once<Registry> _default;
+
+      construct
+        {
+          families = new GLib.HashTable<string, Family> (GLib.str_hash, GLib.str_equal);
+          rwlock = GLib.RWLock ();
+          series = new GLib.HashTable<string, unowned Series> (GLib.str_hash, GLib.str_equal);
+        }
+
+      public static unowned Registry get_default ()
+        {
+          return _default.once (() => new Registry ());
+        }
+
+      public unowned Counter counter (string name, string help, string labels = "")
+        {
+          return lookup (Kind.COUNTER, name, help, labels).counter;
+        }
+
+      public unowned Gauge gauge (string name, string help, string labels = "")
+        {
+          return lookup (Kind.GAUGE, name, help, labels).gauge;
+        }
+
+      /* scale turns recorded integers into the exported unit (1e-6 for microseconds into seconds) */
+      public unowned Histogram histogram (string name, string help, double scale = 1, string labels = "")
+        {
+          return lookup (Kind.HISTOGRAM, name, help, labels, scale).histogram;
+        }
+
+      private unowned Series lookup (Kind kind, string name, string help, string labels, double scale = 1)
+        {
+          unowned Family? family;
+          unowned Series? found;
+          var key = labels.length == 0 ? name : @"$name{$labels}";
+
+          rwlock.reader_lock ();
+
+          /* keys going to the overflow series are not kept, so full families get it by name */
+          if ((found = series.lookup (key)) == null && (family = families.lookup (name)) != null && family.kind == kind && family.series.length >= MAXSERIES)
+
+            found = series.lookup (@"$name{$OVERFLOW}");
+
+          rwlock.reader_unlock ();
+
+          if (likely (found != null))
+
+            return found;
+
+          rwlock.writer_lock ();
+
+          if ((family = families.lookup (name)) == null)
+            {
+              families.insert (name, new Family (name, help, kind));
+              family = families.lookup (name);
+            }
+
+          if (unlikely (family.kind != kind))
+
+            error ("metric %s already registered as a %s", name, family.kind.type_name ());
+
+          if ((found = series.lookup (key)) == null)
+            {
+              if (family.series.length < MAXSERIES)
+                {
+                  var item = new Series (kind, labels, scale);
+
+                  found = item;
+                  family.series.add ((owned) item);
+                  series.insert ((owned) key, found);
+                }
+              else
+                {
+                  var overflow = @"$name{$OVERFLOW}";
+
+                  if ((found = series.lookup (overflow)) == null)
+                    {
+                      var item = new Series (kind, OVERFLOW, scale);
+
+                      found = item;
+                      family.series.add ((owned) item);
+                      series.insert ((owned) overflow, found);
+                    }
+                }
+            }
+
+          rwlock.writer_unlock ();
+          return found;
+        }
+
+      static void append_sample (GLib.StringBuilder builder, string name, string labels, string value)
+        {
+          builder.append (name);
+
+          if (labels.length > 0)
+            {
+              builder.append_c ('{');
+              builder.append (labels);
+              builder.append_c ('}');
+            }
+
+          builder.append_c (' ');
+          builder.append (value);
+          builder.append_c ('\n');
+        }
+
+      static string format_double (double value)
+        {
+          char buffer [double.DTOSTR_BUF_SIZE];
+          return value.to_str (buffer).dup ();
+        }
+
+      static string join_labels (string labels, string extra)
+        {
+          return labels.length == 0 ? extra : @"$labels,$extra";
+        }
+
+      /*
+       * Walks every series, handing each sample (histograms as cumulative
+       * buckets up to the last non empty one, then +Inf, sum and count) to
+       * func along with its family
+       */
+      private void @foreach (FamilyFunc begin, SampleFunc func)
+        {
+          rwlock.reader_lock ();
+
+          var names = families.get_keys ();
+
+          names.sort (GLib.strcmp);
+
+          foreach (unowned var name in names)
+            {
+              unowned var family = families.lookup (name);
+
+              begin (family, name);
+
+              foreach (unowned var item in family.series) switch (family.kind)
+                {
+                  case Kind.COUNTER:
+                    {
+                      var value = item.counter.read ();
+
+                      func (name, item.labels, value.to_string (), (double) value);
+                      break;
+                    }
+
+                  case Kind.GAUGE:
+                    {
+                      var value = item.gauge.read ();
+
+                      func (name, item.labels, value.to_string (), (double) value);
+                      break;
+                    }
+
+                  case Kind.HISTOGRAM:
+                    {
+                      uint64 count, sum, cumulative = 0;
+                      var buckets = new uint64 [BUCKETS];
+                      var last = 0;
+                      var scale = item.histogram.scale;
+
+                      item.histogram.read (buckets, out sum, out count);
+
+                      for (int i = 0; i < BUCKETS - 1; ++i) if (buckets [i] > 0) last = i;
+
+                      for (int i = 0; i <= last; ++i)
+                        {
+                          var le = format_double ((double) ((((uint64) 1) << i) - 1) * scale);
+
+                          cumulative += buckets [i];
+                          func (name + "_bucket", join_labels (item.labels, @"le=\"$le\""), cumulative.to_string (), (double) cumulative);
+                        }
+
+                      func (name + "_bucket", join_labels (item.labels, "le=\"+Inf\""), count.to_string (), (double) count);
+                      func (name + "_sum", item.labels, format_double ((double) sum * scale), (double) sum * scale);
+                      func (name + "_count", item.labels, count.to_string (), (double) count);
+                      break;
+                    }
+                }
+            }
+
+          rwlock.reader_unlock ();
+        }
+
+      delegate void FamilyFunc (Family family, string name);
+      delegate void SampleFunc (string name, string labels, string text, double value);
+
+      /* current value of every sample, keyed as 'name{labels}', each one a double */
+      public GLib.HashTable<string, GLib.Variant> snapshot ()
+        {
+          var table = new GLib.HashTable<string, GLib.Variant> (GLib.str_hash, GLib.str_equal);
+
+          @foreach ((family, name) => { }, (name, labels, text, value) =>
+            {
+              table.insert (labels.length == 0 ? name : @"$name{$labels}", new GLib.Variant.double (value));
+            });
+
+          return (owned) table;
+        }
+
+      /* every sample in Prometheus text exposition format (version 0.0.4) */
+      public string to_prometheus ()
+        {
+          var builder = new GLib.StringBuilder ();
+
+          @foreach ((family, name) =>
+            {
+              builder.append_printf ("# HELP %s %s\n", name, family.help);
+              builder.append_printf ("# TYPE %s %s\n", name, family.kind.type_name ());
+            },
+          (name, labels, text, value) =>
+            {
+              append_sample (builder, name, labels, text);
+            });
+
+          return builder.free_and_steal ();
+        }
+    }
+}
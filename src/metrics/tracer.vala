@@ -0,0 +1,340 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+[CCode (cprefix = "Metrics", lower_case_cprefix = "metrics_")]
+
+namespace Metrics
+{
+  public enum TraceFormat
+    {
+      CHROME,
+      OTLP,
+    }
+
+  /*
+   * What travels along a traced operation: the trace it belongs to and the
+   * span it runs under. A zero trace means the operation was not sampled,
+   * and every span begun from it costs a branch and nothing else
+   */
+
+  public struct TraceContext
+    {
+      public uint64 trace;
+      public uint64 parent;
+
+      public bool sampled ()
+        {
+          return trace != 0;
+        }
+    }
+
+  public struct Span
+    {
+      public uint64 trace;
+      public uint64 id;
+      public uint64 parent;
+      public int64 start;
+
+      public Span (TraceContext context)
+        {
+          if (likely (context.trace == 0))
+            {
+              this.trace = 0;
+              this.id = 0;
+              this.parent = 0;
+              this.start = 0;
+            }
+          else
+            {
+              this.trace = context.trace;
+              this.id = Tracer.random_id ();
+              this.parent = context.parent;
+              this.start = GLib.get_real_time ();
+            }
+        }
+
+      /* context for operations running under this span */
+      public TraceContext child ()
+        {
+          return TraceContext () { trace = this.trace, parent = this.id };
+        }
+
+      public void end (string name, string? detail = null)
+        {
+          if (unlikely (trace != 0)) Tracer.get_default ().record (this, name, detail);
+        }
+
+      public bool sampled ()
+        {
+          return trace != 0;
+        }
+    }
+
+  public struct SpanRecord
+    {
+      public uint64 trace;
+      public uint64 id;
+      public uint64 parent;
+      public int64 start;
+      public int64 end;
+      public uint thread;
+      public string name;
+      public string? detail;
+    }
+
+  [Compact (opaque = true)]
+
+  class SpanRing
+    {
+      public GLib.Mutex mutex;
+      public uint next;
+      public SpanRecord[] records;
+      public uint thread;
+      public bool wrapped;
+
+      public SpanRing (uint thread)
+        {
+          this.mutex = GLib.Mutex ();
+          this.next = 0;
+          this.records = new SpanRecord [Tracer.RINGSIZE];
+          this.thread = thread;
+          this.wrapped = false;
+        }
+    }
+
+  /*
+   * Ended spans go to a ring owned by the thread ending them (the lock on it
+   * is only ever contended by a dump), so the last RINGSIZE spans of each
+   * thread are kept. Dumps come out as Chrome trace event files (for
+   * chrome://tracing or Perfetto) or OTLP-JSON (for any OpenTelemetry
+   * collector), both with wall clock microseconds
+   */
+
+  public class Tracer : GLib.Object
+    {
+      public const uint RINGSIZE = 4096;
+
+      /* fraction (0 to 1) of root operations getting traced */
+      public double rate { get; set; default = 0; }
+      public string service { get; set; default = "scrapperd"; }
+
+      private GLib.GenericArray<SpanRing> rings;
+
+      private static GLib.Once<Tracer> _default;
+      private static GLib.Private local = new GLib.Private ();
+
+      construct
+        {
+          rings = new GLib.GenericArray<SpanRing> ();
+        }
+
+      public static unowned Tracer get_default ()
+        {
+          return _default.once (() => new Tracer ());
+        }
+
+      public void clear ()
+        {
+          lock (rings) foreach (unowned var ring in rings)
+            {
+              ring.mutex.lock ();
+              ring.next = 0;
+              ring.wrapped = false;
+              ring.mutex.unlock ();
+            }
+        }
+
+      /* every span kept, oldest first (enclosing ones first when starting together) */
+      public SpanRecord[] collect ()
+        {
+          var array = new GLib.Array<SpanRecord> ();
+
+          lock (rings) foreach (unowned var ring in rings)
+            {
+              ring.mutex.lock ();
+
+              if (ring.wrapped) for (uint i = ring.next; i < RINGSIZE; ++i) array.append_val (ring.records [i]);
+              for (uint i = 0; i < ring.next; ++i) array.append_val (ring.records [i]);
+
+              ring.mutex.unlock ();
+            }
+
+          array.sort ((a, b) =>
+            {
+              if (a.start != b.start)
+
+                return a.start < b.start ? -1 : 1;
+              else
+                return a.end > b.end ? -1 : (a.end < b.end ? 1 : 0);
+            });
+          return array.steal ();
+        }
+
+      public void dump (string path, TraceFormat format) throws GLib.Error
+        {
+          GLib.FileUtils.set_contents (path, format == TraceFormat.CHROME ? to_chrome_trace () : to_otlp_json ());
+        }
+
+      static string hex (uint64 value)
+        {
+          var builder = new GLib.StringBuilder.sized (16);
+
+          for (int shift = 60; shift >= 0; shift -= 4) builder.append_c ("0123456789abcdef" [(int) ((value >> shift) & 0xf)]);
+          return builder.free_and_steal ();
+        }
+
+      static void append_quoted (GLib.StringBuilder builder, string value)
+        {
+          builder.append_c ('"');
+
+          for (char* p = (char*) value; *p != '\0'; ++p) switch (*p)
+            {
+              case '"': builder.append ("\\\""); break;
+              case '\\': builder.append ("\\\\"); break;
+              default:
+
+                if (((uint8) *p) < 0x20)
+
+                  builder.append_printf ("\\u%04x", (uint8) *p);
+                else
+                  builder.append_c (*p);
+                break;
+            }
+
+          builder.append_c ('"');
+        }
+
+      internal static uint64 random_id ()
+        {
+          uint64 value = 0;
+
+          while (value == 0) value = ((uint64) GLib.Random.next_int () << 32) | GLib.Random.next_int ();
+          return value;
+        }
+
+      internal void record (Span span, string name, string? detail)
+        {
+          unowned SpanRing? ring;
+
+          if (unlikely ((ring = (SpanRing?) local.get ()) == null))
+            {
+              lock (rings)
+                {
+                  rings.add (new SpanRing (rings.length + 1));
+                  ring = rings [rings.length - 1];
+                }
+
+              local.set (ring);
+            }
+
+          ring.mutex.lock ();
+
+          ring.records [ring.next] = SpanRecord ()
+            {
+              trace = span.trace,
+              id = span.id,
+              parent = span.parent,
+              start = span.start,
+              end = GLib.get_real_time (),
+              thread = ring.thread,
+              name = name,
+              detail = detail,
+            };
+
+          if ((ring.next = (ring.next + 1) % RINGSIZE) == 0) ring.wrapped = true;
+          ring.mutex.unlock ();
+        }
+
+      /* a new root context, sampled at rate */
+      public TraceContext sample ()
+        {
+          var rate = _rate;
+
+          if (likely (rate <= 0) || (rate < 1 && GLib.Random.next_double () >= rate))
+
+            return TraceContext ();
+          else
+            return TraceContext () { trace = random_id (), parent = 0 };
+        }
+
+      /* Chrome trace event format: one complete ('X') event per span */
+      public string to_chrome_trace ()
+        {
+          var builder = new GLib.StringBuilder ("{\"traceEvents\":[");
+          var first = true;
+
+          foreach (unowned var record in collect ())
+            {
+              if (first) first = false; else builder.append_c (',');
+
+              builder.append ("{\"name\":");
+              append_quoted (builder, record.name);
+              builder.append_printf (",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%s,\"dur\":%s,\"args\":{", record.thread, record.start.to_string (), (record.end - record.start).to_string ());
+              builder.append_printf ("\"trace\":\"%s\",\"span\":\"%s\",\"parent\":\"%s\"", hex (record.trace), hex (record.id), hex (record.parent));
+
+              if (record.detail != null)
+                {
+                  builder.append (",\"detail\":");
+                  append_quoted (builder, record.detail);
+                }
+
+              builder.append ("}}");
+            }
+
+          builder.append ("],\"displayTimeUnit\":\"ms\"}");
+          return builder.free_and_steal ();
+        }
+
+      /* OTLP-JSON, trace ids being 64 bits wide get zero padded to the 128 bits OTLP wants */
+      public string to_otlp_json ()
+        {
+          var builder = new GLib.StringBuilder ("{\"resourceSpans\":[{\"resource\":{\"attributes\":[{\"key\":\"service.name\",\"value\":{\"stringValue\":");
+          var first = true;
+
+          append_quoted (builder, service);
+          builder.append ("}}]},\"scopeSpans\":[{\"scope\":{\"name\":\"scrapperd\"},\"spans\":[");
+
+          foreach (unowned var record in collect ())
+            {
+              if (first) first = false; else builder.append_c (',');
+
+              builder.append_printf ("{\"traceId\":\"0000000000000000%s\",\"spanId\":\"%s\"", hex (record.trace), hex (record.id));
+
+              if (record.parent != 0)
+
+                builder.append_printf (",\"parentSpanId\":\"%s\"", hex (record.parent));
+
+              builder.append (",\"name\":");
+              append_quoted (builder, record.name);
+              builder.append_printf (",\"kind\":1,\"startTimeUnixNano\":\"%s\",\"endTimeUnixNano\":\"%s\"", (record.start * 1000).to_string (), (record.end * 1000).to_string ());
+              builder.append_printf (",\"attributes\":[{\"key\":\"thread.id\",\"value\":{\"intValue\":\"%u\"}}", record.thread);
+
+              if (record.detail != null)
+                {
+                  builder.append (",{\"key\":\"detail\",\"value\":{\"stringValue\":");
+                  append_quoted (builder, record.detail);
+                  builder.append ("}}");
+                }
+
+              builder.append ("]}");
+            }
+
+          builder.append ("]}]}]}");
+          return builder.free_and_steal ();
+        }
+    }
+}
@@ -23,13 +23,25 @@ namespace ScrapperD.Scrapper
 
   public sealed class Application : ScrapperD.Application
     {
+      const uint REPORT_INTERVAL = 30;
+      const uint SHARE_INTERVAL = 600;
+
       private Scrapper? scrapper = null;
+      private string? seen_file = null;
       private Store? store = null;
       private Object? store_proxy = null;
+      private string? train_dictionary = null;
 
       construct
         {
-          scrapper = new Scrapper ();
+          add_main_option ("codec", 0, 0, GLib.OptionArg.STRING, "Codec used to compress pages (zstd or zlib)", "CODEC");
+          add_main_option ("compression-dictionary", 0, 0, GLib.OptionArg.FILENAME, "Shared zstd dictionary to compress pages with", "FILE");
+          add_main_option ("compression-level", 0, 0, GLib.OptionArg.INT, "Compression level", "LEVEL");
+          add_main_option ("host-delay", 0, 0, GLib.OptionArg.INT, "Wait between fetch rounds to the same host", "MILLISECONDS");
+          add_main_option ("host-fetches", 0, 0, GLib.OptionArg.INT, "Concurrent fetches to the same host", "COUNT");
+          add_main_option ("max-fetches", 0, 0, GLib.OptionArg.INT, "Concurrent fetches", "COUNT");
+          add_main_option ("seen-file", 0, 0, GLib.OptionArg.FILENAME, "Keep the seen URL filter in FILE across restarts", "FILE");
+          add_main_option ("train-dictionary", 0, 0, GLib.OptionArg.FILENAME, "Train a zstd dictionary on the stored pages of the given URLs, save it to FILE and exit", "FILE");
         }
 
       public Application ()
@@ -45,6 +57,76 @@ namespace ScrapperD.Scrapper
       protected override async bool command_line_async (GLib.ApplicationCommandLine cmdline, GLib.Cancellable? cancellable = null)
         {
           bool good;
+          unowned var options = cmdline.get_options_dict ();
+          var codec_name = (string) "zstd";
+          var compression_dictionary = (string?) null;
+          var compression_level = (int) -1;
+          var host_delay = (int) 250;
+          var host_fetches = (int) 2;
+          var max_fetches = (int) 32;
+
+          options.lookup ("codec", "s", out codec_name);
+          options.lookup ("compression-dictionary", "^ay", out compression_dictionary);
+          options.lookup ("compression-level", "i", out compression_level);
+          options.lookup ("host-delay", "i", out host_delay);
+          options.lookup ("host-fetches", "i", out host_fetches);
+          options.lookup ("max-fetches", "i", out max_fetches);
+          options.lookup ("seen-file", "^ay", out seen_file);
+          options.lookup ("train-dictionary", "^ay", out train_dictionary);
+
+          if (host_delay < 0 || host_fetches < 1 || max_fetches < 1)
+            {
+              cmdline.printerr ("invalid fetch limits\n");
+              cmdline.set_exit_status (1);
+              return false;
+            }
+
+          try
+            {
+              var dictionary = (GLib.Bytes?) null;
+
+              if (compression_dictionary != null)
+                {
+                  uint8[] contents;
+
+                  GLib.FileUtils.get_data (compression_dictionary, out contents);
+                  dictionary = new GLib.Bytes.take ((owned) contents);
+                }
+
+              var codec = Codec.for_name (codec_name, compression_level, dictionary);
+              scrapper = new Scrapper (new Frontier (max_fetches, host_fetches, host_delay), new Compressor (codec));
+            }
+          catch (GLib.Error e)
+            {
+              cmdline.printerr ("can not set up compression: %s: %u: %s\n", e.domain.to_string (), e.code, e.message);
+              cmdline.set_exit_status (1);
+              return false;
+            }
+
+          GLib.Timeout.add_seconds (REPORT_INTERVAL, () =>
+            {
+              scrapper.frontier.report ();
+              scrapper.report ();
+
+              if (store != null)
+                {
+                  store.seen.report ();
+                  save_seen ();
+                }
+              return GLib.Source.CONTINUE;
+            });
+
+          GLib.Timeout.add_seconds (SHARE_INTERVAL, () =>
+            {
+              if (store != null && store_proxy != null) store.share_seen.begin (null, (o, res) =>
+                {
+                  try { ((Store) o).share_seen.end (res); } catch (GLib.Error e)
+                    {
+                      warning ("can not share seen filter: %s: %u: %s", e.domain.to_string (), e.code, e.message);
+                    }
+                });
+              return GLib.Source.CONTINUE;
+            });
 
           if (likely (good = yield base.command_line_async (cmdline, cancellable)))
             {
@@ -60,6 +142,14 @@ namespace ScrapperD.Scrapper
                 }
 
               store.store_peer = (Kademlia.ValuePeer) store_proxy;
+              store.store_peer.write_quorum = write_quorum;
+
+              if (train_dictionary != null)
+                {
+                  good = yield train (cmdline, train_dictionary, cancellable);
+                  release ();
+                  return good;
+                }
 
               foreach (unowned var uri_string in cmdline.get_arguments ()) if (first) first = false; else try
                 {
@@ -89,11 +179,88 @@ namespace ScrapperD.Scrapper
 
       protected override async void register_peers () throws GLib.Error
         {
-          var value_store = new Store (scrapper);
+          var seen = (SeenFilter?) null;
+
+          if (seen_file != null && GLib.FileUtils.test (seen_file, GLib.FileTest.EXISTS)) try
+            {
+              uint8[] contents;
+
+              GLib.FileUtils.get_data (seen_file, out contents);
+              seen = new SeenFilter.from_bytes (new GLib.Bytes.take ((owned) contents));
+            }
+          catch (GLib.Error e)
+            {
+              warning ("can not load seen filter: %s: %u: %s", e.domain.to_string (), e.code, e.message);
+            }
+
+          var value_store = new Store (scrapper, seen);
           var scrapper_peer = new Kademlia.DBus.PeerImpl (value_store);
 
           hub.add_local_peer ("scrapper", scrapper_peer);
           (store = value_store).scrapper_peer = scrapper_peer;
         }
+
+      /* trains a dictionary out of the latest stored version of every page given on the command line */
+      private async bool train (GLib.ApplicationCommandLine cmdline, string file, GLib.Cancellable? cancellable = null)
+        {
+          bool first = true;
+          var samples = new GLib.GenericArray<GLib.Bytes> ();
+
+          foreach (unowned var uri_string in cmdline.get_arguments ()) if (first) first = false; else try
+            {
+              GLib.Bytes? page;
+              var uri = (Uri) Scrapper.normal_uri (uri_string);
+              var id = new Kademlia.Key.from_data (uri.to_string ().data);
+
+              if ((page = yield store.lookup_page (id, cancellable)) == null)
+
+                cmdline.printerr ("no page stored for uri '%s'\n", uri_string);
+              else
+                samples.add ((owned) page);
+            }
+          catch (GLib.Error e)
+            {
+              cmdline.printerr ("can not load page '%s': %s: %u: %s\n", uri_string, e.domain.to_string (), e.code, e.message);
+            }
+
+          if (samples.length == 0)
+            {
+              cmdline.printerr ("no pages to train a dictionary on\n");
+              cmdline.set_exit_status (1);
+              return false;
+            }
+
+          try
+            {
+              var dictionary = ZstdCodec.train (samples.data);
+
+              GLib.FileUtils.set_data (file, dictionary.get_data ());
+              cmdline.print ("trained %s dictionary on %u pages\n", GLib.format_size (dictionary.get_size ()), samples.length);
+            }
+          catch (GLib.Error e)
+            {
+              cmdline.printerr ("can not train dictionary: %s: %u: %s\n", e.domain.to_string (), e.code, e.message);
+              cmdline.set_exit_status (1);
+              return false;
+            }
+
+          return true;
+        }
+
+      private void save_seen ()
+        {
+          if (seen_file != null)
+
+            try { GLib.FileUtils.set_data (seen_file, store.seen.to_bytes ().get_data ()); } catch (GLib.Error e)
+              {
+                warning ("can not save seen filter: %s: %u: %s", e.domain.to_string (), e.code, e.message);
+              }
+        }
+
+      public override void shutdown ()
+        {
+          if (store != null) save_seen ();
+          base.shutdown ();
+        }
     } 
 }
@@ -0,0 +1,250 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+[CCode (cprefix = "ScrapperdScrapper", lower_case_cprefix = "scrapperd_scrapper_")]
+
+namespace ScrapperD.Scrapper
+{
+  /*
+   * Page codecs. Implementations must be safe to call from several threads at
+   * once, since Compressor runs them on a thread pool. The codec's name (and
+   * whatever else it needs to decode) goes into the page metadata, so readers
+   * can pick the matching codec with Codec.for_name.
+   */
+
+  public abstract class Codec : GLib.Object
+    {
+      public int level { get; construct; }
+      public abstract string name { get; }
+
+      public virtual void annotate (GLib.VariantBuilder builder)
+        {
+          builder.add ("{ss}", "codec", name);
+        }
+
+      public abstract GLib.Bytes compress (GLib.Bytes data) throws GLib.Error;
+      public abstract GLib.Bytes decompress (GLib.Bytes data) throws GLib.Error;
+
+      public static Codec for_name (string name, int level = -1, GLib.Bytes? dictionary = null) throws GLib.Error
+        {
+          switch (name)
+            {
+              case "zlib": return new ZlibCodec (level < 0 ? 6 : level);
+              case "zstd": return new ZstdCodec (level < 0 ? 3 : level, dictionary);
+              default: throw new IOError.NOT_SUPPORTED ("unknown codec '%s'", name);
+            }
+        }
+    }
+
+  public class ZlibCodec : Codec
+    {
+      public override string name { get { return "zlib"; } }
+
+      public ZlibCodec (int level)
+        {
+          Object (level : level);
+        }
+
+      static GLib.Bytes convert (GLib.Converter converter, GLib.Bytes data) throws GLib.Error
+        {
+          var memory = new GLib.MemoryOutputStream.resizable ();
+          var stream = new GLib.ConverterOutputStream (memory, converter);
+
+          stream.write_all (data.get_data (), null);
+          stream.close ();
+          return memory.steal_as_bytes ();
+        }
+
+      public override GLib.Bytes compress (GLib.Bytes data) throws GLib.Error
+        {
+          return convert (new GLib.ZlibCompressor (GLib.ZlibCompressorFormat.ZLIB, level), data);
+        }
+
+      public override GLib.Bytes decompress (GLib.Bytes data) throws GLib.Error
+        {
+          return convert (new GLib.ZlibDecompressor (GLib.ZlibCompressorFormat.ZLIB), data);
+        }
+    }
+
+  public class ZstdCodec : Codec
+    {
+      public GLib.Bytes? dictionary { get; construct; }
+      public override string name { get { return "zstd"; } }
+
+      private Zstd.CDict? cdict = null;
+      private Zstd.DDict? ddict = null;
+      private uint dictionary_id = 0;
+
+      construct
+        {
+          if (dictionary != null)
+            {
+              unowned var dict = dictionary.get_data ();
+
+              cdict = new Zstd.CDict (dict, level);
+              ddict = new Zstd.DDict (dict);
+              dictionary_id = Zdict.get_dict_id (dict);
+            }
+        }
+
+      public ZstdCodec (int level, GLib.Bytes? dictionary = null)
+        {
+          Object (dictionary : dictionary, level : level.clamp (1, Zstd.max_level ()));
+        }
+
+      public override void annotate (GLib.VariantBuilder builder)
+        {
+          base.annotate (builder);
+
+          if (dictionary_id != 0)
+            {
+              builder.add ("{ss}", "codec-dictionary", "%08x".printf (dictionary_id));
+            }
+        }
+
+      static void check (size_t code) throws GLib.IOError
+        {
+          if (Zstd.is_error (code))
+
+            throw new IOError.FAILED ("zstd: %s", Zstd.get_error_name (code));
+        }
+
+      public override GLib.Bytes compress (GLib.Bytes data) throws GLib.Error
+        {
+          var cctx = new Zstd.CCtx ();
+          var output = new uint8 [Zstd.compress_bound (data.get_size ())];
+          size_t wrote;
+
+          if (cdict == null)
+
+            check (wrote = cctx.compress (output, data.get_data (), level));
+          else
+            check (wrote = cctx.compress_using_cdict (output, data.get_data (), cdict));
+
+          /* compress_bound is far more than pages usually take, so do not keep it around */
+          output.resize ((int) wrote);
+          return new GLib.Bytes.take ((owned) output);
+        }
+
+      public override GLib.Bytes decompress (GLib.Bytes data) throws GLib.Error
+        {
+          var dctx = new Zstd.DCtx ();
+          var size = Zstd.get_frame_content_size (data.get_data ());
+          size_t wrote;
+
+          if (size == Zstd.CONTENTSIZE_ERROR || size == Zstd.CONTENTSIZE_UNKNOWN || size > int.MAX)
+
+            throw new IOError.INVALID_DATA ("zstd: unknown content size");
+
+          var output = new uint8 [(size_t) size];
+
+          if (ddict == null)
+
+            check (wrote = dctx.decompress (output, data.get_data ()));
+          else
+            check (wrote = dctx.decompress_using_ddict (output, data.get_data (), ddict));
+
+          output.length = (int) wrote;
+          return new GLib.Bytes.take ((owned) output);
+        }
+
+      /* trains a shared dictionary of (at most) dictsz bytes out of sample pages */
+      public static GLib.Bytes train (GLib.Bytes[] samples, size_t dictsz = 112640) throws GLib.Error
+        {
+          var dict = new uint8 [dictsz];
+          var joined = new GLib.ByteArray ();
+          var sizes = new size_t [samples.length];
+          size_t wrote;
+
+          for (int i = 0; i < samples.length; ++i)
+            {
+              joined.append (samples [i].get_data ());
+              sizes [i] = samples [i].get_size ();
+            }
+
+          if (Zdict.is_error (wrote = Zdict.train_from_buffer (dict, joined.data, sizes)))
+
+            throw new IOError.FAILED ("can not train dictionary: %s", Zstd.get_error_name (wrote));
+
+          dict.resize ((int) wrote);
+          return new GLib.Bytes.take ((owned) dict);
+        }
+    }
+
+  /*
+   * Runs a codec on a pool of worker threads, so big pages do not stall the
+   * main context, and resumes the caller on its own thread-default context
+   */
+
+  public class Compressor : GLib.Object
+    {
+      public Codec codec { get; construct; }
+      private GLib.ThreadPool<Job> pool;
+
+      class Job : GLib.Object
+        {
+          public GLib.SourceFunc callback;
+          public GLib.MainContext context;
+          public GLib.Error? error = null;
+          public GLib.Bytes input;
+          public GLib.Bytes? output = null;
+
+          public Job (GLib.Bytes input, owned GLib.SourceFunc callback)
+            {
+              this.callback = (owned) callback;
+              this.context = GLib.MainContext.ref_thread_default ();
+              this.input = input;
+            }
+        }
+
+      construct
+        {
+          try { pool = new GLib.ThreadPool<Job>.with_owned_data (work, (int) GLib.get_num_processors (), false); } catch (GLib.ThreadError e)
+            {
+              error ("%s: %u: %s", e.domain.to_string (), e.code, e.message);
+            }
+        }
+
+      public Compressor (Codec codec)
+        {
+          Object (codec : codec);
+        }
+
+      public async GLib.Bytes compress (GLib.Bytes data) throws GLib.Error
+        {
+          var job = new Job (data, compress.callback);
+
+          pool.add (job);
+          yield;
+
+          if (job.error != null) throw job.error.copy ();
+          return job.output;
+        }
+
+      private void work (owned Job job)
+        {
+          try { job.output = codec.compress (job.input); } catch (GLib.Error e)
+            {
+              job.error = (owned) e;
+            }
+
+          var source = new GLib.IdleSource ();
+          source.set_callback ((owned) job.callback);
+          source.attach (job.context);
+        }
+    }
+}
@@ -0,0 +1,317 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+[CCode (cprefix = "ScrapperdScrapper", lower_case_cprefix = "scrapperd_scrapper_")]
+
+namespace ScrapperD.Scrapper
+{
+  /*
+   * Admission control for fetches. Every fetch waits on its host's FIFO queue
+   * until both the global and the per-host in-flight limits allow it and the
+   * host's politeness delay has elapsed. Hosts with waiting fetches take turns
+   * in a ring, and each turn admits as many of the host's fetches as its limit
+   * allows back to back, so they can share the session's kept-alive
+   * connections to that host. Idle hosts are remembered (with their next
+   * admission time and latency) until an occasional sweep finds their delay
+   * over.
+   */
+
+  public class Frontier : GLib.Object
+    {
+      public const uint SWEEPEVERY = 256;
+
+      public uint host_delay { get; construct; default = 250; }
+      public uint host_fetches { get; construct; default = 2; }
+      public uint max_fetches { get; construct; default = 32; }
+
+      public uint fetched { get; private set; default = 0; }
+      public uint inflight { get; private set; default = 0; }
+      public uint queued { get; private set; default = 0; }
+
+      private GLib.HashTable<string, Host> hosts;
+      private uint releases = 0;
+      private GLib.Queue<unowned Host> ring;
+      private GLib.TimeoutSource? timeout = null;
+      private int64 window_start;
+      private uint window_fetched;
+
+      [Compact (opaque = true)] class Host
+        {
+          public uint fetched;
+          public uint inflight;
+          public double latency;
+          public bool listed;
+          public string name;
+          public int64 next_at;
+          public GLib.Queue<unowned Waiter> waiting;
+
+          public Host (string name)
+            {
+              this.fetched = 0;
+              this.inflight = 0;
+              this.latency = 0;
+              this.listed = false;
+              this.name = name;
+              this.next_at = 0;
+              this.waiting = new GLib.Queue<unowned Waiter> ();
+            }
+        }
+
+      [Compact (opaque = true)] class Waiter
+        {
+          public bool admitted;
+          public GLib.SourceFunc? callback;
+
+          public Waiter (owned GLib.SourceFunc callback)
+            {
+              this.admitted = false;
+              this.callback = (owned) callback;
+            }
+        }
+
+      [Compact (opaque = true)] public class Ticket
+        {
+          public string host;
+          public int64 started;
+
+          internal Ticket (string host)
+            {
+              this.host = host;
+              this.started = GLib.get_monotonic_time ();
+            }
+        }
+
+      construct
+        {
+          hosts = new GLib.HashTable<string, Host> (GLib.str_hash, GLib.str_equal);
+          ring = new GLib.Queue<unowned Host> ();
+          window_start = GLib.get_monotonic_time ();
+          window_fetched = 0;
+        }
+
+      public Frontier (uint max_fetches, uint host_fetches, uint host_delay)
+        {
+          Object (host_delay : host_delay, host_fetches : host_fetches, max_fetches : max_fetches);
+        }
+
+      /* drops a cancelled waiter from its host's queue, unless it got its slot meanwhile */
+      private void abandon (string name, Waiter waiter)
+        {
+          unowned Host? host;
+
+          if (waiter.admitted || waiter.callback == null)
+
+            return;
+
+          GLib.assert ((host = hosts.lookup (name)) != null);
+
+          host.waiting.remove (waiter);
+          --queued;
+
+          var callback = (owned) waiter.callback;
+          callback ();
+        }
+
+      /* waits for a fetch slot for uri's host, the returned ticket must be handed back with release () */
+      public async Ticket acquire (GLib.Uri uri, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          unowned Host? host;
+          var name = uri.get_host () ?? "";
+          ulong handler_id = 0;
+
+          cancellable?.set_error_if_cancelled ();
+
+          if ((host = hosts.lookup (name)) == null)
+            {
+              var host_ = new Host (name);
+              hosts.insert (host_.name, (owned) host_);
+              host = hosts.lookup (name);
+            }
+
+          var waiter = new Waiter (acquire.callback);
+
+          host.waiting.push_tail (waiter);
+          ++queued;
+
+          enlist (host);
+          dispatch ();
+
+          /* resuming from inside the handler would disconnect it from itself (and deadlock) */
+          if (cancellable != null)
+            {
+              var context = GLib.MainContext.ref_thread_default ();
+
+              handler_id = cancellable.connect (() =>
+                {
+                  var source = new GLib.IdleSource ();
+
+                  source.set_callback (() => { abandon (name, waiter); return GLib.Source.REMOVE; });
+                  source.attach (context);
+                });
+            }
+
+          yield;
+
+          if (cancellable != null)
+
+            cancellable.disconnect (handler_id);
+
+          if (unlikely (waiter.admitted == false))
+
+            throw new IOError.CANCELLED ("operation was cancelled");
+
+          return new Ticket (name);
+        }
+
+      private void dispatch ()
+        {
+          var now = GLib.get_monotonic_time ();
+          var wait = int64.MAX;
+
+          for (uint turns = ring.length; turns > 0 && inflight < max_fetches; --turns)
+            {
+              unowned var host = ring.pop_head ();
+
+              /* every fetch it had queued got cancelled */
+              if (host.waiting.is_empty ())
+                {
+                  host.listed = false;
+                  continue;
+                }
+
+              if (host.inflight >= host_fetches)
+                {
+                  ring.push_tail (host);
+                  continue;
+                }
+
+              if (host.next_at > now)
+                {
+                  wait = int64.min (wait, host.next_at - now);
+                  ring.push_tail (host);
+                  continue;
+                }
+
+              while (host.inflight < host_fetches && inflight < max_fetches && ! host.waiting.is_empty ())
+                {
+                  unowned var waiter = host.waiting.pop_head ();
+
+                  ++host.inflight;
+                  ++inflight;
+                  --queued;
+                  waiter.admitted = true;
+                  resume ((owned) waiter.callback);
+                }
+
+              host.next_at = now + 1000 * (int64) host_delay;
+
+              if (host.waiting.is_empty ())
+
+                host.listed = false;
+              else
+                ring.push_tail (host);
+            }
+
+          if (wait < int64.MAX && timeout == null)
+            {
+              timeout = new GLib.TimeoutSource ((uint) ((wait + 999) / 1000));
+              timeout.set_callback (() =>
+                {
+                  timeout = null;
+                  dispatch ();
+                  return GLib.Source.REMOVE;
+                });
+
+              timeout.attach (GLib.MainContext.get_thread_default ());
+            }
+        }
+
+      private void enlist (Host host)
+        {
+          if (host.listed == false)
+            {
+              host.listed = true;
+              ring.push_tail (host);
+            }
+        }
+
+      /* average host latency, in seconds, or a negative value for unknown hosts */
+      public double host_latency (string host)
+        {
+          unowned Host? host_;
+          return (host_ = hosts.lookup (host)) == null ? -1 : host_.latency;
+        }
+
+      /* fetches completed per second since the last call */
+      public double pages_per_second ()
+        {
+          var now = GLib.get_monotonic_time ();
+          var elapsed = (double) (now - window_start) / 1000000.0;
+          var rate = elapsed <= 0 ? 0 : (double) (fetched - window_fetched) / elapsed;
+
+          window_fetched = fetched;
+          window_start = now;
+          return rate;
+        }
+
+      public void release (owned Ticket ticket)
+        {
+          unowned Host? host;
+          var elapsed = (double) (GLib.get_monotonic_time () - ticket.started) / 1000000.0;
+
+          GLib.assert ((host = hosts.lookup (ticket.host)) != null);
+
+          --host.inflight;
+          --inflight;
+          ++fetched;
+
+          host.latency = host.fetched++ == 0 ? elapsed : 0.8 * host.latency + 0.2 * elapsed;
+
+          if (++releases % SWEEPEVERY == 0)
+
+            sweep (GLib.get_monotonic_time ());
+
+          dispatch ();
+        }
+
+      public void report ()
+        {
+          debug ("frontier: %.2f pages/s, %u queued, %u inflight, %u hosts", pages_per_second (), queued, inflight, hosts.length);
+
+          hosts.foreach ((name, host) =>
+            {
+              debug ("frontier: host '%s': %u inflight, %u queued, %.3fs latency", name, host.inflight, host.waiting.length, host.latency);
+            });
+        }
+
+      /* forgets hosts with nothing running nor queued whose politeness delay is over */
+      private void sweep (int64 now)
+        {
+          hosts.foreach_remove ((name, host) =>
+            {
+              return host.inflight == 0 && host.listed == false && host.waiting.is_empty () && host.next_at <= now;
+            });
+        }
+
+      static void resume (owned GLib.SourceFunc callback)
+        {
+          var source = new GLib.IdleSource ();
+          source.set_callback ((owned) callback);
+          source.attach (GLib.MainContext.get_thread_default ());
+        }
+    }
+}
@@ -19,36 +19,68 @@
 
 namespace ScrapperD.Scrapper
 {
+  /*
+   * Incremental tokenizer picking every href and src attribute value out of
+   * an HTML stream. State survives chunk boundaries, so each byte is looked
+   * at once no matter how the input gets split, and markup-free stretches
+   * (text, quoted values, comments) are skipped over with memchr.
+   */
+
   public class LinkSearcherConverter : GLib.Object, GLib.Converter
     {
+      const uint MAXNAME = 4;
+      const uint MAXVALUE = 8192;
+
+      private enum State
+        {
+          DATA,
+          TAG_OPEN,
+          TAG_NAME,
+          BEFORE_ATTR,
+          ATTR_NAME,
+          AFTER_ATTR_NAME,
+          BEFORE_VALUE,
+          VALUE_DQ,
+          VALUE_SQ,
+          VALUE_UNQ,
+          MARKUP,
+          COMMENT,
+          SKIP_TAG,
+        }
+
+      private bool capture;
+      private uint dashes;
       private GLib.SList<string> hrefs;
-      private GLib.Regex[] regexes;
+      private uint8 name [4];
+      private uint namelen;
+      private State state;
+      private GLib.StringBuilder value;
 
       construct
         {
           hrefs = new SList<string> ();
+          value = new GLib.StringBuilder.sized (256);
+          reset ();
+        }
 
-          var compile_options1 = GLib.RegexCompileFlags.MULTILINE;
-          var compile_options2 = GLib.RegexCompileFlags.OPTIMIZE;
-          var compile_options3 = GLib.RegexCompileFlags.RAW;
-          var compile_options = compile_options1 | compile_options2 | compile_options3;
+      [CCode (cheader_filename = "string.h", cname = "memchr")]
 
-          var match_options1 = GLib.RegexMatchFlags.NOTEMPTY;
-          var match_options2 = GLib.RegexMatchFlags.PARTIAL_HARD;
-          var match_options = match_options1 | match_options2;
+      private static extern void* memchr (void* s, int c, size_t n);
 
-          try
-            {
-              regexes =
-                {
-                  new GLib.Regex ("<a[^>h]*href\\s*=\\s*\"([^\"]+)\"[^>]*>", compile_options, match_options),
-                  new GLib.Regex ("<a[^/h]*href\\s*=\\s*\"([^\"]+)\"[^/]*/>", compile_options, match_options),
-                };
-            }
-          catch (GLib.Error e)
-            {
-              error (@"$(e.domain): $(e.code): $(e.message)");
-            }
+      static inline bool is_space (char c)
+        {
+          return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\f';
+        }
+
+      static inline int find (uint8[] data, int from, char c)
+        {
+          void* at;
+
+          if ((at = memchr (& data [from], c, data.length - from)) == null)
+
+            return -1;
+          else
+            return (int) ((uint8*) at - (uint8*) data);
         }
 
       static size_t migrate (uint8[] inbuf, uint8[] outbuf)
@@ -65,40 +97,266 @@ namespace ScrapperD.Scrapper
           return !(flush || input_at_end) ? ConverterResult.CONVERTED : (!input_at_end ? ConverterResult.FLUSHED : ConverterResult.FINISHED);
         }
 
-      public GLib.ConverterResult convert (uint8[] inbuf, uint8[] outbuf, GLib.ConverterFlags converter_flags, out size_t bytes_read, out size_t bytes_written) throws GLib.Error
+      private void append (uint8[] data, int from, int to)
         {
-          GLib.MatchInfo? info;
-          unowned var input_ = (string) inbuf;
+          if (capture)
+            {
+              if (value.len + (to - from) > MAXVALUE)
 
-          bytes_read = bytes_written = 0;
+                capture = false;
+              else
+                value.append_len ((string) & data [from], to - from);
+            }
+        }
+
+      private void begin_value ()
+        {
+          capture = (namelen == 4 && Memory.cmp (name, "href", 4) == 0)
+                 || (namelen == 3 && Memory.cmp (name, "src", 3) == 0);
+          value.truncate (0);
+        }
+
+      private void begin_name (char c)
+        {
+          namelen = 0;
+          push_name (c);
+        }
 
-          foreach (unowned var regex in regexes)
+      private void emit ()
+        {
+          if (capture && value.len > 0)
             {
-              regex.match_full (input_, inbuf.length, 0, 0, out info);
+              var href = value.str.strip ();
+              if (href.length > 0) hrefs.prepend ((owned) href);
+            }
 
-              if (info != null)
-                {
-                  if (info.is_partial_match ())
-                    {
-                      if ((converter_flags & (ConverterFlags.FLUSH | ConverterFlags.INPUT_AT_END)) == 0)
-
-                        throw new IOError.PARTIAL_INPUT ("partial match, give me more data to find whole link");
-                    }
-                  else for (unowned var i = 0; info.matches (); ++i)
-                    {
-                      hrefs.prepend (info.fetch (1));
-                      info.next ();
-                    }
-                }
+          capture = false;
+        }
+
+      private void push_name (char c)
+        {
+          if (namelen < MAXNAME) name [namelen] = (uint8) c.tolower ();
+          if (namelen <= MAXNAME) ++namelen;
+        }
+
+      public GLib.ConverterResult convert (uint8[] inbuf, uint8[] outbuf, GLib.ConverterFlags converter_flags, out size_t bytes_read, out size_t bytes_written) throws GLib.Error
+        {
+          bytes_read = bytes_written = 0;
+
+          if (inbuf.length > 0)
+            {
+              bytes_read = bytes_written = migrate (inbuf, outbuf);
+              unowned var scanned = (uint8[]) & inbuf [0]; scanned.length = (int) bytes_read;
+              feed (scanned);
             }
 
-          bytes_read = bytes_written = migrate (inbuf, outbuf);
+          if ((converter_flags & GLib.ConverterFlags.INPUT_AT_END) != 0 && bytes_read == inbuf.length)
+            {
+              if (state == State.VALUE_UNQ) emit ();
+            }
 
           return result_from_flags (converter_flags);
         }
 
+      public void feed (uint8[] data)
+        {
+          int at;
+
+          for (int i = 0; i < data.length; ++i)
+            {
+              var c = (char) data [i];
+
+              switch (state)
+                {
+                  case State.DATA:
+
+                    if ((at = find (data, i, '<')) < 0)
+
+                      return;
+                    else
+                      {
+                        i = at;
+                        state = State.TAG_OPEN;
+                      }
+                    break;
+
+                  case State.TAG_OPEN:
+
+                    if (c.isalpha ())
+
+                      state = State.TAG_NAME;
+                    else if (c == '!')
+                      {
+                        dashes = 0;
+                        state = State.MARKUP;
+                      }
+                    else if (c == '/' || c == '?')
+
+                      state = State.SKIP_TAG;
+                    else if (c != '<')
+
+                      state = State.DATA;
+                    break;
+
+                  case State.TAG_NAME:
+
+                    if (c == '>')
+
+                      state = State.DATA;
+                    else if (c == '/' || is_space (c))
+
+                      state = State.BEFORE_ATTR;
+                    break;
+
+                  case State.BEFORE_ATTR:
+
+                    if (c == '>')
+
+                      state = State.DATA;
+                    else if (c != '/' && ! is_space (c))
+                      {
+                        begin_name (c);
+                        state = State.ATTR_NAME;
+                      }
+                    break;
+
+                  case State.ATTR_NAME:
+                  case State.AFTER_ATTR_NAME:
+
+                    if (c == '>')
+
+                      state = State.DATA;
+                    else if (c == '=')
+                      {
+                        begin_value ();
+                        state = State.BEFORE_VALUE;
+                      }
+                    else if (c == '/')
+
+                      state = State.BEFORE_ATTR;
+                    else if (is_space (c))
+
+                      state = State.AFTER_ATTR_NAME;
+                    else if (state == State.ATTR_NAME)
+
+                      push_name (c);
+                    else
+                      {
+                        begin_name (c);
+                        state = State.ATTR_NAME;
+                      }
+                    break;
+
+                  case State.BEFORE_VALUE:
+
+                    if (c == '>')
+
+                      state = State.DATA;
+                    else if (c == '"')
+
+                      state = State.VALUE_DQ;
+                    else if (c == '\'')
+
+                      state = State.VALUE_SQ;
+                    else if (! is_space (c))
+                      {
+                        append (data, i, i + 1);
+                        state = State.VALUE_UNQ;
+                      }
+                    break;
+
+                  case State.VALUE_DQ:
+                  case State.VALUE_SQ:
+
+                    if ((at = find (data, i, state == State.VALUE_DQ ? '"' : '\'')) < 0)
+                      {
+                        append (data, i, data.length);
+                        return;
+                      }
+                    else
+                      {
+                        append (data, i, at);
+                        emit ();
+                        i = at;
+                        state = State.BEFORE_ATTR;
+                      }
+                    break;
+
+                  case State.VALUE_UNQ:
+
+                    if (c == '>')
+                      {
+                        emit ();
+                        state = State.DATA;
+                      }
+                    else if (is_space (c))
+                      {
+                        emit ();
+                        state = State.BEFORE_ATTR;
+                      }
+                    else
+                      append (data, i, i + 1);
+                    break;
+
+                  case State.MARKUP:
+
+                    if (c == '-' && ++dashes == 2)
+                      {
+                        dashes = 0;
+                        state = State.COMMENT;
+                      }
+                    else if (c == '>')
+
+                      state = State.DATA;
+                    else if (c != '-')
+
+                      state = State.SKIP_TAG;
+                    break;
+
+                  case State.COMMENT:
+
+                    if (c == '-')
+
+                      ++dashes;
+                    else if (c == '>' && dashes >= 2)
+
+                      state = State.DATA;
+                    else
+                      {
+                        /* anything else breaks the run, even if no dash follows in this chunk */
+                        dashes = 0;
+
+                        if ((at = find (data, i, '-')) < 0)
+
+                          return;
+
+                        dashes = 1;
+                        i = at;
+                      }
+                    break;
+
+                  case State.SKIP_TAG:
+
+                    if ((at = find (data, i, '>')) < 0)
+
+                      return;
+                    else
+                      {
+                        i = at;
+                        state = State.DATA;
+                      }
+                    break;
+                }
+            }
+        }
+
       public void reset ()
         {
+          capture = false;
+          dashes = 0;
+          namelen = 0;
+          state = State.DATA;
+          value.truncate (0);
         }
 
       public GLib.SList<string> steal_hrefs ()
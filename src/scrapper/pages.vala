@@ -0,0 +1,146 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using Kademlia;
+
+[CCode (cprefix = "ScrapperdScrapper", lower_case_cprefix = "scrapperd_scrapper_")]
+
+namespace ScrapperD.Scrapper
+{
+  public struct PageVersion
+    {
+      public uint number;
+      public int64 scraped;
+    }
+
+  /*
+   * Every scrape of a page is stored as a record of its own, under a key
+   * derived from the page key and the version number, while the page key
+   * itself holds a small head listing the versions (and whatever attributes
+   * rescrapes need). Adding a version writes the new record and the head,
+   * however long the page's history is.
+   */
+
+  [Compact (opaque = true)] public class PageHead
+    {
+      const string TAG = "page-head";
+
+      public GLib.HashTable<string, string> attributes;
+      public GLib.Array<PageVersion> versions;
+
+      public static GLib.VariantType variant_type = new GLib.VariantType ("(sa(ux)a{ss})");
+
+      public uint latest { get { return versions.length == 0 ? 0 : versions.index (versions.length - 1).number; } }
+
+      public PageHead ()
+        {
+          attributes = new GLib.HashTable<string, string> (GLib.str_hash, GLib.str_equal);
+          versions = new GLib.Array<PageVersion> (false, false, sizeof (PageVersion));
+        }
+
+      public PageHead.from_bytes (GLib.Bytes bytes) throws GLib.Error
+        {
+          this ();
+
+          string tag;
+          GLib.VariantIter versions_iter;
+          GLib.VariantIter attributes_iter;
+          PageVersion version = { };
+          unowned string key, value;
+          var variant = new GLib.Variant.from_bytes (variant_type, bytes, false);
+
+          if (variant.is_normal_form () == false)
+
+            throw new IOError.INVALID_DATA ("malformed page head");
+
+          variant.get ("(sa(ux)a{ss})", out tag, out versions_iter, out attributes_iter);
+
+          if (tag != TAG)
+
+            throw new IOError.INVALID_DATA ("malformed page head");
+
+          while (versions_iter.next ("(ux)", out version.number, out version.scraped))
+            {
+              versions.append_val (version);
+            }
+
+          while (attributes_iter.next ("{&s&s}", out key, out value))
+            {
+              attributes.insert (key, value);
+            }
+        }
+
+      public uint append (int64 scraped)
+        {
+          var version = PageVersion () { number = latest + 1, scraped = scraped };
+
+          versions.append_val (version);
+          return version.number;
+        }
+
+      /*
+       * whether a rescrape is due: the server's max-age (when it sent one, else
+       * default_span) counted from the last time the page was fetched or
+       * confirmed unchanged; times are in microseconds, like get_real_time
+       */
+      public bool is_stale (int64 now, int64 default_span)
+        {
+          unowned string? value;
+          int64 verified = versions.length == 0 ? 0 : versions.index (versions.length - 1).scraped;
+          int64 span = default_span;
+
+          if ((value = attributes.lookup ("verified")) != null)
+
+            int64.try_parse (value, out verified);
+
+          if ((value = attributes.lookup ("max-age")) != null && int64.try_parse (value, out span))
+
+            span *= GLib.TimeSpan.SECOND;
+
+          return verified + span <= now;
+        }
+
+      public GLib.Bytes to_bytes ()
+        {
+          var builder = new GLib.VariantBuilder (variant_type);
+
+          builder.add ("s", TAG);
+          builder.open (new GLib.VariantType ("a(ux)"));
+
+          for (uint i = 0; i < versions.length; ++i)
+            {
+              var version = versions.index (i);
+              builder.add ("(ux)", version.number, version.scraped);
+            }
+
+          builder.close ();
+          builder.open (new GLib.VariantType ("a{ss}"));
+          attributes.foreach ((key, value) => builder.add ("{ss}", key, value));
+          builder.close ();
+          return builder.end ().get_data_as_bytes ();
+        }
+
+      public static Key version_key (Key id, uint version)
+        {
+          var builder = new KeyBuilder ();
+          var number = version.to_big_endian ();
+
+          builder.update (id.bytes, id.bytes.length);
+          builder.update ((uint8[]) & number, sizeof (uint32));
+          return builder.end ();
+        }
+    }
+}
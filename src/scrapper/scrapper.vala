@@ -21,30 +21,71 @@ namespace ScrapperD.Scrapper
 {
   public class Scrapper : GLib.Object
     {
+      public Compressor compressor { get; construct; }
+      public Frontier frontier { get; construct; }
       public Soup.Session session { get; construct; }
 
+      public uint not_modified { get; private set; default = 0; }
+      public uint64 skipped_bytes { get; private set; default = 0; }
+
+      private unowned Metrics.Counter fetched_bytes;
+      private unowned Metrics.Counter fetched_pages;
+      private unowned Metrics.Counter unchanged_pages;
+      private unowned Metrics.Counter unfetched_bytes;
+
       public static GLib.VariantType scrap_variant_type = new GLib.VariantType ("(maysa{ss})");
       private static GLib.VariantType scrap_variant_bytestring_type = new GLib.VariantType ("ay");
       private static GLib.VariantType scrap_variant_dictionary_type = new GLib.VariantType ("a{ss}");
 
       [Compact] public class Result
         {
-          public GLib.Variant content;
+          public GLib.Variant? content;
+          public size_t length;
           public GLib.SList<GLib.Uri> links;
+          public bool unchanged;
+          public GLib.HashTable<string, string> validators;
 
-          public Result (GLib.Variant content, owned SList<Uri> links)
+          public Result (GLib.Variant content, owned SList<Uri> links, size_t length)
             {
               this.content = content;
+              this.length = length;
               this.links = (owned) links;
+              this.unchanged = false;
+              this.validators = new GLib.HashTable<string, string> (GLib.str_hash, GLib.str_equal);
+            }
+
+          /* result of a conditional request the server answered with 304 */
+          public Result.unchanged ()
+            {
+              this.content = null;
+              this.length = 0;
+              this.links = new GLib.SList<GLib.Uri> ();
+              this.unchanged = true;
+              this.validators = new GLib.HashTable<string, string> (GLib.str_hash, GLib.str_equal);
             }
         }
 
       construct
         {
-          session = new Soup.Session ();
+          if (compressor == null) compressor = new Compressor (new ZstdCodec (3));
+          if (frontier == null) frontier = new Frontier (32, 2, 250);
+          session = new Soup.Session.with_options ("max-conns", (int) frontier.max_fetches, "max-conns-per-host", (int) frontier.host_fetches);
 
           session.set_accept_language_auto (true);
           session.set_user_agent (Config.PACKAGE_STRING);
+
+          var registry = Metrics.Registry.get_default ();
+          var pages = "pages scrapped, by whether they came back";
+
+          fetched_bytes = registry.counter ("scrapperd_scrapper_bytes_total", "uncompressed page bytes downloaded");
+          fetched_pages = registry.counter ("scrapperd_scrapper_pages_total", pages, "result=\"fetched\"");
+          unchanged_pages = registry.counter ("scrapperd_scrapper_pages_total", pages, "result=\"unchanged\"");
+          unfetched_bytes = registry.counter ("scrapperd_scrapper_skipped_bytes_total", "uncompressed page bytes not downloaded again, as servers said they did not change");
+        }
+
+      public Scrapper (Frontier? frontier = null, Compressor? compressor = null)
+        {
+          Object (compressor : compressor, frontier : frontier);
         }
 
       static void annotate (GLib.VariantBuilder builder, Soup.MessageHeaders headers, string name, string? @as = null)
@@ -84,12 +125,60 @@ namespace ScrapperD.Scrapper
             }
         }
 
-      public async Result? scrap_uri (owned GLib.Uri uri, GLib.Cancellable? cancellable = null) throws GLib.Error
+      /*
+       * validators are the ones a previous scrape of the same uri returned (see
+       * Result.validators), the request is made conditional on them and, when
+       * the page did not change, an unchanged result comes back
+       */
+      public async Result? scrap_uri (owned GLib.Uri uri, GLib.HashTable<string, string>? validators = null, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var ticket = yield frontier.acquire (uri, cancellable);
+
+          try { return yield fetch_uri (uri, validators, cancellable); } finally
+            {
+              frontier.release ((owned) ticket);
+            }
+        }
+
+      private async Result? fetch_uri (GLib.Uri uri, GLib.HashTable<string, string>? validators, GLib.Cancellable? cancellable) throws GLib.Error
         {
+          unowned string? validator;
           var message = new Soup.Message.from_uri ("GET", uri);
+          var request_headers = message.get_request_headers ();
+
+          if (validators != null && (validator = validators.lookup ("etag")) != null)
+
+            request_headers.replace ("If-None-Match", validator);
+
+          if (validators != null && (validator = validators.lookup ("last-modified")) != null)
+
+            request_headers.replace ("If-Modified-Since", validator);
+
           var stream = yield session.send_async (message, GLib.Priority.LOW, cancellable);
 
+          if (message.get_status () == Soup.Status.NOT_MODIFIED)
+            {
+              unowned string? length;
+              uint64 saved;
+
+              yield stream.close_async (GLib.Priority.LOW, cancellable);
+
+              saved = (validators != null && (length = validators.lookup ("length")) != null) ? uint64.parse (length) : 0;
+
+              ++not_modified;
+              unfetched_bytes.add (saved);
+              skipped_bytes += saved;
+              unchanged_pages.inc ();
+
+              /* a 304 carries the same caching headers a 200 would */
+              var unchanged = new Result.unchanged ();
+              revalidate (unchanged.validators, message.get_response_headers ());
+              return unchanged;
+            }
+
           var builder = new VariantBuilder (scrap_variant_type);
+          var compressed = false;
+          var length = (size_t) 0;
           var links = new GLib.SList<GLib.Uri> ();
           var ratio = (double) (-1.0);
           var response_headers = message.get_response_headers ();
@@ -102,25 +191,25 @@ namespace ScrapperD.Scrapper
           else
             {
               var searcher = new LinkSearcherConverter ();
-              var zlib = new GLib.ZlibCompressor (GLib.ZlibCompressorFormat.ZLIB, 9);
-
               var searcher_stream = new GLib.ConverterInputStream (stream, searcher);
-              var zlib_stream = new GLib.ConverterInputStream (searcher_stream, zlib);
               var bytes_stream = new GLib.MemoryOutputStream.resizable ();
 
               searcher_stream.close_base_stream = true;
-              zlib_stream.close_base_stream = true;
 
               var splice_flags1 = GLib.OutputStreamSpliceFlags.CLOSE_SOURCE;
               var splice_flags2 = GLib.OutputStreamSpliceFlags.CLOSE_TARGET;
               var splice_flags = splice_flags1 | splice_flags2;
 
-              var read = yield bytes_stream.splice_async (zlib_stream, splice_flags, GLib.Priority.LOW, cancellable);
+              yield bytes_stream.splice_async (searcher_stream, splice_flags, GLib.Priority.LOW, cancellable);
 
-              var bytes = bytes_stream.steal_as_bytes ();
+              var raw = bytes_stream.steal_as_bytes ();
+              length = raw.get_size ();
+              var bytes = yield compressor.compress (raw);
               var hrefs = searcher.steal_hrefs ();
 
-              ratio = read >= ssize_t.MAX ? -1 : (double) read / (double) response_headers.get_content_length ();
+              compressed = true;
+
+              ratio = raw.get_size () == 0 ? -1 : (double) bytes.get_size () / (double) raw.get_size ();
 
               foreach (unowned var href in hrefs) try
                 {
@@ -149,12 +238,60 @@ namespace ScrapperD.Scrapper
               builder.add ("{ss}", "ratio", ratio.to_str (buffer));
             }
 
+          if (compressed)
+
+            compressor.codec.annotate (builder);
+
+          annotate (builder, response_headers, "Cache-Control", "cache-control");
           annotate (builder, response_headers, "Content-Type", "content-type");
           annotate (builder, response_headers, "Date", "date");
+          annotate (builder, response_headers, "ETag", "etag");
+          annotate (builder, response_headers, "Last-Modified", "last-modified");
           annotate (builder, response_headers, "Server", "server");
           builder.close ();
 
-          return new Result (builder.end (), (owned) links);
+          fetched_bytes.add (length);
+          fetched_pages.inc ();
+
+          var result = new Result (builder.end (), (owned) links, length);
+
+          revalidate (result.validators, response_headers);
+          result.validators.insert ("length", length.to_string ());
+          return result;
+        }
+
+      public void report ()
+        {
+          debug ("not modified: %u, skipped bytes: %s", not_modified, GLib.format_size (skipped_bytes));
+        }
+
+      /* validators and max-age for the next conditional request, out of a response's headers */
+      static void revalidate (GLib.HashTable<string, string> validators, Soup.MessageHeaders headers)
+        {
+          string? cache_control;
+
+          validate (validators, headers, "ETag", "etag");
+          validate (validators, headers, "Last-Modified", "last-modified");
+
+          if ((cache_control = headers.get_list ("Cache-Control")) != null)
+            {
+              var @params = Soup.header_parse_param_list (cache_control);
+              unowned string? max_age;
+
+              if (@params.lookup_extended ("max-age", null, out max_age) && max_age != null)
+
+                validators.insert ("max-age", max_age);
+            }
+        }
+
+      static void validate (GLib.HashTable<string, string> validators, Soup.MessageHeaders headers, string name, string @as)
+        {
+          string? value;
+
+          if ((value = headers.get_one (name)) != null)
+            {
+              validators.insert (@as, value);
+            }
         }
     }
 }
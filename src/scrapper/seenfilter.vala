@@ -0,0 +1,280 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using Kademlia;
+
+[CCode (cprefix = "ScrapperdScrapper", lower_case_cprefix = "scrapperd_scrapper_")]
+
+namespace ScrapperD.Scrapper
+{
+  public enum SeenAnswer
+    {
+      ABSENT,
+      MAYBE,
+      RECENT,
+    }
+
+  /*
+   * Scalable Bloom filter of URL keys, plus an exact set of the keys seen in
+   * the last RECENT_SPAN. Stages double in size and halve their error rate as
+   * they fill up, so the overall false positive rate stays under twice the
+   * first stage's one however many keys get added. Keys are already uniformly
+   * distributed hashes, so their own bytes feed double hashing directly.
+   */
+
+  public class SeenFilter : GLib.Object
+    {
+      public const int64 RECENT_SPAN = 3600 * GLib.TimeSpan.SECOND;
+      const uint BASE_BITS = 1 << 20;
+      const double BASE_ERROR = 0.01;
+
+      private GLib.GenericArray<Stage> stages;
+      private Deadlines recent;
+
+      private uint checks = 0;
+      private uint false_positives = 0;
+      private uint local_answers = 0;
+      private uint true_positives = 0;
+
+      public double false_positive_rate { get { return checked_positives () == 0 ? 0 : (double) false_positives / (double) checked_positives (); } }
+      public double hit_rate { get { return checks == 0 ? 0 : (double) local_answers / (double) checks; } }
+
+      private static GLib.VariantType variant_type = new GLib.VariantType ("a(uuay)");
+
+      [Compact (opaque = true)] class Stage
+        {
+          public uint8[] bits;
+          public uint capacity;
+          public uint count;
+          public uint hashes;
+
+          public Stage (uint nth)
+            {
+              var error = BASE_ERROR * Math.pow (0.5, nth);
+              var nbits = BASE_BITS << nth;
+
+              this.bits = new uint8 [nbits >> 3];
+              this.capacity = (uint) (nbits * Math.LN2 * Math.LN2 / - Math.log (error));
+              this.count = 0;
+              this.hashes = (uint) Math.ceil (- Math.log2 (error));
+            }
+
+          public Stage.from_variant (GLib.Variant variant) throws GLib.Error
+            {
+              var bytes = variant.get_child_value (2);
+              var nbits = (uint) bytes.get_size () << 3;
+
+              if (nbits < BASE_BITS || (nbits & (nbits - 1)) != 0)
+
+                throw new IOError.INVALID_DATA ("invalid filter stage size %u", nbits);
+
+              this.bits = bytes.get_data_as_bytes ().get_data ();
+              this.count = variant.get_child_value (1).get_uint32 ();
+              this.hashes = variant.get_child_value (0).get_uint32 ();
+              this.capacity = 0;
+            }
+
+          public bool add (Key key)
+            {
+              var added = false;
+              uint64 h1, h2;
+
+              hash_key (key, out h1, out h2);
+
+              for (uint i = 0, mask = (bits.length << 3) - 1; i < hashes; ++i)
+                {
+                  var at = (uint) ((h1 + i * h2) & mask);
+                  var bit = (uint8) (1 << (at & 7));
+
+                  if ((bits [at >> 3] & bit) == 0)
+                    {
+                      bits [at >> 3] |= bit;
+                      added = true;
+                    }
+                }
+
+              if (added) ++count;
+              return added;
+            }
+
+          public bool contains (Key key)
+            {
+              uint64 h1, h2;
+
+              hash_key (key, out h1, out h2);
+
+              for (uint i = 0, mask = (bits.length << 3) - 1; i < hashes; ++i)
+                {
+                  var at = (uint) ((h1 + i * h2) & mask);
+                  if ((bits [at >> 3] & (uint8) (1 << (at & 7))) == 0) return false;
+                }
+              return true;
+            }
+
+          public bool merge (Stage other)
+            {
+              if (other.bits.length != bits.length || other.hashes != hashes)
+
+                return false;
+              else
+                {
+                  var set = 0u;
+
+                  for (int i = 0; i < bits.length; ++i)
+                    {
+                      bits [i] |= other.bits [i];
+                      for (uint b = bits [i]; b != 0; b &= b - 1) ++set;
+                    }
+
+                  /* keys in the union, estimated from how many bits are set */
+                  var nbits = (double) (bits.length << 3);
+                  var estimate = - nbits / hashes * Math.log (1.0 - (double) set / nbits);
+                  count = (uint) double.min (estimate, (double) uint.MAX);
+                }
+              return true;
+            }
+
+          public GLib.Variant to_variant ()
+            {
+              var data = new GLib.Variant.fixed_array (GLib.VariantType.BYTE, bits, sizeof (uint8));
+              return new GLib.Variant.tuple ({ new GLib.Variant.uint32 (hashes), new GLib.Variant.uint32 (count), data });
+            }
+        }
+
+      construct
+        {
+          stages = new GLib.GenericArray<Stage> ();
+          recent = new Deadlines ();
+        }
+
+      public SeenFilter ()
+        {
+          Object ();
+        }
+
+      public SeenFilter.from_bytes (GLib.Bytes bytes) throws GLib.Error
+        {
+          Object ();
+          merge_bytes (bytes);
+        }
+
+      public void add (Key key)
+        {
+          unowned Stage? last = stages.length == 0 ? null : stages [stages.length - 1];
+
+          if (last == null || last.count >= last.capacity)
+            {
+              stages.add (new Stage (stages.length));
+              last = stages [stages.length - 1];
+            }
+
+          if (contains (key) == false) last.add (key);
+          recent.schedule (key, GLib.get_monotonic_time () + RECENT_SPAN);
+        }
+
+      public SeenAnswer check (Key key)
+        {
+          var now = GLib.get_monotonic_time ();
+          ++checks;
+
+          while (recent.pop (now) != null) { }
+
+          if (recent.contains (key))
+            {
+              ++local_answers;
+              return SeenAnswer.RECENT;
+            }
+          else if (contains (key) == false)
+            {
+              ++local_answers;
+              return SeenAnswer.ABSENT;
+            }
+
+          return SeenAnswer.MAYBE;
+        }
+
+      private uint checked_positives ()
+        {
+          return false_positives + true_positives;
+        }
+
+      public bool contains (Key key)
+        {
+          foreach (unowned var stage in stages) if (stage.contains (key)) return true;
+          return false;
+        }
+
+      /* tells the filter how a MAYBE answer turned out once asked to the network */
+      public void confirm (bool found)
+        {
+          if (found) ++true_positives; else ++false_positives;
+        }
+
+      static void hash_key (Key key, out uint64 h1, out uint64 h2)
+        {
+          unowned var bytes = key.bytes;
+
+          GLib.Memory.copy (& h1, & bytes [0], sizeof (uint64));
+          GLib.Memory.copy (& h2, & bytes [sizeof (uint64)], sizeof (uint64));
+          h2 |= 1;
+        }
+
+      /* unions another filter into this one, stage by stage */
+      public void merge_bytes (GLib.Bytes bytes) throws GLib.Error
+        {
+          var variant = new GLib.Variant.from_bytes (variant_type, bytes, false);
+
+          if (variant.is_normal_form () == false)
+
+            throw new IOError.INVALID_DATA ("malformed seen filter");
+
+          for (uint i = 0; i < variant.n_children (); ++i)
+            {
+              var stage = new Stage.from_variant (variant.get_child_value (i));
+
+              if (i >= stages.length)
+
+                stages.add ((owned) stage);
+              else if (stages [i].merge (stage) == false)
+
+                throw new IOError.INVALID_DATA ("seen filter stage %u does not match", i);
+            }
+
+          for (uint i = 0; i < stages.length; ++i)
+            {
+              var fresh = new Stage (i);
+
+              if (fresh.bits.length != stages [i].bits.length || fresh.hashes != stages [i].hashes)
+
+                throw new IOError.INVALID_DATA ("seen filter stage %u does not match", i);
+
+              stages [i].capacity = fresh.capacity;
+            }
+        }
+
+      public void report ()
+        {
+          debug ("seen filter: %u stages, hit rate %.3f, false positive rate %.3f", stages.length, hit_rate, false_positive_rate);
+        }
+
+      public GLib.Bytes to_bytes ()
+        {
+          var builder = new GLib.VariantBuilder (variant_type);
+          foreach (unowned var stage in stages) builder.add_value (stage.to_variant ());
+          return builder.end ().get_data_as_bytes ();
+        }
+    }
+}
@@ -23,14 +23,26 @@ namespace ScrapperD.Scrapper
   public class Store : GLib.Object, ValueStore
     {
       public Scrapper scrapper { get; construct; }
+      public SeenFilter seen { get; construct; }
       private WeakRef _scrapper_peer;
       public ValuePeer scrapper_peer { owned get { return (ValuePeer) _scrapper_peer.get (); } set { _scrapper_peer.set (value); } }
       private WeakRef _store_peer;
       public ValuePeer store_peer { owned get { return (ValuePeer) _store_peer.get (); } set { _store_peer.set (value); } }
 
-      public Store (Scrapper scrapper)
+      /* how long a page stays fresh when its server does not say (Cache-Control max-age) */
+      const int64 RESCRAPE_SPAN = GLib.TimeSpan.DAY;
+
+      /* storage network key under which scrapper nodes pool their seen filters */
+      private static Key seen_key = new Key.from_data ("org.hck.ScrapperD.Scrapper.seen".data);
+
+      construct
+        {
+          if (seen == null) seen = new SeenFilter ();
+        }
+
+      public Store (Scrapper scrapper, SeenFilter? seen = null)
         {
-          Object (scrapper : scrapper);
+          Object (scrapper : scrapper, seen : seen);
         }
 
       public override async Key[] enumerate_staled_values (GLib.Cancellable? cancellable = null) throws GLib.Error
@@ -38,13 +50,88 @@ namespace ScrapperD.Scrapper
           return new Key [0];
         }
 
-      private async void scrap_and_save (owned Key id, GLib.Uri uri, owned GLib.Value? otherv) throws GLib.Error
+      /* page head under id, or null when there is none (or the value predates page heads) */
+      public async PageHead? lookup_head (Kademlia.Key id, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          GLib.Value? value;
+
+          if ((value = yield store_peer.lookup (id, cancellable)) == null)
+
+            return null;
+          else
+            return head_of (id, value);
+        }
+
+      static PageHead? head_of (Kademlia.Key id, GLib.Value value)
+        {
+          if (value.holds (typeof (GLib.Bytes)) == false)
+
+            return null;
+          else
+            {
+              try { return new PageHead.from_bytes ((GLib.Bytes) value.get_boxed ()); } catch (GLib.Error e)
+                {
+                  debug ("value is not a page head %s: %s: %u: %s", id.to_string (), e.domain.to_string (), e.code, e.message);
+                  return null;
+                }
+            }
+        }
+
+      public async GLib.Value? lookup_version (Kademlia.Key id, uint version, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          return yield store_peer.lookup (PageHead.version_key (id, version), cancellable);
+        }
+
+      /*
+       * uncompressed body of the page's latest version, or null when there is
+       * none; pages compressed with a dictionary need the scrapper's codec to
+       * carry that same dictionary
+       */
+      public async GLib.Bytes? lookup_page (Kademlia.Key id, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          GLib.Value? value;
+          PageHead? head;
+          string? dictionary = null;
+          string? name = null;
+
+          if ((head = yield lookup_head (id, cancellable)) == null || head.latest == 0)
+
+            return null;
+
+          if ((value = yield lookup_version (id, head.latest, cancellable)) == null || value.holds (typeof (GLib.Bytes)) == false)
+
+            return null;
+
+          var content = new GLib.Variant.from_bytes (Scrapper.scrap_variant_type, (GLib.Bytes) value.get_boxed (), false);
+          var body = content.get_child_value (0).get_maybe ();
+          var attributes = new GLib.VariantDict (content.get_child_value (2));
+
+          if (body == null)
+
+            return null;
+
+          /* pages from before codecs got annotated were all zlib */
+          if (attributes.lookup ("codec", "s", out name) == false)
+
+            name = "zlib";
+
+          attributes.lookup ("codec-dictionary", "s", out dictionary);
+
+          var codec = dictionary == null ? Codec.for_name (name) : scrapper.compressor.codec;
+
+          if (codec.name != name)
+
+            throw new IOError.NOT_SUPPORTED ("page compressed with %s, not %s", name, codec.name);
+
+          return codec.decompress (body.get_data_as_bytes ());
+        }
 
-          requires (otherv == null || otherv.holds (typeof (GLib.Bytes)))
+      private async void scrap_and_save (owned Key id, GLib.Uri uri, owned PageHead? head) throws GLib.Error
         {
           Scrapper.Result? result = null;
+          GLib.HashTable<string, string>? validators = head == null ? null : head.attributes;
 
-          try { result = yield scrapper.scrap_uri (uri); } catch (GLib.Error e)
+          try { result = yield scrapper.scrap_uri (uri, validators); } catch (GLib.Error e)
             {
               unowned var domain = e.domain.to_string ();
               unowned var code = e.code;
@@ -54,35 +141,50 @@ namespace ScrapperD.Scrapper
               return;
             }
 
-          debug ("uri scrapped %s:('%s')", id.to_string (), uri.to_string ());
+          var now = GLib.get_real_time ();
 
-          GLib.Variant contents;
+          seen.add (id);
 
-          if (otherv == null)
+          if (result.unchanged)
             {
-              Variant arv [1] = { result.content };
-              contents = new Variant.array (null, arv);
+              debug ("uri not modified %s:('%s')", id.to_string (), uri.to_string ());
+
+              /* validators the server left out stay as they were, but a missing max-age means none */
+              head.attributes.remove ("max-age");
+              result.validators.foreach ((key, value) => head.attributes.insert (key, value));
+              head.attributes.insert ("verified", now.to_string ());
+
+              if (unlikely (false == yield store_peer.insert (id, head.to_bytes ())))
+                {
+                  debug ("uri head was not saved %s:('%s')", id.to_string (), uri.to_string ());
+                }
+              return;
             }
-          else
-            {
-              var type = new VariantType.array (Scrapper.scrap_variant_type);
-              var other = new Variant.from_bytes (type, (Bytes) otherv.get_boxed (), false);
-              var builder = new VariantBuilder (type);
-              var iter = new VariantIter (other);
-              var child = (GLib.Variant?) null;
 
-              while ((child = iter.next_value ()) != null)
+          debug ("uri scrapped %s:('%s')", id.to_string (), uri.to_string ());
 
-                builder.add_value (child);
-                builder.add_value (result.content);
+          /* another node may have saved the page while this one was scraping it */
+          if (head == null && (head = yield lookup_head (id)) == null)
 
-              contents = builder.end ();
-            }
+            head = new PageHead ();
 
-          if (unlikely (false == yield store_peer.insert (id, contents.get_data_as_bytes ())))
+          var version = head.append (now);
+          var version_id = PageHead.version_key (id, version);
+
+          head.attributes.remove ("etag");
+          head.attributes.remove ("last-modified");
+          head.attributes.remove ("max-age");
+          result.validators.foreach ((key, value) => head.attributes.insert (key, value));
+          head.attributes.insert ("verified", now.to_string ());
+
+          if (unlikely (false == yield store_peer.insert (version_id, result.content.get_data_as_bytes ())))
             {
               debug ("uri data was not saved %s:('%s')", id.to_string (), uri.to_string ());
             }
+          else if (unlikely (false == yield store_peer.insert (id, head.to_bytes ())))
+            {
+              debug ("uri head was not saved %s:('%s')", id.to_string (), uri.to_string ());
+            }
           else foreach (unowned var link in result.links)
             {
               var uri_string = (string?) null;
@@ -103,6 +205,7 @@ namespace ScrapperD.Scrapper
             {
               var uri = (Uri) Scrapper.normal_uri (value.get_string ());
               var other = (GLib.Value?) null;
+              var head = (PageHead?) null;
 
               if (Scrapper.uri_is_valid (uri) == false)
                 {
@@ -112,25 +215,84 @@ namespace ScrapperD.Scrapper
 
               debug ("scrapping uri %s:('%s')", id.to_string (), uri.to_string ());
 
-              if (null != (other = yield store_peer.lookup (id, cancellable)))
+              /*
+               * ABSENT only speaks for this node's filter, which may have been
+               * lost or never pooled, so the page head is fetched either way
+               * and a page other nodes already hold keeps its history
+               */
+              switch (seen.check (id))
+                {
+                  case SeenAnswer.ABSENT:
+
+                    other = yield store_peer.lookup (id, cancellable);
+                    break;
+
+                  case SeenAnswer.MAYBE:
+
+                    seen.confirm ((other = yield store_peer.lookup (id, cancellable)) != null);
+                    break;
+
+                  case SeenAnswer.RECENT:
 
-                debug ("uri already scrapped %s:('%s')", id.to_string (), uri.to_string ());
-              else
+                    debug ("uri recently seen %s:('%s')", id.to_string (), uri.to_string ());
+                    return true;
+                }
+
+              seen.add (id);
+
+              if (other != null && ((head = head_of (id, other)) == null || head.is_stale (GLib.get_real_time (), RESCRAPE_SPAN) == false))
+                {
+                  debug ("uri already scrapped %s:('%s')", id.to_string (), uri.to_string ());
+                  return true;
+                }
 
-                scrap_and_save.begin (id.copy (), uri, (owned) other, (o, res) =>
-                  {
-                    try { ((Store) o).scrap_and_save.end (res); } catch (GLib.Error e)
-                      {
-                        warning (@"$(e.domain): $(e.code): $(e.message)");
-                      }
-                  });
+              if (head != null)
+
+                debug ("uri stale, rescrapping %s:('%s')", id.to_string (), uri.to_string ());
+
+              scrap_and_save.begin (id.copy (), uri, (owned) head, (o, res) =>
+                {
+                  try { ((Store) o).scrap_and_save.end (res); } catch (GLib.Error e)
+                    {
+                      warning (@"$(e.domain): $(e.code): $(e.message)");
+                    }
+                });
               return true;
             }
         }
 
+      /* unions the seen filter pooled in the storage network into ours and publishes the result */
+      public async void share_seen (GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          GLib.Value? pooled;
+
+          if ((pooled = yield store_peer.lookup (seen_key, cancellable)) != null && pooled.holds (typeof (GLib.Bytes)))
+
+            try { seen.merge_bytes ((GLib.Bytes) pooled.get_boxed ()); } catch (GLib.Error e)
+              {
+                warning ("can not merge pooled seen filter: %s: %u: %s", e.domain.to_string (), e.code, e.message);
+              }
+
+          yield store_peer.insert (seen_key, seen.to_bytes (), cancellable);
+        }
+
+      /* latest version of the page, or the raw value when it has no page head */
       public async GLib.Value? lookup_value (Kademlia.Key id, GLib.Cancellable? cancellable) throws GLib.Error
         {
-          return yield store_peer.lookup (id, cancellable);
+          GLib.Value? value;
+          PageHead? head;
+
+          if ((value = yield store_peer.lookup (id, cancellable)) == null)
+
+            return null;
+          else if ((head = head_of (id, value)) == null)
+
+            return (owned) value;
+          else if (head.latest == 0)
+
+            return null;
+          else
+            return yield lookup_version (id, head.latest, cancellable);
         }
     }
 }
@@ -23,6 +23,12 @@ namespace ScrapperD.Storage
 
   public sealed class Application : ScrapperD.Application
     {
+      private string? data_dir = null;
+
+      construct
+        {
+          add_main_option ("data-dir", 'd', 0, GLib.OptionArg.FILENAME, "Keep stored values on disk, under DIRECTORY", "DIRECTORY");
+        }
 
       public Application ()
         {
@@ -34,9 +40,25 @@ namespace ScrapperD.Storage
           return (new Application ()).run (argv);
         }
 
+      protected override async bool command_line_async (GLib.ApplicationCommandLine cmdline, GLib.Cancellable? cancellable = null)
+        {
+          unowned var options = cmdline.get_options_dict ();
+
+          options.lookup ("data-dir", "^ay", out data_dir);
+          return yield base.command_line_async (cmdline, cancellable);
+        }
+
       protected override async void register_peers () throws GLib.Error
         {
-          hub.add_local_peer ("storage", new Kademlia.DBus.PeerImpl (new Store ()));
+          Kademlia.ValueStore value_store;
+
+          if (data_dir == null)
+
+            value_store = new Store ();
+          else
+            value_store = new DiskStore (data_dir);
+
+          hub.add_local_peer ("storage", new Kademlia.DBus.PeerImpl (value_store));
         }
     } 
 }
@@ -0,0 +1,796 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using Kademlia;
+
+[CCode (cprefix = "ScrapperdStorage", lower_case_cprefix = "scrapperd_storage_")]
+
+namespace ScrapperD.Storage
+{
+  /*
+   * On disk (host byte order) a data directory holds:
+   *
+   *   values.log: LogHead, then { RecordHead, (sv) variant, zero padding }
+   *   values.idx: IndexHead, then IndexEntry [count] sorted by key
+   *
+   * Records start at 8-byte boundaries so variants can be used straight from
+   * the mapped log. Each log is given a random generation when created, and
+   * the index snapshots every live record below 'covered' of the log with
+   * its same generation; anything appended past that is replayed into
+   * 'recent' on startup, and the first torn or corrupt record marks the end
+   * of the log. An index not matching the log gets deleted, and the whole
+   * log replayed instead.
+   *
+   * Record checks leave in_time out, so refreshing it in place (in the index
+   * entry when the index covers the record, in its head otherwise) can not
+   * tear the record.
+   */
+
+  const uint KEYLEN = Key.BITLEN >> 3;
+  const string LOG_MAGIC = "SCRLOG02";
+  const string IDX_MAGIC = "SCRIDX02";
+
+  [CCode (has_type_id = false)]
+
+  struct LogHead
+    {
+      public uint8 magic [8];
+      public uint64 generation;
+    }
+
+  [CCode (has_type_id = false)]
+
+  struct RecordHead
+    {
+      public uint8 key [32];
+      public int64 in_time;
+      public uint32 size;
+      public uint32 check;
+    }
+
+  [CCode (has_type_id = false)]
+
+  struct IndexHead
+    {
+      public uint8 magic [8];
+      public uint64 generation;
+      public uint64 covered;
+      public uint64 count;
+    }
+
+  [CCode (has_type_id = false)]
+
+  struct IndexEntry
+    {
+      public uint8 key [32];
+      public int64 in_time;
+      public uint64 offset;
+      public uint64 size;
+    }
+
+  struct Location
+    {
+      public int64 in_time;
+      public uint64 offset;
+      public uint64 size;
+
+      public Location (uint64 offset, uint64 size, int64 in_time)
+        {
+          this.in_time = in_time;
+          this.offset = offset;
+          this.size = size;
+        }
+
+      public bool removed { get { return offset == 0; } }
+    }
+
+  public class DiskStore : GLib.Object, ValueStore
+    {
+      public const int64 VALUE_TIMESPAN = Store.VALUE_TIMESPAN;
+      public const uint64 COMPACT_THRESHOLD = 64 << 20;
+
+      public string directory { get; construct; }
+
+      private bool compacting = false;
+      private uint64 dead_bytes = 0;
+      private uint64 generation;
+      private GLib.MappedFile? index = null;
+      private GLib.FileIOStream? index_file = null;
+      private GLib.FileIOStream log;
+      private GLib.Bytes? mapped = null;
+      private uint64 log_size;
+      private GLib.HashTable<Key, Location?> recent;
+      private Deadlines republish;
+
+      private static GLib.VariantType serial_type;
+
+      private string idx_path { owned get { return GLib.Path.build_filename (directory, "values.idx"); } }
+      private string log_path { owned get { return GLib.Path.build_filename (directory, "values.log"); } }
+
+      static construct
+        {
+          serial_type = new GLib.VariantType ("(sv)");
+        }
+
+      construct
+        {
+          recent = new GLib.HashTable<Key, Location?> (Key.hash, Key.equal);
+          republish = new Deadlines ();
+        }
+
+      public DiskStore (string directory) throws GLib.Error
+        {
+          Object (directory : directory);
+
+          GLib.DirUtils.create_with_parents (directory, 0750);
+          recover ();
+        }
+
+      static uint32 checksum (uint32 hash, uint8* data, size_t size)
+        {
+          for (size_t i = 0; i < size; ++i) hash = (hash ^ data [i]) * 16777619;
+          return hash;
+        }
+
+      /* key, size and data, but not in_time */
+      static uint32 record_check (RecordHead* head, uint8* data)
+        {
+          var hash = checksum (2166136261, (uint8*) head, KEYLEN);
+          hash = checksum (hash, (uint8*) & head->size, sizeof (uint32));
+          return checksum (hash, data, head->size);
+        }
+
+      static uint64 record_size (uint32 size)
+        {
+          return sizeof (RecordHead) + ((size + 7) & ~7);
+        }
+
+      static unowned uint8[] view (void* data, size_t size)
+        {
+          unowned var ar = (uint8[]) data;
+                    ar.length = (int) size;
+            return ar;
+        }
+
+      static uint64 new_generation ()
+        {
+          return ((uint64) GLib.Random.next_int () << 32) | GLib.Random.next_int ();
+        }
+
+      static void write_log_head (GLib.OutputStream output, uint64 generation, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var head = LogHead ();
+          size_t wrote;
+
+          GLib.Memory.copy (head.magic, LOG_MAGIC.data, LOG_MAGIC.length);
+          head.generation = generation;
+          output.write_all (view (& head, sizeof (LogHead)), out wrote, cancellable);
+        }
+
+      /* flushes whatever got written to path down to the disk */
+      static void sync_file (string path) throws GLib.Error
+        {
+          int fd;
+
+          if ((fd = Sys.open (path, Sys.O_RDWR)) < 0 || Sys.fsync (fd) < 0)
+            {
+              var code = GLib.errno;
+
+              if (fd >= 0) Sys.close (fd);
+              throw new GLib.Error (GLib.IOError.quark (), GLib.IOError.from_errno (code), "%s: %s", path, GLib.strerror (code));
+            }
+
+          Sys.close (fd);
+        }
+
+      private void recover () throws GLib.Error
+        {
+          var file = GLib.File.new_for_path (log_path);
+
+          try { log = file.create_readwrite (GLib.FileCreateFlags.PRIVATE); } catch (GLib.IOError e)
+            {
+              if (e.code != GLib.IOError.EXISTS)
+
+                throw (owned) e;
+              else
+                log = file.open_readwrite ();
+            }
+
+          load_index ();
+
+          var covered = (uint64) sizeof (LogHead);
+          var size = (uint64) log.query_info (GLib.FileAttribute.STANDARD_SIZE).get_size ();
+
+          if (size < sizeof (LogHead))
+            {
+              log.truncate (0);
+              write_log_head (log.output_stream, generation = new_generation ());
+              size = covered;
+              drop_index ();
+            }
+          else
+            {
+              mapped = new GLib.MappedFile (log_path, false).get_bytes ();
+
+              unowned var log_head = (LogHead*) mapped.get_data ();
+
+              if (GLib.Memory.cmp (log_head->magic, LOG_MAGIC.data, LOG_MAGIC.length) != 0)
+
+                throw new GLib.IOError.INVALID_DATA ("%s: not a value log", log_path);
+
+              generation = log_head->generation;
+
+              if (index != null)
+                {
+                  unowned var head = (IndexHead*) index.get_contents ();
+
+                  if (head->generation != generation)
+                    {
+                      warning ("%s: index belongs to another log, ignoring it", idx_path);
+                      drop_index ();
+                    }
+                  else if (head->covered < covered || head->covered > size)
+                    {
+                      warning ("%s: index does not fit the log, ignoring it", idx_path);
+                      drop_index ();
+                    }
+                  else
+                    {
+                      covered = head->covered;
+                      index_file = GLib.File.new_for_path (idx_path).open_readwrite ();
+                    }
+                }
+
+              size = replay (mapped, covered, size, recent);
+            }
+
+          log.truncate ((int64) size);
+          log.seek ((int64) (log_size = size), GLib.SeekType.SET);
+          dead_bytes = log_size - sizeof (LogHead) - live_bytes ();
+
+          recent.foreach ((k, l) => { if (! l.removed) republish.schedule (k, l.in_time + VALUE_TIMESPAN); });
+
+          if (index != null)
+            {
+              unowned var head = (IndexHead*) index.get_contents ();
+              unowned var entries = (IndexEntry*) (head + 1);
+
+              for (uint64 i = 0; i < head->count; ++i)
+                {
+                  var key = new Key.verbatim (view (entries [i].key, KEYLEN));
+                  if (recent.contains (key) == false) republish.schedule (key, entries [i].in_time + VALUE_TIMESPAN);
+                }
+            }
+        }
+
+      private void load_index ()
+        {
+          try
+            {
+              var mapped_index = new GLib.MappedFile (idx_path, false);
+              var length = mapped_index.get_length ();
+              unowned var head = (IndexHead*) mapped_index.get_contents ();
+
+              if (length < sizeof (IndexHead) || GLib.Memory.cmp (head->magic, IDX_MAGIC.data, IDX_MAGIC.length) != 0)
+                {
+                  warning ("%s: not a value index, ignoring it", idx_path);
+                  drop_index ();
+                }
+              else if (length != sizeof (IndexHead) + head->count * sizeof (IndexEntry))
+                {
+                  warning ("%s: truncated index, ignoring it", idx_path);
+                  drop_index ();
+                }
+              else
+                index = mapped_index;
+            }
+          catch (GLib.FileError e)
+            {
+              if (e.code != GLib.FileError.NOENT)
+
+                warning ("%s: %s: %u: %s", idx_path, e.domain.to_string (), e.code, e.message);
+            }
+        }
+
+      /* forgets the index and deletes it, so a later restart does not pick it up again */
+      private void drop_index ()
+        {
+          index = null;
+          index_file = null;
+          GLib.FileUtils.unlink (idx_path);
+        }
+
+      /*
+       * Replays records in [from, to) into table, returning where the last
+       * sound record ends.
+       */
+
+      static uint64 replay (GLib.Bytes mapped, uint64 from, uint64 to, GLib.HashTable<Key, Location?> table)
+        {
+          unowned var data = (uint8*) mapped.get_data ();
+
+          while (from + sizeof (RecordHead) <= to)
+            {
+              var head = (RecordHead*) (data + from);
+              var size = record_size (head->size);
+
+              if (from + size > to || head->check != record_check (head, data + from + sizeof (RecordHead)))
+                {
+                  warning ("torn record at %" + uint64.FORMAT + ", dropping log tail", from);
+                  break;
+                }
+
+              table.insert (new Key.verbatim (view (head->key, KEYLEN)), Location (head->size == 0 ? 0 : from, size, head->in_time));
+              from += size;
+            }
+          return from;
+        }
+
+      private uint64 live_bytes ()
+        {
+          uint64 live = 0;
+
+          recent.foreach ((k, l) => live += l.removed ? 0 : l.size);
+
+          if (index != null)
+            {
+              unowned var head = (IndexHead*) index.get_contents ();
+              unowned var entries = (IndexEntry*) (head + 1);
+
+              for (uint64 i = 0; i < head->count; ++i)
+                {
+                  if (recent.contains (new Key.verbatim (view (entries [i].key, KEYLEN))) == false)
+
+                    live += entries [i].size;
+                }
+            }
+          return live;
+        }
+
+      private bool index_position (Key id, out uint64 position)
+        {
+          position = 0;
+          if (index == null) return false;
+
+          unowned var head = (IndexHead*) index.get_contents ();
+          unowned var entries = (IndexEntry*) (head + 1);
+          uint64 left = 0, right = head->count;
+
+          while (left < right)
+            {
+              var middle = left + (right - left) / 2;
+              var cmp = GLib.Memory.cmp (entries [middle].key, id.bytes, KEYLEN);
+
+              if (cmp < 0) left = middle + 1;
+              else if (cmp > 0) right = middle;
+              else
+                {
+                  position = middle;
+                  return true;
+                }
+            }
+          return false;
+        }
+
+      private bool index_find (Key id, out Location location)
+        {
+          uint64 at;
+
+          if (index_position (id, out at) == false)
+            {
+              location = Location (0, 0, 0);
+              return false;
+            }
+          else
+            {
+              unowned var entries = (IndexEntry*) ((IndexHead*) index.get_contents () + 1);
+              location = Location (entries [at].offset, entries [at].size, entries [at].in_time);
+              return true;
+            }
+        }
+
+      /*
+       * Rewrites the in_time of the record at location where startup reads it
+       * back: its index entry when the index covers it, its head otherwise
+       * (both keep in_time right after the key)
+       */
+
+      private void persist_in_time (Key id, Location location) throws GLib.Error
+        {
+          uint64 at;
+          size_t wrote;
+          var in_time = location.in_time;
+
+          if (index != null && location.offset < ((IndexHead*) index.get_contents ())->covered)
+            {
+              if (index_position (id, out at))
+                {
+                  index_file.seek ((int64) (sizeof (IndexHead) + at * sizeof (IndexEntry) + KEYLEN), GLib.SeekType.SET);
+                  index_file.output_stream.write_all (view (& in_time, sizeof (int64)), out wrote);
+                }
+            }
+          else
+            {
+              log.seek ((int64) (location.offset + KEYLEN), GLib.SeekType.SET);
+              log.output_stream.write_all (view (& in_time, sizeof (int64)), out wrote);
+              log.seek ((int64) log_size, GLib.SeekType.SET);
+            }
+        }
+
+      private bool locate (Key id, out Location location)
+        {
+          unowned Location? found;
+
+          if ((found = recent.lookup (id)) == null)
+
+            return index_find (id, out location);
+          else
+            {
+              location = found;
+              return found.removed == false;
+            }
+        }
+
+      private unowned GLib.Bytes ensure_mapped (uint64 end) throws GLib.Error
+        {
+          if (mapped == null || mapped.get_size () < end)
+
+            mapped = new GLib.MappedFile (log_path, false).get_bytes ();
+          return mapped;
+        }
+
+      private void append (Key id, GLib.Bytes? data, int64 in_time) throws GLib.Error
+        {
+          Location location;
+          var head = RecordHead ();
+          var offset = log_size;
+          var size = data == null ? 0 : data.get_size ();
+          size_t wrote;
+
+          GLib.Memory.copy (head.key, id.bytes, KEYLEN);
+          head.in_time = in_time;
+          head.size = (uint32) size;
+          head.check = record_check (& head, data == null ? null : (uint8*) data.get_data ());
+
+          if (locate (id, out location)) dead_bytes += location.size;
+
+          log.output_stream.write_all (view (& head, sizeof (RecordHead)), out wrote);
+
+          if (data != null)
+            {
+              uint8 padding [8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+              log.output_stream.write_all (data.get_data (), out wrote);
+              log.output_stream.write_all (view (padding, (size_t) (record_size (head.size) - sizeof (RecordHead) - size)), out wrote);
+            }
+
+          log_size += record_size (head.size);
+          recent.insert (id.copy (), Location (data == null ? 0 : offset, record_size (head.size), in_time));
+
+          if (data == null)
+            republish.cancel (id);
+          else
+            republish.schedule (id, in_time + VALUE_TIMESPAN);
+
+          if (data == null) dead_bytes += record_size (0);
+        }
+
+      private void insert_unlocked (Key id, GLib.Bytes? data) throws GLib.Error
+        {
+          Location location;
+          var now = GLib.get_real_time ();
+
+          if (data != null && locate (id, out location) && location.size == record_size ((uint32) data.get_size ()))
+            {
+              unowned var bytes = ensure_mapped (location.offset + location.size);
+              unowned var stored = (uint8*) bytes.get_data () + location.offset + sizeof (RecordHead);
+
+              if (((RecordHead*) ((uint8*) bytes.get_data () + location.offset))->size == data.get_size ()
+                && GLib.Memory.cmp (stored, data.get_data (), data.get_size ()) == 0)
+                {
+                  location.in_time = now;
+                  persist_in_time (id, location);
+                  recent.insert (id.copy (), location);
+                  republish.schedule (id, now + VALUE_TIMESPAN);
+                  return;
+                }
+            }
+
+          append (id, data, now);
+        }
+
+      private GLib.Value? lookup_unlocked (Key id) throws GLib.Error
+        {
+          Location location;
+
+          if (locate (id, out location) == false)
+
+            return null;
+          else
+            {
+              var bytes = new GLib.Bytes.from_bytes (ensure_mapped (location.offset + location.size), (size_t) location.offset, location.size);
+              unowned var head = (RecordHead*) bytes.get_data ();
+              var data = new GLib.Bytes.from_bytes (bytes, sizeof (RecordHead), head->size);
+              return GValr.net2nat (new GLib.Variant.from_bytes (serial_type, data, false));
+            }
+        }
+
+      private static GLib.Bytes? serialize (GLib.Value? value)
+        {
+          return value == null ? null : GValr.nat2net (value).get_data_as_bytes ();
+        }
+
+      public async Key[] enumerate_staled_values (GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          Key? key;
+          var array = new GenericArray<Key> ();
+          var now = GLib.get_real_time ();
+
+          lock (recent)
+            {
+              while ((key = republish.pop (now)) != null)
+                {
+                  republish.schedule (key, now + VALUE_TIMESPAN);
+                  array.add ((owned) key);
+                }
+            }
+          return array.steal ();
+        }
+
+      public async bool insert_value (Key id, GLib.Value? value, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          var data = serialize (value);
+          lock (recent) insert_unlocked (id, data);
+          maybe_compact ();
+          return true;
+        }
+
+      public async bool insert_values (Key[] ids, GLib.Value?[] values, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          var datas = new GLib.Bytes? [values.length];
+
+          for (int i = 0; i < ids.length; ++i) datas [i] = serialize (values [i]);
+
+          lock (recent)
+            {
+              for (int i = 0; i < ids.length; ++i) insert_unlocked (ids [i], datas [i]);
+            }
+
+          maybe_compact ();
+          return true;
+        }
+
+      public async GLib.Value? lookup_value (Key id, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          lock (recent)
+            {
+              return lookup_unlocked (id);
+            }
+        }
+
+      public async GLib.Value?[] lookup_values (Key[] ids, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          var found = new GLib.Value? [ids.length];
+
+          lock (recent)
+            {
+              for (int i = 0; i < ids.length; ++i) found [i] = lookup_unlocked (ids [i]);
+            }
+          return (owned) found;
+        }
+
+      /*
+       * Inserts come from handler threads which need not run any main loop,
+       * so the compaction they set off neither reports back to one nor waits
+       * on one to be marked done
+       */
+
+      private void maybe_compact ()
+        {
+          lock (recent)
+            {
+              if (compacting || dead_bytes < COMPACT_THRESHOLD || dead_bytes < log_size / 2)
+
+                return;
+
+              compacting = true;
+            }
+
+          new GLib.Thread<void> ("compaction", () =>
+            {
+              GLib.Error? error;
+
+              if ((error = compact_thread (null)) != null)
+
+                warning ("compaction failed: %s: %u: %s", error.domain.to_string (), error.code, error.message);
+            });
+        }
+
+      /*
+       * Rewrites the live records into a fresh log and index on a worker
+       * thread. Only the snapshot and the final swap (which also carries over
+       * whatever got appended meanwhile) happen under the lock.
+       */
+
+      public async void compact (GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          GLib.Error? error = null;
+          var context = GLib.MainContext.ref_thread_default ();
+
+          lock (recent)
+            {
+              if (compacting) return;
+              compacting = true;
+            }
+
+          new GLib.Thread<void> ("compaction", () =>
+            {
+              error = compact_thread (cancellable);
+
+              var source = new GLib.IdleSource ();
+              source.set_callback (compact.callback);
+              source.attach (context);
+            });
+
+          yield;
+
+          if (unlikely (error != null)) throw (owned) error;
+        }
+
+      /* runs a compaction the caller marked as started, and marks it done */
+      private GLib.Error? compact_thread (GLib.Cancellable? cancellable)
+        {
+          GLib.Error? error = null;
+
+          try { compact_sync (cancellable); } catch (GLib.Error e) { error = (owned) e; }
+
+          lock (recent) compacting = false;
+          return (owned) error;
+        }
+
+      private void compact_sync (GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          GLib.Bytes source;
+          IndexEntry[] entries;
+          size_t wrote;
+          uint64 covered;
+
+          lock (recent)
+            {
+              source = ensure_mapped (log_size);
+              covered = log_size;
+              entries = snapshot ();
+            }
+
+          var log_tmp = log_path + ".compact";
+          var idx_tmp = idx_path + ".compact";
+          var generation = new_generation ();
+          var output = GLib.File.new_for_path (log_tmp).replace (null, false, GLib.FileCreateFlags.PRIVATE, cancellable);
+          var offset = (uint64) sizeof (LogHead);
+
+          write_log_head (output, generation, cancellable);
+
+          for (int i = 0; i < entries.length; ++i)
+            {
+              unowned var data = (uint8*) source.get_data () + entries [i].offset;
+
+              output.write_all (view (data, (size_t) entries [i].size), out wrote, cancellable);
+              entries [i].offset = offset;
+              offset += entries [i].size;
+            }
+
+          /* what the index covers must be on disk before the index itself is */
+          sync_file (log_tmp);
+
+          var head = IndexHead ();
+          var index_output = GLib.File.new_for_path (idx_tmp).replace (null, false, GLib.FileCreateFlags.PRIVATE, cancellable);
+
+          GLib.Memory.copy (head.magic, IDX_MAGIC.data, IDX_MAGIC.length);
+          head.count = entries.length;
+          head.covered = offset;
+          head.generation = generation;
+
+          index_output.write_all (view (& head, sizeof (IndexHead)), out wrote, cancellable);
+          index_output.write_all (view (entries, entries.length * sizeof (IndexEntry)), out wrote, cancellable);
+          index_output.close (cancellable);
+          sync_file (idx_tmp);
+
+          lock (recent)
+            {
+              var tail = new GLib.HashTable<Key, Location?> (Key.hash, Key.equal);
+              var current = ensure_mapped (log_size);
+
+              if (log_size > covered)
+                {
+                  output.write_all (view ((uint8*) current.get_data () + covered, (size_t) (log_size - covered)), out wrote, cancellable);
+                  replay (current, covered, log_size, tail);
+                }
+
+              output.close (cancellable);
+
+              /* a crash in between leaves no index, or one whose generation does not match, and the log gets fully replayed */
+              GLib.FileUtils.unlink (idx_path);
+              GLib.FileUtils.rename (log_tmp, log_path);
+              GLib.FileUtils.rename (idx_tmp, idx_path);
+
+              var old = (owned) recent;
+
+              recent = new GLib.HashTable<Key, Location?> (Key.hash, Key.equal);
+              tail.foreach ((k, l) => recent.insert (k.copy (), Location (l.removed ? 0 : l.offset - covered + offset, l.size, l.in_time)));
+
+              this.generation = generation;
+              index = new GLib.MappedFile (idx_path, false);
+              index_file = GLib.File.new_for_path (idx_path).open_readwrite (cancellable);
+              log = GLib.File.new_for_path (log_path).open_readwrite (cancellable);
+              log.seek ((int64) (log_size = offset + (log_size - covered)), GLib.SeekType.SET);
+              mapped = null;
+
+              /* in_time refreshes made while compacting, which went to the old files */
+              old.foreach ((k, l) =>
+                {
+                  Location now;
+                  if (l.removed == false && locate (k, out now) && now.in_time < l.in_time)
+                    {
+                      now.in_time = l.in_time;
+                      recent.insert (k.copy (), now);
+
+                      try { persist_in_time (k, now); } catch (GLib.Error e)
+                        {
+                          warning ("can not persist in_time: %s: %u: %s", e.domain.to_string (), e.code, e.message);
+                        }
+                    }
+                });
+
+              dead_bytes = log_size - sizeof (LogHead) - live_bytes ();
+            }
+        }
+
+      private IndexEntry[] snapshot ()
+        {
+          var entries = new GLib.Array<IndexEntry> (false, false, (uint) sizeof (IndexEntry));
+
+          if (index != null)
+            {
+              unowned var head = (IndexHead*) index.get_contents ();
+              unowned var items = (IndexEntry*) (head + 1);
+
+              for (uint64 i = 0; i < head->count; ++i)
+                {
+                  if (recent.contains (new Key.verbatim (view (items [i].key, KEYLEN))) == false)
+
+                    entries.append_val (items [i]);
+                }
+            }
+
+          recent.foreach ((k, l) =>
+            {
+              if (l.removed == false)
+                {
+                  var entry = IndexEntry ();
+
+                  GLib.Memory.copy (entry.key, k.bytes, KEYLEN);
+                  entry.in_time = l.in_time;
+                  entry.offset = l.offset;
+                  entry.size = l.size;
+                  entries.append_val (entry);
+                }
+            });
+
+          entries.sort ((a, b) => GLib.Memory.cmp (a.key, b.key, KEYLEN));
+          return entries.steal ();
+        }
+    }
+}
@@ -20,41 +20,128 @@ using Kademlia;
 
 namespace ScrapperD.Storage
 {
-  struct Entry
+  /* never changed once stored, so readers may hold a reference past their shard's lock */
+  class Entry
     {
       public int64 in_time;
+      public int64 size;
       public GLib.Value value;
 
       public Entry (owned GLib.Value value)
         {
           this.in_time = GLib.get_monotonic_time ();
+          this.size = measure (value);
           this.value = value;
         }
+
+      /* payload bytes a value holds, as far as it can be told without serializing it */
+      static int64 measure (GLib.Value value)
+        {
+          if (value.holds (typeof (GLib.Variant)))
+
+            return (int64) ((GLib.Variant) value.get_variant ()).get_size ();
+          else if (value.holds (typeof (GLib.Bytes)))
+
+            return (int64) ((GLib.Bytes) value.get_boxed ()).get_size ();
+          else if (value.holds (typeof (string)))
+
+            return (int64) (value.get_string () ?? "").length;
+          else
+            return 0;
+        }
     }
 
+  [Compact (opaque = true)]
+
+  class Shard
+    {
+      public Deadlines republish;
+      public GLib.RWLock rwlock;
+      public GLib.HashTable<Key, Entry> values;
+
+      public Shard ()
+        {
+          republish = new Deadlines ();
+          rwlock = GLib.RWLock ();
+          values = new GLib.HashTable<Key, Entry> (Key.hash, Key.equal);
+        }
+    }
+
+  /*
+   * Keys are spread over SHARDS tables by their leading bits, each behind its
+   * own reader-writer lock, so handlers running on different incoming
+   * connections only contend when they hit the same shard for writing.
+   * Lookups only take a reference on the entry under the lock and hand out a
+   * GValue copy of it afterwards, which for page variants and bytes is itself
+   * just a reference.
+   */
+
   public class Store : GLib.Object, ValueStore
     {
       public const int64 VALUE_TIMESPAN = 3 * Buckets.USEC_PER_SEC;
-      private GLib.HashTable<Key, Entry?> values;
+      public const uint SHARD_BITS = 6;
+      public const uint SHARDS = 1 << SHARD_BITS;
+
+      [CCode (array_length_cexpr = "SCRAPPERD_STORAGE_STORE_SHARDS")]
+      private Shard shards [SHARDS];
+      private unowned Metrics.Gauge stored_bytes;
+      private unowned Metrics.Gauge stored_keys;
 
       construct
         {
-          values = new HashTable<Key, Entry?> (Key.hash, Key.equal);
+          var registry = Metrics.Registry.get_default ();
+
+          for (uint i = 0; i < SHARDS; ++i) shards [i] = new Shard ();
+
+          stored_bytes = registry.gauge ("scrapperd_store_bytes", "payload bytes held by in-memory stores");
+          stored_keys = registry.gauge ("scrapperd_store_keys", "values held by in-memory stores");
         }
 
-      public override async Kademlia.Key[] enumerate_staled_values (GLib.Cancellable? cancellable) throws GLib.Error
+      ~Store ()
+        {
+          foreach (unowned var shard in shards)
+          foreach (unowned var entry in shard.values.get_values ())
+            {
+              stored_bytes.add (- entry.size);
+              stored_keys.add (-1);
+            }
+        }
+
+      /* drops id from shard (which must be write locked), keeping store gauges in step */
+      private void forget (Shard shard, Kademlia.Key id)
         {
-          unowned Key key;
           unowned Entry? entry;
+
+          if ((entry = shard.values.lookup (id)) != null)
+            {
+              stored_bytes.add (- entry.size);
+              stored_keys.add (-1);
+              shard.values.remove (id);
+            }
+        }
+
+      private unowned Shard shard_for (Key key)
+        {
+          return shards [key.bytes [0] >> (8 - SHARD_BITS)];
+        }
+
+      public override async Kademlia.Key[] enumerate_staled_values (GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          Key? key;
           var array = new GenericArray<Key> ();
-          var iter = HashTableIter<Key, Entry?> (values);
           var now = (int64) GLib.get_monotonic_time ();
 
-          while (iter.next (out key, out entry))
+          foreach (unowned var shard in shards)
             {
-              if (now - entry.in_time > VALUE_TIMESPAN)
+              shard.rwlock.writer_lock ();
 
-                array.add (key.copy ());
+              while ((key = shard.republish.pop (now)) != null)
+                {
+                  shard.republish.schedule (key, now + VALUE_TIMESPAN);
+                  array.add ((owned) key);
+                }
+
+              shard.rwlock.writer_unlock ();
             }
           return array.steal ();
         }
@@ -62,38 +149,81 @@ namespace ScrapperD.Storage
       public async bool insert_value (Kademlia.Key id, GLib.Value? value, GLib.Cancellable? cancellable) throws GLib.Error
         {
           debug ("insert value %s", id.to_string ());
+          insert_value_sharded (id, value);
+          return true;
+        }
 
-          lock (values)
+      public async bool insert_values (Kademlia.Key[] ids, GLib.Value?[] values, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          debug ("insert %i values", ids.length);
 
-            if (value == null)
+          for (int i = 0; i < ids.length; ++i) insert_value_sharded (ids [i], values [i]);
+          return true;
+        }
 
-              values.remove (id);
-            else
-              {
-                var copy = GLib.Value (value.type ());
+      private void insert_value_sharded (Kademlia.Key id, GLib.Value? value)
+        {
+          unowned var shard = shard_for (id);
 
-                value.copy (ref copy);
-                values.insert (id.copy (), Entry ((owned) copy));
-              }
-          return true;
+          if (value == null)
+            {
+              shard.rwlock.writer_lock ();
+              forget (shard, id);
+              shard.republish.cancel (id);
+              shard.rwlock.writer_unlock ();
+            }
+          else
+            {
+              var copy = GLib.Value (value.type ());
+              var key = id.copy ();
+
+              value.copy (ref copy);
+
+              var entry = new Entry ((owned) copy);
+
+              shard.rwlock.writer_lock ();
+              forget (shard, id);
+              stored_bytes.add (entry.size);
+              stored_keys.add (1);
+              shard.republish.schedule (key, entry.in_time + VALUE_TIMESPAN);
+              shard.values.insert ((owned) key, (owned) entry);
+              shard.rwlock.writer_unlock ();
+            }
         }
 
       public async GLib.Value? lookup_value (Kademlia.Key id, GLib.Cancellable? cancellable) throws GLib.Error
         {
           debug ("lookup value %s", id.to_string ());
-          unowned GLib.Value? value;
+          return lookup_value_sharded (id);
+        }
+
+      public async GLib.Value?[] lookup_values (Kademlia.Key[] ids, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          debug ("lookup %i values", ids.length);
+          var found = new GLib.Value? [ids.length];
+
+          for (int i = 0; i < ids.length; ++i) found [i] = lookup_value_sharded (ids [i]);
+          return (owned) found;
+        }
 
-          lock (values)
+      private GLib.Value? lookup_value_sharded (Kademlia.Key id)
+        {
+          Entry? entry;
+          unowned var shard = shard_for (id);
 
-            if ((value = values.lookup (id).value) == null)
+          shard.rwlock.reader_lock ();
+          entry = shard.values.lookup (id);
+          shard.rwlock.reader_unlock ();
 
-              return null;
-            else
-              {
-                var copy = GLib.Value (value.type ());
-                  value.copy (ref copy);
-                return (owned) copy;
-              }
+          if (entry == null)
+
+            return null;
+          else
+            {
+              var copy = GLib.Value (entry.value.type ());
+              entry.value.copy (ref copy);
+              return (owned) copy;
+            }
         }
     }
 }
@@ -0,0 +1,117 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+namespace Testing
+{
+  /*
+   * Every benchmark reports through bench_result (or bench_samples, from
+   * the main thread only), which goes into the regular GTest perf output
+   * and also gets collected; once the suite ran, bench_run appends it all
+   * as one JSON line to the file named by BENCH_JSON (if any), so results
+   * can be tracked across commits:
+   *
+   *   { "suite" : ..., "commit" : ..., "time" : ..., "results" : [
+   *       { "name" : ..., "value" : ..., "unit" : ..., "better" : "higher" | "lower" }, ... ] }
+   */
+
+  static Json.Array? bench_results = null;
+
+  public static void bench_result (string name, double value, string unit, bool higher_is_better = true)
+    {
+      var result = new Json.Object ();
+
+      if (higher_is_better)
+
+        GLib.Test.maximized_result (value, "%s (%s)", name, unit);
+      else
+        GLib.Test.minimized_result (value, "%s (%s)", name, unit);
+
+      result.set_string_member ("name", name);
+      result.set_double_member ("value", value);
+      result.set_string_member ("unit", unit);
+      result.set_string_member ("better", higher_is_better ? "higher" : "lower");
+
+      if (bench_results == null) bench_results = new Json.Array ();
+      bench_results.add_object_element ((owned) result);
+    }
+
+  /* latency distribution of a set of samples (seconds each), as mean and percentiles */
+  public static void bench_samples (string name, double[] samples, string unit = "s")
+    {
+      var sorted = samples.copy ();
+      var sum = (double) 0;
+
+      if (sorted.length == 0)
+
+        return;
+
+      GLib.qsort_with_data<double?> ((double?[]) sorted, sizeof (double), (a, b) => a < b ? -1 : (a > b ? 1 : 0));
+
+      foreach (unowned var sample in sorted) sum += sample;
+
+      GLib.Test.message ("%s: mean %06f, p50 %06f, p90 %06f, p99 %06f, max %06f", name, sum / sorted.length,
+        percentile (sorted, 50), percentile (sorted, 90), percentile (sorted, 99), sorted [sorted.length - 1]);
+
+      bench_result (@"$name mean", sum / sorted.length, unit, false);
+      bench_result (@"$name p50", percentile (sorted, 50), unit, false);
+      bench_result (@"$name p90", percentile (sorted, 90), unit, false);
+      bench_result (@"$name p99", percentile (sorted, 99), unit, false);
+    }
+
+  public static int bench_run ()
+    {
+      var code = GLib.Test.run ();
+      unowned string? path;
+
+      if ((path = GLib.Environment.get_variable ("BENCH_JSON")) != null && bench_results != null)
+        {
+          var generator = new Json.Generator ();
+          var root = new Json.Object ();
+
+          root.set_string_member ("suite", GLib.Path.get_basename (GLib.Environment.get_prgname ()));
+          root.set_string_member ("time", new GLib.DateTime.now_utc ().format_iso8601 ());
+
+          if (BENCH_COMMIT != "")
+
+            root.set_string_member ("commit", BENCH_COMMIT);
+
+          root.set_array_member ("results", bench_results);
+          generator.root = new Json.Node.alloc ().init_object (root);
+
+          try
+            {
+              var file = GLib.File.new_for_path (path);
+              var stream = file.append_to (GLib.FileCreateFlags.NONE);
+
+              stream.write_all ((generator.to_data (null) + "\n").data, null);
+              stream.close ();
+            }
+          catch (GLib.Error e)
+            {
+              warning ("can not write '%s': %s: %u: %s", path, e.domain.to_string (), e.code, e.message);
+            }
+        }
+
+      return code;
+    }
+
+  static double percentile (double[] sorted, uint nth)
+    {
+      var at = (int) ((sorted.length - 1) * nth / 100);
+      return sorted [at];
+    }
+}
@@ -25,6 +25,7 @@ namespace Testing
       GLib.Test.add_func (TESTPATHROOT + "/Buckets/insert", () => test_insert (new Key.random (), new Key.random ()));
       GLib.Test.add_func (TESTPATHROOT + "/Buckets/nearest", () => test_nearest (new Key.random (), new Key.random (), new Key.random ()));
       GLib.Test.add_func (TESTPATHROOT + "/Buckets/nearest2", () => test_nearest2 (new Key.random (), 10000));
+      GLib.Test.add_func (TESTPATHROOT + "/Buckets/nearest_span", () => test_nearest_span (new Key.random (), 1000));
       GLib.Test.add_func (TESTPATHROOT + "/Buckets/new", () => test_new (new Key.random ()));
       return GLib.Test.run ();
     }
@@ -158,4 +159,25 @@ namespace Testing
 
       GLib.Test.message ("self: %s", buckets.self.to_string ());
     }
+
+  static void test_nearest_span (Key self, uint keycount)
+    {
+      var buckets = new Buckets (self.copy ());
+      var target = new Key.random ();
+
+      for (uint i = 0; i < keycount; ++i) buckets.insert (new Key.random ());
+
+      var list = buckets.nearest (target);
+      var span = new KeyVal [Buckets.MAXSPAN];
+      var got = buckets.nearest_span (target, span);
+
+      assert_cmpuint (got, CompareOperator.EQ, list.length ());
+
+      for (uint i = 0; i < got; ++i) assert_true (list.nth_data (i).equal_val (span [i]));
+
+      var short_span = new KeyVal [3];
+
+      assert_cmpuint (buckets.nearest_span (target, short_span), CompareOperator.EQ, 3);
+      for (uint i = 0; i < 3; ++i) assert_true (list.nth_data (i).equal_val (short_span [i]));
+    }
 }
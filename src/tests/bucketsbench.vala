@@ -0,0 +1,171 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using Kademlia;
+
+namespace Testing
+{
+  public static int main (string[] args)
+    {
+      GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/Buckets/bench/1000", () => bench_buckets (1000));
+      GLib.Test.add_func (TESTPATHROOT + "/Buckets/bench/10000", () => bench_buckets (10000));
+      GLib.Test.add_func (TESTPATHROOT + "/Buckets/bench/100000", () => bench_buckets (100000));
+      return bench_run ();
+    }
+
+  /*
+   * Routing table layout as it was before buckets got indexed (sorted list of
+   * buckets, each one a list of keys), kept here as the reference point.
+   */
+
+  [Compact] class ListBucket
+    {
+      public int index;
+      public GLib.Queue<Key> nodes = new GLib.Queue<Key> ();
+      public GLib.Queue<Key> replacements = new GLib.Queue<Key> ();
+
+      public ListBucket (int index)
+        {
+          this.index = index;
+        }
+    }
+
+  class ListBuckets
+    {
+      private GLib.List<ListBucket> buckets = new GLib.List<ListBucket> ();
+      private Key self;
+
+      public ListBuckets (Key self)
+        {
+          this.self = self.copy ();
+        }
+
+      static int compare_key (Key a, Key b) { return Key.equal (a, b) ? 0 : 1; }
+
+      static bool bring_front (GLib.Queue<Key> queue, Key key)
+        {
+          unowned GLib.List<Key>? link;
+
+          if ((link = queue.find_custom (key, compare_key)) == null)
+
+            return false;
+          else
+            {
+              queue.unlink (link);
+              queue.push_head_link (link);
+            }
+          return true;
+        }
+
+      public bool insert (Key key)
+        {
+          unowned var bucket = search_index (Key.distance (self, key), true);
+
+          if (bring_front (bucket.replacements, key) || bring_front (bucket.nodes, key))
+
+            return false;
+          else if (bucket.nodes.length >= Buckets.MAXSPAN)
+            {
+              bucket.replacements.push_head (key.copy ());
+              return false;
+            }
+          else
+            {
+              bucket.nodes.push_head (key.copy ());
+              return true;
+            }
+        }
+
+      public GLib.SList<Key> nearest (Key key)
+        {
+          var got = 0;
+          var result = new GLib.SList<Key> ();
+          var d = Key.distance (self, key);
+          unowned ListBucket? pivt;
+
+          for (int i = d < 0 ? 0 : d, j = i + 1; got < Buckets.MAXSPAN && (i >= 0 || j < Key.BITLEN); --i, ++j)
+            {
+              if (i >= 0 && (pivt = search_index (i, false)) != null)
+              for (unowned var head = pivt.nodes.head; head != null && got < Buckets.MAXSPAN; head = head.next, ++got)
+                {
+                  result.prepend (head.data.copy ());
+                }
+
+              if (j < Key.BITLEN && (pivt = search_index (j, false)) != null)
+              for (unowned var head = pivt.nodes.head; head != null && got < Buckets.MAXSPAN; head = head.next, ++got)
+                {
+                  result.prepend (head.data.copy ());
+                }
+            }
+
+          result.reverse ();
+          return result;
+        }
+
+      private unowned ListBucket? search_index (int index, bool create)
+        {
+          foreach (unowned var bucket in buckets) if (bucket.index == index) return bucket;
+          if (create == false) return null;
+
+          buckets.insert_sorted (new ListBucket (index), (a, b) => b.index - a.index);
+          return search_index (index, false);
+        }
+    }
+
+  static void bench_buckets (uint keycount, uint lookups = 1000)
+    {
+      var self = new Key.random ();
+      var keys = new Key [keycount];
+      var targets = new Key [lookups];
+      var timer = new GLib.Timer ();
+
+      for (uint i = 0; i < keycount; ++i) keys [i] = new Key.random ();
+      for (uint i = 0; i < lookups; ++i) targets [i] = new Key.random ();
+
+      var indexed = new Buckets (self.copy ());
+      var listed = new ListBuckets (self);
+
+      timer.start ();
+      foreach (unowned var key in keys) indexed.insert (key);
+      var indexed_insert = timer.elapsed ();
+
+      timer.start ();
+      foreach (unowned var key in keys) listed.insert (key);
+      var listed_insert = timer.elapsed ();
+
+      timer.start ();
+      foreach (unowned var key in targets) indexed.nearest (key);
+      var indexed_nearest = timer.elapsed ();
+
+      timer.start ();
+      foreach (unowned var key in targets) listed.nearest (key);
+      var listed_nearest = timer.elapsed ();
+
+      timer.start ();
+      foreach (unowned var key in keys) indexed.drop (key);
+      var indexed_drop = timer.elapsed ();
+
+      GLib.Test.message ("contacts: %u, lookups: %u", keycount, lookups);
+      GLib.Test.message ("insert: indexed %04fus, listed %04fus", 1e6 * indexed_insert / keycount, 1e6 * listed_insert / keycount);
+      GLib.Test.message ("nearest: indexed %04fus, listed %04fus", 1e6 * indexed_nearest / lookups, 1e6 * listed_nearest / lookups);
+      GLib.Test.message ("drop: indexed %04fus", 1e6 * indexed_drop / keycount);
+
+      bench_result (@"Buckets.insert $keycount contacts", indexed_insert / keycount, "s", false);
+      bench_result (@"Buckets.nearest $keycount contacts", indexed_nearest / lookups, "s", false);
+      bench_result (@"Buckets.drop $keycount contacts", indexed_drop / keycount, "s", false);
+    }
+}
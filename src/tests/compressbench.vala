@@ -0,0 +1,134 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using ScrapperD.Scrapper;
+
+namespace Testing
+{
+  public static int main (string[] args)
+    {
+      GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/Compressor/bench/zlib-6", () => bench_codec ("zlib", 6, false));
+      GLib.Test.add_func (TESTPATHROOT + "/Compressor/bench/zlib-9", () => bench_codec ("zlib", 9, false));
+      GLib.Test.add_func (TESTPATHROOT + "/Compressor/bench/zstd-3", () => bench_codec ("zstd", 3, false));
+      GLib.Test.add_func (TESTPATHROOT + "/Compressor/bench/zstd-3-dictionary", () => bench_codec ("zstd", 3, true));
+      GLib.Test.add_func (TESTPATHROOT + "/Compressor/bench/zstd-19", () => bench_codec ("zstd", 19, false));
+      return bench_run ();
+    }
+
+  static GLib.Bytes[]? corpus = null;
+
+  /*
+   * Pages are read from the directory named by SCRAPPERD_BENCH_CORPUS (saved
+   * pages, one per file), or synthesized when it is not set.
+   */
+
+  static unowned GLib.Bytes[] load_corpus ()
+    {
+      if (corpus != null) return corpus;
+
+      unowned string? path;
+      var pages = new GLib.GenericArray<GLib.Bytes> ();
+
+      if ((path = GLib.Environment.get_variable ("SCRAPPERD_BENCH_CORPUS")) != null)
+        {
+          try
+            {
+              var dir = GLib.Dir.open (path);
+              unowned string? name;
+
+              while ((name = dir.read_name ()) != null)
+                {
+                  uint8[] contents;
+                  GLib.FileUtils.get_data (GLib.Path.build_filename (path, name), out contents);
+                  pages.add (new GLib.Bytes.take ((owned) contents));
+                }
+            }
+          catch (GLib.Error e)
+            {
+              assert_no_error (e);
+            }
+        }
+      else for (uint i = 0; i < 64; ++i)
+        {
+          var builder = new GLib.StringBuilder.sized (1 << 17);
+
+          builder.append ("<!DOCTYPE html><html><head><title>page</title><link rel=\"stylesheet\" href=\"/style.css\"></head><body>\n");
+          builder.append ("<nav><ul><li><a href=\"/\">home</a></li><li><a href=\"/about\">about</a></li><li><a href=\"/contact\">contact</a></li></ul></nav>\n");
+
+          while (builder.len < (1 << 17))
+            {
+              switch (GLib.Random.int_range (0, 4))
+                {
+                  case 0: builder.append_printf ("<p class=\"text\">lorem ipsum %u dolor sit amet %u</p>\n", GLib.Random.next_int (), GLib.Random.next_int ()); break;
+                  case 1: builder.append_printf ("<a href=\"/page/%u\" title=\"link\">link</a>\n", GLib.Random.next_int ()); break;
+                  case 2: builder.append_printf ("<img src=\"/img/%u.png\" alt=\"image\"/>\n", GLib.Random.next_int ()); break;
+                  case 3: builder.append_printf ("<div id=\"d%u\" class=\"card\"><span>%u</span></div>\n", GLib.Random.next_int (), GLib.Random.next_int ()); break;
+                }
+            }
+
+          builder.append ("<footer>copyright</footer></body></html>\n");
+          pages.add (new GLib.Bytes (builder.str.data));
+        }
+
+      corpus = pages.steal ();
+      return corpus;
+    }
+
+  static void bench_codec (string name, int level, bool dictionary)
+    {
+      Codec codec;
+      unowned var pages = load_corpus ();
+
+      /* dictionaries get trained on the first half, everything gets measured on the second */
+      var half = pages.length >> 1;
+      var total = (size_t) 0;
+      var compressed = (size_t) 0;
+
+      try
+        {
+          var dict = dictionary ? ZstdCodec.train (pages [0:half]) : null;
+          codec = Codec.for_name (name, level, dict);
+        }
+      catch (GLib.Error e)
+        {
+          assert_no_error (e);
+          return;
+        }
+
+      var timer = new GLib.Timer ();
+
+      for (int i = half; i < pages.length; ++i) try
+        {
+          compressed += codec.compress (pages [i]).get_size ();
+          total += pages [i].get_size ();
+        }
+      catch (GLib.Error e)
+        {
+          assert_no_error (e);
+        }
+
+      var elapsed = timer.elapsed ();
+      var ratio = (double) compressed / (double) total;
+      var rate = (double) total / elapsed / (double) (1 << 20);
+      var label = "%s-%i%s".printf (name, level, dictionary ? " with dictionary" : "");
+
+      GLib.Test.message ("%s: bytes %u, compressed %u", label, (uint) total, (uint) compressed);
+      GLib.Test.message ("%s: ratio %04f, throughput %04f MiB/s", label, ratio, rate);
+      bench_result (@"$label compression ratio", ratio, "ratio", false);
+      bench_result (@"$label compression", rate, "MiB/s");
+    }
+}
@@ -0,0 +1,162 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using ScrapperD.Scrapper;
+
+namespace Testing
+{
+  public static int main (string[] args)
+    {
+      GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/Frontier/cancel", () => (new TestFrontierCancel ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Frontier/delay", () => (new TestFrontierDelay ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Frontier/limits", () => (new TestFrontier ()).run ());
+      return GLib.Test.run ();
+    }
+
+  class TestFrontier : AsyncTest
+    {
+      const string[] uris =
+        {
+          "http://a.example/1", "http://a.example/2", "http://a.example/3",
+          "http://b.example/1", "http://b.example/2", "http://c.example/1",
+        };
+
+      protected override async void test ()
+        {
+          var frontier = new Frontier (2, 1, 0);
+          var order = new GLib.GenericArray<string> ();
+          var pending = uris.length;
+          var per_host = new GLib.HashTable<string, uint> (GLib.str_hash, GLib.str_equal);
+
+          foreach (unowned var uri_string in uris)
+            {
+              GLib.Uri uri;
+
+              try { uri = GLib.Uri.parse (uri_string, GLib.UriFlags.NONE); } catch (GLib.Error e)
+                {
+                  assert_no_error (e);
+                  return;
+                }
+
+              frontier.acquire.begin (uri, null, (o, res) =>
+                {
+                  Frontier.Ticket ticket;
+
+                  try { ticket = frontier.acquire.end (res); } catch (GLib.Error e)
+                    {
+                      assert_no_error (e);
+                      return;
+                    }
+
+                  var running = per_host.lookup (ticket.host);
+
+                  GLib.assert_cmpuint (running, GLib.CompareOperator.EQ, 0);
+                  GLib.assert_cmpuint (frontier.inflight, GLib.CompareOperator.LE, 2);
+
+                  order.add (ticket.host);
+                  per_host.insert (ticket.host, running + 1);
+
+                  GLib.Timeout.add (5, () =>
+                    {
+                      per_host.insert (ticket.host, per_host.lookup (ticket.host) - 1);
+                      frontier.release ((owned) ticket);
+
+                      if (--pending == 0) test.callback ();
+                      return GLib.Source.REMOVE;
+                    });
+                });
+            }
+
+          yield;
+
+          GLib.assert_cmpuint (order.length, GLib.CompareOperator.EQ, uris.length);
+          GLib.assert_cmpuint (frontier.fetched, GLib.CompareOperator.EQ, uris.length);
+          GLib.assert_cmpuint (frontier.queued, GLib.CompareOperator.EQ, 0);
+
+          /* hosts take turns, so c.example is not left behind a.example's whole queue */
+          GLib.assert_cmpstr (order [0], GLib.CompareOperator.EQ, "a.example");
+          GLib.assert_cmpstr (order [1], GLib.CompareOperator.EQ, "b.example");
+          GLib.assert_cmpstr (order [order.length - 1], GLib.CompareOperator.EQ, "a.example");
+        }
+    }
+
+  class TestFrontierCancel : AsyncTest
+    {
+      protected override async void test ()
+        {
+          var cancellable = new GLib.Cancellable ();
+          var frontier = new Frontier (1, 1, 0);
+          var uri = GLib.Uri.build (GLib.UriFlags.NONE, "http", null, "a.example", -1, "/", null, null);
+          Frontier.Ticket ticket;
+
+          try { ticket = yield frontier.acquire (uri); } catch (GLib.Error e)
+            {
+              assert_no_error (e);
+              return;
+            }
+
+          /* the only slot is taken, so this one queues until cancelled */
+          GLib.Timeout.add (20, () => { cancellable.cancel (); return GLib.Source.REMOVE; });
+
+          try { yield frontier.acquire (uri, cancellable); assert_not_reached (); } catch (GLib.Error e)
+            {
+              GLib.assert_true (e.matches (IOError.quark (), IOError.CANCELLED));
+            }
+
+          GLib.assert_cmpuint (frontier.queued, GLib.CompareOperator.EQ, 0);
+          GLib.assert_cmpuint (frontier.inflight, GLib.CompareOperator.EQ, 1);
+
+          frontier.release ((owned) ticket);
+
+          GLib.assert_cmpuint (frontier.inflight, GLib.CompareOperator.EQ, 0);
+        }
+    }
+
+  class TestFrontierDelay : AsyncTest
+    {
+      const uint DELAY = 100;
+
+      protected override async void test ()
+        {
+          var frontier = new Frontier (4, 1, DELAY);
+          var uri = GLib.Uri.build (GLib.UriFlags.NONE, "http", null, "a.example", -1, "/", null, null);
+          var last = (int64) 0;
+
+          /* one fetch after the other, each released before asking for the next */
+          for (int i = 0; i < 3; ++i)
+            {
+              Frontier.Ticket ticket;
+
+              try { ticket = yield frontier.acquire (uri); } catch (GLib.Error e)
+                {
+                  assert_no_error (e);
+                  return;
+                }
+
+              var now = GLib.get_monotonic_time ();
+
+              if (i > 0) GLib.assert_cmpint ((int) ((now - last) / 1000), GLib.CompareOperator.GE, (int) DELAY - 5);
+
+              last = now;
+              frontier.release ((owned) ticket);
+
+              /* an idle host keeps what the frontier learned about it */
+              GLib.assert_cmpfloat (frontier.host_latency ("a.example"), GLib.CompareOperator.GE, 0);
+            }
+        }
+    }
+}
@@ -0,0 +1,91 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using Kademlia;
+
+namespace Testing
+{
+  public static int main (string[] args)
+    {
+      GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/Deadlines/cancel", () => test_cancel ());
+      GLib.Test.add_func (TESTPATHROOT + "/Deadlines/order", () => test_order (1000));
+      GLib.Test.add_func (TESTPATHROOT + "/Deadlines/schedule", () => test_schedule ());
+      return GLib.Test.run ();
+    }
+
+  static void test_cancel ()
+    {
+      var deadlines = new Deadlines ();
+      var key1 = new Key.random ();
+      var key2 = new Key.random ();
+
+      deadlines.schedule (key1, 10);
+      deadlines.schedule (key2, 20);
+
+      assert_true (deadlines.cancel (key1));
+      assert_false (deadlines.cancel (key1));
+      assert_false (deadlines.contains (key1));
+      assert_cmpuint (deadlines.length, CompareOperator.EQ, 1);
+      assert_true (Key.equal (deadlines.pop (30), key2));
+      assert_null (deadlines.pop (30));
+    }
+
+  static void test_order (uint count)
+    {
+      var deadlines = new Deadlines ();
+      int64 due, last = int64.MIN;
+      Key? key;
+
+      for (uint i = 0; i < count; ++i)
+        {
+          deadlines.schedule (new Key.random (), GLib.Random.int_range (0, 1000));
+        }
+
+      assert_null (deadlines.pop (-1));
+
+      for (uint i = 0; deadlines.peek (out due); ++i)
+        {
+          assert_cmpint ((int) due, CompareOperator.GE, (int) last);
+          assert_nonnull (key = deadlines.pop (due));
+          assert_false (deadlines.contains (key));
+          last = due;
+        }
+
+      assert_cmpuint (deadlines.length, CompareOperator.EQ, 0);
+    }
+
+  static void test_schedule ()
+    {
+      var deadlines = new Deadlines ();
+      var key1 = new Key.random ();
+      var key2 = new Key.random ();
+      var key3 = new Key.random ();
+
+      deadlines.schedule (key1, 10);
+      deadlines.schedule (key2, 20);
+      deadlines.schedule (key3, 30);
+      deadlines.schedule (key3, 5);
+      deadlines.schedule (key1, 40);
+
+      assert_cmpuint (deadlines.length, CompareOperator.EQ, 3);
+      assert_null (deadlines.pop (4));
+      assert_true (Key.equal (deadlines.pop (25), key3));
+      assert_true (Key.equal (deadlines.pop (25), key2));
+      assert_null (deadlines.pop (25));
+      assert_true (Key.equal (deadlines.pop (40), key1));
+    }
+}
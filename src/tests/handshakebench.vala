@@ -0,0 +1,171 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+namespace Testing
+{
+  public static int main (string[] args)
+    {
+      GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/Krypt/bench/handshake/full", () => (new BenchHandshake (false)).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Krypt/bench/handshake/resumed", () => (new BenchHandshake (true)).run ());
+      return bench_run ();
+    }
+
+  /*
+   * Handshakes a Krypt.IOStream pair over fresh loopback TCP connections
+   * over and over, either from scratch every time or resuming the session
+   * the previous round left behind, and reports handshakes per second
+   */
+
+  class BenchHandshake : AsyncTest
+    {
+      public uint rounds { get; construct; default = 500; }
+      public bool resume { get; construct; }
+
+      public BenchHandshake (bool resume)
+        {
+          Object (resume : resume);
+        }
+
+      private async GLib.IOStream[] connect (GLib.SocketListener listener, uint16 port) throws GLib.Error
+        {
+          GLib.Error? error = null;
+          GLib.SocketConnection? accepted = null;
+          var waiting = false;
+
+          listener.accept_async.begin (null, (o, res) =>
+            {
+              try { accepted = listener.accept_async.end (res); } catch (GLib.Error e)
+                {
+                  error = (owned) e;
+                }
+
+              if (waiting) connect.callback ();
+            });
+
+          var client = yield (new GLib.SocketClient ()).connect_to_host_async ("127.0.0.1", port);
+
+          if (accepted == null && error == null)
+            {
+              waiting = true;
+              yield;
+            }
+
+          if (error != null) throw (owned) error;
+          return { client, accepted };
+        }
+
+      private async Krypt.IOStream[] handshake (GLib.IOStream client, GLib.IOStream server, Krypt.Dh.SessionCache? ccache, Krypt.Dh.SessionCache? scache) throws GLib.Error
+        {
+          GLib.Error? error = null;
+          var pending = 2;
+          var waiting = false;
+
+          var kclient = new Krypt.IOStream ("AES", "GCM", client);
+          var kserver = new Krypt.IOStream ("AES", "GCM", server);
+
+          kclient.session_cache = ccache;
+          kclient.session_name = "bench";
+          kserver.session_cache = scache;
+
+          GLib.AsyncReadyCallback done = (o, res) =>
+            {
+              try
+                {
+                  if (o == kclient)
+
+                    kclient.handshake_client.end (res);
+                  else
+                    kserver.handshake_server.end (res);
+                }
+              catch (GLib.Error e)
+                {
+                  error = (owned) e;
+                }
+
+              if (--pending == 0 && waiting) handshake.callback ();
+            };
+
+          kclient.handshake_client.begin (GLib.Priority.DEFAULT, null, done);
+          kserver.handshake_server.begin (GLib.Priority.DEFAULT, null, done);
+
+          if (pending > 0)
+            {
+              waiting = true;
+              yield;
+            }
+
+          if (error != null) throw (owned) error;
+          return { kclient, kserver };
+        }
+
+      protected override async void test ()
+        {
+          var ccache = resume ? new Krypt.Dh.SessionCache () : null;
+          var scache = resume ? new Krypt.Dh.SessionCache () : null;
+          var listener = new GLib.SocketListener ();
+          var elapsed = (double) 0;
+          var resumed = 0u;
+          var timer = new GLib.Timer ();
+          uint16 port;
+
+          try { port = listener.add_any_inet_port (null); } catch (GLib.Error e)
+            {
+              assert_no_error (e);
+              return;
+            }
+
+          /* first round primes the caches, it is not counted */
+          for (uint i = 0; i <= rounds; ++i) try
+            {
+              var streams = yield connect (listener, port);
+
+              timer.start ();
+              var kstreams = yield handshake (streams [0], streams [1], ccache, scache);
+              if (i > 0) elapsed += timer.elapsed ();
+
+              if (kstreams [0].resumed) ++resumed;
+
+              var probe = "probe".data;
+              var got = new uint8 [probe.length];
+              size_t read_;
+
+              yield kstreams [0].output_stream.write_all_async (probe, GLib.Priority.DEFAULT, null, null);
+              yield kstreams [0].output_stream.flush_async (GLib.Priority.DEFAULT, null);
+              yield kstreams [1].input_stream.read_all_async (got, GLib.Priority.DEFAULT, null, out read_);
+
+              assert_cmpmem (got, probe);
+
+              yield kstreams [0].close_async (GLib.Priority.DEFAULT, null);
+              yield kstreams [1].close_async (GLib.Priority.DEFAULT, null);
+            }
+          catch (GLib.Error e)
+            {
+              assert_no_error (e);
+              return;
+            }
+
+          listener.close ();
+
+          GLib.assert_cmpuint (resumed, GLib.CompareOperator.EQ, resume ? rounds : 0);
+
+          GLib.Test.message ("handshakes: %u, resumed: %u", rounds, resumed);
+          GLib.Test.message ("handshakes per second: %04f", (double) rounds / elapsed);
+          bench_result (resume ? "resumed handshakes" : "full handshakes", (double) rounds / elapsed, "handshakes/s");
+        }
+    }
+}
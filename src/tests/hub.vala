@@ -27,6 +27,10 @@ namespace Testing
       GLib.Test.add_func (TESTPATHROOT + "/Hub/insert_exotic", () => (new TestIntegrationInsertExotic (new TestHub ())).run ());
       GLib.Test.add_func (TESTPATHROOT + "/Hub/lookup", () => (new TestIntegrationLookup (new TestHub ())).run ());
       GLib.Test.add_func (TESTPATHROOT + "/Hub/lookup_node", () => (new TestIntegrationLookupNode (new TestHub ())).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Hub/network/backoff", () => (new TestNetworkBackoff ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Hub/network/coalesce", () => (new TestNetworkCoalesce ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Hub/network/expire", () => (new TestNetworkExpire ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Hub/network/race", () => (new TestNetworkRace ()).run ());
       GLib.Test.add_func (TESTPATHROOT + "/Hub/new", () => new TestHub ());
       return GLib.Test.run ();
     }
@@ -88,4 +92,250 @@ namespace Testing
           throw new PeerError.UNREACHABLE ("can not reach node '%s'", id.to_string ());
         }
     }
+
+  /*
+   * Loopback listener counting the connections it gets, which it either
+   * splices to target or (without one) accepts and never answers
+   */
+
+  public class Relay : GLib.Object
+    {
+      public uint accepted { get; private set; default = 0; }
+      public Address address;
+      public Address? target;
+
+      private GLib.GenericArray<GLib.SocketConnection> held;
+      private GLib.SocketService service;
+
+      public Relay (Address? target = null) throws GLib.Error
+        {
+          GLib.SocketAddress effective;
+
+          this.held = new GLib.GenericArray<GLib.SocketConnection> ();
+          this.service = new GLib.SocketService ();
+          this.target = target;
+
+          var any = new GLib.InetSocketAddress (new GLib.InetAddress.loopback (GLib.SocketFamily.IPV4), 0);
+
+          service.add_address (any, GLib.SocketType.STREAM, GLib.SocketProtocol.TCP, null, out effective);
+          service.incoming.connect ((c, s) => on_incoming (c));
+          service.start ();
+
+          address = Address ("127.0.0.1", ((GLib.InetSocketAddress) effective).port);
+        }
+
+      ~Relay ()
+        {
+          service.stop ();
+          service.close ();
+        }
+
+      private bool on_incoming (GLib.SocketConnection connection)
+        {
+          ++accepted;
+
+          if (target == null)
+
+            held.add (connection);
+          else
+            splice.begin (connection);
+          return true;
+        }
+
+      private async void splice (GLib.SocketConnection connection)
+        {
+          var flags = GLib.IOStreamSpliceFlags.CLOSE_STREAM1 | GLib.IOStreamSpliceFlags.CLOSE_STREAM2;
+
+          try
+            {
+              var upstream = yield (new GLib.SocketClient ()).connect_to_host_async (target.address, target.port, null);
+              yield connection.splice_async (upstream, flags, GLib.Priority.DEFAULT, null);
+            }
+          catch (GLib.Error e)
+            {
+              debug ("relay: %s: %u: %s", e.domain.to_string (), e.code, e.message);
+            }
+        }
+    }
+
+  /*
+   * One peer served by a loopback NetworkHub and a second hub which only
+   * knows the addresses subclasses give it, so every lookup there has to
+   * reconnect
+   */
+
+  public abstract class TestNetworkBase : AsyncTest
+    {
+      public const uint TIMEOUT = 5000;
+
+      protected NetworkHub client;
+      protected PeerImpl peer;
+      protected NetworkHub server;
+      protected Address served;
+
+      construct
+        {
+          client = create_client ();
+          peer = new PeerImpl (new DummyValueStore ());
+          server = new NetworkHub ();
+        }
+
+      protected virtual NetworkHub create_client ()
+        {
+          return new NetworkHub ();
+        }
+
+      protected abstract async void exercise () throws GLib.Error;
+
+      /* looks the peer up from the client, giving up after TIMEOUT so a stuck dial fails instead of hanging */
+      protected async Role lookup () throws GLib.Error
+        {
+          var cancellable = new GLib.Cancellable ();
+          var source = GLib.Timeout.add (TIMEOUT, () => { cancellable.cancel (); return GLib.Source.REMOVE; });
+
+          try { return yield client.lookup_role (peer.id, cancellable); } finally
+            {
+              if (cancellable.is_cancelled () == false) GLib.Source.remove (source);
+            }
+        }
+
+      protected static async void sleep (uint interval)
+        {
+          GLib.Timeout.add (interval, sleep.callback);
+          yield;
+        }
+
+      protected override async void test ()
+        {
+          try
+            {
+              server.add_local_peer ("testing", peer);
+              yield server.add_local_address ("127.0.0.1", 0);
+              server.start ();
+
+              served = server.list_local_addresses () [0];
+              yield exercise ();
+            }
+          catch (GLib.Error e)
+            {
+              assert_no_error (e);
+            }
+
+          server.stop ();
+        }
+    }
+
+  public class TestNetworkBackoff : TestNetworkBase
+    {
+
+      protected override async void exercise () throws GLib.Error
+        {
+          var socket = new GLib.Socket (GLib.SocketFamily.IPV4, GLib.SocketType.STREAM, GLib.SocketProtocol.TCP);
+
+          /* a port nobody listens at, so dials to it get refused right away */
+          socket.bind (new GLib.InetSocketAddress (new GLib.InetAddress.loopback (GLib.SocketFamily.IPV4), 0), true);
+
+          var port = ((GLib.InetSocketAddress) socket.get_local_address ()).port;
+
+          socket.close ();
+          client.add_contact_addresses (peer.id, { Address ("127.0.0.1", port) });
+
+          try { yield lookup (); assert_not_reached (); } catch (GLib.Error e)
+            {
+              assert_error (e, GLib.IOError.quark (), GLib.IOError.CONNECTION_REFUSED);
+            }
+
+          /* the address is not dialed again until FIRSTBACKOFF went by */
+          try { yield lookup (); assert_not_reached (); } catch (GLib.Error e)
+            {
+              assert_error (e, PeerError.quark (), PeerError.UNREACHABLE);
+            }
+
+          yield sleep ((uint) (NetworkHub.FIRSTBACKOFF / 1000) + 50);
+
+          try { yield lookup (); assert_not_reached (); } catch (GLib.Error e)
+            {
+              assert_error (e, GLib.IOError.quark (), GLib.IOError.CONNECTION_REFUSED);
+            }
+
+          /* and not forgotten before it failed MAXBACKOFF times */
+          assert_cmpuint (client.list_remote_addresses (peer.id).length, GLib.CompareOperator.EQ, 1);
+        }
+    }
+
+  public class TestNetworkCoalesce : TestNetworkBase
+    {
+      public const uint CALLERS = 8;
+
+      protected override async void exercise () throws GLib.Error
+        {
+          var relay = new Relay (served);
+          var pending = CALLERS;
+          var roles = new GLib.GenericArray<Role> ();
+
+          client.add_contact_addresses (peer.id, { relay.address });
+
+          for (uint i = 0; i < CALLERS; ++i) lookup.begin ((o, res) =>
+            {
+              try { roles.add (lookup.end (res)); } catch (GLib.Error e)
+                {
+                  assert_no_error (e);
+                }
+
+              if (--pending == 0) exercise.callback ();
+            });
+
+          yield;
+
+          assert_cmpuint (roles.length, GLib.CompareOperator.EQ, CALLERS);
+          assert_cmpuint (relay.accepted, GLib.CompareOperator.EQ, 1);
+
+          foreach (unowned var role in roles) assert_true (Key.equal (new Key.verbatim (role.id.value), peer.id));
+        }
+    }
+
+  public class TestNetworkExpire : TestNetworkBase
+    {
+      public const int64 IDLETIME = NetworkHub.USEC_PER_SEC;
+
+      protected override NetworkHub create_client ()
+        {
+          return new NetworkHub (IDLETIME);
+        }
+
+      protected override async void exercise () throws GLib.Error
+        {
+          client.add_contact_addresses (peer.id, { served });
+
+          var role = yield lookup ();
+          var dbus = ((GLib.DBusProxy) role).get_connection ();
+
+          assert_false (dbus.is_closed ());
+
+          /* the hub clock closes it once it went unused for IDLETIME */
+          yield sleep ((uint) (IDLETIME / 1000) << 1);
+
+          assert_true (dbus.is_closed ());
+          assert_null (client.pick_contact_role (peer.id));
+        }
+    }
+
+  public class TestNetworkRace : TestNetworkBase
+    {
+
+      protected override async void exercise () throws GLib.Error
+        {
+          var relay = new Relay (served);
+          var stall = new Relay ();
+
+          /* one address never gets past the handshake, the other one has to win anyway */
+          client.add_contact_addresses (peer.id, { stall.address, relay.address });
+
+          var role = yield lookup ();
+
+          assert_true (Key.equal (new Key.verbatim (role.id.value), peer.id));
+          assert_cmpuint (relay.accepted, GLib.CompareOperator.EQ, 1);
+          assert_cmpuint (stall.accepted, GLib.CompareOperator.LE, 1);
+        }
+    }
 }
@@ -21,116 +21,311 @@ namespace Testing
   public static int main (string[] args)
     {
       GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/Integration/batch", () => (new TestIntegrationBatch ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Integration/batch_cancel_queued", () => (new TestIntegrationBatchCancelQueued ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Integration/batch_cancel_sent", () => (new TestIntegrationBatchCancelSent ()).run ());
       GLib.Test.add_func (TESTPATHROOT + "/Integration/connect", () => (new TestIntegrationConnect (new TestHub ())).run ());
       GLib.Test.add_func (TESTPATHROOT + "/Integration/insert", () => (new TestIntegrationInsert (new TestHub ())).run ());
       GLib.Test.add_func (TESTPATHROOT + "/Integration/insert_exotic", () => (new TestIntegrationInsertExotic (new TestHub ())).run ());
       GLib.Test.add_func (TESTPATHROOT + "/Integration/lookup", () => (new TestIntegrationLookup (new TestHub ())).run ());
       GLib.Test.add_func (TESTPATHROOT + "/Integration/lookup_node", () => (new TestIntegrationLookupNode (new TestHub ())).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Integration/quorum", () => (new TestIntegrationQuorum ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Integration/republish", () => (new TestIntegrationRepublish ()).run ());
       return GLib.Test.run ();
     }
 
-  public class TestHub : GLib.Object, PeerProvider
+  /* two peers, a knowing only b, so every lookup from a asks b exactly once */
+  public abstract class TestIntegrationBatchBase : AsyncTest
     {
-      private HashTable<Key, ValuePeer> table;
+      protected TestValuePeer a;
+      protected TestValuePeer b;
+      protected double[] elapsed;
+
+      private TestHub net;
 
       construct
         {
-          table = new HashTable<Key, ValuePeer> (Key.hash, Key.equal);
+          var peers = (net = new TestHub (2, 3)).list_peers ();
+
+          a = (TestValuePeer) peers.nth_data (0);
+          b = (TestValuePeer) peers.nth_data (1);
+          a.add_contact (b.id);
         }
 
-      public TestHub (int min_nodes = 100, int max_nodes = 1000)
+      /* looks every key up at once, gathering what each lookup threw and how long it took */
+      protected async GLib.Error?[] lookup_all (Key[] keys, GLib.Cancellable?[] cancellables)
         {
-          for (unowned var i = 0; i < GLib.Random.int_range (min_nodes, max_nodes); ++i)
+          var errors = new GLib.Error? [keys.length];
+          var left = keys.length;
+          var timer = new GLib.Timer ();
+
+          elapsed = new double [keys.length];
+
+          for (int i = 0; i < keys.length; ++i)
             {
-              var id = new Key.random ();
-              var peer = new TestValuePeer (new DummyValueStore (), id, this);
+              var at = i;
+
+              a.lookup.begin (keys [i], cancellables [i], (o, res) =>
+                {
+                  try { ((ValuePeer) o).lookup.end (res); } catch (GLib.Error e)
+                    {
+                      errors [at] = (owned) e;
+                    }
 
-              table.insert ((owned) id, peer);
+                  elapsed [at] = timer.elapsed ();
+
+                  if (--left == 0) lookup_all.callback ();
+                });
             }
-        }
 
-      public GLib.List<unowned ValuePeer> list_peers ()
-        {
-          return table.get_values ();
+          yield;
+          return (owned) errors;
         }
 
-      public GLib.List<unowned Key> list_peers_id ()
+      protected static bool is_cancelled (GLib.Error? error)
         {
-          return table.get_keys ();
+          return error != null && error.matches (IOError.quark (), IOError.CANCELLED);
         }
+    }
 
-      public async ValuePeer pick (Key id)
+  public class TestIntegrationBatch : TestIntegrationBatchBase
+    {
+
+      protected override async void test ()
         {
-          var peer = table.lookup (id); assert (peer != null);
-          return (owned) peer;
+          var count = 8;
+          var keys = new Key [count];
+
+          for (int i = 0; i < count; ++i) keys [i] = new Key.random ();
+
+          a.batch_window = 50;
+
+          var errors = yield lookup_all (keys, new GLib.Cancellable? [count]);
+
+          foreach (unowned var error in errors) assert_no_error (error);
+
+          assert_cmpuint (a.batches, GLib.CompareOperator.EQ, 1);
+          assert_cmpuint (a.batched, GLib.CompareOperator.EQ, count);
         }
+    }
+
+  public class TestIntegrationBatchCancelQueued : TestIntegrationBatchBase
+    {
 
-      public async ValuePeer pick_any () requires (table.length > 0)
+      protected override async void test ()
         {
-          var iter = HashTableIter<Key, ValuePeer> (table);
-          var peer = (ValuePeer?) null;
-          iter.next (null, out peer);
-          return (owned) peer;
+          var cancellable = new GLib.Cancellable ();
+          var keys = new Key [] { new Key.random (), new Key.random (), new Key.random () };
+
+          a.batch_window = 500;
+          GLib.Timeout.add (20, () => { cancellable.cancel (); return GLib.Source.REMOVE; });
+
+          var errors = yield lookup_all (keys, new GLib.Cancellable? [] { null, cancellable, null });
+
+          assert_no_error (errors [0]);
+          assert_true (is_cancelled (errors [1]));
+          assert_no_error (errors [2]);
+
+          /* the cancelled lookup did not wait for the window, nor went out with the batch */
+          assert_cmpfloat (elapsed [1], GLib.CompareOperator.LT, 0.25);
+          assert_cmpuint (a.batches, GLib.CompareOperator.EQ, 1);
+          assert_cmpuint (a.batched, GLib.CompareOperator.EQ, 2);
         }
     }
 
-  public class TestValuePeer : ValuePeer
+  public class TestIntegrationBatchCancelSent : TestIntegrationBatchBase
     {
-      unowned TestHub net;
 
-      public TestValuePeer (ValueStore value_store, Key id, TestHub net)
+      protected override async void test ()
         {
-          base (value_store, id);
-          this.net = net;
+          var first = new GLib.Cancellable ();
+          var second = new GLib.Cancellable ();
+          var keys = new Key [] { new Key.random (), new Key.random (), new Key.random () };
+
+          a.delay = 300;
+          GLib.Timeout.add (50, () => { first.cancel (); return GLib.Source.REMOVE; });
+          GLib.Timeout.add (100, () => { second.cancel (); return GLib.Source.REMOVE; });
+
+          var errors = yield lookup_all (keys, new GLib.Cancellable? [] { first, second, null });
+
+          assert_true (is_cancelled (errors [0]));
+          assert_true (is_cancelled (errors [1]));
+          assert_no_error (errors [2]);
+
+          /* cancelled lookups got resumed without the reply, which the third one still waited for */
+          assert_cmpfloat (elapsed [0], GLib.CompareOperator.LT, 0.25);
+          assert_cmpfloat (elapsed [1], GLib.CompareOperator.LT, 0.25);
+          assert_cmpuint (a.batches, GLib.CompareOperator.EQ, 1);
+          assert_false (a.batch_cancellable.is_cancelled ());
+
+          var both = new GLib.Cancellable ();
+          var more = new Key [] { new Key.random (), new Key.random () };
+
+          GLib.Timeout.add (50, () => { both.cancel (); return GLib.Source.REMOVE; });
+
+          errors = yield lookup_all (more, new GLib.Cancellable? [] { both, both });
+
+          assert_true (is_cancelled (errors [0]));
+          assert_true (is_cancelled (errors [1]));
+
+          /* nobody waits for the call any more, so the call itself got cancelled */
+          assert_cmpuint (a.batches, GLib.CompareOperator.EQ, 2);
+          assert_true (a.batch_cancellable.is_cancelled ());
         }
+    }
 
-      async ValuePeer getother (Key peer) throws GLib.Error
+  /* four peers, the first knowing the other three, the last of which is offline */
+  public class TestIntegrationQuorum : AsyncTest
+    {
+      private TestHub net;
+      private TestValuePeer[] peers;
+
+      construct
         {
-          ValuePeer other;
+          var list = (net = new TestHub (4, 5)).list_peers ();
 
-          if ((other = yield net.pick (peer)) == null)
+          peers = new TestValuePeer [list.length ()];
 
-            throw new PeerError.UNREACHABLE ("no node in net with id (%s)", peer.to_string ());
+          for (int i = 0; i < peers.length; ++i) peers [i] = (TestValuePeer) list.nth_data (i);
+          for (int i = 1; i < peers.length; ++i) peers [0].add_contact (peers [i].id);
 
-          return other;
+          peers [3].online = false;
         }
 
-      protected async override Key[] find_peer (Key peer, Key id, GLib.Cancellable? cancellable = null) throws GLib.Error
+      protected override async void test ()
         {
-          var other = yield getother (peer);
-          var peers = yield other.find_peer_complete (this.id, id, cancellable);
+          unowned var a = peers [0];
+          var held = 0;
+          var id = new Key.random ();
+
+          /* no more than three replicas can take it */
+          a.write_quorum = (uint) peers.length;
+
+          try
+            {
+              assert_false (yield a.insert (new Key.random (), "value"));
+
+              a.write_quorum = 2;
+              assert_true (yield a.insert (id, "value"));
 
-          foreach (unowned var peer_ in peers)
+              foreach (unowned var peer in peers)
+                {
+                  var value = yield peer.value_store.lookup_value (id);
+                  if (value != null) ++held;
+                }
+            }
+          catch (GLib.Error e)
             {
-              if (Key.equal (peer_, this.id) == false) buckets.insert (peer_);
+              assert_no_error (e);
             }
-          return (owned) peers;
+
+          assert_cmpint (held, GLib.CompareOperator.GE, 2);
         }
+    }
 
-      protected async override Kademlia.Value find_value (Key peer, Key id, GLib.Cancellable? cancellable = null) throws GLib.Error
+  /* value store handing every value put in it out as stale, once */
+  public class StaleValueStore : GLib.Object, ValueStore
+    {
+      private GenericArray<Key> stale;
+      private HashTable<Key, GLib.Value?> values;
+
+      construct
         {
-          var other = yield getother (peer);
-          var value = yield other.find_value_complete (this.id, id, cancellable);
+          stale = new GenericArray<Key> ();
+          values = new HashTable<Key, GLib.Value?> (Key.hash, Key.equal);
+        }
 
-          if (value.is_delegated)
-          foreach (unowned var peer_ in value.keys)
-            {
-              if (Key.equal (peer_, this.id) == false) buckets.insert (peer_);
-            }
+      public override async Kademlia.Key[] enumerate_staled_values (GLib.Cancellable? cancellable)
+        {
+          return stale.steal ();
+        }
+
+      static GLib.Value copy_of (GLib.Value value)
+        {
+          var copy = GLib.Value (value.type ());
+
+          value.copy (ref copy);
+          return (owned) copy;
+        }
+
+      public async bool insert_value (Key id, GLib.Value? value, GLib.Cancellable? cancellable)
+        {
+          values.insert (id.copy (), copy_of (value));
+          return true;
+        }
+
+      public async GLib.Value? lookup_value (Key id, GLib.Cancellable? cancellable)
+        {
+          unowned GLib.Value? value;
 
-          return (owned) value;
+          if (values.lookup_extended (id, null, out value) == false)
+
+            return null;
+          else
+            return copy_of (value);
         }
 
-      protected async override bool store_value (Key peer, Key id, GLib.Value? value = null, GLib.Cancellable? cancellable = null) throws GLib.Error
+      public void put_stale (Key id, GLib.Value value)
         {
-          var other = yield getother (peer);
-          return yield other.store_value_complete (this.id, id, value, cancellable);
+          values.insert (id.copy (), copy_of (value));
+          stale.add (id.copy ());
         }
+    }
 
-      protected async override bool ping_peer (Key peer, GLib.Cancellable? cancellable = null) throws GLib.Error
+  /* more stale values than the republisher's burst, two of them stored on us by another node */
+  public class TestIntegrationRepublish : AsyncTest
+    {
+      const uint BURST = 8;
+      const uint COUNT = 20;
+      const double RATE = 8;
+
+      protected override async void test ()
         {
-          var other = yield getother (peer);
-          return yield other.ping_peer_complete (this.id, cancellable);
+          var net = new TestHub (1, 2);
+          var store = new StaleValueStore ();
+          var b = (TestValuePeer) net.list_peers ().nth_data (0);
+          var a = net.add_peer (store);
+          var keys = new Key [COUNT];
+
+          a.add_contact (b.id);
+          a.republisher.burst = BURST;
+          a.republisher.jitter = 0;
+          a.republisher.rate = RATE;
+
+          for (uint i = 0; i < COUNT; ++i) store.put_stale (keys [i] = new Key.random (), "value");
+
+          try
+            {
+              yield a.store_value_complete (b.id, keys [0], "value", Metrics.TraceContext ());
+              yield a.store_value_complete (b.id, keys [1], "value", Metrics.TraceContext ());
+
+              /* the bucket starts full, whatever does not fit gets deferred */
+              yield a.republisher.step ();
+
+              assert_cmpuint (a.republisher.skipped, GLib.CompareOperator.EQ, 2);
+              assert_cmpuint (a.republisher.republished, GLib.CompareOperator.EQ, BURST);
+              assert_cmpuint (a.republisher.deferred, GLib.CompareOperator.EQ, COUNT - 2 - BURST);
+              assert_cmpuint (a.republisher.backlog, GLib.CompareOperator.EQ, COUNT - 2 - BURST);
+
+              /* and the backlog drains at rate, not at once */
+              var timer = new GLib.Timer ();
+
+              while (a.republisher.backlog > 0 && timer.elapsed () < 5)
+                {
+                  GLib.Timeout.add (100, test.callback);
+                  yield;
+                  yield a.republisher.step ();
+                }
+
+              assert_cmpuint (a.republisher.backlog, GLib.CompareOperator.EQ, 0);
+              assert_cmpuint (a.republisher.republished, GLib.CompareOperator.EQ, COUNT - 2);
+              assert_cmpuint (a.republisher.skipped, GLib.CompareOperator.EQ, 2);
+              assert_cmpfloat (timer.elapsed (), GLib.CompareOperator.GE, (COUNT - 2 - BURST - 1) / RATE);
+            }
+          catch (GLib.Error e)
+            {
+              assert_no_error (e);
+            }
         }
     }
 }
@@ -21,8 +21,10 @@ namespace Testing
   public static int main (string[] args)
     {
       GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/Key/compare_distance", () => test_compare_distance (1000));
       GLib.Test.add_func (TESTPATHROOT + "/Key/copy", () => test_copy ());
       GLib.Test.add_func (TESTPATHROOT + "/Key/distance", () => test_distance ());
+      GLib.Test.add_func (TESTPATHROOT + "/Key/distance/bytewise", () => test_distance_bytewise (1000));
       GLib.Test.add_func (TESTPATHROOT + "/Key/equal", () => test_equal ());
       GLib.Test.add_func (TESTPATHROOT + "/Key/hash", () => test_hash ());
       GLib.Test.add_func (TESTPATHROOT + "/Key/new_from_bytes", () => test_new_from_bytes ("test data".data));
@@ -33,6 +35,24 @@ namespace Testing
       return GLib.Test.run ();
     }
 
+  static void test_compare_distance (uint triples)
+    {
+      for (uint i = 0; i < triples; ++i)
+        {
+          var key1 = new Key.random ();
+          var key2 = new Key.random ();
+          var target = new Key.random ();
+          var distance1 = Key.xor (key1, target);
+          var distance2 = Key.xor (key2, target);
+          var expected = GLib.Memory.cmp (distance1.bytes, distance2.bytes, distance1.bytes.length);
+
+          assert_cmpint (Key.compare_distance (key1, key2, target), CompareOperator.EQ, expected.clamp (-1, 1));
+        }
+
+      var key = new Key.random ();
+      assert_cmpint (Key.compare_distance (key, key, new Key.random ()), CompareOperator.EQ, 0);
+    }
+
   static void test_copy ()
     {
       var key1 = new Key.random ();
@@ -59,6 +79,40 @@ namespace Testing
       assert_cmpint (Key.distance (key1, key2) + Key.distance (key2, key3), CompareOperator.GE,Key.distance (key1, key3));
     }
 
+  /* reference distance, the highest differing bit found a byte at a time */
+  static int bytewise_distance (Key a, Key b)
+    {
+      for (int i = 0; i < a.bytes.length; ++i)
+        {
+          var c = (uint8) (a.bytes [i] ^ b.bytes [i]);
+
+          if (c != 0)
+            {
+              var bit = 7;
+              while ((c >> bit) == 0) --bit;
+              return (int) Key.BITLEN - ((i + 1) << 3) + bit;
+            }
+        }
+      return -1;
+    }
+
+  static void test_distance_bytewise (uint pairs)
+    {
+      for (uint i = 0; i < pairs; ++i)
+        {
+          var key1 = new Key.random ();
+          var bytes = key1.bytes;
+          var at = GLib.Random.int_range (0, bytes.length);
+
+          /* share a prefix of random length so every word position gets exercised */
+          var other = (uint8[]) bytes.copy ();
+          for (int j = at; j < other.length; ++j) other [j] = (uint8) GLib.Random.int_range (0, 256);
+          var key2 = new Key.verbatim (other);
+
+          assert_cmpint (Key.distance (key1, key2), CompareOperator.EQ, bytewise_distance (key1, key2));
+        }
+    }
+
   static void test_equal ()
     {
       var key1 = new Key.zero ();
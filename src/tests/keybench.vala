@@ -0,0 +1,146 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using Kademlia;
+
+namespace Testing
+{
+  public static int main (string[] args)
+    {
+      GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/Key/bench/keyval", () => bench_keyval ());
+      GLib.Test.add_func (TESTPATHROOT + "/Key/bench/key", () => bench_key ());
+      return bench_run ();
+    }
+
+  /*
+   * Raw cost of the key math the routing table and crawlers lean on, over a
+   * working set small enough to stay in cache (results are folded into a
+   * sink which gets printed, so none of it can be optimized away)
+   */
+
+  static void bench_keyval (uint count = 4096, uint rounds = 512)
+    {
+      var vals = new KeyVal [count];
+      var timer = new GLib.Timer ();
+      var ops = (double) count * (double) rounds;
+      var sink = (uint) 0;
+
+      for (uint i = 0; i < count; ++i)
+      for (uint j = 0; j < vals [i].bytes.length; ++j)
+        {
+          vals [i].bytes [j] = (uint8) GLib.Random.int_range (0, uint8.MAX + 1);
+        }
+
+      timer.start ();
+
+      for (uint r = 0; r < rounds; ++r)
+      for (uint i = 0; i < count; ++i)
+        {
+          KeyVal d;
+          KeyVal.xor (out d, vals [i], vals [(i + r + 1) % count]);
+          sink ^= d.longs [0];
+        }
+
+      var xor_time = timer.elapsed ();
+
+      timer.start ();
+
+      for (uint r = 0; r < rounds; ++r)
+      for (uint i = 0; i < count; ++i)
+        {
+          sink += KeyVal.log (vals [i], vals [(i + r + 1) % count]);
+        }
+
+      var log_time = timer.elapsed ();
+
+      timer.start ();
+
+      for (uint r = 0; r < rounds; ++r)
+      for (uint i = 0; i < count; ++i)
+        {
+          sink ^= vals [i].hash () + r;
+        }
+
+      var hash_time = timer.elapsed ();
+
+      timer.start ();
+
+      for (uint r = 0; r < rounds; ++r)
+      for (uint i = 0; i < count; ++i)
+        {
+          sink += KeyVal.cmp (vals [i], vals [(i + r) % count]) ? 1 : 0;
+        }
+
+      var cmp_time = timer.elapsed ();
+
+      GLib.Test.message ("keys: %u, rounds: %u, sink: %u", count, rounds, sink);
+      GLib.Test.message ("xor %04fns, log %04fns, hash %04fns, cmp %04fns", 1e9 * xor_time / ops, 1e9 * log_time / ops, 1e9 * hash_time / ops, 1e9 * cmp_time / ops);
+
+      bench_result ("KeyVal.xor", xor_time / ops, "s", false);
+      bench_result ("KeyVal.log", log_time / ops, "s", false);
+      bench_result ("KeyVal.hash", hash_time / ops, "s", false);
+      bench_result ("KeyVal.cmp", cmp_time / ops, "s", false);
+    }
+
+  /* same through the heap allocated Key wrapper the rest of the code uses */
+  static void bench_key (uint count = 4096, uint rounds = 64)
+    {
+      var keys = new Key [count];
+      var timer = new GLib.Timer ();
+      var ops = (double) count * (double) rounds;
+      var sink = (uint) 0;
+
+      for (uint i = 0; i < count; ++i) keys [i] = new Key.random ();
+
+      timer.start ();
+
+      for (uint r = 0; r < rounds; ++r)
+      for (uint i = 0; i < count; ++i)
+        {
+          sink += Key.distance (keys [i], keys [(i + r + 1) % count]);
+        }
+
+      var distance_time = timer.elapsed ();
+
+      timer.start ();
+
+      for (uint r = 0; r < rounds; ++r)
+      for (uint i = 0; i < count; ++i)
+        {
+          sink ^= Key.xor (keys [i], keys [(i + r + 1) % count]).bytes [0];
+        }
+
+      var xor_time = timer.elapsed ();
+
+      timer.start ();
+
+      for (uint r = 0; r < rounds; ++r)
+      for (uint i = 0; i < count; ++i)
+        {
+          sink ^= Key.hash (keys [i]) + r;
+        }
+
+      var hash_time = timer.elapsed ();
+
+      GLib.Test.message ("keys: %u, rounds: %u, sink: %u", count, rounds, sink);
+      GLib.Test.message ("distance %04fns, xor %04fns, hash %04fns", 1e9 * distance_time / ops, 1e9 * xor_time / ops, 1e9 * hash_time / ops);
+
+      bench_result ("Key.distance", distance_time / ops, "s", false);
+      bench_result ("Key.xor", xor_time / ops, "s", false);
+      bench_result ("Key.hash", hash_time / ops, "s", false);
+    }
+}
@@ -21,23 +21,195 @@ namespace Testing
   public static int main (string[] args)
     {
       GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/Krypt/datagram_roundtrip", () => (new TestDatagramRoundtrip ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Krypt/record_roundtrip", () => (new TestRecordRoundtrip (false)).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Krypt/record_tampered", () => (new TestRecordRoundtrip (true)).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Krypt/session_cache", () => (new TestSessionCache ()).run ());
       GLib.Test.add_func (TESTPATHROOT + "/Krypt/stream_splice", () => (new TestStreamSplice ()).run ());
       return GLib.Test.run ();
     }
 
-  class TestStreamSplice : AsyncTest
+  static GLib.Bytes random_bytes_vector (uint minsize, uint maxsize)
+    {
+      var size = GLib.Random.int_range ((int32) minsize, (int32) maxsize);
+      var data = new uint8 [size];
+
+      for (int i = 0; i < size; ++i) data [i] = (uint8) GLib.Random.int_range (0, uint8.MAX);
+      return new GLib.Bytes.take ((owned) data);
+    }
+
+  class TestDatagramRoundtrip : SyncTest
     {
       const string algo_name = "AES";
-      const string mode_name = "CBC";
+      const uint64 session = 0x0123456789abcdef;
+
+      protected override void test ()
+        {
+          var key = new uint8 [16];
+          var salt = new uint8 [Krypt.Aead.SALTSZ];
+
+          for (int i = 0; i < key.length; ++i) key [i] = (uint8) GLib.Random.int_range (0, uint8.MAX);
+          for (int i = 0; i < salt.length; ++i) salt [i] = (uint8) GLib.Random.int_range (0, uint8.MAX);
+
+          try
+            {
+              var opener = new Krypt.Aead.DatagramOpener (algo_name);
+              var sealer = new Krypt.Aead.DatagramSealer (algo_name);
+              var vector1 = random_bytes_vector (10, 1000);
+              var vector2 = random_bytes_vector (10, 1000);
+
+              opener.set_key (key, salt);
+              sealer.set_key (key, salt);
+
+              var packet1 = sealer.seal (7, session, vector1.get_data ());
+              var packet2 = sealer.seal (7, session, vector2.get_data ());
+
+              GLib.assert_cmpuint (Krypt.Aead.DatagramOpener.parse_kind (packet1), GLib.CompareOperator.EQ, 7);
+              GLib.assert_true (Krypt.Aead.DatagramOpener.parse_session (packet1) == session);
+
+              /* out of order delivery is fine, replays are not */
+              assert_cmpmem (opener.open (packet2), vector2.get_data ());
+              assert_cmpmem (opener.open (packet1), vector1.get_data ());
+
+              try { opener.open (packet1); GLib.assert_not_reached (); } catch (GLib.Error e)
+                {
+                  GLib.assert_error (e, GLib.IOError.quark (), GLib.IOError.INVALID_DATA);
+                }
+
+              var packet3 = sealer.seal (7, session, vector1.get_data ());
+
+              packet3 [1] ^= 0x5a;
+
+              try { opener.open (packet3); GLib.assert_not_reached (); } catch (GLib.Error e)
+                {
+                  GLib.assert_error (e, GLib.IOError.quark (), GLib.IOError.INVALID_DATA);
+                }
+            }
+          catch (GLib.Error e)
+            {
+              assert_no_error (e);
+            }
+        }
+    }
+
+  class TestRecordRoundtrip : SyncTest
+    {
+      const string algo_name = "AES";
+      const string mode_name = "GCM";
+
+      public bool tamper { get; construct; }
+
+      public TestRecordRoundtrip (bool tamper)
+        {
+          Object (tamper : tamper);
+        }
+
+      protected override void test ()
+        {
+          Krypt.IOStream reader, writer;
+          Krypt.Aead.Opener opener;
+          Krypt.Aead.Sealer sealer;
+
+          var vector = random_bytes_vector (100000, 300000);
+          var key = new uint8 [16];
+          var salt = new uint8 [Krypt.Aead.SALTSZ];
+          var wire = new GLib.MemoryOutputStream.resizable ();
+
+          for (int i = 0; i < key.length; ++i) key [i] = (uint8) GLib.Random.int_range (0, uint8.MAX);
+          for (int i = 0; i < salt.length; ++i) salt [i] = (uint8) GLib.Random.int_range (0, uint8.MAX);
+
+          try
+            {
+              writer = new Krypt.IOStream (algo_name, mode_name, new GLib.SimpleIOStream (new GLib.MemoryInputStream (), wire));
+              writer.output_stream.get ("sealer", out sealer);
+              sealer.set_key (key, salt);
+              writer.output_stream.write_all (vector.get_data (), null);
+              writer.output_stream.close ();
+            }
+          catch (GLib.Error e)
+            {
+              assert_no_error (e);
+              return;
+            }
+
+          var sent = wire.steal_as_bytes ();
+          var frames = (uint8[]) sent.get_data ();
+
+          GLib.assert_cmpuint (sent.get_size (), GLib.CompareOperator.GT, vector.get_size ());
+
+          if (tamper) frames [Krypt.Aead.HEADSZ + 10] ^= 0x5a;
+
+          try
+            {
+              reader = new Krypt.IOStream (algo_name, mode_name, new GLib.SimpleIOStream (new GLib.MemoryInputStream.from_bytes (sent), new GLib.MemoryOutputStream.resizable ()));
+              reader.input_stream.get ("opener", out opener);
+              opener.set_key (key, salt);
+            }
+          catch (GLib.Error e)
+            {
+              assert_no_error (e);
+              return;
+            }
+
+          var got = new uint8 [vector.get_size ()];
+          size_t read_ = 0;
+
+          try { reader.input_stream.read_all (got, out read_); } catch (GLib.Error e)
+            {
+              if (tamper)
+                {
+                  GLib.assert_error (e, GLib.IOError.quark (), GLib.IOError.INVALID_DATA);
+                  return;
+                }
 
-      static GLib.Bytes random_bytes_vector (uint minsize, uint maxsize)
+              assert_no_error (e);
+            }
+
+          GLib.assert_false (tamper);
+          assert_cmpmem (got [0:(int) read_], vector.get_data ());
+        }
+    }
+
+  class TestSessionCache : SyncTest
+    {
+      static Krypt.Dh.Ticket make_ticket (uint8 seed, int64 expires)
+        {
+          var id = new uint8 [Krypt.Dh.Ticket.IDSZ];
+          var secret = new uint8 [Krypt.Dh.Ticket.SECRETSZ];
+
+          for (int i = 0; i < id.length; ++i) id [i] = seed;
+          for (int i = 0; i < secret.length; ++i) secret [i] = (uint8) (seed ^ 0x5a);
+          return new Krypt.Dh.Ticket (id, secret, expires);
+        }
+
+      protected override void test ()
         {
-          var size = GLib.Random.int_range ((int32) minsize, (int32) maxsize);
-          var data = new uint8 [size];
+          var cache = new Krypt.Dh.SessionCache (4);
+          var later = GLib.get_monotonic_time () + cache.lifetime;
+          var ticket = make_ticket (1, later);
+          var id = ticket.id;
+
+          cache.put_accepted ((owned) ticket);
+          cache.put_issued ("a", make_ticket (2, later));
+          cache.put_issued ("b", make_ticket (3, GLib.get_monotonic_time () - 1));
+
+          /* tickets are single use, and expired ones are never handed out */
+          GLib.assert_nonnull (cache.take_accepted (id));
+          GLib.assert_null (cache.take_accepted (id));
+          GLib.assert_nonnull (cache.take_issued ("a"));
+          GLib.assert_null (cache.take_issued ("a"));
+          GLib.assert_null (cache.take_issued ("b"));
 
-          for (int i = 0; i < size; ++i) data [i] = (uint8) GLib.Random.int_range (0, uint8.MAX);
-          return new GLib.Bytes.take ((owned) data);
+          for (uint8 i = 0; i < 10; ++i) cache.put_accepted (make_ticket (i, later));
+
+          GLib.assert_cmpuint (cache.length, GLib.CompareOperator.LE, 4);
         }
+    }
+
+  class TestStreamSplice : AsyncTest
+    {
+      const string algo_name = "AES";
+      const string mode_name = "CBC";
 
       protected override async void test ()
         {
@@ -0,0 +1,178 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+namespace Testing
+{
+  public static int main (string[] args)
+    {
+      GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/Krypt/bench/plain", () => (new BenchLoopback (null)).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Krypt/bench/cbc", () => (new BenchLoopback ("CBC")).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Krypt/bench/gcm", () => (new BenchLoopback ("GCM")).run ());
+      return bench_run ();
+    }
+
+  /*
+   * Pushes a fixed amount of data through a loopback TCP connection, either
+   * bare or wrapped in a handshaked Krypt.IOStream, and reports throughput
+   */
+
+  class BenchLoopback : AsyncTest
+    {
+      public string? mode_name { get; construct; }
+      public uint total { get; construct; default = 256 << 20; }
+
+      public BenchLoopback (string? mode_name)
+        {
+          Object (mode_name : mode_name);
+        }
+
+      private async GLib.IOStream[] connect () throws GLib.Error
+        {
+          GLib.Error? error = null;
+          GLib.SocketConnection? accepted = null;
+          var listener = new GLib.SocketListener ();
+          var port = listener.add_any_inet_port (null);
+          var waiting = false;
+
+          listener.accept_async.begin (null, (o, res) =>
+            {
+              try { accepted = listener.accept_async.end (res); } catch (GLib.Error e)
+                {
+                  error = (owned) e;
+                }
+
+              if (waiting) connect.callback ();
+            });
+
+          var client = yield (new GLib.SocketClient ()).connect_to_host_async ("127.0.0.1", port);
+
+          if (accepted == null && error == null)
+            {
+              waiting = true;
+              yield;
+            }
+
+          if (error != null) throw (owned) error;
+          listener.close ();
+          return { client, accepted };
+        }
+
+      private async GLib.IOStream[] handshake (GLib.IOStream client, GLib.IOStream server) throws GLib.Error
+        {
+          GLib.Error? error = null;
+          var pending = 2;
+          var waiting = false;
+
+          var kclient = new Krypt.IOStream ("AES", mode_name, client);
+          var kserver = new Krypt.IOStream ("AES", mode_name, server);
+
+          GLib.AsyncReadyCallback done = (o, res) =>
+            {
+              try
+                {
+                  if (o == kclient)
+
+                    kclient.handshake_client.end (res);
+                  else
+                    kserver.handshake_server.end (res);
+                }
+              catch (GLib.Error e)
+                {
+                  error = (owned) e;
+                }
+
+              if (--pending == 0 && waiting) handshake.callback ();
+            };
+
+          kclient.handshake_client.begin (GLib.Priority.DEFAULT, null, done);
+          kserver.handshake_server.begin (GLib.Priority.DEFAULT, null, done);
+
+          if (pending > 0)
+            {
+              waiting = true;
+              yield;
+            }
+
+          if (error != null) throw (owned) error;
+          return { kclient, kserver };
+        }
+
+      protected override async void test ()
+        {
+          GLib.IOStream[] streams;
+
+          try
+            {
+              streams = yield connect ();
+
+              if (mode_name != null)
+
+                streams = yield handshake (streams [0], streams [1]);
+            }
+          catch (GLib.Error e)
+            {
+              assert_no_error (e);
+              return;
+            }
+
+          var chunk = new uint8 [1 << 16];
+          var received = (size_t) 0;
+          var buffer = new uint8 [1 << 16];
+          unowned var output_stream = streams [0].output_stream;
+          unowned var input_stream = streams [1].input_stream;
+
+          for (int i = 0; i < chunk.length; ++i) chunk [i] = (uint8) GLib.Random.int_range (0, uint8.MAX);
+
+          var timer = new GLib.Timer ();
+          var writer = new GLib.Thread<bool> ("writer", () =>
+            {
+              try { for (uint sent = 0; sent < total; sent += chunk.length) output_stream.write_all (chunk, null); } catch (GLib.Error e)
+                {
+                  assert_no_error (e);
+                }
+              return true;
+            });
+
+          try
+            {
+              ssize_t got;
+
+              while (received < total && (got = input_stream.read (buffer)) > 0) received += got;
+            }
+          catch (GLib.Error e)
+            {
+              assert_no_error (e);
+            }
+
+          writer.join ();
+
+          var elapsed = timer.elapsed ();
+          var rate = (double) received / elapsed / (double) (1 << 20);
+          var name = mode_name ?? "plain TCP";
+
+          GLib.Test.message ("stream: %s, bytes: %u", name, (uint) received);
+          GLib.Test.message ("throughput: %04f MiB/s", rate);
+          bench_result (@"loopback with $name", rate, "MiB/s");
+
+          foreach (unowned var stream in streams) try { stream.close (); } catch (GLib.Error e)
+            {
+              assert_no_error (e);
+            }
+        }
+    }
+}
@@ -0,0 +1,91 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using ScrapperD.Scrapper;
+
+namespace Testing
+{
+  public static int main (string[] args)
+    {
+      GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/LinkSearcher/attributes", () => (new TestLinkSearcher (0)).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/LinkSearcher/bytewise", () => (new TestLinkSearcher (1)).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/LinkSearcher/chunked", () => (new TestLinkSearcher (7)).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/LinkSearcher/comment", () => (new TestLinkSearcherComment ()).run ());
+      return GLib.Test.run ();
+    }
+
+  class TestLinkSearcher : SyncTest
+    {
+      public uint chunksz { get; construct; }
+
+      const string page = """<!DOCTYPE html>
+        <html><head><link rel="stylesheet" HREF='/style.css'><script src=/app.js></script></head>
+        <!-- <a href="/commented"> -- still a comment -->
+        <body><a class="x" href = "/double">one</a><A HREF=/unquoted>two</A>
+        <a data-href="/not-a-link" title='a > b' href='/single' /><area shape=rect href="/area">
+        <img alt="<a href=/neither>" src="  /spaced  "><a href="">empty</a></body></html>""";
+
+      const string[] expected = { "/style.css", "/app.js", "/double", "/unquoted", "/single", "/area", "/spaced" };
+
+      public TestLinkSearcher (uint chunksz)
+        {
+          Object (chunksz : chunksz);
+        }
+
+      protected override void test ()
+        {
+          var searcher = new LinkSearcherConverter ();
+          var data = (uint8[]) page.data;
+
+          if (chunksz == 0)
+
+            searcher.feed (data);
+          else for (int i = 0; i < data.length; i += (int) chunksz)
+            {
+              searcher.feed (data [i : int.min (i + (int) chunksz, data.length)]);
+            }
+
+          var hrefs = searcher.steal_hrefs ();
+          hrefs.reverse ();
+
+          GLib.assert_cmpuint (hrefs.length (), GLib.CompareOperator.EQ, expected.length);
+
+          for (unowned var i = 0; i < expected.length; ++i)
+            {
+              GLib.assert_cmpstr (hrefs.nth_data (i), GLib.CompareOperator.EQ, expected [i]);
+            }
+        }
+    }
+
+  /* a dash run cut short right before a chunk boundary does not end the comment */
+  class TestLinkSearcherComment : SyncTest
+    {
+      const string[] chunks = { "<p><!-- --x", "><a href=\"/commented\"> -->", "<a href=\"/after\">" };
+
+      protected override void test ()
+        {
+          var searcher = new LinkSearcherConverter ();
+
+          foreach (unowned var chunk in chunks) searcher.feed ((uint8[]) chunk.data);
+
+          var hrefs = searcher.steal_hrefs ();
+
+          GLib.assert_cmpuint (hrefs.length (), GLib.CompareOperator.EQ, 1);
+          GLib.assert_cmpstr (hrefs.nth_data (0), GLib.CompareOperator.EQ, "/after");
+        }
+    }
+}
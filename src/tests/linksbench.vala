@@ -0,0 +1,199 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using ScrapperD.Scrapper;
+
+namespace Testing
+{
+  public static int main (string[] args)
+    {
+      GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/LinkSearcher/bench/regex", () => bench_searcher (new RegexLinkSearcher (), "regex"));
+      GLib.Test.add_func (TESTPATHROOT + "/LinkSearcher/bench/tokenizer", () => bench_searcher (new LinkSearcherConverter (), "tokenizer"));
+      return bench_run ();
+    }
+
+  /*
+   * Link searcher as it was before the tokenizer (two partial-matching regexes
+   * run over every chunk), kept here as the reference point.
+   */
+
+  class RegexLinkSearcher : GLib.Object, GLib.Converter
+    {
+      private GLib.SList<string> hrefs;
+      private GLib.Regex[] regexes;
+
+      construct
+        {
+          hrefs = new SList<string> ();
+
+          var compile_options = GLib.RegexCompileFlags.MULTILINE | GLib.RegexCompileFlags.OPTIMIZE | GLib.RegexCompileFlags.RAW;
+          var match_options = GLib.RegexMatchFlags.NOTEMPTY | GLib.RegexMatchFlags.PARTIAL_HARD;
+
+          try
+            {
+              regexes =
+                {
+                  new GLib.Regex ("<a[^>h]*href\\s*=\\s*\"([^\"]+)\"[^>]*>", compile_options, match_options),
+                  new GLib.Regex ("<a[^/h]*href\\s*=\\s*\"([^\"]+)\"[^/]*/>", compile_options, match_options),
+                };
+            }
+          catch (GLib.Error e)
+            {
+              error (@"$(e.domain): $(e.code): $(e.message)");
+            }
+        }
+
+      public GLib.ConverterResult convert (uint8[] inbuf, uint8[] outbuf, GLib.ConverterFlags converter_flags, out size_t bytes_read, out size_t bytes_written) throws GLib.Error
+        {
+          GLib.MatchInfo? info;
+          unowned var input_ = (string) inbuf;
+          var at_end = (converter_flags & (ConverterFlags.FLUSH | ConverterFlags.INPUT_AT_END)) != 0;
+
+          bytes_read = bytes_written = 0;
+
+          foreach (unowned var regex in regexes)
+            {
+              regex.match_full (input_, inbuf.length, 0, 0, out info);
+
+              if (info != null)
+                {
+                  if (info.is_partial_match ())
+                    {
+                      if (! at_end) throw new IOError.PARTIAL_INPUT ("partial match, give me more data to find whole link");
+                    }
+                  else while (info.matches ())
+                    {
+                      hrefs.prepend (info.fetch (1));
+                      info.next ();
+                    }
+                }
+            }
+
+          Memory.copy (& outbuf [0], & inbuf [0], bytes_read = bytes_written = size_t.min (inbuf.length, outbuf.length));
+          return ! at_end ? ConverterResult.CONVERTED : ConverterResult.FINISHED;
+        }
+
+      public void reset ()
+        {
+        }
+
+      public GLib.SList<string> steal_hrefs ()
+        {
+          var hrefs_ = (owned) hrefs;
+            hrefs = new GLib.SList<string> ();
+          return (owned) hrefs_;
+        }
+    }
+
+  static GLib.Bytes[]? corpus = null;
+
+  /*
+   * Pages are read from the directory named by SCRAPPERD_BENCH_CORPUS (saved
+   * pages, one per file), or synthesized when it is not set.
+   */
+
+  static unowned GLib.Bytes[] load_corpus ()
+    {
+      if (corpus != null) return corpus;
+
+      unowned string? path;
+      var pages = new GLib.GenericArray<GLib.Bytes> ();
+
+      if ((path = GLib.Environment.get_variable ("SCRAPPERD_BENCH_CORPUS")) != null)
+        {
+          try
+            {
+              var dir = GLib.Dir.open (path);
+              unowned string? name;
+
+              while ((name = dir.read_name ()) != null)
+                {
+                  uint8[] contents;
+                  GLib.FileUtils.get_data (GLib.Path.build_filename (path, name), out contents);
+                  pages.add (new GLib.Bytes.take ((owned) contents));
+                }
+            }
+          catch (GLib.Error e)
+            {
+              assert_no_error (e);
+            }
+        }
+      else for (uint i = 0; i < 32; ++i)
+        {
+          var builder = new GLib.StringBuilder.sized (1 << 18);
+
+          builder.append ("<!DOCTYPE html><html><head><title>page</title><link rel=\"stylesheet\" href=\"/style.css\"></head><body>\n");
+
+          while (builder.len < (1 << 18))
+            {
+              switch (GLib.Random.int_range (0, 6))
+                {
+                  case 0: builder.append_printf ("<p class=\"text\">%s</p>\n", string.nfill (GLib.Random.int_range (64, 512), 'x')); break;
+                  case 1: builder.append_printf ("<a href=\"/page/%u\" title=\"link\">link</a>\n", GLib.Random.next_int ()); break;
+                  case 2: builder.append_printf ("<img src=\"/img/%u.png\" alt=\"image\"/>\n", GLib.Random.next_int ()); break;
+                  case 3: builder.append_printf ("<div id=\"d%u\"><span>%s</span></div>\n", GLib.Random.next_int (), string.nfill (64, 'y')); break;
+                  case 4: builder.append ("<!-- some comment about the <a href=\"/commented\"> markup -->\n"); break;
+                  case 5: builder.append_printf ("<script>var a = %u < b;</script>\n", GLib.Random.next_int ()); break;
+                }
+            }
+
+          builder.append ("</body></html>\n");
+          pages.add (new GLib.Bytes (builder.str.data));
+        }
+
+      corpus = pages.steal ();
+      return corpus;
+    }
+
+  static void bench_searcher (GLib.Converter searcher, string name)
+    {
+      var buffer = new uint8 [1 << 14];
+      var links = 0u;
+      var total = (size_t) 0;
+      var timer = new GLib.Timer ();
+
+      foreach (unowned var page in load_corpus ())
+        {
+          var stream = new GLib.ConverterInputStream (new GLib.MemoryInputStream.from_bytes (page), searcher);
+
+          try
+            {
+              ssize_t got;
+              while ((got = stream.read (buffer)) > 0) total += got;
+            }
+          catch (GLib.Error e)
+            {
+              assert_no_error (e);
+            }
+
+          searcher.reset ();
+        }
+
+      var elapsed = timer.elapsed ();
+      var rate = (double) total / elapsed / (double) (1 << 20);
+
+      if (searcher is LinkSearcherConverter)
+
+        links = ((LinkSearcherConverter) searcher).steal_hrefs ().length ();
+      else
+        links = ((RegexLinkSearcher) searcher).steal_hrefs ().length ();
+
+      GLib.Test.message ("%s: bytes %u, links %u", name, (uint) total, links);
+      GLib.Test.message ("%s: throughput %04f MiB/s", name, rate);
+      bench_result (@"$name link searcher", rate, "MiB/s");
+    }
+}
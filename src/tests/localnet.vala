@@ -0,0 +1,193 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using Kademlia;
+
+namespace Testing
+{
+  public class TestHub : GLib.Object, PeerProvider
+    {
+      private HashTable<Key, ValuePeer> table;
+
+      construct
+        {
+          table = new HashTable<Key, ValuePeer> (Key.hash, Key.equal);
+        }
+
+      public TestHub (int min_nodes = 100, int max_nodes = 1000)
+        {
+          for (unowned var i = 0; i < GLib.Random.int_range (min_nodes, max_nodes); ++i)
+            {
+              add_peer (new DummyValueStore ());
+            }
+        }
+
+      public unowned TestValuePeer add_peer (ValueStore value_store)
+        {
+          var id = new Key.random ();
+          var peer = new TestValuePeer (value_store, id, this);
+
+          table.insert ((owned) id, peer);
+          return (TestValuePeer) table.lookup (peer.id);
+        }
+
+      public GLib.List<unowned ValuePeer> list_peers ()
+        {
+          return table.get_values ();
+        }
+
+      public GLib.List<unowned Key> list_peers_id ()
+        {
+          return table.get_keys ();
+        }
+
+      public async ValuePeer pick (Key id)
+        {
+          var peer = table.lookup (id); assert (peer != null);
+          return (owned) peer;
+        }
+
+      public async ValuePeer pick_any () requires (table.length > 0)
+        {
+          var iter = HashTableIter<Key, ValuePeer> (table);
+          var peer = (ValuePeer?) null;
+          iter.next (null, out peer);
+          return (owned) peer;
+        }
+    }
+
+  public class TestValuePeer : ValuePeer
+    {
+      unowned TestHub net;
+
+      /* FindValues and StoreMany calls made, the keys they carried, and what cancelled the last one */
+      public uint batched { get; private set; default = 0; }
+      public uint batches { get; private set; default = 0; }
+      public GLib.Cancellable? batch_cancellable { get; private set; default = null; }
+
+      /* milliseconds every value call waits before reaching the other end */
+      public uint delay { get; set; default = 0; }
+
+      /* whether calls from other peers reach this one at all */
+      public bool online { get; set; default = true; }
+
+      public TestValuePeer (ValueStore value_store, Key id, TestHub net)
+        {
+          base (value_store, id);
+          this.net = net;
+        }
+
+      private void count_batch (uint keys, GLib.Cancellable? cancellable)
+        {
+          batch_cancellable = cancellable;
+          batched += keys;
+          ++batches;
+        }
+
+      async ValuePeer getother (Key peer) throws GLib.Error
+        {
+          ValuePeer other;
+
+          if ((other = yield net.pick (peer)) == null)
+
+            throw new PeerError.UNREACHABLE ("no node in net with id (%s)", peer.to_string ());
+
+          if (((TestValuePeer) other).online == false)
+
+            throw new PeerError.UNREACHABLE ("node %s is offline", peer.to_string ());
+
+          return other;
+        }
+
+      async void stall ()
+        {
+          if (delay == 0)
+
+            return;
+
+          GLib.Timeout.add (delay, stall.callback);
+          yield;
+        }
+
+      protected async override KeyVal[] find_peer (Key peer, Key id, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var other = yield getother (peer);
+          var peers = yield other.find_peer_complete (this.id, id, cancellable);
+
+          foreach (var val in peers)
+            {
+              if (this.id.equal_val (val) == false) buckets.insert (new Key.from_val (val));
+            }
+          return (owned) peers;
+        }
+
+      protected async override Kademlia.Value find_value (Key peer, Key id, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          yield stall ();
+
+          var other = yield getother (peer);
+          var value = yield other.find_value_complete (this.id, id, trace, cancellable);
+
+          if (value.is_delegated)
+          foreach (unowned var peer_ in value.keys)
+            {
+              if (Key.equal (peer_, this.id) == false) buckets.insert (peer_);
+            }
+
+          return (owned) value;
+        }
+
+      protected async override Kademlia.Value[] find_values (Key peer, Key[] ids, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          count_batch (ids.length, cancellable);
+          yield stall ();
+
+          var other = yield getother (peer);
+          var values = yield other.find_values_complete (this.id, ids, trace, cancellable);
+
+          foreach (unowned var value in values) if (value.is_delegated)
+          foreach (unowned var peer_ in value.keys)
+            {
+              if (Key.equal (peer_, this.id) == false) buckets.insert (peer_);
+            }
+
+          return (owned) values;
+        }
+
+      protected async override bool store_value (Key peer, Key id, GLib.Value? value, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          yield stall ();
+
+          var other = yield getother (peer);
+          return yield other.store_value_complete (this.id, id, value, trace, cancellable);
+        }
+
+      protected async override bool store_values (Key peer, Key[] ids, GLib.Value?[] values, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          count_batch (ids.length, cancellable);
+          yield stall ();
+
+          var other = yield getother (peer);
+          return yield other.store_values_complete (this.id, ids, values, trace, cancellable);
+        }
+
+      protected async override bool ping_peer (Key peer, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var other = yield getother (peer);
+          return yield other.ping_peer_complete (this.id, cancellable);
+        }
+    }
+}
@@ -0,0 +1,121 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using Kademlia;
+
+namespace Testing
+{
+  public static int main (string[] args)
+    {
+      GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/LookupNode/bench/sequential", () => (new BenchLookupNode (new TestHub (500, 501), 1)).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/LookupNode/bench/concurrent", () => (new BenchLookupNode (new TestHub (500, 501), 32)).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Insert/bench/sequential", () => (new BenchLookupNode (new TestHub (500, 501), 1, true)).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Insert/bench/concurrent", () => (new BenchLookupNode (new TestHub (500, 501), 32, true)).run ());
+      return bench_run ();
+    }
+
+  [CCode (cheader_filename = "time.h", cname = "clock")]
+  extern long cpu_clock ();
+  [CCode (cheader_filename = "time.h", cname = "CLOCKS_PER_SEC")]
+  extern const long CLOCKS_PER_SEC;
+
+  public class BenchLookupNode : TestIntegrationConnect
+    {
+      public uint concurrency { get; construct; }
+      public bool insert { get; construct; }
+      public uint lookups { get; construct; default = 2000; }
+
+      /* inserts (or looks up) on an in-process cluster, recording every operation latency */
+      public BenchLookupNode (PeerProvider net, uint concurrency, bool insert = false)
+        {
+          Object (net : net, concurrency : concurrency, insert : insert);
+        }
+
+      private async void operate (ValuePeer peer) throws GLib.Error
+        {
+          if (insert == false)
+
+            yield peer.lookup_node (new Key.random ());
+          else
+            {
+              var value = GLib.Value (typeof (uint));
+
+              value.set_uint (GLib.Random.next_int ());
+              yield peer.insert (new Key.random (), value);
+            }
+        }
+
+      protected override async void test ()
+        {
+          yield base.test ();
+          var peer = yield net.pick_any ();
+          var latencies = new double [lookups];
+          var name = insert ? "insert" : "lookup_node";
+          var pending = lookups;
+          var running = 0u;
+          var waiting = false;
+
+          var timer = new GLib.Timer ();
+          var clock = cpu_clock ();
+
+          while (pending > 0 || running > 0)
+            {
+              while (pending > 0 && running < concurrency)
+                {
+                  var at = --pending;
+                  var started = GLib.get_monotonic_time ();
+
+                  ++running;
+
+                  operate.begin (peer, (o, res) =>
+                    {
+                      try { ((BenchLookupNode) o).operate.end (res); } catch (GLib.Error e)
+                        {
+                          assert_no_error (e);
+                        }
+
+                      latencies [at] = (double) (GLib.get_monotonic_time () - started) / 1e6;
+                      --running;
+
+                      if (waiting)
+                        {
+                          waiting = false;
+                          test.callback ();
+                        }
+                    });
+                }
+
+              if (running > 0)
+                {
+                  waiting = true;
+                  yield;
+                }
+            }
+
+          var elapsed = timer.elapsed ();
+          var cpu = (double) (cpu_clock () - clock) / (double) CLOCKS_PER_SEC;
+
+          GLib.Test.message ("%s: %u, concurrency: %u", name, lookups, concurrency);
+          GLib.Test.message ("%s per second: %04f", name, (double) lookups / elapsed);
+          GLib.Test.message ("cpu seconds per %s: %06f", name, cpu / (double) lookups);
+
+          bench_result (@"$name at concurrency $concurrency", (double) lookups / elapsed, "operations/s");
+          bench_result (@"$name cpu at concurrency $concurrency", cpu / (double) lookups, "s", false);
+          bench_samples (@"$name latency at concurrency $concurrency", latencies);
+        }
+    }
+}
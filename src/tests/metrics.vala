@@ -0,0 +1,169 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using Metrics;
+
+namespace Testing
+{
+  public static int main (string[] args)
+    {
+      GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/Metrics/counter", () => test_counter (8, 10000));
+      GLib.Test.add_func (TESTPATHROOT + "/Metrics/histogram", () => test_histogram ());
+      GLib.Test.add_func (TESTPATHROOT + "/Metrics/overflow", () => test_overflow ());
+      GLib.Test.add_func (TESTPATHROOT + "/Metrics/prometheus", () => test_prometheus ());
+      GLib.Test.add_func (TESTPATHROOT + "/Metrics/trace/sampled", () => test_trace_sampled ());
+      GLib.Test.add_func (TESTPATHROOT + "/Metrics/trace/unsampled", () => test_trace_unsampled ());
+      return GLib.Test.run ();
+    }
+
+  static void test_counter (uint threads, uint increments)
+    {
+      var counter = new Counter ();
+      var workers = new GLib.Thread<bool> [threads];
+
+      for (uint i = 0; i < threads; ++i)
+        {
+          workers [i] = new GLib.Thread<bool> ("counter", () =>
+            {
+              for (uint j = 0; j < increments; ++j) counter.inc ();
+              return true;
+            });
+        }
+
+      foreach (unowned var worker in workers) worker.join ();
+      assert_cmpuint ((uint) counter.read (), CompareOperator.EQ, threads * increments);
+    }
+
+  static void test_histogram ()
+    {
+      var buckets = new uint64 [BUCKETS];
+      var histogram = new Histogram (1);
+      uint64 count, sum;
+
+      /* shards sit on cache lines of their own only if the cells start on one */
+      assert_cmpuint ((uint) (((size_t) (void*) histogram) % 64), CompareOperator.EQ, 0);
+
+      histogram.observe (0);
+      histogram.observe (1);
+      histogram.observe (5);
+      histogram.observe (7);
+      histogram.observe (8);
+      histogram.read (buckets, out sum, out count);
+
+      assert_cmpuint ((uint) count, CompareOperator.EQ, 5);
+      assert_cmpuint ((uint) sum, CompareOperator.EQ, 21);
+      assert_cmpuint ((uint) buckets [0], CompareOperator.EQ, 1);
+      assert_cmpuint ((uint) buckets [1], CompareOperator.EQ, 1);
+      assert_cmpuint ((uint) buckets [3], CompareOperator.EQ, 2);
+      assert_cmpuint ((uint) buckets [4], CompareOperator.EQ, 1);
+    }
+
+  static void test_overflow ()
+    {
+      var registry = new Registry ();
+
+      for (uint i = 0; i < Registry.MAXSERIES + 10; ++i)
+        {
+          registry.counter ("test_series_total", "series", @"id=\"$i\"").inc ();
+        }
+
+      var snapshot = registry.snapshot ();
+      unowned var overflow = snapshot.lookup ("test_series_total{" + Registry.OVERFLOW + "}");
+
+      assert_nonnull (overflow);
+      assert_cmpfloat (overflow.get_double (), CompareOperator.EQ, 10);
+
+      /* overflowed label sets keep resolving to the overflow series */
+      unowned var first = registry.counter ("test_series_total", "series", @"id=\"$(Registry.MAXSERIES)\"");
+      unowned var again = registry.counter ("test_series_total", "series", @"id=\"$(Registry.MAXSERIES)\"");
+
+      assert_true (first == again);
+      assert_true (first == registry.counter ("test_series_total", "series", Registry.OVERFLOW));
+    }
+
+  static void test_prometheus ()
+    {
+      var registry = new Registry ();
+
+      registry.counter ("test_pages_total", "pages", "result=\"fetched\"").add (3);
+      registry.gauge ("test_keys", "keys").set (-2);
+      registry.histogram ("test_seconds", "latency", 1e-6).observe (3);
+
+      var text = registry.to_prometheus ();
+
+      assert_true (text.contains ("# TYPE test_pages_total counter\n"));
+      assert_true (text.contains ("test_pages_total{result=\"fetched\"} 3\n"));
+      assert_true (text.contains ("# TYPE test_keys gauge\n"));
+      assert_true (text.contains ("test_keys -2\n"));
+      assert_true (text.contains ("# TYPE test_seconds histogram\n"));
+      assert_true (text.contains ("test_seconds_bucket{le=\"+Inf\"} 1\n"));
+      assert_true (text.contains ("test_seconds_count 1\n"));
+    }
+
+  static void test_trace_sampled ()
+    {
+      var tracer = Tracer.get_default ();
+
+      tracer.clear ();
+      tracer.rate = 1;
+
+      var root = Span (tracer.sample ());
+      var child = Span (root.child ());
+
+      tracer.rate = 0;
+
+      assert_true (root.sampled ());
+      assert_true (child.trace == root.trace && child.parent == root.id);
+
+      child.end ("child", "a \"quoted\" detail");
+      root.end ("root");
+
+      var spans = tracer.collect ();
+      var first = spans [0].name == "root" ? 0 : 1;
+
+      assert_cmpint (spans.length, CompareOperator.EQ, 2);
+      assert_cmpstr (spans [first].name, CompareOperator.EQ, "root");
+      assert_cmpstr (spans [1 - first].name, CompareOperator.EQ, "child");
+      assert_true (spans [first].parent == 0);
+      assert_true (spans [1 - first].parent == spans [first].id);
+
+      var chrome = tracer.to_chrome_trace ();
+      var otlp = tracer.to_otlp_json ();
+
+      assert_true (chrome.has_prefix ("{\"traceEvents\":[{\"name\":"));
+      assert_true (chrome.contains ("\"ph\":\"X\""));
+      assert_true (chrome.contains ("\"detail\":\"a \\\"quoted\\\" detail\""));
+      assert_true (otlp.contains ("\"parentSpanId\":"));
+      assert_true (otlp.contains ("\"name\":\"child\""));
+    }
+
+  static void test_trace_unsampled ()
+    {
+      var tracer = Tracer.get_default ();
+
+      tracer.clear ();
+      tracer.rate = 0;
+
+      var root = Span (tracer.sample ());
+
+      root.end ("root");
+      Span (root.child ()).end ("child");
+
+      assert_false (root.sampled ());
+      assert_cmpint (tracer.collect ().length, CompareOperator.EQ, 0);
+    }
+}
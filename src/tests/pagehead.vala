@@ -0,0 +1,98 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using Kademlia;
+using ScrapperD.Scrapper;
+
+namespace Testing
+{
+  public static int main (string[] args)
+    {
+      GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/PageHead/roundtrip", () => (new TestPageHead ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/PageHead/stale", () => (new TestPageHeadStale ()).run ());
+      return GLib.Test.run ();
+    }
+
+  class TestPageHead : SyncTest
+    {
+
+      protected override void test ()
+        {
+          var id = new Key.random ();
+          var head = new PageHead ();
+
+          GLib.assert_cmpuint (head.latest, GLib.CompareOperator.EQ, 0);
+          GLib.assert_cmpuint (head.append (100), GLib.CompareOperator.EQ, 1);
+          GLib.assert_cmpuint (head.append (200), GLib.CompareOperator.EQ, 2);
+
+          head.attributes.insert ("etag", "\"abc\"");
+
+          try
+            {
+              var copy = new PageHead.from_bytes (head.to_bytes ());
+
+              GLib.assert_cmpuint (copy.latest, GLib.CompareOperator.EQ, 2);
+              GLib.assert_cmpuint (copy.versions.length, GLib.CompareOperator.EQ, 2);
+              GLib.assert_cmpint ((int) copy.versions.index (0).scraped, GLib.CompareOperator.EQ, 100);
+              GLib.assert_cmpstr (copy.attributes.lookup ("etag"), GLib.CompareOperator.EQ, "\"abc\"");
+            }
+          catch (GLib.Error e)
+            {
+              assert_no_error (e);
+            }
+
+          /* legacy a(maysa{ss}) values are not page heads */
+          try
+            {
+              var legacy = new GLib.Variant.array (new GLib.VariantType ("(maysa{ss})"), { });
+              new PageHead.from_bytes (legacy.get_data_as_bytes ());
+              GLib.assert_not_reached ();
+            }
+          catch (GLib.Error e)
+            {
+            }
+
+          GLib.assert_false (Key.equal (PageHead.version_key (id, 1), PageHead.version_key (id, 2)));
+          GLib.assert_true (Key.equal (PageHead.version_key (id, 1), PageHead.version_key (id.copy (), 1)));
+          GLib.assert_false (Key.equal (PageHead.version_key (id, 1), id));
+        }
+    }
+
+  class TestPageHeadStale : SyncTest
+    {
+
+      protected override void test ()
+        {
+          var head = new PageHead ();
+
+          head.append (1000);
+
+          GLib.assert_false (head.is_stale (1500, 1000));
+          GLib.assert_true (head.is_stale (2000, 1000));
+
+          head.attributes.insert ("verified", "3000");
+
+          GLib.assert_false (head.is_stale (2000, 1000));
+          GLib.assert_true (head.is_stale (4000, 1000));
+
+          head.attributes.insert ("max-age", "1");
+
+          GLib.assert_false (head.is_stale (4000, 1000));
+          GLib.assert_true (head.is_stale (3000 + GLib.TimeSpan.SECOND, 1000));
+        }
+    }
+}
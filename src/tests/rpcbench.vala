@@ -0,0 +1,155 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using Kademlia;
+using Kademlia.DBus;
+
+namespace Testing
+{
+  public static int main (string[] args)
+    {
+      GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/Rpc/bench/dbus/sequential", () => (new BenchRpc ("dbus", 1)).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Rpc/bench/dbus/pipelined", () => (new BenchRpc ("dbus", 64)).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Rpc/bench/wire/sequential", () => (new BenchRpc ("wire", 1)).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Rpc/bench/wire/pipelined", () => (new BenchRpc ("wire", 64)).run ());
+      return bench_run ();
+    }
+
+  /*
+   * Issues FindNode calls against a peer living behind a loopback hub, over
+   * either transport, keeping up to concurrency of them in flight, and
+   * reports calls per second plus the mean latency of each call
+   */
+
+  class BenchRpc : AsyncTest
+    {
+      public uint calls { get; construct; default = 20000; }
+      public uint concurrency { get; construct; }
+      public string transport { get; construct; }
+
+      private Hub? client = null;
+      private Hub? server = null;
+
+      public BenchRpc (string transport, uint concurrency)
+        {
+          Object (concurrency : concurrency, transport : transport);
+        }
+
+      private async Role connect (PeerImpl peer) throws GLib.Error
+        {
+          Address address;
+
+          if (transport == "dbus")
+            {
+              var server = new NetworkHub ();
+              var client = new NetworkHub ();
+
+              server.add_local_peer ("bench", peer);
+              yield server.add_local_address ("127.0.0.1", 0);
+              server.start ();
+
+              address = server.list_local_addresses () [0];
+              yield client.join_at (address.address, address.port, "bench");
+
+              this.client = client;
+              this.server = server;
+            }
+          else
+            {
+              var server = new WireHub ();
+              var client = new WireHub ();
+
+              server.add_local_peer ("bench", peer);
+              yield server.add_local_address ("127.0.0.1", 0);
+              server.start ();
+
+              address = server.list_local_addresses () [0];
+              yield client.join_at (address.address, address.port, "bench");
+
+              this.client = client;
+              this.server = server;
+            }
+
+          return yield client.lookup_role (peer.id);
+        }
+
+      protected override async void test ()
+        {
+          Role role;
+          var peer = new PeerImpl (new DummyValueStore ());
+
+          for (uint i = 0; i < 100; ++i) peer.add_contact (new Key.random ());
+
+          try { role = yield connect (peer); } catch (GLib.Error e)
+            {
+              assert_no_error (e);
+              return;
+            }
+
+          var from = PeerRef.anonymous (new Key.random ().bytes);
+          var latency = (int64) 0;
+          var pending = calls;
+          var running = 0u;
+          var waiting = false;
+          var timer = new GLib.Timer ();
+
+          while (pending > 0 || running > 0)
+            {
+              while (pending > 0 && running < concurrency)
+                {
+                  var started = GLib.get_monotonic_time ();
+
+                  --pending;
+                  ++running;
+
+                  role.find_node.begin (from, KeyRef (new Key.random ().bytes), Metrics.TraceContext (), null, (o, res) =>
+                    {
+                      try { ((Role) o).find_node.end (res); } catch (GLib.Error e)
+                        {
+                          assert_no_error (e);
+                        }
+
+                      latency += GLib.get_monotonic_time () - started;
+                      --running;
+
+                      if (waiting)
+                        {
+                          waiting = false;
+                          test.callback ();
+                        }
+                    });
+                }
+
+              if (running > 0)
+                {
+                  waiting = true;
+                  yield;
+                }
+            }
+
+          var elapsed = timer.elapsed ();
+          var mean = (double) latency / (double) calls / 1e6;
+
+          GLib.Test.message ("transport: %s, calls: %u, concurrency: %u", transport, calls, concurrency);
+          GLib.Test.message ("calls per second: %04f", (double) calls / elapsed);
+          GLib.Test.message ("mean latency: %06fus", 1e6 * mean);
+
+          bench_result (@"$transport FindNode at concurrency $concurrency", (double) calls / elapsed, "calls/s");
+          bench_result (@"$transport FindNode latency at concurrency $concurrency", mean, "s", false);
+        }
+    }
+}
@@ -0,0 +1,88 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using Kademlia;
+using ScrapperD.Scrapper;
+
+namespace Testing
+{
+  public static int main (string[] args)
+    {
+      GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/SeenFilter/false_positives", () => (new TestSeenFilter (false)).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/SeenFilter/merge", () => (new TestSeenFilter (true)).run ());
+      return GLib.Test.run ();
+    }
+
+  class TestSeenFilter : SyncTest
+    {
+      public bool merge { get; construct; }
+
+      const uint KEYCOUNT = 200000;
+      const uint PROBES = 100000;
+
+      public TestSeenFilter (bool merge)
+        {
+          Object (merge : merge);
+        }
+
+      protected override void test ()
+        {
+          var filter1 = new SeenFilter ();
+          var filter2 = new SeenFilter ();
+          var keycount = merge ? KEYCOUNT >> 1 : KEYCOUNT;
+          var keys = new Key [keycount];
+
+          for (uint i = 0; i < keycount; ++i)
+            {
+              keys [i] = new Key.random ();
+              ((merge && (i & 1) == 1) ? filter2 : filter1).add (keys [i]);
+            }
+
+          if (merge)
+            {
+              try
+                {
+                  filter1 = new SeenFilter.from_bytes (filter1.to_bytes ());
+                  filter1.merge_bytes (filter2.to_bytes ());
+                }
+              catch (GLib.Error e)
+                {
+                  assert_no_error (e);
+                  return;
+                }
+            }
+
+          foreach (unowned var key in keys)
+            {
+              GLib.assert_true (filter1.contains (key));
+              GLib.assert_true (filter1.check (key) != SeenAnswer.ABSENT);
+            }
+
+          var positives = 0u;
+
+          for (uint i = 0; i < PROBES; ++i)
+            {
+              var key = new Key.random ();
+              if (filter1.check (key) != SeenAnswer.ABSENT) ++positives;
+            }
+
+          GLib.Test.message ("false positives: %u/%u", positives, PROBES);
+          GLib.assert_cmpfloat ((double) positives / (double) PROBES, GLib.CompareOperator.LT, 0.02);
+          GLib.assert_cmpfloat (filter1.hit_rate, GLib.CompareOperator.GT, 0.0);
+        }
+    }
+}
@@ -0,0 +1,651 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using Kademlia;
+
+namespace Testing
+{
+  /*
+   * Deterministic in-process network: thousands of SimPeers exchange RPCs over
+   * an in-memory bus with a simulated clock. Every message takes a latency
+   * drawn from the net's own seeded generator (or gets lost, with probability
+   * loss), and run () advances the clock from event to event rather than
+   * waiting on the wall clock, so two runs with the same seed behave alike.
+   */
+
+  public enum SimOperation
+    {
+      INSERT,
+      LOOKUP_NODE,
+      LOOKUP_VALUE,
+    }
+
+  public class SimNet : GLib.Object
+    {
+      [Compact (opaque = true)]
+
+      class Event
+        {
+          public GLib.SourceFunc callback;
+          public int64 due;
+          public uint64 sequence;
+
+          public Event (int64 due, uint64 sequence, owned GLib.SourceFunc callback)
+            {
+              this.callback = (owned) callback;
+              this.due = due;
+              this.sequence = sequence;
+            }
+        }
+
+      public int64 jitter { get; set; default = 20 * Buckets.USEC_PER_SEC / 1000; }
+      public int64 latency { get; set; default = 10 * Buckets.USEC_PER_SEC / 1000; }
+      public double loss { get; set; default = 0; }
+      public uint64 messages { get; private set; default = 0; }
+      public int64 now { get; private set; default = 0; }
+      public uint online { get; private set; default = 0; }
+      public uint32 seed { get; construct; }
+      public int64 timeout { get; set; default = Buckets.USEC_PER_SEC; }
+
+      private uint count = 0;
+      private Event?[] heap = new Event? [64];
+      private GLib.HashTable<unowned Key, unowned SimPeer> index;
+      private GenericArray<SimPeer> peers;
+      private GLib.Rand rand;
+      private uint64 sequence = 0;
+
+      public uint length { get { return peers.length; } }
+
+      construct
+        {
+          index = new GLib.HashTable<unowned Key, unowned SimPeer> (Key.hash, Key.equal);
+          peers = new GenericArray<SimPeer> ();
+          rand = new GLib.Rand.with_seed (seed);
+        }
+
+      public SimNet (uint32 seed = 0)
+        {
+          Object (seed : seed);
+        }
+
+      static int compare_distance (Key a, Key b)
+        {
+          return GLib.Memory.cmp (a.bytes, b.bytes, a.bytes.length);
+        }
+
+      /* the n online peers truly closest to target (by whole xor distance), closest first */
+      public Key[] closest (Key target, uint n)
+        {
+          var distances = new Key [n];
+          var got = (uint) 0;
+          var ids = new Key [n];
+
+          foreach (unowned var peer in peers) if (peer.online)
+            {
+              var distance = Key.xor (peer.id, target);
+              uint at;
+
+              if (got == n && compare_distance (distance, distances [n - 1]) >= 0)
+
+                continue;
+
+              for (at = got < n ? got++ : n - 1; at > 0 && compare_distance (distance, distances [at - 1]) < 0; --at)
+                {
+                  distances [at] = (owned) distances [at - 1];
+                  ids [at] = (owned) ids [at - 1];
+                }
+
+              distances [at] = (owned) distance;
+              ids [at] = peer.id.copy ();
+            }
+
+          ids.resize ((int) got);
+          return (owned) ids;
+        }
+
+      /* takes fraction of the online peers down and lets as many fresh ones join */
+      public void churn (double fraction)
+        {
+          var leaving = (uint) (fraction * online);
+
+          for (uint i = 0; i < leaving; ++i)
+            {
+              pick ().online = false;
+              --online;
+            }
+
+          grow (leaving);
+        }
+
+      /* mean fraction of each key's k closest online peers holding it */
+      public double coverage (Key[] keys)
+        {
+          var sum = (double) 0;
+
+          foreach (unowned var key in keys)
+            {
+              var closest = closest (key, Buckets.MAXSPAN);
+              var held = 0;
+
+              foreach (unowned var id in closest) if (index.lookup (id).store.contains (key)) ++held;
+              sum += closest.length == 0 ? 0 : (double) held / closest.length;
+            }
+
+          return keys.length == 0 ? 0 : sum / keys.length;
+        }
+
+      /* spawns nodes peers, each one joining through a random online one */
+      public void grow (uint nodes)
+        {
+          for (uint i = 0; i < nodes; ++i)
+            {
+              Key? bootstrap = null;
+              var peer = new SimPeer (this, random_key ());
+
+              if (online > 0) bootstrap = pick ().id.copy ();
+
+              index.insert (peer.id, peer);
+              peers.add (peer);
+              ++online;
+
+              if (bootstrap == null)
+
+                continue;
+
+              peer.join.begin (bootstrap, null, (o, res) =>
+                {
+                  try { ((SimPeer) o).join.end (res); } catch (GLib.Error e)
+                    {
+                      warning ("%s: %u: %s", e.domain.to_string (), e.code, e.message);
+                    }
+                });
+
+              run ();
+            }
+        }
+
+      public bool is_online (Key id)
+        {
+          unowned SimPeer? peer;
+          return (peer = index.lookup (id)) != null && peer.online;
+        }
+
+      /*
+       * Runs operation once per target, one after the other, each from a random
+       * online peer, and tallies what each one cost
+       */
+      public SimRound measure (SimOperation operation, Key[] targets)
+        {
+          var round = new SimRound (targets.length);
+
+          foreach (unowned var target in targets)
+            {
+              var done = false;
+              var found = false;
+              var started = now;
+              var finished = now;
+              unowned var origin = pick ();
+
+              origin.tally = new SimTally ();
+
+              operate.begin (origin, operation, target, (o, res) =>
+                {
+                  try { found = ((SimNet) o).operate.end (res); } catch (GLib.Error e)
+                    {
+                      warning ("%s: %u: %s", e.domain.to_string (), e.code, e.message);
+                    }
+
+                  done = true;
+                  finished = now;
+                });
+
+              run ();
+              assert (done);
+
+              round.add (origin.tally, finished - started, found);
+              origin.tally = null;
+            }
+
+          return round;
+        }
+
+      private async bool operate (SimPeer origin, SimOperation operation, Key target) throws GLib.Error
+        {
+          switch (operation)
+            {
+              case SimOperation.INSERT:
+                {
+                  var value = GLib.Value (typeof (uint));
+
+                  value.set_uint (rand.next_int ());
+                  return (yield origin.insert_replicated (target, value)) > 0;
+                }
+
+              case SimOperation.LOOKUP_NODE:
+                {
+                  var closest = closest (target, 1);
+                  var found = yield origin.lookup_node (target);
+
+                  foreach (unowned var key in found) if (Key.equal (key, closest [0])) return true;
+
+                  return false;
+                }
+
+              case SimOperation.LOOKUP_VALUE:
+
+                return (yield origin.lookup (target)) != null;
+
+              default: assert_not_reached ();
+            }
+        }
+
+      public unowned SimPeer pick () requires (online > 0)
+        {
+          unowned var peer = peers [rand.int_range (0, peers.length)];
+
+          while (peer.online == false) peer = peers [rand.int_range (0, peers.length)];
+          return peer;
+        }
+
+      public Key random_key ()
+        {
+          var bytes = new uint8 [Key.BITLEN >> 3];
+
+          for (int i = 0; i < bytes.length; ++i) bytes [i] = (uint8) rand.int_range (0, 256);
+          return new Key.verbatim (bytes);
+        }
+
+      public Key[] random_keys (uint n)
+        {
+          var keys = new Key [n];
+
+          for (uint i = 0; i < n; ++i) keys [i] = random_key ();
+          return (owned) keys;
+        }
+
+      /* delivers the request leg of an RPC, handing back the peer it reached */
+      internal async SimPeer request (SimPeer from, Key to, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          unowned SimPeer? other = index.lookup (to);
+
+          if (other == null || other.online == false || transmit (from) == false)
+            {
+              yield sleep (timeout);
+              if (from.tally != null) ++from.tally.timeouts;
+              throw new PeerError.UNREACHABLE ("no reply from %s", to.to_string ());
+            }
+
+          yield sleep (transit ());
+          give_up (from, cancellable);
+          return other;
+        }
+
+      /* delivers the reply leg of an RPC back to from */
+      internal async void respond (SimPeer from, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          if (transmit (from) == false)
+            {
+              yield sleep (timeout);
+              if (from.tally != null) ++from.tally.timeouts;
+              throw new PeerError.UNREACHABLE ("reply lost");
+            }
+
+          yield sleep (transit ());
+          give_up (from, cancellable);
+        }
+
+      /* throws when the caller cancelled the RPC while it was in transit, tallying it */
+      private static void give_up (SimPeer from, GLib.Cancellable? cancellable) throws GLib.Error
+        {
+          if (cancellable == null || cancellable.is_cancelled () == false)
+
+            return;
+
+          if (from.tally != null) ++from.tally.cancelled;
+          cancellable.set_error_if_cancelled ();
+        }
+
+      /*
+       * Drains the queued events in (simulated) time order, letting whatever they
+       * wake up run to its next wait before the clock moves again
+       */
+      public void run ()
+        {
+          Event? event;
+          var context = GLib.MainContext.ref_thread_default ();
+
+          do
+            {
+              while (context.pending ()) context.iteration (false);
+
+              if ((event = pop ()) != null)
+                {
+                  now = event.due;
+                  event.callback ();
+                }
+            }
+          while (event != null);
+        }
+
+      private async void sleep (int64 usec)
+        {
+          if (count == heap.length) heap.resize (heap.length << 1);
+
+          heap [count] = new Event (now + usec, sequence++, sleep.callback);
+          sift_up (count++);
+          yield;
+        }
+
+      /* minimum latency plus an exponentially distributed tail averaging jitter */
+      private int64 transit ()
+        {
+          return latency + (int64) (- (double) jitter * Math.log (1 - rand.next_double ()));
+        }
+
+      private bool transmit (SimPeer from)
+        {
+          ++messages;
+          if (from.tally != null) ++from.tally.messages;
+          return loss <= 0 || rand.next_double () >= loss;
+        }
+
+      static bool before (Event a, Event b)
+        {
+          return a.due < b.due || (a.due == b.due && a.sequence < b.sequence);
+        }
+
+      private Event? pop ()
+        {
+          if (count == 0)
+
+            return null;
+          else
+            {
+              var top = (owned) heap [0];
+
+              if (--count > 0)
+                {
+                  heap [0] = (owned) heap [count];
+                  sift_down (0);
+                }
+
+              return (owned) top;
+            }
+        }
+
+      private void sift_down (uint i)
+        {
+          uint least;
+
+          while (true)
+            {
+              var left = (i << 1) + 1;
+              var right = left + 1;
+
+              least = i;
+
+              if (left < count && before (heap [left], heap [least])) least = left;
+              if (right < count && before (heap [right], heap [least])) least = right;
+              if (least == i) break;
+
+              swap (i, least);
+              i = least;
+            }
+        }
+
+      private void sift_up (uint i)
+        {
+          while (i > 0)
+            {
+              var parent = (i - 1) >> 1;
+
+              if (before (heap [i], heap [parent]) == false) break;
+
+              swap (i, parent);
+              i = parent;
+            }
+        }
+
+      private void swap (uint a, uint b)
+        {
+          var t = (owned) heap [a];
+          heap [a] = (owned) heap [b];
+          heap [b] = (owned) t;
+        }
+    }
+
+  public class SimPeer : ValuePeer
+    {
+      public unowned SimNet net;
+      public bool online { get; internal set; default = true; }
+      public SimStore store { get { return (SimStore) value_store; } }
+
+      internal SimTally? tally = null;
+
+      public SimPeer (SimNet net, Key id)
+        {
+          base (new SimStore (), id);
+          this.net = net;
+        }
+
+      /* adds what peer answered to routing, tracking (when measured) how deep into the crawl it was found */
+      private void learn (Key peer, KeyVal[] contacts)
+        {
+          uint depth = 1;
+
+          if (tally != null)
+            {
+              depth = uint.max (1, tally.depths.lookup (peer));
+              tally.hops = uint.max (tally.hops, depth);
+            }
+
+          foreach (var val in contacts)
+            {
+              var contact = new Key.from_val (val);
+
+              if (Key.equal (contact, this.id) == false) add_contact (contact);
+              if (tally == null) continue;
+
+              ++tally.contacts;
+              if (net.is_online (contact) == false) ++tally.stale;
+              if (tally.depths.contains (contact) == false) tally.depths.insert ((owned) contact, depth + 1);
+            }
+        }
+
+      protected async override KeyVal[] find_peer (Key peer, Key id, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var other = yield net.request (this, peer, cancellable);
+          var peers = yield other.find_peer_complete (this.id, id, cancellable);
+
+          yield net.respond (this, cancellable);
+          learn (peer, peers);
+          return (owned) peers;
+        }
+
+      protected async override Kademlia.Value find_value (Key peer, Key id, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var other = yield net.request (this, peer, cancellable);
+          var value = yield other.find_value_complete (this.id, id, trace, cancellable);
+
+          yield net.respond (this, cancellable);
+          learn (peer, value.is_delegated ? value.keys : new Key [0]);
+          return (owned) value;
+        }
+
+      protected async override Kademlia.Value[] find_values (Key peer, Key[] ids, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var other = yield net.request (this, peer, cancellable);
+          var values = yield other.find_values_complete (this.id, ids, trace, cancellable);
+
+          yield net.respond (this, cancellable);
+          foreach (unowned var value in values) learn (peer, value.is_delegated ? value.keys : new Key [0]);
+          return (owned) values;
+        }
+
+      protected async override bool ping_peer (Key peer, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var other = yield net.request (this, peer, cancellable);
+          var alive = yield other.ping_peer_complete (this.id, cancellable);
+
+          yield net.respond (this, cancellable);
+          return alive;
+        }
+
+      protected async override bool store_value (Key peer, Key id, GLib.Value? value, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var other = yield net.request (this, peer, cancellable);
+          var stored = yield other.store_value_complete (this.id, id, value, trace, cancellable);
+
+          yield net.respond (this, cancellable);
+          return stored;
+        }
+
+      protected async override bool store_values (Key peer, Key[] ids, GLib.Value?[] values, Metrics.TraceContext trace, GLib.Cancellable? cancellable = null) throws GLib.Error
+        {
+          var other = yield net.request (this, peer, cancellable);
+          var stored = yield other.store_values_complete (this.id, ids, values, trace, cancellable);
+
+          yield net.respond (this, cancellable);
+          return stored;
+        }
+    }
+
+  /* what a single measured operation cost */
+  [Compact (opaque = true)]
+
+  public class SimTally
+    {
+      public uint cancelled = 0;
+      public uint contacts = 0;
+      public GLib.HashTable<Key, uint> depths = new GLib.HashTable<Key, uint> (Key.hash, Key.equal);
+      public uint hops = 0;
+      public uint messages = 0;
+      public uint stale = 0;
+      public uint timeouts = 0;
+
+      public SimTally ()
+        {
+        }
+    }
+
+  /* samples gathered over a SimNet.measure round */
+  [Compact (opaque = true)]
+
+  public class SimRound
+    {
+      public uint cancelled = 0;
+      public uint contacts = 0;
+      public uint found = 0;
+      public double[] hops;
+      public double[] latencies;
+      public double[] messages;
+      public uint operations = 0;
+      public uint stale = 0;
+      public uint timeouts = 0;
+
+      public SimRound (uint operations)
+        {
+          hops = new double [operations];
+          latencies = new double [operations];
+          messages = new double [operations];
+        }
+
+      public void add (SimTally tally, int64 elapsed, bool found)
+        {
+          cancelled += tally.cancelled;
+          contacts += tally.contacts;
+          hops [operations] = tally.hops;
+          latencies [operations] = (double) elapsed / Buckets.USEC_PER_SEC;
+          messages [operations] = tally.messages;
+          stale += tally.stale;
+          timeouts += tally.timeouts;
+
+          if (found) ++this.found;
+          ++operations;
+        }
+
+      public static double mean (double[] samples)
+        {
+          var sum = (double) 0;
+
+          foreach (unowned var sample in samples) sum += sample;
+          return samples.length == 0 ? 0 : sum / samples.length;
+        }
+
+      /* fraction of the contacts peers answered with that were already gone */
+      public double stale_rate ()
+        {
+          return contacts == 0 ? 0 : (double) stale / contacts;
+        }
+
+      public double success_rate ()
+        {
+          return operations == 0 ? 0 : (double) found / operations;
+        }
+    }
+
+  public class SimStore : GLib.Object, ValueStore
+    {
+      private GLib.HashTable<Key, GLib.Value?> values;
+
+      public uint length { get { return values.length; } }
+
+      construct
+        {
+          values = new GLib.HashTable<Key, GLib.Value?> (Key.hash, Key.equal);
+        }
+
+      public bool contains (Key id)
+        {
+          return values.contains (id);
+        }
+
+      /* every value counts as stale, so tests drive republication by hand */
+      public override async Key[] enumerate_staled_values (GLib.Cancellable? cancellable)
+        {
+          var keys = new Key [values.length];
+          var i = 0;
+
+          foreach (unowned var key in values.get_keys ()) keys [i++] = key.copy ();
+          return (owned) keys;
+        }
+
+      public async bool insert_value (Key id, GLib.Value? value, GLib.Cancellable? cancellable)
+        {
+          var val = GLib.Value (value.type ());
+
+          value.copy (ref val);
+          values.insert (id.copy (), (owned) val);
+          return true;
+        }
+
+      public async GLib.Value? lookup_value (Key id, GLib.Cancellable? cancellable)
+        {
+          unowned GLib.Value? value;
+
+          if (values.lookup_extended (id, null, out value) == false)
+
+            return null;
+          else
+            {
+              var copy = GLib.Value (value.type ());
+
+              value.copy (ref copy);
+              return (owned) copy;
+            }
+        }
+    }
+}
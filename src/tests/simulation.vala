@@ -0,0 +1,393 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using Kademlia;
+
+namespace Testing
+{
+  public static int main (string[] args)
+    {
+      GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/Simulation/churn", () => (new TestSimulationChurn ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Simulation/crawl", () => (new TestSimulationCrawl ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Simulation/deterministic", () => (new TestSimulationDeterministic ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Simulation/lookup", () => (new TestSimulationLookup ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Simulation/quorum", () => (new TestSimulationQuorum ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Simulation/republish", () => (new TestSimulationRepublish ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Simulation/traced", () => (new TestSimulationTraced ()).run ());
+      return GLib.Test.run ();
+    }
+
+  class TestSimulationChurn : SyncTest
+    {
+      protected override void test ()
+        {
+          var net = new SimNet (3);
+
+          net.grow (300);
+          net.measure (SimOperation.INSERT, net.random_keys (20));
+          net.churn (0.3);
+
+          var round = net.measure (SimOperation.LOOKUP_NODE, net.random_keys (50));
+
+          assert_cmpuint (net.online, GLib.CompareOperator.EQ, 300);
+          assert_cmpuint (net.length, GLib.CompareOperator.EQ, 390);
+          assert_cmpuint (round.stale, GLib.CompareOperator.GT, 0);
+          assert_cmpuint (round.timeouts, GLib.CompareOperator.GT, 0);
+        }
+    }
+
+  /*
+   * Crawls against an exhaustive one, which asks every other peer once (at
+   * most ALPHA at a time): node lookups and value misses converge well before,
+   * value hits stop sooner still and cancel whatever they had in flight
+   */
+
+  class TestSimulationCrawl : SyncTest
+    {
+      const uint COUNT = 20;
+
+      static LookupNodeCrawler lookup_node (SimNet net, Key target) throws GLib.Error
+        {
+          var crawler = new LookupNodeCrawler (net.pick (), target.copy (), Metrics.TraceContext ());
+          var done = false;
+
+          crawler.crawl.begin (null, (o, res) =>
+            {
+              try { ((LookupNodeCrawler) o).crawl.end (res); } catch (GLib.Error e)
+                {
+                  assert_no_error (e);
+                }
+
+              done = true;
+            });
+
+          net.run ();
+          assert_true (done);
+          return crawler;
+        }
+
+      static LookupValueCrawler lookup_value (SimNet net, Key target, out bool found, out uint cancelled) throws GLib.Error
+        {
+          unowned var origin = net.pick ();
+          var crawler = new LookupValueCrawler (origin, target.copy (), Metrics.TraceContext ());
+          var done = false;
+          var hit = false;
+
+          origin.tally = new SimTally ();
+
+          crawler.crawl.begin (null, (o, res) =>
+            {
+              try { hit = ((LookupValueCrawler) o).crawl.end (res) != null; } catch (GLib.Error e)
+                {
+                  assert_no_error (e);
+                }
+
+              done = true;
+            });
+
+          /* runs on past the crawl's end, until every cancelled call gave up */
+          net.run ();
+          assert_true (done);
+
+          found = hit;
+          cancelled = origin.tally.cancelled;
+          origin.tally = null;
+          return crawler;
+        }
+
+      protected override void test ()
+        {
+          var net = new SimNet (13);
+
+          net.grow (300);
+
+          var keys = net.random_keys (COUNT);
+          var inserts = net.measure (SimOperation.INSERT, keys);
+          var exhaustive_rpcs = net.online - 1;
+          var exhaustive_rounds = exhaustive_rpcs / Peer.ALPHA;
+
+          assert_cmpuint (inserts.found, GLib.CompareOperator.EQ, COUNT);
+
+          uint cancelled = 0;
+          uint hit_rpcs = 0;
+          uint miss_rpcs = 0;
+
+          try
+            {
+              foreach (unowned var key in net.random_keys (COUNT))
+                {
+                  var crawler = lookup_node (net, key);
+
+                  assert_cmpuint (crawler.rpcs, GLib.CompareOperator.LT, exhaustive_rpcs);
+                  assert_cmpuint (crawler.rounds, GLib.CompareOperator.LT, exhaustive_rounds);
+                }
+
+              foreach (unowned var key in net.random_keys (COUNT))
+                {
+                  bool found;
+                  uint gave_up;
+                  var crawler = lookup_value (net, key, out found, out gave_up);
+
+                  assert_false (found);
+                  assert_cmpuint (crawler.rpcs, GLib.CompareOperator.LT, exhaustive_rpcs);
+                  assert_cmpuint (crawler.rounds, GLib.CompareOperator.LT, exhaustive_rounds);
+                  miss_rpcs += crawler.rpcs;
+                }
+
+              foreach (unowned var key in keys)
+                {
+                  bool found;
+                  uint gave_up;
+                  var crawler = lookup_value (net, key, out found, out gave_up);
+
+                  assert_true (found);
+                  assert_cmpuint (crawler.rpcs, GLib.CompareOperator.LT, exhaustive_rpcs);
+                  assert_cmpuint (crawler.rounds, GLib.CompareOperator.LT, exhaustive_rounds);
+                  cancelled += gave_up;
+                  hit_rpcs += crawler.rpcs;
+                }
+            }
+          catch (GLib.Error e)
+            {
+              assert_no_error (e);
+            }
+
+          assert_cmpuint (hit_rpcs, GLib.CompareOperator.LT, miss_rpcs);
+          assert_cmpuint (cancelled, GLib.CompareOperator.GT, 0);
+        }
+    }
+
+  class TestSimulationDeterministic : SyncTest
+    {
+      static SimRound simulate (out int64 now, out uint64 messages)
+        {
+          var net = new SimNet (7);
+
+          net.loss = 0.05;
+          net.grow (200);
+
+          var round = net.measure (SimOperation.LOOKUP_NODE, net.random_keys (30));
+
+          now = net.now;
+          messages = net.messages;
+          return round;
+        }
+
+      protected override void test ()
+        {
+          int64 now1, now2;
+          uint64 messages1, messages2;
+          var round1 = simulate (out now1, out messages1);
+          var round2 = simulate (out now2, out messages2);
+
+          assert_cmpint ((int) (now1 - now2), GLib.CompareOperator.EQ, 0);
+          assert_cmpuint ((uint) (messages1 - messages2), GLib.CompareOperator.EQ, 0);
+          assert_cmpuint (round1.found, GLib.CompareOperator.EQ, round2.found);
+
+          for (int i = 0; i < round1.operations; ++i)
+            {
+              assert_cmpfloat (round1.hops [i], GLib.CompareOperator.EQ, round2.hops [i]);
+              assert_cmpfloat (round1.latencies [i], GLib.CompareOperator.EQ, round2.latencies [i]);
+              assert_cmpfloat (round1.messages [i], GLib.CompareOperator.EQ, round2.messages [i]);
+            }
+        }
+    }
+
+  class TestSimulationLookup : SyncTest
+    {
+      protected override void test ()
+        {
+          var net = new SimNet (5);
+
+          net.grow (300);
+
+          var keys = net.random_keys (20);
+          var inserts = net.measure (SimOperation.INSERT, keys);
+          var lookups = net.measure (SimOperation.LOOKUP_NODE, net.random_keys (50));
+          var values = net.measure (SimOperation.LOOKUP_VALUE, keys);
+
+          assert_cmpuint (inserts.found, GLib.CompareOperator.EQ, keys.length);
+          assert_cmpfloat (lookups.success_rate (), GLib.CompareOperator.GE, 0.9);
+          assert_cmpfloat (SimRound.mean (lookups.hops), GLib.CompareOperator.GE, 1);
+          assert_cmpuint (lookups.stale, GLib.CompareOperator.EQ, 0);
+          assert_cmpuint (values.found, GLib.CompareOperator.EQ, keys.length);
+          assert_cmpfloat (net.coverage (keys), GLib.CompareOperator.GE, 0.5);
+        }
+    }
+
+  /*
+   * A net smaller than a bucket has fewer closest peers than write_quorum
+   * asks for, storing on all of them is as quorate as it gets
+   */
+
+  class TestSimulationQuorum : SyncTest
+    {
+      protected override void test ()
+        {
+          var net = new SimNet (19);
+          var done = false;
+          var quorate = false;
+          var value = GLib.Value (typeof (uint));
+
+          net.grow (6);
+          value.set_uint (7);
+
+          unowned var origin = net.pick ();
+
+          origin.write_quorum = Buckets.MAXSPAN;
+          origin.insert.begin (net.random_key (), value, null, (o, res) =>
+            {
+              try { quorate = ((SimPeer) o).insert.end (res); } catch (GLib.Error e)
+                {
+                  assert_no_error (e);
+                }
+
+              done = true;
+            });
+
+          net.run ();
+
+          assert_true (done);
+          assert_true (quorate);
+        }
+    }
+
+  /*
+   * Republishes keys sharing only their first few bits, whose k closest nodes
+   * differ once the net is this large, next to a run of keys so close together
+   * that a single lookup serves them all: replicas land on each key's true k
+   * closest nodes about as well as when every key gets inserted on its own
+   */
+
+  class TestSimulationRepublish : SyncTest
+    {
+      const uint CLUSTERED = 8;
+      const uint PREFIX = 6;
+      const uint SCATTERED = 24;
+
+      /* key taking its first bits bits from prefix and the rest from rest */
+      static Key with_prefix (Key prefix, Key rest, uint bits)
+        {
+          var bytes = (uint8[]) rest.bytes.copy ();
+
+          for (uint i = 0; i < bits; ++i)
+            {
+              var mask = (uint8) (0x80 >> (i & 7));
+              bytes [i >> 3] = (uint8) ((bytes [i >> 3] & ~mask) | (prefix.bytes [i >> 3] & mask));
+            }
+
+          return new Key.verbatim (bytes);
+        }
+
+      protected override void test ()
+        {
+          var net = new SimNet (17);
+
+          net.grow (2000);
+
+          unowned var origin = net.pick ();
+          var anchor = net.random_key ();
+          var clustered = new Key [CLUSTERED];
+          var done = false;
+          var inserted = new Key [SCATTERED];
+          var scattered = new Key [SCATTERED];
+
+          for (uint i = 0; i < CLUSTERED; ++i) clustered [i] = with_prefix (anchor, net.random_key (), Key.BITLEN - 8);
+
+          for (uint i = 0; i < SCATTERED; ++i)
+            {
+              inserted [i] = with_prefix (anchor, net.random_key (), PREFIX);
+              scattered [i] = with_prefix (anchor, net.random_key (), PREFIX);
+            }
+
+          for (uint i = 0; i < CLUSTERED + SCATTERED; ++i)
+            {
+              var value = GLib.Value (typeof (uint));
+
+              value.set_uint (i);
+              origin.store.insert_value.begin (i < CLUSTERED ? clustered [i] : scattered [i - CLUSTERED], value, null);
+            }
+
+          origin.republisher.jitter = 0;
+          origin.republisher.step.begin (null, (o, res) =>
+            {
+              try { ((Republisher) o).step.end (res); } catch (GLib.Error e)
+                {
+                  assert_no_error (e);
+                }
+
+              done = true;
+            });
+
+          net.run ();
+          assert_true (done);
+
+          var inserts = net.measure (SimOperation.INSERT, inserted);
+          var baseline = net.coverage (inserted);
+
+          GLib.Test.message ("coverage: clustered %.3f, scattered %.3f, inserted %.3f; %u lookups",
+            net.coverage (clustered), net.coverage (scattered), baseline, origin.republisher.lookups);
+
+          assert_cmpuint (inserts.found, GLib.CompareOperator.EQ, SCATTERED);
+          assert_cmpuint (origin.republisher.republished, GLib.CompareOperator.EQ, CLUSTERED + SCATTERED);
+          assert_cmpuint (origin.republisher.lookups, GLib.CompareOperator.LE, SCATTERED + 1);
+          assert_cmpfloat (net.coverage (clustered), GLib.CompareOperator.GE, baseline - 0.1);
+          assert_cmpfloat (net.coverage (scattered), GLib.CompareOperator.GE, baseline - 0.1);
+        }
+    }
+
+  class TestSimulationTraced : SyncTest
+    {
+      protected override void test ()
+        {
+          var net = new SimNet (11);
+          var tracer = Metrics.Tracer.get_default ();
+
+          net.grow (100);
+          tracer.clear ();
+          tracer.rate = 1;
+          net.measure (SimOperation.LOOKUP_NODE, net.random_keys (1));
+          tracer.rate = 0;
+
+          var spans = tracer.collect ();
+          var rounds = new GLib.GenericSet<uint64?> (GLib.int64_hash, GLib.int64_equal);
+          var roots = 0;
+          var rpcs = 0;
+
+          assert_cmpuint (spans.length, GLib.CompareOperator.GT, 0);
+
+          foreach (unowned var span in spans)
+            {
+              assert_true (span.trace == spans [0].trace);
+              assert_cmpint ((int) (span.end - span.start), GLib.CompareOperator.GE, 0);
+
+              if (span.name == "lookup node") ++roots;
+              if (span.name == "round") rounds.add (span.id);
+            }
+
+          foreach (unowned var span in spans) if (span.name == "FindNode")
+            {
+              assert_true (rounds.contains (span.parent));
+              ++rpcs;
+            }
+
+          assert_cmpint (roots, GLib.CompareOperator.EQ, 1);
+          assert_cmpuint (rounds.length, GLib.CompareOperator.GT, 0);
+          assert_cmpint (rpcs, GLib.CompareOperator.GE, (int) rounds.length);
+        }
+    }
+}
@@ -0,0 +1,89 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using Kademlia;
+
+namespace Testing
+{
+  public static int main (string[] args)
+    {
+      GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/Simulation/bench/1000", () => bench_simulation (1000));
+      GLib.Test.add_func (TESTPATHROOT + "/Simulation/bench/10000", () => bench_simulation (10000));
+      GLib.Test.add_func (TESTPATHROOT + "/Simulation/bench/churn", () => bench_simulation_churn (2000, 5, 0.1));
+      return bench_run ();
+    }
+
+  static void report_round (string name, SimRound round)
+    {
+      GLib.Test.message ("%s: %u operations, %u succeeded", name, round.operations, round.found);
+      GLib.Test.message ("%s: %04f hops, %04f messages, %04f stale", name, SimRound.mean (round.hops), SimRound.mean (round.messages), round.stale_rate ());
+
+      bench_result (@"$name success rate", round.success_rate (), "ratio");
+      bench_result (@"$name stale contacts", round.stale_rate (), "ratio", false);
+      bench_result (@"$name timeouts per operation", (double) round.timeouts / round.operations, "timeouts", false);
+      bench_samples (@"$name hops", round.hops, "hops");
+      bench_samples (@"$name latency", round.latencies);
+      bench_samples (@"$name messages", round.messages, "messages");
+    }
+
+  /* a network of the given size, as is: lookups, replicated inserts and how far they reached */
+  static void bench_simulation (uint nodes, uint operations = 200)
+    {
+      var net = new SimNet (nodes);
+      var timer = new GLib.Timer ();
+
+      net.grow (nodes);
+
+      var joined = timer.elapsed ();
+      var keys = net.random_keys (operations);
+
+      report_round (@"simulated lookup_node on $nodes nodes", net.measure (SimOperation.LOOKUP_NODE, net.random_keys (operations)));
+      report_round (@"simulated insert on $nodes nodes", net.measure (SimOperation.INSERT, keys));
+      report_round (@"simulated lookup on $nodes nodes", net.measure (SimOperation.LOOKUP_VALUE, keys));
+
+      GLib.Test.message ("nodes: %u, join wall time: %04fs, messages: %s", nodes, joined, net.messages.to_string ());
+
+      bench_result (@"simulated replication coverage on $nodes nodes", net.coverage (keys), "ratio");
+      bench_result (@"simulated join messages per node on $nodes nodes", (double) net.messages / nodes, "messages", false);
+    }
+
+  /* replaces fraction of the nodes every round, with some loss on the wire */
+  static void bench_simulation_churn (uint nodes, uint rounds, double fraction, uint operations = 200)
+    {
+      var net = new SimNet (nodes);
+
+      net.loss = 0.01;
+      net.grow (nodes);
+
+      var keys = net.random_keys (operations);
+
+      net.measure (SimOperation.INSERT, keys);
+
+      for (uint i = 1; i <= rounds; ++i)
+        {
+          net.churn (fraction);
+
+          var coverage = net.coverage (keys);
+
+          report_round (@"simulated lookup_node after churn round $i", net.measure (SimOperation.LOOKUP_NODE, net.random_keys (operations)));
+          report_round (@"simulated lookup after churn round $i", net.measure (SimOperation.LOOKUP_VALUE, keys));
+
+          GLib.Test.message ("churn round %u: %u nodes ever, coverage %04f", i, net.length, coverage);
+          bench_result (@"simulated replication coverage after churn round $i", coverage, "ratio");
+        }
+    }
+}
@@ -0,0 +1,206 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using Kademlia;
+using ScrapperD.Storage;
+
+namespace Testing
+{
+  public static int main (string[] args)
+    {
+      GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/Storage/DiskStore/compact", () => (new TestDiskStoreCompact ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Storage/DiskStore/foreign_index", () => (new TestDiskStoreForeignIndex ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Storage/DiskStore/reopen", () => (new TestDiskStoreReopen ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Storage/DiskStore/torn", () => (new TestDiskStoreTorn ()).run ());
+      return GLib.Test.run ();
+    }
+
+  public abstract class TestDiskStore : AsyncTest
+    {
+      protected string directory;
+
+      construct
+        {
+          try { directory = GLib.DirUtils.make_tmp ("scrapperd-XXXXXX"); } catch (GLib.Error e)
+            {
+              assert_no_error (e);
+            }
+        }
+
+      public override void dispose ()
+        {
+          GLib.FileUtils.unlink (GLib.Path.build_filename (directory, "values.idx"));
+          GLib.FileUtils.unlink (GLib.Path.build_filename (directory, "values.log"));
+          GLib.DirUtils.remove (directory);
+          base.dispose ();
+        }
+
+      protected static async void check (DiskStore store, Key key, string? expected) throws GLib.Error
+        {
+          var value = yield store.lookup_value (key, null);
+
+          if (expected == null)
+
+            assert_true (value == null);
+          else
+            assert_cmpstr (value.get_string (), CompareOperator.EQ, expected);
+        }
+    }
+
+  public class TestDiskStoreCompact : TestDiskStore
+    {
+      protected override async void test ()
+        {
+          var keys = new Key [32];
+
+          for (int i = 0; i < keys.length; ++i) keys [i] = new Key.random ();
+
+          try
+            {
+              var store = new DiskStore (directory);
+
+              for (int i = 0; i < keys.length; ++i) yield store.insert_value (keys [i], "first %i".printf (i), null);
+              for (int i = 0; i < keys.length; i += 2) yield store.insert_value (keys [i], "second %i".printf (i), null);
+              for (int i = 0; i < keys.length; i += 4) yield store.insert_value (keys [i], null, null);
+
+              yield store.compact ();
+
+              for (int i = 0; i < keys.length; ++i) yield check (store, keys [i], i % 4 == 0 ? null : "%s %i".printf (i % 2 == 0 ? "second" : "first", i));
+
+              store = new DiskStore (directory);
+
+              for (int i = 0; i < keys.length; ++i) yield check (store, keys [i], i % 4 == 0 ? null : "%s %i".printf (i % 2 == 0 ? "second" : "first", i));
+            }
+          catch (GLib.Error e)
+            {
+              assert_no_error (e);
+            }
+        }
+    }
+
+  /* an index left by some other log is neither trusted nor kept */
+  public class TestDiskStoreForeignIndex : TestDiskStore
+    {
+      protected override async void test ()
+        {
+          var key1 = new Key.random ();
+          var key2 = new Key.random ();
+
+          try
+            {
+              uint8[] contents;
+              var other = GLib.DirUtils.make_tmp ("scrapperd-XXXXXX");
+              var path = GLib.Path.build_filename (directory, "values.idx");
+              var store = new DiskStore (directory);
+              var foreign = new DiskStore (other);
+
+              yield store.insert_value (key1, "value 1", null);
+              yield store.compact ();
+              yield foreign.insert_value (key2, "value 2", null);
+              yield foreign.compact ();
+
+              store = null;
+              foreign = null;
+
+              GLib.FileUtils.get_data (GLib.Path.build_filename (other, "values.idx"), out contents);
+              GLib.FileUtils.set_data (path, contents);
+              GLib.FileUtils.unlink (GLib.Path.build_filename (other, "values.idx"));
+              GLib.FileUtils.unlink (GLib.Path.build_filename (other, "values.log"));
+              GLib.DirUtils.remove (other);
+
+              store = new DiskStore (directory);
+
+              yield check (store, key1, "value 1");
+              yield check (store, key2, null);
+              assert_false (GLib.FileUtils.test (path, GLib.FileTest.EXISTS));
+            }
+          catch (GLib.Error e)
+            {
+              assert_no_error (e);
+            }
+        }
+    }
+
+  public class TestDiskStoreReopen : TestDiskStore
+    {
+      protected override async void test ()
+        {
+          var key1 = new Key.random ();
+          var key2 = new Key.random ();
+
+          try
+            {
+              var store = new DiskStore (directory);
+
+              yield store.insert_value (key1, "value 1", null);
+              yield store.insert_value (key2, "value 2", null);
+              yield store.insert_value (key2, null, null);
+              yield check (store, key1, "value 1");
+              yield check (store, key2, null);
+
+              store = new DiskStore (directory);
+
+              yield check (store, key1, "value 1");
+              yield check (store, key2, null);
+            }
+          catch (GLib.Error e)
+            {
+              assert_no_error (e);
+            }
+        }
+    }
+
+  public class TestDiskStoreTorn : TestDiskStore
+    {
+      protected override async void test ()
+        {
+          var key1 = new Key.random ();
+          var key2 = new Key.random ();
+
+          try
+            {
+              var store = new DiskStore (directory);
+              var path = GLib.Path.build_filename (directory, "values.log");
+
+              yield store.insert_value (key1, "value 1", null);
+              yield store.insert_value (key2, "value 2", null);
+
+              store = null;
+
+              var stream = GLib.File.new_for_path (path).open_readwrite ();
+              var size = stream.query_info (GLib.FileAttribute.STANDARD_SIZE).get_size ();
+
+              stream.truncate (size - 4);
+              stream.close ();
+
+              store = new DiskStore (directory);
+
+              yield check (store, key1, "value 1");
+              yield check (store, key2, null);
+              yield store.insert_value (key2, "value 3", null);
+
+              store = new DiskStore (directory);
+
+              yield check (store, key2, "value 3");
+            }
+          catch (GLib.Error e)
+            {
+              assert_no_error (e);
+            }
+        }
+    }
+}
@@ -0,0 +1,124 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using Kademlia;
+using ScrapperD.Storage;
+
+namespace Testing
+{
+  public static int main (string[] args)
+    {
+      GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/Storage/Store/bench/1", () => bench_store (1));
+      GLib.Test.add_func (TESTPATHROOT + "/Storage/Store/bench/2", () => bench_store (2));
+      GLib.Test.add_func (TESTPATHROOT + "/Storage/Store/bench/4", () => bench_store (4));
+      GLib.Test.add_func (TESTPATHROOT + "/Storage/Store/bench/8", () => bench_store (8));
+      return bench_run ();
+    }
+
+  static void wait_for (ref bool done)
+    {
+      var context = GLib.MainContext.get_thread_default ();
+      while (! done) context.iteration (true);
+    }
+
+  static void insert_sync (Store store, Key key, GLib.Value? value)
+    {
+      var done = false;
+
+      store.insert_value.begin (key, value, null, (o, res) =>
+        {
+          try { ((Store) o).insert_value.end (res); } catch (GLib.Error e)
+            {
+              assert_no_error (e);
+            }
+
+          done = true;
+        });
+
+      wait_for (ref done);
+    }
+
+  static void lookup_sync (Store store, Key key)
+    {
+      var done = false;
+
+      store.lookup_value.begin (key, null, (o, res) =>
+        {
+          try { assert_nonnull (((Store) o).lookup_value.end (res)); } catch (GLib.Error e)
+            {
+              assert_no_error (e);
+            }
+
+          done = true;
+        });
+
+      wait_for (ref done);
+    }
+
+  /* one write every ten operations, over a page-sized variant */
+  static void worker (Store store, Key[] keys, GLib.Value page, uint operations, uint32 seed)
+    {
+      var context = new GLib.MainContext ();
+      var rand = new GLib.Rand.with_seed (seed);
+
+      context.push_thread_default ();
+
+      for (uint i = 0; i < operations; ++i)
+        {
+          unowned var key = keys [rand.int_range (0, keys.length)];
+
+          if (i % 10 == 0)
+            insert_sync (store, key, page);
+          else
+            lookup_sync (store, key);
+        }
+
+      context.pop_thread_default ();
+    }
+
+  static void bench_store (uint threads, uint operations = 400000, uint keycount = 4096)
+    {
+      var context = new GLib.MainContext ();
+      var keys = new Key [keycount];
+      var page = GLib.Value (typeof (GLib.Variant));
+      var store = new Store ();
+      var timer = new GLib.Timer ();
+      var workers = new GLib.Thread<void> [threads];
+
+      page.set_variant (new GLib.Variant.from_bytes (GLib.VariantType.BYTESTRING, new GLib.Bytes (new uint8 [1 << 20]), true));
+      context.push_thread_default ();
+
+      for (uint i = 0; i < keycount; ++i) insert_sync (store, keys [i] = new Key.random (), page);
+
+      context.pop_thread_default ();
+      timer.start ();
+
+      for (uint i = 0; i < threads; ++i)
+        {
+          var seed = i;
+          workers [i] = new GLib.Thread<void> ("worker", () => worker (store, keys, page, operations / threads, seed));
+        }
+
+      foreach (unowned var thread in workers) thread.join ();
+
+      var elapsed = timer.elapsed ();
+
+      GLib.Test.message ("threads: %u, keys: %u, operations: %u", threads, keycount, operations);
+      GLib.Test.message ("operations per second: %04f", (double) operations / elapsed);
+      bench_result (@"Store with $threads threads", (double) operations / elapsed, "operations/s");
+    }
+}
@@ -0,0 +1,378 @@
+/* Copyright 2024-2029
+ * This file is part of ScrapperD.
+ *
+ * ScrapperD is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * ScrapperD is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with ScrapperD. If not, see <http://www.gnu.org/licenses/>.
+ */
+using Kademlia;
+using Kademlia.DBus;
+
+namespace Testing
+{
+  public static int main (string[] args)
+    {
+      GLib.Test.init (ref args, null);
+      GLib.Test.add_func (TESTPATHROOT + "/Transport/datagram/find_node", () => (new TestDatagramFindNode ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Transport/datagram/ping", () => (new TestDatagramPing ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Transport/datagram/unlinked", () => (new TestDatagramUnlinked ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Transport/wire/cancel", () => (new TestWireCancel ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Transport/wire/find_value", () => (new TestWireFindValue ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Transport/wire/find_values", () => (new TestWireFindValues ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Transport/wire/store", () => (new TestWireStore ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Transport/wire/store_many", () => (new TestWireStoreMany ()).run ());
+      GLib.Test.add_func (TESTPATHROOT + "/Transport/wire/trace", () => (new TestWireTrace ()).run ());
+      return GLib.Test.run ();
+    }
+
+  /* value store whose lookups take longer than any caller in here waits */
+  public class StallingValueStore : GLib.Object, ValueStore
+    {
+      public uint stall { get; construct; default = 2000; }
+
+      public override async Key[] enumerate_staled_values (GLib.Cancellable? cancellable)
+        {
+          return new Key [0];
+        }
+
+      public async bool insert_value (Key id, GLib.Value? value, GLib.Cancellable? cancellable)
+        {
+          return true;
+        }
+
+      public async GLib.Value? lookup_value (Key id, GLib.Cancellable? cancellable)
+        {
+          GLib.Timeout.add (stall, lookup_value.callback);
+          yield;
+          return null;
+        }
+    }
+
+  /*
+   * One peer served by a loopback WireHub and a second hub dialing it;
+   * subclasses get the role the dialing hub resolved for the served peer
+   */
+
+  public abstract class TestWireBase : AsyncTest
+    {
+      protected PeerRef from;
+      protected PeerImpl peer;
+
+      construct
+        {
+          from = PeerRef.anonymous (new Key.random ().bytes);
+          peer = new PeerImpl (create_store ());
+        }
+
+      protected virtual ValueStore create_store ()
+        {
+          return new DummyValueStore ();
+        }
+
+      protected abstract async void exercise (Role role) throws GLib.Error;
+
+      protected static GLib.Variant pack (string value)
+        {
+          return GValr.nat2net (value);
+        }
+
+      protected override async void test ()
+        {
+          Address address;
+          Role role;
+
+          var client = new WireHub ();
+          var server = new WireHub ();
+
+          try
+            {
+              server.add_local_peer ("testing", peer);
+              yield server.add_local_address ("127.0.0.1", 0);
+              server.start ();
+
+              address = server.list_local_addresses () [0];
+              yield client.join_at (address.address, address.port, "testing");
+
+              role = yield client.lookup_role (peer.id);
+            }
+          catch (GLib.Error e)
+            {
+              assert_no_error (e);
+              return;
+            }
+
+          try { yield exercise (role); } catch (GLib.Error e)
+            {
+              assert_no_error (e);
+            }
+
+          server.stop ();
+        }
+    }
+
+  public class TestWireCancel : TestWireBase
+    {
+
+      protected override ValueStore create_store ()
+        {
+          return new StallingValueStore ();
+        }
+
+      protected override async void exercise (Role role) throws GLib.Error
+        {
+          var cancellable = new GLib.Cancellable ();
+          var key = KeyRef (new Key.random ().bytes);
+          var timer = new GLib.Timer ();
+
+          GLib.Timeout.add (50, () => { cancellable.cancel (); return GLib.Source.REMOVE; });
+
+          try { yield role.find_value (from, key, Metrics.TraceContext (), cancellable); assert_not_reached (); } catch (GLib.Error e)
+            {
+              assert_true (e.matches (IOError.quark (), IOError.CANCELLED));
+            }
+
+          assert_cmpfloat (timer.elapsed (), GLib.CompareOperator.LT, 1.0);
+
+          /* the link stays usable after a call on it got cancelled */
+          assert_true (yield role.ping (from, Metrics.TraceContext ()));
+        }
+    }
+
+  public class TestWireFindValue : TestWireBase
+    {
+
+      protected override async void exercise (Role role) throws GLib.Error
+        {
+          var id = new Key.random ();
+
+          yield peer.value_store.insert_value (id, "value");
+
+          var found = yield role.find_value (from, KeyRef (id.bytes), Metrics.TraceContext ());
+          var value = found.get_value ();
+
+          assert_true (value != null && value.holds (typeof (string)));
+          assert_cmpstr (value.get_string (), GLib.CompareOperator.EQ, "value");
+        }
+    }
+
+  public class TestWireFindValues : TestWireBase
+    {
+
+      protected override async void exercise (Role role) throws GLib.Error
+        {
+          var ids = new Key [] { new Key.random (), new Key.random (), new Key.random () };
+
+          yield peer.value_store.insert_value (ids [0], "first");
+          yield peer.value_store.insert_value (ids [2], "third");
+
+          var keys = new KeyRef [ids.length];
+
+          for (int i = 0; i < ids.length; ++i) keys [i] = KeyRef (ids [i].bytes);
+
+          var found = yield role.find_values (from, keys, Metrics.TraceContext ());
+
+          assert_cmpuint (found.length, GLib.CompareOperator.EQ, ids.length);
+
+          var first = found [0].get_value ();
+          var second = found [1].get_value ();
+          var third = found [2].get_value ();
+
+          assert_true (first != null && first.holds (typeof (string)));
+          assert_cmpstr (first.get_string (), GLib.CompareOperator.EQ, "first");
+          assert_true (second == null || second.holds (typeof (string)) == false);
+          assert_true (third != null && third.holds (typeof (string)));
+          assert_cmpstr (third.get_string (), GLib.CompareOperator.EQ, "third");
+        }
+    }
+
+  public class TestWireStore : TestWireBase
+    {
+
+      protected override async void exercise (Role role) throws GLib.Error
+        {
+          var id = new Key.random ();
+
+          assert_true (yield role.store (from, KeyRef (id.bytes), pack ("value"), Metrics.TraceContext ()));
+
+          var value = yield peer.value_store.lookup_value (id);
+
+          assert_true (value != null && value.holds (typeof (string)));
+          assert_cmpstr (value.get_string (), GLib.CompareOperator.EQ, "value");
+        }
+    }
+
+  public class TestWireStoreMany : TestWireBase
+    {
+
+      protected override async void exercise (Role role) throws GLib.Error
+        {
+          var count = 16;
+          var keys = new KeyRef [count];
+          var ids = new Key [count];
+          var values = new GLib.Variant [count];
+
+          for (int i = 0; i < count; ++i)
+            {
+              ids [i] = new Key.random ();
+              keys [i] = KeyRef (ids [i].bytes);
+              values [i] = pack (@"value $i");
+            }
+
+          assert_true (yield role.store_many (from, keys, values, Metrics.TraceContext ()));
+
+          for (int i = 0; i < count; ++i)
+            {
+              var value = yield peer.value_store.lookup_value (ids [i]);
+
+              assert_true (value != null && value.holds (typeof (string)));
+              assert_cmpstr (value.get_string (), GLib.CompareOperator.EQ, @"value $i");
+            }
+        }
+    }
+
+  /* the caller's trace context crosses the wire only when sampled, and served spans hang under it */
+  public class TestWireTrace : TestWireBase
+    {
+
+      protected override async void exercise (Role role) throws GLib.Error
+        {
+          var key = KeyRef (new Key.random ().bytes);
+          var looked = false;
+          var sampled = Metrics.TraceContext () { trace = 0x1234, parent = 0x5678 };
+          var served = (uint64) 0;
+          var tracer = Metrics.Tracer.get_default ();
+
+          tracer.clear ();
+          yield role.find_value (from, key, Metrics.TraceContext ());
+
+          assert_cmpint (tracer.collect ().length, GLib.CompareOperator.EQ, 0);
+
+          yield role.find_value (from, key, sampled);
+
+          var spans = tracer.collect ();
+
+          foreach (unowned var span in spans) if (span.name == "serve FindValue")
+            {
+              assert_true (span.trace == sampled.trace);
+              assert_true (span.parent == sampled.parent);
+              served = span.id;
+            }
+
+          assert_true (served != 0);
+
+          foreach (unowned var span in spans) if (span.name == "store lookup")
+            {
+              assert_true (span.trace == sampled.trace);
+              assert_true (span.parent == served);
+              looked = true;
+            }
+
+          assert_true (looked);
+        }
+    }
+
+  /*
+   * One peer served by a loopback NetworkHub and a second hub dialing it;
+   * subclasses get the datagram role the dialing hub derived from the
+   * encrypted link, which only ever talks UDP
+   */
+
+  public abstract class TestDatagramBase : AsyncTest
+    {
+      protected NetworkHub client;
+      protected PeerRef from;
+      protected PeerImpl peer;
+
+      construct
+        {
+          from = PeerRef.anonymous (new Key.random ().bytes);
+          peer = new PeerImpl (new DummyValueStore ());
+        }
+
+      protected abstract async void exercise (Role role) throws GLib.Error;
+
+      protected override async void test ()
+        {
+          Address address;
+          Role? role;
+
+          var server = new NetworkHub ();
+
+          client = new NetworkHub ();
+
+          try
+            {
+              server.add_local_peer ("testing", peer);
+              yield server.add_local_address ("127.0.0.1", 0);
+              server.start ();
+
+              address = server.list_local_addresses () [0];
+              yield client.join_at (address.address, address.port, "testing");
+            }
+          catch (GLib.Error e)
+            {
+              assert_no_error (e);
+              return;
+            }
+
+          role = client.pick_datagram_role (peer.id);
+          assert_nonnull (role);
+
+          try { yield exercise (role); } catch (GLib.Error e)
+            {
+              assert_no_error (e);
+            }
+
+          server.stop ();
+        }
+    }
+
+  public class TestDatagramFindNode : TestDatagramBase
+    {
+
+      protected override async void exercise (Role role) throws GLib.Error
+        {
+          for (uint i = 0; i < 20; ++i) peer.add_contact (new Key.random ());
+
+          var found = yield role.find_node (from, KeyRef (new Key.random ().bytes), Metrics.TraceContext ());
+
+          assert_cmpuint (found.length, GLib.CompareOperator.GT, 0);
+        }
+    }
+
+  public class TestDatagramPing : TestDatagramBase
+    {
+
+      protected override async void exercise (Role role) throws GLib.Error
+        {
+          for (uint i = 0; i < 8; ++i) assert_true (yield role.ping (from, Metrics.TraceContext ()));
+        }
+    }
+
+  public class TestDatagramUnlinked : TestDatagramBase
+    {
+
+      protected override async void exercise (Role role) throws GLib.Error
+        {
+          var dbus = ((GLib.DBusProxy) client.pick_contact_role (peer.id)).get_connection ();
+
+          /* the channel has to outlive the stream it got its keys from */
+          yield dbus.close ();
+
+          GLib.Idle.add (exercise.callback);
+          yield;
+
+          assert_true (dbus.is_closed ());
+          assert_true (yield role.ping (from, Metrics.TraceContext ()));
+        }
+    }
+}